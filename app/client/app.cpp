@@ -12,6 +12,7 @@ void SimpleRenderProcessHandler::OnContextCreated(
     CefRefPtr<CefV8Context> context) {
   // Register JavaScript functions with the new context
   message_router_->OnContextCreated(browser, frame, context);
+  binary_channel_.OnContextCreated(browser, frame, context);
 }
 
 void SimpleRenderProcessHandler::OnContextReleased(
@@ -19,12 +20,15 @@ void SimpleRenderProcessHandler::OnContextReleased(
     CefRefPtr<CefV8Context> context) {
   // Clean up context
   message_router_->OnContextReleased(browser, frame, context);
+  binary_channel_.OnContextReleased(browser, frame, context);
 }
 
 bool SimpleRenderProcessHandler::OnProcessMessageReceived(
     CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
     CefProcessId source_process, CefRefPtr<CefProcessMessage> message) {
   // Handle process messages
+  if (binary_channel_.OnProcessMessageReceived(browser, frame, message))
+    return true;
   return message_router_->OnProcessMessageReceived(browser, frame,
                                                    source_process, message);
 }
@@ -2,6 +2,7 @@
 #include "include/cef_app.h"
 #include "include/cef_render_process_handler.h"
 #include "include/wrapper/cef_message_router.h"
+#include "../internal/binaryrenderer.hpp"
 
 // Render process handler for message router
 class SimpleRenderProcessHandler : public CefRenderProcessHandler {
@@ -24,6 +25,8 @@ public:
 
 private:
   CefRefPtr<CefMessageRouterRendererSide> message_router_;
+  // window.cefBinaryQuery
+  SimpleIPC::BinaryChannelRenderer binary_channel_;
   IMPLEMENT_REFCOUNTING(SimpleRenderProcessHandler);
 };
 
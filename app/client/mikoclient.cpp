@@ -1,10 +1,16 @@
 #include "mikoclient.hpp"
+#include "../internal/eventbus.hpp"
+#include "../internal/perfecthash.hpp"
 #include "../internal/simpleipc.hpp"
 #include "client.hpp"
 #include "offscreenrender.hpp"
 #include "windowed.hpp"
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <iterator>
+#include <sstream>
+#include <string_view>
 #ifndef _WIN32
 #include <unistd.h>
 #endif
@@ -33,6 +39,41 @@ constexpr int kVirtualKeyF5 = 0x74;
 constexpr int kVirtualKeyF11 = 0x7A;
 constexpr int kVirtualKeyF12 = 0x7B;
 
+// JSON query types, in the order of HyperionClient::HandleJsonQuery's table
+constexpr std::string_view kQueryTypes[] = {
+    "open_menu_overlay", "menu_item_click",        "open_editor",
+    "close_editor",      "editor_position_update", "auto_height_result"};
+constexpr size_t kQueryTypeCount = std::size(kQueryTypes);
+constexpr SimpleIPC::PerfectHash<kQueryTypeCount, 16>
+    kQueryTypeHash(kQueryTypes);
+static_assert(kQueryTypeHash.Valid(),
+              "no collision-free seed for the query types; grow the table");
+
+// Handling cost per query type, parsing included. Only touched on the UI
+// thread.
+struct QueryTiming {
+  uint64_t count = 0;
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+};
+QueryTiming g_query_timings[kQueryTypeCount];
+
+// {"<type>": {"count": n, "avgUs": ..., "maxUs": ...}, ...}
+std::string HandleQueryStats(const std::string &message) {
+  std::ostringstream ss;
+  ss << "{";
+  for (size_t i = 0; i < kQueryTypeCount; ++i) {
+    const QueryTiming &timing = g_query_timings[i];
+    double average =
+        timing.count ? double(timing.totalNs) / timing.count / 1000.0 : 0.0;
+    ss << (i ? "," : "") << "\"" << kQueryTypes[i] << "\": {\"count\": "
+       << timing.count << ", \"avgUs\": " << average
+       << ", \"maxUs\": " << timing.maxNs / 1000.0 << "}";
+  }
+  ss << "}";
+  return ss.str();
+}
+
 } // namespace
 
 bool HyperionClient::OnCursorChange(CefRefPtr<CefBrowser> browser,
@@ -102,6 +143,10 @@ HyperionClient::HyperionClient(SDL3Window *window)
   if (window_) {
     window_->SetClient(this);
   }
+
+  // Reads the timings HandleJsonQuery records on this thread
+  SimpleIPC::IPCHandler::GetInstance().RegisterHandler(
+      "queryStats", HandleQueryStats, {SimpleIPC::HandlerThread::UI});
 }
 bool HyperionClient::OnQuery(
     CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, int64_t query_id,
@@ -111,377 +156,63 @@ bool HyperionClient::OnQuery(
 
   std::string request_str = request.ToString();
 
-  // Handle JSON-based menu overlay requests
-  if (request_str.find("{") == 0) {
-    try {
-      // Parse JSON request
-      size_t type_pos = request_str.find("\"type\":");
-      if (type_pos != std::string::npos) {
-        size_t type_start = request_str.find("\"", type_pos + 7) + 1;
-        size_t type_end = request_str.find("\"", type_start);
-        std::string type =
-            request_str.substr(type_start, type_end - type_start);
-
-        if (type == "open_menu_overlay") {
-          Logger::LogMessage("DEBUG: Starting open_menu_overlay handler");
-          Logger::LogMessage("DEBUG: Request string: " + request_str);
-
-          try {
-            Logger::LogMessage("DEBUG: Extracting JSON fields");
-            // Extract section, x, y from JSON
-            size_t section_pos = request_str.find("\"section\":");
-            size_t x_pos = request_str.find("\"x\":");
-            size_t y_pos = request_str.find("\"y\":");
-            size_t width_pos = request_str.find("\"width\":");
-            size_t height_pos = request_str.find("\"height\":");
-
-            int width = 0;
-            int height = 0;
-            Logger::LogMessage("DEBUG: Found positions - section: " +
-                               std::to_string(section_pos) +
-                               ", x: " + std::to_string(x_pos) +
-                               ", y: " + std::to_string(y_pos));
-
-            if (width_pos != std::string::npos) {
-              size_t w_start = request_str.find(":", width_pos) + 1;
-              size_t w_end = request_str.find_first_of(",}", w_start);
-              width = std::stoi(request_str.substr(w_start, w_end - w_start));
-            }
-            if (height_pos != std::string::npos) {
-              size_t h_start = request_str.find(":", height_pos) + 1;
-              size_t h_end = request_str.find_first_of(",}", h_start);
-              height = std::stoi(request_str.substr(h_start, h_end - h_start));
-            }
-            if (section_pos != std::string::npos &&
-                x_pos != std::string::npos && y_pos != std::string::npos) {
-              Logger::LogMessage("DEBUG: Extracting section");
-              // Extract section
-              size_t section_start =
-                  request_str.find("\"", section_pos + 10) + 1;
-              size_t section_end = request_str.find("\"", section_start);
-              std::string section = request_str.substr(
-                  section_start, section_end - section_start);
-              Logger::LogMessage("DEBUG: Extracted section: " + section);
-
-              Logger::LogMessage("DEBUG: Extracting x coordinate");
-              // Extract x coordinate (handle numeric values without quotes)
-              size_t x_colon = request_str.find(":", x_pos);
-              size_t x_start = x_colon + 1;
-              // Skip any whitespace
-              while (x_start < request_str.length() &&
-                     (request_str[x_start] == ' ' ||
-                      request_str[x_start] == '\t')) {
-                x_start++;
-              }
-              size_t x_end = request_str.find(",", x_start);
-              if (x_end == std::string::npos)
-                x_end = request_str.find("}", x_start);
-              std::string x_str = request_str.substr(x_start, x_end - x_start);
-              // Trim whitespace
-              x_str.erase(0, x_str.find_first_not_of(" \t"));
-              x_str.erase(x_str.find_last_not_of(" \t") + 1);
-              Logger::LogMessage("DEBUG: x_str before conversion: '" + x_str +
-                                 "'");
-              int x = static_cast<int>(std::stod(x_str));
-              Logger::LogMessage("DEBUG: Extracted x: " + std::to_string(x));
-
-              Logger::LogMessage("DEBUG: Extracting y coordinate");
-              // Extract y coordinate (handle numeric values without quotes)
-              size_t y_colon = request_str.find(":", y_pos);
-              size_t y_start = y_colon + 1;
-              // Skip any whitespace
-              while (y_start < request_str.length() &&
-                     (request_str[y_start] == ' ' ||
-                      request_str[y_start] == '\t')) {
-                y_start++;
-              }
-              size_t y_end = request_str.find("}", y_start);
-              if (y_end == std::string::npos)
-                y_end = request_str.find(",", y_start);
-              std::string y_str = request_str.substr(y_start, y_end - y_start);
-              // Trim whitespace
-              y_str.erase(0, y_str.find_first_not_of(" \t"));
-              y_str.erase(y_str.find_last_not_of(" \t") + 1);
-              Logger::LogMessage("DEBUG: y_str before conversion: '" + y_str +
-                                 "'");
-              int y = static_cast<int>(std::stod(y_str));
-              Logger::LogMessage("DEBUG: Extracted y: " + std::to_string(y));
-
-              Logger::LogMessage(
-                  "Processing menu overlay request for section: " + section +
-                  " at (" + std::to_string(x) + ", " + std::to_string(y) + ")");
-
-              Logger::LogMessage(
-                  "DEBUG: About to call OpenMenuOverlay or CloseMenuOverlay");
-              // Handle menu overlay opening
-              if (section == "close") {
-                Logger::LogMessage("DEBUG: Calling CloseMenuOverlay");
-                CloseMenuOverlay();
-              } else {
-                Logger::LogMessage("DEBUG: Calling OpenMenuOverlay");
-                OpenMenuOverlay(section, x, y, width, height);
-              }
-              Logger::LogMessage(
-                  "DEBUG: Successfully completed menu overlay operation");
-            } else {
-              Logger::LogMessage("DEBUG: Missing required JSON fields");
-            }
-
-            callback->Success("success");
-            return true;
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in open_menu_overlay handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error in menu overlay");
-            return true;
-          } catch (...) {
-            Logger::LogMessage("Unknown exception in open_menu_overlay handler "
-                               "(possibly 0xe06d7363)");
-            callback->Failure(500, "Unknown error in menu overlay");
-            return true;
-          }
-        } else if (type == "menu_item_click") {
-          try {
-            // Extract section and action from JSON
-            size_t section_pos = request_str.find("\"section\":");
-            size_t action_pos = request_str.find("\"action\":");
-
-            if (section_pos != std::string::npos &&
-                action_pos != std::string::npos) {
-              // Extract section
-              size_t section_start =
-                  request_str.find("\"", section_pos + 10) + 1;
-              size_t section_end = request_str.find("\"", section_start);
-              std::string section = request_str.substr(
-                  section_start, section_end - section_start);
-
-              // Extract action
-              size_t action_start = request_str.find("\"", action_pos + 9) + 1;
-              size_t action_end = request_str.find("\"", action_start);
-              std::string action =
-                  request_str.substr(action_start, action_end - action_start);
-
-              // Log menu item click for debugging
-              Logger::LogMessage("Menu item clicked - Section: " + section +
-                                 ", Action: " + action);
-
-              // Close menu overlay after click
-              CloseMenuOverlay();
-
-              callback->Success("success");
-              return true;
-            } else {
-              Logger::LogMessage("Invalid menu item click parameters");
-              callback->Failure(400, "Invalid parameters");
-              return true;
-            }
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in menu_item_click handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error in menu item click");
-            return true;
-          } catch (...) {
-            Logger::LogMessage("Unknown exception in menu_item_click handler "
-                               "(possibly 0xe06d7363)");
-            callback->Failure(500, "Unknown error in menu item click");
-            return true;
-          }
-        } else if (type == "open_editor") {
-          try {
-            // Extract position and dimensions from JSON
-            size_t x_pos = request_str.find("\"x\":");
-            size_t y_pos = request_str.find("\"y\":");
-            size_t width_pos = request_str.find("\"width\":");
-            size_t height_pos = request_str.find("\"height\":");
-
-            if (x_pos != std::string::npos && y_pos != std::string::npos &&
-                width_pos != std::string::npos &&
-                height_pos != std::string::npos) {
-
-              // Extract x coordinate
-              size_t x_start = request_str.find(":", x_pos) + 1;
-              size_t x_end = request_str.find_first_of(",}", x_start);
-              int x = std::stoi(request_str.substr(x_start, x_end - x_start));
-
-              // Extract y coordinate
-              size_t y_start = request_str.find(":", y_pos) + 1;
-              size_t y_end = request_str.find_first_of(",}", y_start);
-              int y = std::stoi(request_str.substr(y_start, y_end - y_start));
-
-              // Extract width
-              size_t width_start = request_str.find(":", width_pos) + 1;
-              size_t width_end = request_str.find_first_of(",}", width_start);
-              int width = std::stoi(
-                  request_str.substr(width_start, width_end - width_start));
-
-              // Extract height
-              size_t height_start = request_str.find(":", height_pos) + 1;
-              size_t height_end = request_str.find_first_of(",}", height_start);
-              int height = std::stoi(
-                  request_str.substr(height_start, height_end - height_start));
-
-              Logger::LogMessage(
-                  "Opening editor at position: " + std::to_string(x) + "," +
-                  std::to_string(y) + " with size: " + std::to_string(width) +
-                  "x" + std::to_string(height));
-
-              // Open editor using the same technique as menu overlay
-              OpenEditor(x, y, width, height);
-
-              callback->Success("success");
-              return true;
-            } else {
-              Logger::LogMessage(
-                  "DEBUG: Missing required JSON fields for editor");
-              callback->Failure(400, "Missing required parameters");
-              return true;
-            }
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in open_editor handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error in editor");
-            return true;
-          } catch (...) {
-            Logger::LogMessage("Unknown exception in open_editor handler "
-                               "(possibly 0xe06d7363)");
-            callback->Failure(500, "Unknown error in editor");
-            return true;
-          }
-        } else if (type == "close_editor") {
-          try {
-            Logger::LogMessage("Closing editor");
-            CloseEditor();
-            callback->Success("success");
-            return true;
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in close_editor handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error closing editor");
-            return true;
-          } catch (...) {
-            Logger::LogMessage("Unknown exception in close_editor handler "
-                               "(possibly 0xe06d7363)");
-            callback->Failure(500, "Unknown error closing editor");
-            return true;
-          }
-        } else if (type == "editor_position_update") {
-          try {
-            // Extract new position and dimensions from JSON
-            size_t x_pos = request_str.find("\"x\":");
-            size_t y_pos = request_str.find("\"y\":");
-            size_t width_pos = request_str.find("\"width\":");
-            size_t height_pos = request_str.find("\"height\":");
-
-            if (x_pos != std::string::npos && y_pos != std::string::npos &&
-                width_pos != std::string::npos &&
-                height_pos != std::string::npos) {
-
-              // Extract coordinates and dimensions
-              size_t x_start = request_str.find(":", x_pos) + 1;
-              size_t x_end = request_str.find_first_of(",}", x_start);
-              int x = std::stoi(request_str.substr(x_start, x_end - x_start));
-
-              size_t y_start = request_str.find(":", y_pos) + 1;
-              size_t y_end = request_str.find_first_of(",}", y_start);
-              int y = std::stoi(request_str.substr(y_start, y_end - y_start));
-
-              size_t width_start = request_str.find(":", width_pos) + 1;
-              size_t width_end = request_str.find_first_of(",}", width_start);
-              int width = std::stoi(
-                  request_str.substr(width_start, width_end - width_start));
-
-              size_t height_start = request_str.find(":", height_pos) + 1;
-              size_t height_end = request_str.find_first_of(",}", height_start);
-              int height = std::stoi(
-                  request_str.substr(height_start, height_end - height_start));
-
-              Logger::LogMessage(
-                  "Updating editor position to: " + std::to_string(x) + "," +
-                  std::to_string(y) + " with size: " + std::to_string(width) +
-                  "x" + std::to_string(height));
-
-              // Update editor position using window method
-              if (window_) {
-                window_->SetEditorPosition(x, y, width, height);
-              }
-
-              callback->Success("success");
-              return true;
-            } else {
-              Logger::LogMessage("DEBUG: Missing required JSON fields for "
-                                 "editor position update");
-              callback->Failure(400, "Missing required parameters");
-              return true;
-            }
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in editor_position_update handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error updating editor position");
-            return true;
-          } catch (...) {
-            Logger::LogMessage("Unknown exception in editor_position_update "
-                               "handler (possibly 0xe06d7363)");
-            callback->Failure(500, "Unknown error updating editor position");
-            return true;
-          }
-        } else if (type == "auto_height_result") {
-          try {
-            // Extract height from JSON
-            size_t height_pos = request_str.find("\"height\":");
-
-            if (height_pos != std::string::npos) {
-              size_t height_start = request_str.find(":", height_pos) + 1;
-              size_t height_end = request_str.find_first_of(",}", height_start);
-              int height = std::stoi(
-                  request_str.substr(height_start, height_end - height_start));
-
-              Logger::LogMessage("Received auto height result: " +
-                                 std::to_string(height));
-
-              // Resize menu overlay to the calculated height
-              if (window_ && menu_overlay_active_) {
-                window_->ResizeMenuOverlay(height);
-              }
-
-              callback->Success("success");
-              return true;
-            } else {
-              Logger::LogMessage(
-                  "DEBUG: Missing height field in auto_height_result");
-              callback->Failure(400, "Missing height parameter");
-              return true;
-            }
-          } catch (const std::exception &ex) {
-            Logger::LogMessage("Exception in auto_height_result handler: " +
-                               std::string(ex.what()));
-            callback->Failure(500, "Internal error processing auto height");
-            return true;
-          } catch (...) {
-            Logger::LogMessage(
-                "Unknown exception in auto_height_result handler");
-            callback->Failure(500, "Unknown error processing auto height");
-            return true;
-          }
-        }
-      }
-    } catch (const std::exception &) {
-      callback->Failure(-1, "Failed to parse menu overlay request");
+  // JSON requests from the web UI ({"type": "...", ...}); unknown types
+  // fall through to the other formats
+  if (!request_str.empty() && request_str[0] == '{' &&
+      HandleJsonQuery(request_str, callback)) {
+    return true;
+  }
+
+  // Event bus subscriptions: "event_subscribe:<topics>" (persistent),
+  // "event_topics:<id>:<topics>" and "event_ack:<id>:<seq>"
+  if (request_str.compare(0, 16, "event_subscribe:") == 0) {
+    if (!persistent) {
+      callback->Failure(400, "Event subscriptions must be persistent");
+      return true;
+    }
+    SimpleIPC::EventBus::GetInstance().Subscribe(
+        query_id, SimpleIPC::EventBus::ParseTopics(request_str.substr(16)),
+        [callback](const std::string &message) { callback->Success(message); });
+    return true;
+  }
+  if (request_str.compare(0, 13, "event_topics:") == 0 ||
+      request_str.compare(0, 10, "event_ack:") == 0) {
+    bool ack = request_str.compare(0, 10, "event_ack:") == 0;
+    const char *id_start = request_str.c_str() + (ack ? 10 : 13);
+    char *id_end = nullptr;
+    int64_t id = std::strtoll(id_start, &id_end, 10);
+    if (id_end == id_start || *id_end != ':') {
+      callback->Failure(400, "Invalid event subscription id");
       return true;
     }
+    auto &events = SimpleIPC::EventBus::GetInstance();
+    if (ack) {
+      events.Acknowledge(id, std::strtoull(id_end + 1, nullptr, 10));
+    } else {
+      events.SetTopics(id, SimpleIPC::EventBus::ParseTopics(id_end + 1));
+    }
+    callback->Success("");
+    return true;
   }
 
   // Handle IPC calls
   if (request_str.find("ipc_call:") == 0) {
-    // Parse IPC call format: "ipc_call:method:message"
+    // Parse IPC call format: "ipc_call:method:message", where method may
+    // also be "#<id>" (see IPCHandler::MethodId)
     size_t first_colon = request_str.find(':', 9); // Skip "ipc_call:"
     if (first_colon != std::string::npos) {
       std::string method = request_str.substr(9, first_colon - 9);
       std::string message = request_str.substr(first_colon + 1);
 
-      // Handle the IPC call
-      std::string response =
-          SimpleIPC::IPCHandler::GetInstance().HandleCall(method, message);
-      callback->Success(response);
+      // Handled on the UI thread or the IPC worker pool depending on the
+      // method; the response arrives later on the UI thread
+      SimpleIPC::IPCHandler::GetInstance().Dispatch(
+          query_id, method, std::move(message),
+          [callback](bool success, const std::string &response) {
+            // Failures resolve as "Error: ..." strings, as handlers'
+            // own errors do
+            callback->Success(success ? response : "Error: " + response);
+          });
       return true;
     }
   }
@@ -522,6 +253,176 @@ bool HyperionClient::OnQuery(
   return false;
 }
 
+bool HyperionClient::HandleJsonQuery(
+    const std::string &request,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  static constexpr QueryHandler kHandlers[kQueryTypeCount] = {
+      &HyperionClient::HandleOpenMenuOverlay,
+      &HyperionClient::HandleMenuItemClick,
+      &HyperionClient::HandleOpenEditor,
+      &HyperionClient::HandleCloseEditor,
+      &HyperionClient::HandleEditorPositionUpdate,
+      &HyperionClient::HandleAutoHeightResult};
+
+  auto start = std::chrono::steady_clock::now();
+  SimpleIPC::QueryJson query;
+  std::string_view type;
+  std::string scratch;
+  if (!query.Parse(request) || !query.GetString("type", type, scratch))
+    return false;
+  int index = kQueryTypeHash.Find(type);
+  if (index < 0)
+    return false;
+
+  try {
+    (this->*kHandlers[index])(query, callback);
+  } catch (const std::exception &ex) {
+    Logger::Error("Exception in " + std::string(type) +
+                  " handler: " + ex.what());
+    callback->Failure(500, "Internal error in " + std::string(type));
+  } catch (...) {
+    Logger::Error("Unknown exception in " + std::string(type) + " handler");
+    callback->Failure(500, "Unknown error in " + std::string(type));
+  }
+
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  QueryTiming &timing = g_query_timings[index];
+  ++timing.count;
+  timing.totalNs += elapsed;
+  timing.maxNs = std::max(timing.maxNs, elapsed);
+  return true;
+}
+
+void HyperionClient::HandleOpenMenuOverlay(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  std::string section;
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+  query.GetInt("width", width);
+  query.GetInt("height", height);
+
+  if (query.GetString("section", section) && query.GetInt("x", x) &&
+      query.GetInt("y", y)) {
+    Logger::LogMessage("Processing menu overlay request for section: " +
+                       section + " at (" + std::to_string(x) + ", " +
+                       std::to_string(y) + ")");
+    if (section == "close") {
+      CloseMenuOverlay();
+    } else {
+      OpenMenuOverlay(section, x, y, width, height);
+    }
+  } else {
+    LOG_DEBUG("open_menu_overlay without section, x or y");
+  }
+
+  callback->Success("success");
+}
+
+void HyperionClient::HandleMenuItemClick(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  std::string section;
+  std::string action;
+  if (!query.GetString("section", section) ||
+      !query.GetString("action", action)) {
+    Logger::LogMessage("Invalid menu item click parameters");
+    callback->Failure(400, "Invalid parameters");
+    return;
+  }
+
+  Logger::LogMessage("Menu item clicked - Section: " + section +
+                     ", Action: " + action);
+
+  // Close menu overlay after click
+  CloseMenuOverlay();
+  callback->Success("success");
+}
+
+void HyperionClient::HandleOpenEditor(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  int x, y, width, height;
+  if (!query.GetInt("x", x) || !query.GetInt("y", y) ||
+      !query.GetInt("width", width) || !query.GetInt("height", height)) {
+    LOG_DEBUG("open_editor without x, y, width or height");
+    callback->Failure(400, "Missing required parameters");
+    return;
+  }
+
+  Logger::LogMessage("Opening editor at position: " + std::to_string(x) +
+                     "," + std::to_string(y) +
+                     " with size: " + std::to_string(width) + "x" +
+                     std::to_string(height));
+
+  // Open editor using the same technique as menu overlay
+  OpenEditor(x, y, width, height);
+  callback->Success("success");
+}
+
+void HyperionClient::HandleCloseEditor(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  Logger::LogMessage("Closing editor");
+  CloseEditor();
+  callback->Success("success");
+}
+
+void HyperionClient::HandleEditorPositionUpdate(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  // Sent on every layout change, so nothing here may log in release builds
+  int x, y, width, height;
+  if (!query.GetInt("x", x) || !query.GetInt("y", y) ||
+      !query.GetInt("width", width) || !query.GetInt("height", height)) {
+    LOG_DEBUG("editor_position_update without x, y, width or height");
+    callback->Failure(400, "Missing required parameters");
+    return;
+  }
+
+  LOG_DEBUG("Updating editor position to: " + std::to_string(x) + "," +
+            std::to_string(y) + " with size: " + std::to_string(width) + "x" +
+            std::to_string(height));
+
+  if (window_) {
+    window_->SetEditorPosition(x, y, width, height);
+  }
+  callback->Success("success");
+}
+
+void HyperionClient::HandleAutoHeightResult(
+    const SimpleIPC::QueryJson &query,
+    CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) {
+  int height;
+  if (!query.GetInt("height", height)) {
+    LOG_DEBUG("auto_height_result without height");
+    callback->Failure(400, "Missing height parameter");
+    return;
+  }
+
+  LOG_DEBUG("Received auto height result: " + std::to_string(height));
+
+  // Resize menu overlay to the calculated height
+  if (window_ && menu_overlay_active_) {
+    window_->ResizeMenuOverlay(height);
+  }
+  callback->Success("success");
+}
+
+void HyperionClient::OnQueryCanceled(CefRefPtr<CefBrowser> browser,
+                                     CefRefPtr<CefFrame> frame,
+                                     int64_t query_id) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // The page navigated away, closed or cancelled the query itself
+  SimpleIPC::IPCHandler::GetInstance().Cancel(query_id);
+  SimpleIPC::EventBus::GetInstance().Unsubscribe(query_id);
+}
+
 void HyperionClient::OnTitleChange(CefRefPtr<CefBrowser> browser,
                                    const CefString &title) {
   CEF_REQUIRE_UI_THREAD();
@@ -616,6 +517,7 @@ bool HyperionClient::OnBeforeBrowse(CefRefPtr<CefBrowser> browser,
   CEF_REQUIRE_UI_THREAD();
 
   message_router_->OnBeforeBrowse(browser, frame);
+  binary_channel_.OnBeforeBrowse(browser, frame);
   return false;
 }
 
@@ -645,10 +547,22 @@ bool HyperionClient::OnProcessMessageReceived(
     CefProcessId source_process, CefRefPtr<CefProcessMessage> message) {
   CEF_REQUIRE_UI_THREAD();
 
+  if (binary_channel_.OnProcessMessageReceived(browser, frame, message))
+    return true;
   return message_router_->OnProcessMessageReceived(browser, frame,
                                                    source_process, message);
 }
 
+void HyperionClient::OnRenderProcessTerminated(
+    CefRefPtr<CefBrowser> browser, TerminationStatus status, int error_code,
+    const CefString &error_string) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // Cancels the queries of the crashed renderer
+  message_router_->OnRenderProcessTerminated(browser);
+  binary_channel_.CancelBrowser(browser->GetIdentifier());
+}
+
 bool HyperionClient::OnBeforePopup(
     CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, int popup_id,
     const CefString &target_url, const CefString &target_frame_name,
@@ -733,6 +647,10 @@ bool HyperionClient::DoClose(CefRefPtr<CefBrowser> browser) {
 void HyperionClient::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
   CEF_REQUIRE_UI_THREAD();
 
+  // Cancels the browser's pending queries
+  message_router_->OnBeforeClose(browser);
+  binary_channel_.CancelBrowser(browser->GetIdentifier());
+
   // Check if this is the menu overlay browser being closed
   if (menu_overlay_browser_ && menu_overlay_browser_->IsSame(browser)) {
     menu_overlay_active_ = false;
@@ -13,6 +13,8 @@
 #include "include/cef_request_handler.h"
 #include "include/cef_task.h"
 #include "include/wrapper/cef_message_router.h"
+#include "../internal/binaryhost.hpp"
+#include "../internal/queryjson.hpp"
 #include <list>
 
 // Forward declarations
@@ -56,6 +58,9 @@ public:
   OnQuery(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
           int64_t query_id, const CefString &request, bool persistent,
           CefRefPtr<CefMessageRouterBrowserSide::Callback> callback) override;
+  virtual void OnQueryCanceled(CefRefPtr<CefBrowser> browser,
+                               CefRefPtr<CefFrame> frame,
+                               int64_t query_id) override;
 
   // CefDisplayHandler methods
   virtual void OnTitleChange(CefRefPtr<CefBrowser> browser,
@@ -128,6 +133,11 @@ public:
                            CefProcessId source_process,
                            CefRefPtr<CefProcessMessage> message) override;
 
+  virtual void OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
+                                         TerminationStatus status,
+                                         int error_code,
+                                         const CefString &error_string) override;
+
   // CefRequestHandler methods
   virtual CefRefPtr<CefResourceHandler>
   GetResourceHandler(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
@@ -179,6 +189,31 @@ public:
 
 private:
   typedef std::list<CefRefPtr<CefBrowser>> BrowserList;
+
+  // JSON queries from the web UI, dispatched on their "type" member
+  typedef void (HyperionClient::*QueryHandler)(
+      const SimpleIPC::QueryJson &query,
+      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  bool HandleJsonQuery(const std::string &request,
+                       CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void HandleOpenMenuOverlay(
+      const SimpleIPC::QueryJson &query,
+      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void
+  HandleMenuItemClick(const SimpleIPC::QueryJson &query,
+                      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void HandleOpenEditor(const SimpleIPC::QueryJson &query,
+                        CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void HandleCloseEditor(
+      const SimpleIPC::QueryJson &query,
+      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void HandleEditorPositionUpdate(
+      const SimpleIPC::QueryJson &query,
+      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+  void HandleAutoHeightResult(
+      const SimpleIPC::QueryJson &query,
+      CefRefPtr<CefMessageRouterBrowserSide::Callback> callback);
+
   BrowserList browser_list_;
 
   // SDL3 window reference
@@ -187,6 +222,9 @@ private:
   // Message router for handling JavaScript queries
   CefRefPtr<CefMessageRouterBrowserSide> message_router_;
 
+  // Serves window.cefBinaryQuery calls
+  SimpleIPC::BinaryChannelHost binary_channel_;
+
   // Binary resource provider for handling miko:// protocol
   CefRefPtr<BinaryResourceProvider> resource_provider_;
 
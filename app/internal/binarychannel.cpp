@@ -0,0 +1,94 @@
+#include "binarychannel.hpp"
+#include "include/cef_shared_process_message_builder.h"
+#include "include/cef_values.h"
+#include <cstring>
+
+namespace SimpleIPC {
+
+const char kBinaryMessageName[] = "miko.binary";
+
+namespace {
+
+struct FrameHeader {
+  uint32_t requestId;
+  uint8_t kind;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(FrameHeader) == 8, "frame header is sent as is");
+
+void WriteHeader(void *target, uint32_t requestId, BinaryFrameKind kind) {
+  FrameHeader header = {};
+  header.requestId = requestId;
+  header.kind = static_cast<uint8_t>(kind);
+  std::memcpy(target, &header, sizeof(header));
+}
+
+} // namespace
+
+bool SendBinaryFrame(CefRefPtr<CefFrame> frame, CefProcessId target,
+                     uint32_t requestId, BinaryFrameKind kind,
+                     std::string_view body) {
+  if (!frame || !frame->IsValid())
+    return false;
+
+  size_t size = sizeof(FrameHeader) + body.size();
+  if (size >= kSharedMemoryThreshold) {
+    // Written once into the region; the receiver maps the same pages
+    CefRefPtr<CefSharedProcessMessageBuilder> builder =
+        CefSharedProcessMessageBuilder::Create(kBinaryMessageName, size);
+    if (!builder || !builder->IsValid())
+      return false;
+    auto *memory = static_cast<char *>(builder->Memory());
+    WriteHeader(memory, requestId, kind);
+    std::memcpy(memory + sizeof(FrameHeader), body.data(), body.size());
+    CefRefPtr<CefProcessMessage> message = builder->Build();
+    if (!message)
+      return false;
+    frame->SendProcessMessage(target, message);
+    return true;
+  }
+
+  std::string data(size, '\0');
+  WriteHeader(&data[0], requestId, kind);
+  std::memcpy(&data[sizeof(FrameHeader)], body.data(), body.size());
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create(kBinaryMessageName);
+  message->GetArgumentList()->SetBinary(
+      0, CefBinaryValue::Create(data.data(), data.size()));
+  frame->SendProcessMessage(target, message);
+  return true;
+}
+
+bool ReadBinaryFrame(CefRefPtr<CefProcessMessage> message, uint32_t &requestId,
+                     BinaryFrameKind &kind, std::string_view &body) {
+  if (!message || message->GetName() != kBinaryMessageName)
+    return false;
+
+  const char *data = nullptr;
+  size_t size = 0;
+  CefRefPtr<CefSharedMemoryRegion> region = message->GetSharedMemoryRegion();
+  if (region && region->IsValid()) {
+    data = static_cast<const char *>(region->Memory());
+    size = region->Size();
+  } else {
+    CefRefPtr<CefListValue> arguments = message->GetArgumentList();
+    if (!arguments || arguments->GetType(0) != VTYPE_BINARY)
+      return false;
+    CefRefPtr<CefBinaryValue> binary = arguments->GetBinary(0);
+    data = static_cast<const char *>(binary->GetRawData());
+    size = binary->GetSize();
+  }
+  if (!data || size < sizeof(FrameHeader))
+    return false;
+
+  FrameHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.kind > static_cast<uint8_t>(BinaryFrameKind::Cancel))
+    return false;
+  requestId = header.requestId;
+  kind = static_cast<BinaryFrameKind>(header.kind);
+  body = std::string_view(data + sizeof(FrameHeader), size - sizeof(header));
+  return true;
+}
+
+} // namespace SimpleIPC
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "include/cef_frame.h"
+#include "include/cef_process_message.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace SimpleIPC {
+
+// Process message carrying one frame of the binary channel. Each frame is
+// a fixed header followed by a CBOR body:
+//   Call   - method name (text), then the request item
+//   Reply  - the response item
+//   Error  - error message (text)
+//   Cancel - empty; sent by the renderer when a call is abandoned
+extern const char kBinaryMessageName[];
+
+enum class BinaryFrameKind : uint8_t {
+  Call = 0,
+  Reply = 1,
+  Error = 2,
+  Cancel = 3,
+};
+
+// Frames from this size on go through a shared memory region rather than a
+// CefBinaryValue, which is copied again by every layer it passes through
+constexpr size_t kSharedMemoryThreshold = 64 * 1024;
+
+// Sends a frame to the other process; false when the frame is gone or the
+// message could not be built
+bool SendBinaryFrame(CefRefPtr<CefFrame> frame, CefProcessId target,
+                     uint32_t requestId, BinaryFrameKind kind,
+                     std::string_view body);
+
+// Parses a kBinaryMessageName message. body points into the message's own
+// memory (its binary argument or shared region) and is valid while the
+// message is referenced.
+bool ReadBinaryFrame(CefRefPtr<CefProcessMessage> message, uint32_t &requestId,
+                     BinaryFrameKind &kind, std::string_view &body);
+
+} // namespace SimpleIPC
@@ -0,0 +1,342 @@
+#include "binarycodec.hpp"
+#include <cstring>
+
+namespace SimpleIPC {
+
+namespace {
+
+constexpr uint8_t kMajorUnsigned = 0;
+constexpr uint8_t kMajorNegative = 1;
+constexpr uint8_t kMajorBytes = 2;
+constexpr uint8_t kMajorText = 3;
+constexpr uint8_t kMajorArray = 4;
+constexpr uint8_t kMajorMap = 5;
+constexpr uint8_t kMajorSimple = 7;
+
+constexpr uint8_t kFalse = 20;
+constexpr uint8_t kTrue = 21;
+constexpr uint8_t kNull = 22;
+constexpr uint8_t kFloat64 = 27;
+
+// Nesting deeper than this is rejected rather than recursed into
+constexpr int kMaxDepth = 64;
+
+} // namespace
+
+void CborWriter::Head(uint8_t major, uint64_t value) {
+  uint8_t type = static_cast<uint8_t>(major << 5);
+  if (value < 24) {
+    out_.push_back(static_cast<char>(type | value));
+    return;
+  }
+  int bytes;
+  if (value <= 0xFF) {
+    out_.push_back(static_cast<char>(type | 24));
+    bytes = 1;
+  } else if (value <= 0xFFFF) {
+    out_.push_back(static_cast<char>(type | 25));
+    bytes = 2;
+  } else if (value <= 0xFFFFFFFFull) {
+    out_.push_back(static_cast<char>(type | 26));
+    bytes = 4;
+  } else {
+    out_.push_back(static_cast<char>(type | 27));
+    bytes = 8;
+  }
+  // Big endian
+  for (int i = bytes - 1; i >= 0; --i) {
+    out_.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+void CborWriter::Int(int64_t value) {
+  if (value >= 0) {
+    Head(kMajorUnsigned, static_cast<uint64_t>(value));
+  } else {
+    // -1 - n, computed without overflowing on INT64_MIN
+    Head(kMajorNegative, ~static_cast<uint64_t>(value));
+  }
+}
+
+void CborWriter::UInt(uint64_t value) { Head(kMajorUnsigned, value); }
+
+void CborWriter::Double(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  out_.push_back(static_cast<char>((kMajorSimple << 5) | kFloat64));
+  for (int i = 7; i >= 0; --i) {
+    out_.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+  }
+}
+
+void CborWriter::Bool(bool value) {
+  out_.push_back(static_cast<char>((kMajorSimple << 5) | (value ? kTrue : kFalse)));
+}
+
+void CborWriter::Null() {
+  out_.push_back(static_cast<char>((kMajorSimple << 5) | kNull));
+}
+
+void CborWriter::Text(std::string_view text) {
+  Head(kMajorText, text.size());
+  out_.append(text.data(), text.size());
+}
+
+void CborWriter::Bytes(const void *data, size_t size) {
+  Head(kMajorBytes, size);
+  out_.append(static_cast<const char *>(data), size);
+}
+
+char *CborWriter::BytesInPlace(size_t size) {
+  Head(kMajorBytes, size);
+  size_t offset = out_.size();
+  out_.resize(offset + size);
+  return &out_[offset];
+}
+
+void CborWriter::BeginArray(size_t count) { Head(kMajorArray, count); }
+
+void CborWriter::BeginMap(size_t pairs) { Head(kMajorMap, pairs); }
+
+bool CborReader::Head(uint8_t &major, uint64_t &value, size_t &next) const {
+  if (pos_ >= size_)
+    return false;
+  uint8_t initial = static_cast<uint8_t>(data_[pos_]);
+  major = initial >> 5;
+  uint8_t info = initial & 0x1F;
+  next = pos_ + 1;
+  if (info < 24) {
+    value = info;
+    return true;
+  }
+  if (info > 27) // indefinite lengths and reserved values
+    return false;
+  size_t bytes = size_t(1) << (info - 24);
+  if (size_ - next < bytes)
+    return false;
+  value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value = (value << 8) | static_cast<uint8_t>(data_[next + i]);
+  }
+  next += bytes;
+  return true;
+}
+
+CborType CborReader::Peek() const {
+  uint8_t major;
+  uint64_t value;
+  size_t next;
+  if (!Head(major, value, next))
+    return CborType::Invalid;
+  switch (major) {
+  case kMajorUnsigned:
+    return CborType::Unsigned;
+  case kMajorNegative:
+    return CborType::Negative;
+  case kMajorBytes:
+    return CborType::Bytes;
+  case kMajorText:
+    return CborType::Text;
+  case kMajorArray:
+    return CborType::Array;
+  case kMajorMap:
+    return CborType::Map;
+  case kMajorSimple: {
+    uint8_t info = static_cast<uint8_t>(data_[pos_]) & 0x1F;
+    if (info == kFalse)
+      return CborType::False;
+    if (info == kTrue)
+      return CborType::True;
+    if (info == kNull)
+      return CborType::Null;
+    if (info == kFloat64)
+      return CborType::Double;
+    return CborType::Invalid;
+  }
+  default: // tags
+    return CborType::Invalid;
+  }
+}
+
+bool CborReader::ReadUInt(uint64_t &value) {
+  uint8_t major;
+  size_t next;
+  if (!Head(major, value, next) || major != kMajorUnsigned)
+    return false;
+  pos_ = next;
+  return true;
+}
+
+bool CborReader::ReadInt(int64_t &value) {
+  uint8_t major;
+  uint64_t raw;
+  size_t next;
+  if (!Head(major, raw, next) || raw > static_cast<uint64_t>(INT64_MAX))
+    return false;
+  if (major == kMajorUnsigned) {
+    value = static_cast<int64_t>(raw);
+  } else if (major == kMajorNegative) {
+    value = -1 - static_cast<int64_t>(raw);
+  } else {
+    return false;
+  }
+  pos_ = next;
+  return true;
+}
+
+bool CborReader::ReadDouble(double &value) {
+  CborType type = Peek();
+  if (type == CborType::Unsigned) {
+    uint64_t integer;
+    ReadUInt(integer);
+    value = static_cast<double>(integer);
+    return true;
+  }
+  if (type == CborType::Negative) {
+    uint8_t major;
+    uint64_t raw;
+    size_t next;
+    Head(major, raw, next);
+    value = -1.0 - static_cast<double>(raw);
+    pos_ = next;
+    return true;
+  }
+  if (type != CborType::Double)
+    return false;
+  uint8_t major;
+  uint64_t bits;
+  size_t next;
+  if (!Head(major, bits, next))
+    return false;
+  std::memcpy(&value, &bits, sizeof(value));
+  pos_ = next;
+  return true;
+}
+
+bool CborReader::ReadBool(bool &value) {
+  CborType type = Peek();
+  if (type != CborType::True && type != CborType::False)
+    return false;
+  value = type == CborType::True;
+  ++pos_;
+  return true;
+}
+
+bool CborReader::ReadNull() {
+  if (Peek() != CborType::Null)
+    return false;
+  ++pos_;
+  return true;
+}
+
+bool CborReader::ReadString(uint8_t expected, std::string_view &out) {
+  uint8_t major;
+  uint64_t length;
+  size_t next;
+  if (!Head(major, length, next) || major != expected ||
+      length > size_ - next)
+    return false;
+  out = std::string_view(data_ + next, static_cast<size_t>(length));
+  pos_ = next + static_cast<size_t>(length);
+  return true;
+}
+
+bool CborReader::ReadText(std::string_view &text) {
+  return ReadString(kMajorText, text);
+}
+
+bool CborReader::ReadBytes(std::string_view &bytes) {
+  return ReadString(kMajorBytes, bytes);
+}
+
+bool CborReader::ReadArray(size_t &count) {
+  uint8_t major;
+  uint64_t value;
+  size_t next;
+  // Every item takes at least a byte, which bounds bogus counts
+  if (!Head(major, value, next) || major != kMajorArray ||
+      value > size_ - next)
+    return false;
+  count = static_cast<size_t>(value);
+  pos_ = next;
+  return true;
+}
+
+bool CborReader::ReadMap(size_t &pairs) {
+  uint8_t major;
+  uint64_t value;
+  size_t next;
+  if (!Head(major, value, next) || major != kMajorMap ||
+      value > (size_ - next) / 2)
+    return false;
+  pairs = static_cast<size_t>(value);
+  pos_ = next;
+  return true;
+}
+
+bool CborReader::Skip() {
+  size_t start = pos_;
+  if (!Skip(0)) {
+    pos_ = start;
+    return false;
+  }
+  return true;
+}
+
+bool CborReader::Skip(int depth) {
+  if (depth > kMaxDepth)
+    return false;
+  uint8_t major;
+  uint64_t value;
+  size_t next;
+  if (!Head(major, value, next))
+    return false;
+  switch (major) {
+  case kMajorUnsigned:
+  case kMajorNegative:
+    pos_ = next;
+    return true;
+  case kMajorBytes:
+  case kMajorText:
+    if (value > size_ - next)
+      return false;
+    pos_ = next + static_cast<size_t>(value);
+    return true;
+  case kMajorArray:
+  case kMajorMap: {
+    uint64_t items = major == kMajorMap ? value * 2 : value;
+    if (value > size_ - next)
+      return false;
+    pos_ = next;
+    for (uint64_t i = 0; i < items; ++i) {
+      if (!Skip(depth + 1))
+        return false;
+    }
+    return true;
+  }
+  case kMajorSimple:
+    if (Peek() == CborType::Invalid)
+      return false;
+    pos_ = next;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool CborReader::FindKey(size_t pairs, std::string_view key) {
+  for (size_t i = 0; i < pairs; ++i) {
+    std::string_view name;
+    bool isText = ReadText(name);
+    if (isText && name == key)
+      return true;
+    // Non-text keys are skipped along with their values
+    if (!isText && !Skip())
+      return false;
+    if (!Skip())
+      return false;
+  }
+  return false;
+}
+
+} // namespace SimpleIPC
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace SimpleIPC {
+
+// Encoding of the binary IPC channel: the definite-length subset of CBOR
+// (RFC 8949) - integers, doubles, booleans, null, UTF-8 text, byte strings,
+// arrays and maps. Self-describing, so the renderer turns it into JS values
+// without a schema, and byte strings map to ArrayBuffers without escaping.
+enum class CborType {
+  Unsigned,
+  Negative,
+  Bytes,
+  Text,
+  Array,
+  Map,
+  False,
+  True,
+  Null,
+  Double,
+  Invalid, // end of input or an unsupported item
+};
+
+// Appends items to a string used as a byte buffer
+class CborWriter {
+public:
+  explicit CborWriter(std::string &out) : out_(out) {}
+
+  void Int(int64_t value);
+  void UInt(uint64_t value);
+  void Double(double value);
+  void Bool(bool value);
+  void Null();
+  void Text(std::string_view text);
+  void Bytes(const void *data, size_t size);
+  // Appends a byte string of size bytes and returns where its content goes,
+  // so large payloads (file contents) are written into the message directly
+  char *BytesInPlace(size_t size);
+  // Followed by count items, or pairs key/value items
+  void BeginArray(size_t count);
+  void BeginMap(size_t pairs);
+
+private:
+  void Head(uint8_t major, uint64_t value);
+
+  std::string &out_;
+};
+
+// Reads items from a buffer it does not own. Text and byte strings are
+// returned as views into the buffer. A read that doesn't match the next
+// item fails and leaves the position unchanged.
+class CborReader {
+public:
+  CborReader(const char *data, size_t size) : data_(data), size_(size) {}
+  explicit CborReader(std::string_view data)
+      : CborReader(data.data(), data.size()) {}
+
+  CborType Peek() const;
+  bool AtEnd() const { return pos_ >= size_; }
+  size_t Position() const { return pos_; }
+
+  bool ReadInt(int64_t &value);
+  bool ReadUInt(uint64_t &value);
+  // Integers are accepted as well
+  bool ReadDouble(double &value);
+  bool ReadBool(bool &value);
+  bool ReadNull();
+  bool ReadText(std::string_view &text);
+  bool ReadBytes(std::string_view &bytes);
+  bool ReadArray(size_t &count);
+  bool ReadMap(size_t &pairs);
+  // Skips one complete item, nested ones included
+  bool Skip();
+
+  // In a map of pairs entries (after ReadMap), moves to the value of key,
+  // or returns false with the position at the end of the map
+  bool FindKey(size_t pairs, std::string_view key);
+
+private:
+  bool Head(uint8_t &major, uint64_t &value, size_t &next) const;
+  bool ReadString(uint8_t major, std::string_view &out);
+  bool Skip(int depth);
+
+  const char *data_;
+  size_t size_;
+  size_t pos_ = 0;
+};
+
+} // namespace SimpleIPC
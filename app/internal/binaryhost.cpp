@@ -0,0 +1,112 @@
+#include "binaryhost.hpp"
+#include "binarycodec.hpp"
+#include "simpleipc.hpp"
+#include "include/wrapper/cef_helpers.h"
+#include <vector>
+
+namespace SimpleIPC {
+
+namespace {
+
+void SendError(CefRefPtr<CefFrame> frame, uint32_t requestId,
+               const std::string &error) {
+  std::string body;
+  CborWriter(body).Text(error);
+  SendBinaryFrame(frame, PID_RENDERER, requestId, BinaryFrameKind::Error, body);
+}
+
+} // namespace
+
+bool BinaryChannelHost::OnProcessMessageReceived(
+    CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+    CefRefPtr<CefProcessMessage> message) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (message->GetName() != kBinaryMessageName)
+    return false;
+
+  uint32_t requestId;
+  BinaryFrameKind kind;
+  std::string_view body;
+  if (!ReadBinaryFrame(message, requestId, kind, body) || !frame)
+    return true;
+
+  std::string frameId = frame->GetIdentifier().ToString();
+  if (kind == BinaryFrameKind::Cancel) {
+    for (const auto &entry : calls_) {
+      if (entry.second.requestId == requestId &&
+          entry.second.frameId == frameId) {
+        Cancel(entry.first);
+        break;
+      }
+    }
+    return true;
+  }
+  if (kind != BinaryFrameKind::Call)
+    return true;
+
+  CborReader reader(body);
+  std::string_view method;
+  if (!reader.ReadText(method)) {
+    SendError(frame, requestId, "Malformed call");
+    return true;
+  }
+
+  IPCHandler &ipc = IPCHandler::GetInstance();
+  int64_t callId = ipc.ReserveCallId();
+  calls_[callId] = Call{browser->GetIdentifier(), frameId, requestId};
+  ipc.Dispatch(
+      callId, std::string(method), std::string(body.substr(reader.Position())),
+      [this, callId, frame](bool success, const std::string &response) {
+        auto it = calls_.find(callId);
+        if (it == calls_.end())
+          return;
+        uint32_t requestId = it->second.requestId;
+        calls_.erase(it);
+        if (success) {
+          SendBinaryFrame(frame, PID_RENDERER, requestId,
+                          BinaryFrameKind::Reply, response);
+        } else {
+          SendError(frame, requestId, response);
+        }
+      },
+      true);
+  return true;
+}
+
+void BinaryChannelHost::OnBeforeBrowse(CefRefPtr<CefBrowser> browser,
+                                       CefRefPtr<CefFrame> frame) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (frame->IsMain()) {
+    CancelBrowser(browser->GetIdentifier());
+    return;
+  }
+  std::string frameId = frame->GetIdentifier().ToString();
+  std::vector<int64_t> cancelled;
+  for (const auto &entry : calls_) {
+    if (entry.second.frameId == frameId)
+      cancelled.push_back(entry.first);
+  }
+  for (int64_t callId : cancelled)
+    Cancel(callId);
+}
+
+void BinaryChannelHost::CancelBrowser(int browserId) {
+  CEF_REQUIRE_UI_THREAD();
+
+  std::vector<int64_t> cancelled;
+  for (const auto &entry : calls_) {
+    if (entry.second.browserId == browserId)
+      cancelled.push_back(entry.first);
+  }
+  for (int64_t callId : cancelled)
+    Cancel(callId);
+}
+
+void BinaryChannelHost::Cancel(int64_t callId) {
+  calls_.erase(callId);
+  IPCHandler::GetInstance().Cancel(callId);
+}
+
+} // namespace SimpleIPC
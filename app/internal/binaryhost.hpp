@@ -0,0 +1,40 @@
+#pragma once
+
+#include "binarychannel.hpp"
+#include "include/cef_browser.h"
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace SimpleIPC {
+
+// Browser side of the binary channel. Calls made with cefBinaryQuery in a
+// renderer are dispatched to the IPCHandler's binary handlers, so they share
+// its worker pool, concurrency limits and cancellation. UI thread only.
+class BinaryChannelHost {
+public:
+  // True when message belonged to the channel
+  bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                CefRefPtr<CefFrame> frame,
+                                CefRefPtr<CefProcessMessage> message);
+
+  // A frame navigates: its calls (all of the browser's for the main frame)
+  // are cancelled
+  void OnBeforeBrowse(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame);
+  // Browser closed or its renderer died
+  void CancelBrowser(int browserId);
+
+private:
+  struct Call {
+    int browserId;
+    std::string frameId;
+    uint32_t requestId;
+  };
+
+  void Cancel(int64_t callId);
+
+  // By IPCHandler call id
+  std::map<int64_t, Call> calls_;
+};
+
+} // namespace SimpleIPC
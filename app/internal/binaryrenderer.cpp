@@ -0,0 +1,322 @@
+#include "binaryrenderer.hpp"
+#include "binarycodec.hpp"
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace SimpleIPC {
+
+namespace {
+
+// Deeper values are rejected; they are most likely cyclic
+constexpr int kMaxDepth = 64;
+
+bool EncodeValue(CefRefPtr<CefV8Value> value, CborWriter &out, int depth) {
+  if (depth > kMaxDepth)
+    return false;
+  if (!value || value->IsUndefined() || value->IsNull() ||
+      value->IsFunction()) {
+    out.Null();
+  } else if (value->IsBool()) {
+    out.Bool(value->GetBoolValue());
+  } else if (value->IsInt()) {
+    out.Int(value->GetIntValue());
+  } else if (value->IsUInt()) {
+    out.UInt(value->GetUIntValue());
+  } else if (value->IsDouble()) {
+    double number = value->GetDoubleValue();
+    // Whole numbers keep the short integer encoding
+    if (std::trunc(number) == number && std::fabs(number) < 9007199254740992.0) {
+      out.Int(static_cast<int64_t>(number));
+    } else {
+      out.Double(number);
+    }
+  } else if (value->IsString()) {
+    out.Text(value->GetStringValue().ToString());
+  } else if (value->IsArrayBuffer()) {
+    out.Bytes(value->GetArrayBufferData(), value->GetArrayBufferByteLength());
+  } else if (value->IsArray()) {
+    int length = value->GetArrayLength();
+    out.BeginArray(static_cast<size_t>(length));
+    for (int i = 0; i < length; ++i) {
+      if (!EncodeValue(value->GetValue(i), out, depth + 1))
+        return false;
+    }
+  } else if (value->IsObject()) {
+    // Typed arrays and DataViews: the bytes of their window on the buffer
+    CefRefPtr<CefV8Value> buffer = value->GetValue("buffer");
+    if (buffer && buffer->IsArrayBuffer()) {
+      CefRefPtr<CefV8Value> offset = value->GetValue("byteOffset");
+      CefRefPtr<CefV8Value> length = value->GetValue("byteLength");
+      size_t start = offset && offset->IsUInt() ? offset->GetUIntValue() : 0;
+      size_t size = length && length->IsUInt() ? length->GetUIntValue() : 0;
+      if (start + size > buffer->GetArrayBufferByteLength())
+        return false;
+      out.Bytes(static_cast<const char *>(buffer->GetArrayBufferData()) + start,
+                size);
+      return true;
+    }
+    std::vector<CefString> keys;
+    value->GetKeys(keys);
+    out.BeginMap(keys.size());
+    for (const auto &key : keys) {
+      out.Text(key.ToString());
+      if (!EncodeValue(value->GetValue(key), out, depth + 1))
+        return false;
+    }
+  } else {
+    out.Null();
+  }
+  return true;
+}
+
+CefRefPtr<CefV8Value> DecodeValue(CborReader &in, int depth) {
+  if (depth > kMaxDepth)
+    return nullptr;
+  switch (in.Peek()) {
+  case CborType::Unsigned: {
+    uint64_t value;
+    in.ReadUInt(value);
+    if (value <= std::numeric_limits<uint32_t>::max())
+      return CefV8Value::CreateUInt(static_cast<uint32_t>(value));
+    return CefV8Value::CreateDouble(static_cast<double>(value));
+  }
+  case CborType::Negative: {
+    int64_t value;
+    if (!in.ReadInt(value)) {
+      double number;
+      in.ReadDouble(number);
+      return CefV8Value::CreateDouble(number);
+    }
+    if (value >= std::numeric_limits<int32_t>::min())
+      return CefV8Value::CreateInt(static_cast<int32_t>(value));
+    return CefV8Value::CreateDouble(static_cast<double>(value));
+  }
+  case CborType::Double: {
+    double value;
+    in.ReadDouble(value);
+    return CefV8Value::CreateDouble(value);
+  }
+  case CborType::True:
+  case CborType::False: {
+    bool value;
+    in.ReadBool(value);
+    return CefV8Value::CreateBool(value);
+  }
+  case CborType::Null:
+    in.ReadNull();
+    return CefV8Value::CreateNull();
+  case CborType::Text: {
+    std::string_view text;
+    if (!in.ReadText(text))
+      return nullptr;
+    return CefV8Value::CreateString(CefString(std::string(text)));
+  }
+  case CborType::Bytes: {
+    std::string_view bytes;
+    if (!in.ReadBytes(bytes))
+      return nullptr;
+    // The message memory goes away after dispatch; one copy into V8's heap
+    return CefV8Value::CreateArrayBufferWithCopy(
+        const_cast<char *>(bytes.data()), bytes.size());
+  }
+  case CborType::Array: {
+    size_t count;
+    if (!in.ReadArray(count))
+      return nullptr;
+    CefRefPtr<CefV8Value> array = CefV8Value::CreateArray(static_cast<int>(count));
+    for (size_t i = 0; i < count; ++i) {
+      CefRefPtr<CefV8Value> item = DecodeValue(in, depth + 1);
+      if (!item)
+        return nullptr;
+      array->SetValue(static_cast<int>(i), item);
+    }
+    return array;
+  }
+  case CborType::Map: {
+    size_t pairs;
+    if (!in.ReadMap(pairs))
+      return nullptr;
+    CefRefPtr<CefV8Value> object = CefV8Value::CreateObject(nullptr, nullptr);
+    for (size_t i = 0; i < pairs; ++i) {
+      std::string key;
+      std::string_view text;
+      int64_t number;
+      if (in.ReadText(text)) {
+        key = std::string(text);
+      } else if (in.ReadInt(number)) {
+        key = std::to_string(number);
+      } else {
+        return nullptr;
+      }
+      CefRefPtr<CefV8Value> item = DecodeValue(in, depth + 1);
+      if (!item)
+        return nullptr;
+      object->SetValue(key, item, V8_PROPERTY_ATTRIBUTE_NONE);
+    }
+    return object;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+// window.cefBinaryQuery
+class QueryFunction : public CefV8Handler {
+public:
+  explicit QueryFunction(BinaryChannelRenderer *channel) : channel_(channel) {}
+
+  bool Execute(const CefString &name, CefRefPtr<CefV8Value> object,
+               const CefV8ValueList &arguments, CefRefPtr<CefV8Value> &retval,
+               CefString &exception) override {
+    retval = channel_->Call(CefV8Context::GetCurrentContext(), arguments,
+                            exception);
+    return true;
+  }
+
+private:
+  BinaryChannelRenderer *channel_;
+  IMPLEMENT_REFCOUNTING(QueryFunction);
+};
+
+// Abort listener of one call
+class AbortFunction : public CefV8Handler {
+public:
+  AbortFunction(BinaryChannelRenderer *channel, uint32_t requestId)
+      : channel_(channel), requestId_(requestId) {}
+
+  bool Execute(const CefString &name, CefRefPtr<CefV8Value> object,
+               const CefV8ValueList &arguments, CefRefPtr<CefV8Value> &retval,
+               CefString &exception) override {
+    channel_->Abort(requestId_);
+    return true;
+  }
+
+private:
+  BinaryChannelRenderer *channel_;
+  uint32_t requestId_;
+  IMPLEMENT_REFCOUNTING(AbortFunction);
+};
+
+} // namespace
+
+BinaryChannelRenderer::BinaryChannelRenderer()
+    : queryFunction_(new QueryFunction(this)) {}
+
+void BinaryChannelRenderer::OnContextCreated(CefRefPtr<CefBrowser> browser,
+                                             CefRefPtr<CefFrame> frame,
+                                             CefRefPtr<CefV8Context> context) {
+  context->GetGlobal()->SetValue(
+      "cefBinaryQuery",
+      CefV8Value::CreateFunction("cefBinaryQuery", queryFunction_),
+      V8_PROPERTY_ATTRIBUTE_READONLY);
+}
+
+void BinaryChannelRenderer::OnContextReleased(
+    CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+    CefRefPtr<CefV8Context> context) {
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    if (it->second.context->IsSame(context)) {
+      SendBinaryFrame(frame, PID_BROWSER, it->first, BinaryFrameKind::Cancel,
+                      {});
+      it = pending_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+CefRefPtr<CefV8Value>
+BinaryChannelRenderer::Call(CefRefPtr<CefV8Context> context,
+                            const CefV8ValueList &arguments,
+                            CefString &exception) {
+  if (arguments.empty() || !arguments[0]->IsString()) {
+    exception = "cefBinaryQuery: method name expected";
+    return nullptr;
+  }
+
+  std::string body;
+  CborWriter writer(body);
+  writer.Text(arguments[0]->GetStringValue().ToString());
+  if (!EncodeValue(arguments.size() > 1 ? arguments[1] : nullptr, writer, 0)) {
+    exception = "cefBinaryQuery: value is nested too deeply or invalid";
+    return nullptr;
+  }
+
+  uint32_t requestId = ++lastRequestId_;
+  if (!SendBinaryFrame(context->GetFrame(), PID_BROWSER, requestId,
+                       BinaryFrameKind::Call, body)) {
+    exception = "cefBinaryQuery: frame is gone";
+    return nullptr;
+  }
+
+  CefRefPtr<CefV8Value> promise = CefV8Value::CreatePromise();
+  pending_[requestId] = Pending{context, promise};
+
+  if (arguments.size() > 2 && arguments[2]->IsObject()) {
+    CefRefPtr<CefV8Value> addEventListener =
+        arguments[2]->GetValue("addEventListener");
+    if (addEventListener && addEventListener->IsFunction()) {
+      CefV8ValueList listenerArguments = {
+          CefV8Value::CreateString("abort"),
+          CefV8Value::CreateFunction("abort", new AbortFunction(this, requestId))};
+      addEventListener->ExecuteFunction(arguments[2], listenerArguments);
+    }
+  }
+  return promise;
+}
+
+void BinaryChannelRenderer::Abort(uint32_t requestId) {
+  auto it = pending_.find(requestId);
+  if (it == pending_.end())
+    return;
+  Pending pending = it->second;
+  pending_.erase(it);
+
+  SendBinaryFrame(pending.context->GetFrame(), PID_BROWSER, requestId,
+                  BinaryFrameKind::Cancel, {});
+  if (pending.context->Enter()) {
+    pending.promise->RejectPromise("Aborted");
+    pending.context->Exit();
+  }
+}
+
+bool BinaryChannelRenderer::OnProcessMessageReceived(
+    CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+    CefRefPtr<CefProcessMessage> message) {
+  if (message->GetName() != kBinaryMessageName)
+    return false;
+
+  uint32_t requestId;
+  BinaryFrameKind kind;
+  std::string_view body;
+  if (!ReadBinaryFrame(message, requestId, kind, body))
+    return true;
+  auto it = pending_.find(requestId);
+  if (it == pending_.end())
+    return true; // aborted or the context was released
+  Pending pending = it->second;
+  pending_.erase(it);
+
+  if (!pending.context->IsValid() || !pending.context->Enter())
+    return true;
+  CborReader reader(body);
+  if (kind == BinaryFrameKind::Reply) {
+    CefRefPtr<CefV8Value> value = DecodeValue(reader, 0);
+    if (value) {
+      pending.promise->ResolvePromise(value);
+    } else {
+      pending.promise->RejectPromise("Malformed response");
+    }
+  } else {
+    std::string_view error;
+    pending.promise->RejectPromise(
+        reader.ReadText(error) ? CefString(std::string(error))
+                               : CefString("Call failed"));
+  }
+  pending.context->Exit();
+  return true;
+}
+
+} // namespace SimpleIPC
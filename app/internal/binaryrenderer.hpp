@@ -0,0 +1,48 @@
+#pragma once
+
+#include "binarychannel.hpp"
+#include "include/cef_browser.h"
+#include "include/cef_v8.h"
+#include <cstdint>
+#include <map>
+
+namespace SimpleIPC {
+
+// Renderer side of the binary channel. Binds
+//   window.cefBinaryQuery(method, value[, abortSignal]) -> Promise
+// where value is any JSON-like value in which ArrayBuffers and typed arrays
+// travel as raw bytes. The response is decoded the same way, byte strings
+// becoming ArrayBuffers. Renderer main thread only.
+class BinaryChannelRenderer {
+public:
+  BinaryChannelRenderer();
+
+  void OnContextCreated(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                        CefRefPtr<CefV8Context> context);
+  // Pending calls of the context are cancelled on the browser side
+  void OnContextReleased(CefRefPtr<CefBrowser> browser,
+                         CefRefPtr<CefFrame> frame,
+                         CefRefPtr<CefV8Context> context);
+  // True when message belonged to the channel
+  bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
+                                CefRefPtr<CefFrame> frame,
+                                CefRefPtr<CefProcessMessage> message);
+
+  // Sends a call and returns its promise, or sets exception
+  CefRefPtr<CefV8Value> Call(CefRefPtr<CefV8Context> context,
+                             const CefV8ValueList &arguments,
+                             CefString &exception);
+  void Abort(uint32_t requestId);
+
+private:
+  struct Pending {
+    CefRefPtr<CefV8Context> context;
+    CefRefPtr<CefV8Value> promise;
+  };
+
+  CefRefPtr<CefV8Handler> queryFunction_;
+  uint32_t lastRequestId_ = 0;
+  std::map<uint32_t, Pending> pending_;
+};
+
+} // namespace SimpleIPC
@@ -0,0 +1,264 @@
+#include "eventbus.hpp"
+#include "include/cef_task.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace SimpleIPC {
+
+namespace {
+
+void AppendJsonString(std::string &out, const std::string &text) {
+  out.push_back('"');
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+} // namespace
+
+class EventBus::FlushTask : public CefTask {
+public:
+  void Execute() override { EventBus::GetInstance().Flush(); }
+
+private:
+  IMPLEMENT_REFCOUNTING(FlushTask);
+};
+
+EventBus &EventBus::GetInstance() {
+  static EventBus instance;
+  return instance;
+}
+
+void EventBus::Publish(const std::string &topic, std::string data,
+                       EventMode mode, const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (shutdown_)
+    return;
+
+  bool deliverable = false;
+  for (auto &entry : subscribers_) {
+    Subscriber &subscriber = entry.second;
+    if (!Matches(subscriber.topics, topic))
+      continue;
+
+    auto it = std::find_if(subscriber.pending.begin(),
+                           subscriber.pending.end(),
+                           [&topic](const PendingTopic &pending) {
+                             return pending.topic == topic;
+                           });
+    if (it == subscriber.pending.end()) {
+      subscriber.pending.emplace_back();
+      it = subscriber.pending.end() - 1;
+      it->topic = topic;
+    }
+
+    if (mode == EventMode::Latest) {
+      it->latest[key] = data;
+    } else {
+      if (it->batch.size() == kMaxBatch) {
+        it->batch.pop_front();
+        ++it->dropped;
+      }
+      it->batch.push_back(data);
+    }
+    deliverable = deliverable || !subscriber.awaitingAck;
+  }
+
+  if (deliverable)
+    ScheduleFlush();
+}
+
+void EventBus::Subscribe(int64_t id, std::vector<std::string> topics,
+                         Sink sink) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (shutdown_)
+      return;
+    Subscriber &subscriber = subscribers_[id];
+    subscriber.topics = std::move(topics);
+    subscriber.sink = sink;
+  }
+
+  // Tells the page the id it acknowledges with; needs no acknowledgement
+  sink("{\"id\":" + std::to_string(id) + ",\"seq\":0,\"events\":[]}");
+}
+
+void EventBus::SetTopics(int64_t id, std::vector<std::string> topics) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = subscribers_.find(id);
+  if (it == subscribers_.end())
+    return;
+  Subscriber &subscriber = it->second;
+  subscriber.topics = std::move(topics);
+  auto &pending = subscriber.pending;
+  pending.erase(std::remove_if(pending.begin(), pending.end(),
+                               [&subscriber](const PendingTopic &topic) {
+                                 return !Matches(subscriber.topics,
+                                                 topic.topic);
+                               }),
+                pending.end());
+}
+
+void EventBus::Acknowledge(int64_t id, uint64_t seq) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = subscribers_.find(id);
+  if (it == subscribers_.end() || it->second.seq != seq)
+    return;
+  it->second.awaitingAck = false;
+  if (!it->second.pending.empty())
+    ScheduleFlush();
+}
+
+void EventBus::Unsubscribe(int64_t id) {
+  Sink sink;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(id);
+    if (it == subscribers_.end())
+      return;
+    // Released outside the lock, it may own the query's callback
+    sink = std::move(it->second.sink);
+    subscribers_.erase(it);
+  }
+}
+
+void EventBus::Shutdown() {
+  std::map<int64_t, Subscriber> subscribers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    subscribers.swap(subscribers_);
+  }
+}
+
+std::vector<std::string> EventBus::ParseTopics(const std::string &list) {
+  std::vector<std::string> topics;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = std::min(list.find(',', start), list.size());
+    size_t first = list.find_first_not_of(' ', start);
+    if (first < end) {
+      size_t last = list.find_last_not_of(' ', end - 1);
+      topics.push_back(list.substr(first, last - first + 1));
+    }
+    start = end + 1;
+  }
+  return topics;
+}
+
+bool EventBus::Matches(const std::vector<std::string> &topics,
+                       const std::string &topic) {
+  for (const std::string &pattern : topics) {
+    if (pattern == "*" || pattern == topic)
+      return true;
+    // "build.*" matches "build.progress" and "build.output.stderr"
+    size_t prefix = pattern.size() - 1;
+    if (pattern.size() > 2 && pattern.compare(prefix - 1, 2, ".*") == 0 &&
+        topic.size() > prefix &&
+        topic.compare(0, prefix, pattern, 0, prefix) == 0)
+      return true;
+  }
+  return false;
+}
+
+std::string EventBus::BuildMessage(int64_t id, const Subscriber &subscriber) {
+  size_t size = 64;
+  for (const PendingTopic &pending : subscriber.pending) {
+    size += pending.topic.size() + 48;
+    for (const std::string &data : pending.batch)
+      size += data.size() + 1;
+    for (const auto &latest : pending.latest)
+      size += latest.second.size() + 1;
+  }
+
+  std::string message;
+  message.reserve(size);
+  message += "{\"id\":" + std::to_string(id) +
+             ",\"seq\":" + std::to_string(subscriber.seq) + ",\"events\":[";
+  bool firstTopic = true;
+  for (const PendingTopic &pending : subscriber.pending) {
+    if (!firstTopic)
+      message.push_back(',');
+    firstTopic = false;
+
+    message += "{\"topic\":";
+    AppendJsonString(message, pending.topic);
+    message += ",\"data\":[";
+    bool firstEvent = true;
+    for (const std::string &data : pending.batch) {
+      if (!firstEvent)
+        message.push_back(',');
+      firstEvent = false;
+      message += data;
+    }
+    for (const auto &latest : pending.latest) {
+      if (!firstEvent)
+        message.push_back(',');
+      firstEvent = false;
+      message += latest.second;
+    }
+    message.push_back(']');
+    if (pending.dropped != 0)
+      message += ",\"dropped\":" + std::to_string(pending.dropped);
+    message.push_back('}');
+  }
+  message += "]}";
+  return message;
+}
+
+void EventBus::ScheduleFlush() {
+  if (flushScheduled_ || shutdown_)
+    return;
+  flushScheduled_ = true;
+  CefPostDelayedTask(TID_UI, new FlushTask(), kFrameMs);
+}
+
+void EventBus::Flush() {
+  std::vector<std::pair<Sink, std::string>> messages;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushScheduled_ = false;
+    for (auto &entry : subscribers_) {
+      Subscriber &subscriber = entry.second;
+      if (subscriber.awaitingAck || subscriber.pending.empty())
+        continue;
+      ++subscriber.seq;
+      messages.emplace_back(subscriber.sink,
+                            BuildMessage(entry.first, subscriber));
+      subscriber.pending.clear();
+      subscriber.awaitingAck = true;
+    }
+  }
+
+  // Outside the lock: sinks may publish or unsubscribe
+  for (auto &message : messages)
+    message.first(message.second);
+}
+
+} // namespace SimpleIPC
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SimpleIPC {
+
+// How an event combines with undelivered ones of its topic
+enum class EventMode {
+  Batch,  // every event is delivered, in publish order
+  Latest, // only the last per topic and key, e.g. progress
+};
+
+// Pushes native events to web pages over one persistent cefQuery per page
+// (see mikobench/src/shared/events.ts). Events published between two
+// frames are coalesced and go out as a single message per subscriber:
+//
+//   {"id": 7, "seq": 3, "events": [
+//     {"topic": "fs.changed", "data": [..., ...]},
+//     {"topic": "build.progress", "data": [...], "dropped": 12}]}
+//
+// "data" holds a topic's batched events, or its latest event per key. A
+// subscriber gets nothing more until it acknowledges a message, so a busy
+// renderer makes events pile up here, where they keep coalescing, instead
+// of queueing scripts. Batched topics keep the newest kMaxBatch events
+// and count the rest as dropped.
+class EventBus {
+public:
+  // Receives a subscriber's messages on the UI thread
+  using Sink = std::function<void(const std::string &message)>;
+
+  static constexpr int64_t kFrameMs = 16;
+  static constexpr size_t kMaxBatch = 1024;
+
+  static EventBus &GetInstance();
+
+  // Any thread. data is a JSON value; key only matters for Latest
+  void Publish(const std::string &topic, std::string data,
+               EventMode mode = EventMode::Batch, const std::string &key = "");
+
+  // UI thread. topics are exact names, "prefix.*" or "*"; id is the
+  // subscription's query id, which the page acknowledges with
+  void Subscribe(int64_t id, std::vector<std::string> topics, Sink sink);
+  void SetTopics(int64_t id, std::vector<std::string> topics);
+  void Acknowledge(int64_t id, uint64_t seq);
+  // Unknown ids are ignored
+  void Unsubscribe(int64_t id);
+  // Drops all subscribers, releasing their queries, before CEF shuts down
+  void Shutdown();
+
+  // Comma-separated topic list from a query
+  static std::vector<std::string> ParseTopics(const std::string &list);
+
+private:
+  class FlushTask;
+
+  struct PendingTopic {
+    std::string topic;
+    std::deque<std::string> batch;
+    std::map<std::string, std::string> latest;
+    size_t dropped = 0;
+  };
+
+  struct Subscriber {
+    std::vector<std::string> topics;
+    Sink sink;
+    // In publish order of each topic's first pending event
+    std::vector<PendingTopic> pending;
+    uint64_t seq = 0;
+    bool awaitingAck = false;
+  };
+
+  EventBus() = default;
+
+  static bool Matches(const std::vector<std::string> &topics,
+                      const std::string &topic);
+  static std::string BuildMessage(int64_t id, const Subscriber &subscriber);
+
+  // With mutex_ held
+  void ScheduleFlush();
+
+  // UI thread, once per frame while there is something to send
+  void Flush();
+
+  std::mutex mutex_;
+  std::map<int64_t, Subscriber> subscribers_;
+  bool flushScheduled_ = false;
+  bool shutdown_ = false;
+};
+
+} // namespace SimpleIPC
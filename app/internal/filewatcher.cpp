@@ -0,0 +1,780 @@
+#include "filewatcher.hpp"
+#include "eventbus.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace SimpleIPC {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Share of the user's inotify watch limit one workspace may use; other
+// editors, language servers and build tools draw from the same limit
+constexpr size_t kWatchLimitShare = 2;
+constexpr size_t kDefaultWatchLimit = 8192;
+
+void AppendJsonString(std::string &out, const std::string &text) {
+  out.push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+}
+
+std::string Join(const std::string &dir, std::string_view name) {
+  return dir.empty() ? std::string(name) : dir + "/" + std::string(name);
+}
+
+// Glob matching with gitignore's rules: "*" and "?" stay within a path
+// component, "**" spans components, "[a-z]" and "[!a-z]" are classes and
+// "\" escapes the next character
+bool GlobMatch(std::string_view pattern, std::string_view text) {
+  while (!pattern.empty()) {
+    char c = pattern[0];
+    if (c == '*') {
+      if (pattern.size() > 1 && pattern[1] == '*') {
+        std::string_view rest = pattern.substr(2);
+        if (!rest.empty() && rest[0] == '/') {
+          // "**/": any number of whole directories, including none
+          rest = rest.substr(1);
+          for (size_t i = 0;;) {
+            if (GlobMatch(rest, text.substr(i)))
+              return true;
+            i = text.find('/', i);
+            if (i == std::string_view::npos)
+              return false;
+            ++i;
+          }
+        }
+        for (size_t i = 0; i <= text.size(); ++i) {
+          if (GlobMatch(rest, text.substr(i)))
+            return true;
+        }
+        return false;
+      }
+      std::string_view rest = pattern.substr(1);
+      for (size_t i = 0; i <= text.size(); ++i) {
+        if (GlobMatch(rest, text.substr(i)))
+          return true;
+        if (i < text.size() && text[i] == '/')
+          return false;
+      }
+      return false;
+    }
+
+    if (text.empty())
+      return false;
+    if (c == '?') {
+      if (text[0] == '/')
+        return false;
+    } else if (c == '[') {
+      size_t i = 1;
+      bool negate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+      if (negate)
+        ++i;
+      // A "]" first in the class is a member
+      size_t close = pattern.find(']', i + 1);
+      if (close == std::string_view::npos) {
+        // No class, a literal "["
+        if (text[0] != '[')
+          return false;
+      } else {
+        bool member = false;
+        for (; i < close; ++i) {
+          if (i + 2 < close && pattern[i + 1] == '-') {
+            member = member || (text[0] >= pattern[i] && text[0] <= pattern[i + 2]);
+            i += 2;
+          } else {
+            member = member || text[0] == pattern[i];
+          }
+        }
+        if (member == negate || text[0] == '/')
+          return false;
+        pattern = pattern.substr(close + 1);
+        text = text.substr(1);
+        continue;
+      }
+    } else {
+      if (c == '\\' && pattern.size() > 1) {
+        pattern = pattern.substr(1);
+        c = pattern[0];
+      }
+      if (c != text[0])
+        return false;
+    }
+    pattern = pattern.substr(1);
+    text = text.substr(1);
+  }
+  return text.empty();
+}
+
+struct IgnoreRule {
+  std::string pattern;
+  bool negate = false;
+  bool dirOnly = false;
+  bool anchored = false; // matched against the path, else the name alone
+};
+
+// The .gitignore files of a tree, read as directories are first looked at.
+// Paths are relative to the root and '/' separated.
+class IgnoreRules {
+public:
+  explicit IgnoreRules(fs::path root) : root_(std::move(root)) {}
+
+  bool Excluded(const std::string &path, bool directory) {
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && ExcludedDirectory(path.substr(0, slash)))
+      return true;
+    return directory ? ExcludedDirectory(path) : Matches(path, false);
+  }
+
+  // After the .gitignore in dir changed
+  void Reload(const std::string &dir) {
+    rules_.erase(dir);
+    excludedDirs_.clear();
+  }
+
+private:
+  bool ExcludedDirectory(const std::string &path) {
+    auto it = excludedDirs_.find(path);
+    if (it != excludedDirs_.end())
+      return it->second;
+    // Nothing under an excluded directory can be included again
+    size_t slash = path.rfind('/');
+    bool excluded =
+        (slash != std::string::npos &&
+         ExcludedDirectory(path.substr(0, slash))) ||
+        Matches(path, true);
+    excludedDirs_.emplace(path, excluded);
+    return excluded;
+  }
+
+  // Whether the rules of path's ancestors ignore path itself
+  bool Matches(const std::string &path, bool directory) {
+    size_t slash = path.rfind('/');
+    std::string_view name = path;
+    if (slash != std::string::npos)
+      name.remove_prefix(slash + 1);
+    if (directory && (name == ".git" || name == "node_modules"))
+      return true;
+
+    // From the root's .gitignore down, the last matching rule decides
+    bool ignored = false;
+    size_t end = 0;
+    for (;;) {
+      std::string dir = path.substr(0, end);
+      std::string_view relative = path;
+      relative.remove_prefix(end == 0 ? 0 : end + 1);
+      for (const IgnoreRule &rule : RulesOf(dir)) {
+        if (rule.dirOnly && !directory)
+          continue;
+        if (GlobMatch(rule.pattern, rule.anchored ? relative : name))
+          ignored = !rule.negate;
+      }
+      if (end == slash || slash == std::string::npos)
+        break;
+      end = path.find('/', end + 1);
+    }
+    return ignored;
+  }
+
+  const std::vector<IgnoreRule> &RulesOf(const std::string &dir) {
+    auto it = rules_.find(dir);
+    if (it != rules_.end())
+      return it->second;
+
+    std::vector<IgnoreRule> rules;
+    std::ifstream file(root_ / fs::u8path(dir) / ".gitignore");
+    std::string line;
+    while (std::getline(file, line)) {
+      while (!line.empty() && (line.back() == '\r' || line.back() == ' ') &&
+             !(line.size() > 1 && line[line.size() - 2] == '\\'))
+        line.pop_back();
+      if (line.empty() || line[0] == '#')
+        continue;
+      IgnoreRule rule;
+      if (line[0] == '!') {
+        rule.negate = true;
+        line.erase(0, 1);
+      } else if (line[0] == '\\') {
+        line.erase(0, 1);
+      }
+      if (!line.empty() && line.back() == '/') {
+        rule.dirOnly = true;
+        line.pop_back();
+      }
+      rule.anchored = line.find('/') != std::string::npos;
+      if (!line.empty() && line[0] == '/')
+        line.erase(0, 1);
+      if (line.empty())
+        continue;
+      rule.pattern = std::move(line);
+      rules.push_back(std::move(rule));
+    }
+    return rules_.emplace(dir, std::move(rules)).first->second;
+  }
+
+  fs::path root_;
+  std::unordered_map<std::string, std::vector<IgnoreRule>> rules_;
+  std::unordered_map<std::string, bool> excludedDirs_;
+};
+
+// Orders paths so that a directory's subtree directly follows it: '/'
+// sorts before every other character, so "d", "d/a", "d/b", "d-x"
+struct PathLess {
+  bool operator()(const std::string &a, const std::string &b) const {
+    size_t count = std::min(a.size(), b.size());
+    for (size_t i = 0; i < count; ++i) {
+      if (a[i] == b[i])
+        continue;
+      if (a[i] == '/' || b[i] == '/')
+        return a[i] == '/';
+      return static_cast<unsigned char>(a[i]) <
+             static_cast<unsigned char>(b[i]);
+    }
+    return a.size() < b.size();
+  }
+};
+
+// Changes since the last batch, one entry per path. What a path did in
+// between doesn't matter, only whether it existed before the first event
+// and after the last.
+class Coalescer {
+public:
+  bool Empty() const { return entries_.empty() && !overflow_; }
+
+  void Overflow() { overflow_ = true; }
+
+  void Add(const std::string &path, FileChange change) {
+    auto it = entries_.find(path);
+    if (it == entries_.end())
+      entries_.emplace(path, Entry{change != FileChange::Created,
+                                   change != FileChange::Deleted});
+    else
+      it->second.existsAfter = change != FileChange::Deleted;
+  }
+
+  // In path order. A path that is gone at the end stands for everything
+  // below it, which is gone too; its type doesn't matter, since a file has
+  // no entries below it. Decided here rather than as events come in, so a
+  // directory deleted and created again still reports its old contents.
+  FileEventBatch Take(const std::string &root) {
+    FileEventBatch batch;
+    batch.overflow = overflow_;
+    std::string gone; // "<path>/" of the last path gone, or empty
+    for (const auto &[path, entry] : entries_) {
+      if (!gone.empty() && path.compare(0, gone.size(), gone) == 0)
+        continue;
+      if (!entry.existsAfter)
+        gone = path + "/";
+      if (!entry.existedBefore && !entry.existsAfter)
+        continue;
+      FileChange change = !entry.existedBefore ? FileChange::Created
+                          : !entry.existsAfter ? FileChange::Deleted
+                                               : FileChange::Changed;
+      batch.events.push_back({root + "/" + path, change});
+    }
+    entries_.clear();
+    overflow_ = false;
+    return batch;
+  }
+
+private:
+  struct Entry {
+    bool existedBefore;
+    bool existsAfter;
+  };
+
+  std::map<std::string, Entry, PathLess> entries_;
+  bool overflow_ = false;
+};
+
+} // namespace
+
+// The watcher thread's state for one root
+class FileWatcher::Backend {
+public:
+  Backend(fs::path root, std::shared_ptr<Status> status)
+      : root_(std::move(root)), rootText_(root_.generic_u8string()),
+        rules_(root_), status_(std::move(status)) {}
+
+  ~Backend() {
+#ifdef _WIN32
+    if (directory_ != INVALID_HANDLE_VALUE)
+      CloseHandle(directory_);
+    if (overlapped_.hEvent)
+      CloseHandle(overlapped_.hEvent);
+    if (stopEvent_)
+      CloseHandle(stopEvent_);
+#else
+    if (inotify_ >= 0)
+      close(inotify_);
+    if (stopEvent_ >= 0)
+      close(stopEvent_);
+#endif
+  }
+
+  Backend(const Backend &) = delete;
+  Backend &operator=(const Backend &) = delete;
+
+  bool Open() {
+#ifdef _WIN32
+    stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    overlapped_.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    directory_ = CreateFileW(
+        root_.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr);
+    return stopEvent_ && overlapped_.hEvent &&
+           directory_ != INVALID_HANDLE_VALUE;
+#else
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopEvent_ = eventfd(0, EFD_CLOEXEC);
+    watchBudget_ = kDefaultWatchLimit;
+    std::ifstream limit("/proc/sys/fs/inotify/max_user_watches");
+    limit >> watchBudget_;
+    watchBudget_ /= kWatchLimitShare;
+    return inotify_ >= 0 && stopEvent_ >= 0;
+#endif
+  }
+
+  // Any thread
+  void Stop() {
+    stopping_ = true;
+#ifdef _WIN32
+    SetEvent(stopEvent_);
+#else
+    uint64_t one = 1;
+    (void)!write(stopEvent_, &one, sizeof(one));
+#endif
+  }
+
+  void Run(FileWatcher &owner) {
+#ifdef _WIN32
+    if (!Read())
+      return;
+    status_->watches = 1;
+#else
+    AddTree("", false);
+#endif
+    status_->ready = true;
+
+    while (!stopping_) {
+      int timeout = -1;
+      if (!coalescer_.Empty()) {
+        auto now = Clock::now();
+        auto deadline = std::min(lastEvent_ + std::chrono::milliseconds(kDebounceMs),
+                                 firstEvent_ + std::chrono::milliseconds(kMaxLatencyMs));
+        if (deadline <= now) {
+          owner.Deliver(coalescer_.Take(rootText_));
+          continue;
+        }
+        timeout = static_cast<int>(
+            std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+      }
+
+#ifdef _WIN32
+      HANDLE handles[] = {stopEvent_, overlapped_.hEvent};
+      DWORD result = WaitForMultipleObjects(
+          2, handles, FALSE, timeout < 0 ? INFINITE : DWORD(timeout));
+      if (result == WAIT_OBJECT_0 + 1 && !ReadEvents())
+        break;
+      if (result == WAIT_FAILED)
+        break;
+#else
+      pollfd fds[] = {{stopEvent_, POLLIN, 0}, {inotify_, POLLIN, 0}};
+      if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+        break;
+      if ((fds[1].revents & POLLIN) && !ReadEvents())
+        break;
+#endif
+    }
+    // Changes that came in just before the root went away
+    if (!stopping_ && !coalescer_.Empty())
+      owner.Deliver(coalescer_.Take(rootText_));
+#ifdef _WIN32
+    CancelIoEx(directory_, &overlapped_);
+    DWORD ignored;
+    GetOverlappedResult(directory_, &overlapped_, &ignored, TRUE);
+#endif
+  }
+
+private:
+  void Add(const std::string &path, FileChange change) {
+    auto now = Clock::now();
+    if (coalescer_.Empty())
+      firstEvent_ = now;
+    lastEvent_ = now;
+    coalescer_.Add(path, change);
+  }
+
+  void Overflow() {
+    if (coalescer_.Empty())
+      firstEvent_ = Clock::now();
+    lastEvent_ = Clock::now();
+    coalescer_.Overflow();
+  }
+
+  // An event for path that the watch reported
+  void Report(const std::string &path, FileChange change, bool directory) {
+    if (rules_.Excluded(path, directory))
+      return;
+    size_t slash = path.rfind('/');
+    std::string_view name = path;
+    if (slash != std::string::npos)
+      name.remove_prefix(slash + 1);
+    if (name == ".gitignore")
+      rules_.Reload(slash == std::string::npos ? "" : path.substr(0, slash));
+    Add(path, change);
+  }
+
+#ifdef _WIN32
+  bool Read() {
+    ResetEvent(overlapped_.hEvent);
+    return ReadDirectoryChangesW(
+        directory_, buffer_, sizeof(buffer_), TRUE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+            FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+        nullptr, &overlapped_, nullptr);
+  }
+
+  bool ReadEvents() {
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(directory_, &overlapped_, &bytes, FALSE)) {
+      // The root itself was deleted or renamed
+      Overflow();
+      return false;
+    }
+    if (bytes == 0) {
+      // The buffer overflowed and the changes are lost
+      Overflow();
+    }
+
+    for (DWORD offset = 0; bytes != 0;) {
+      auto *info = reinterpret_cast<FILE_NOTIFY_INFORMATION *>(buffer_ + offset);
+      std::wstring name(info->FileName,
+                        info->FileNameLength / sizeof(WCHAR));
+      std::string path = fs::path(name).generic_u8string();
+      // Whether a removed path was a directory can't be known anymore; the
+      // coalescer doesn't need to
+      DWORD attributes = GetFileAttributesW((root_ / name).c_str());
+      bool directory = attributes != INVALID_FILE_ATTRIBUTES &&
+                       (attributes & FILE_ATTRIBUTE_DIRECTORY);
+      switch (info->Action) {
+      case FILE_ACTION_ADDED:
+      case FILE_ACTION_RENAMED_NEW_NAME:
+        Report(path, FileChange::Created, directory);
+        break;
+      case FILE_ACTION_REMOVED:
+      case FILE_ACTION_RENAMED_OLD_NAME:
+        Report(path, FileChange::Deleted, directory);
+        break;
+      case FILE_ACTION_MODIFIED:
+        // A directory is "modified" whenever its entries are
+        if (!directory)
+          Report(path, FileChange::Changed, false);
+        break;
+      }
+      if (info->NextEntryOffset == 0)
+        break;
+      offset += info->NextEntryOffset;
+    }
+    return Read();
+  }
+#else
+  // Watches dir and the directories below it, nearest first, so a tree
+  // bigger than the watch budget keeps its top levels covered. With report
+  // set, dir is new and what is already in it was created.
+  void AddTree(const std::string &dir, bool report) {
+    std::deque<std::string> queue = {dir};
+    while (!queue.empty() && !stopping_) {
+      std::string current = std::move(queue.front());
+      queue.pop_front();
+      if (!AddWatch(current)) {
+        ++status_->unwatched;
+        continue;
+      }
+
+      std::error_code error;
+      fs::directory_iterator it(root_ / fs::u8path(current),
+                                fs::directory_options::skip_permission_denied,
+                                error);
+      for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        std::string path = Join(current, it->path().filename().u8string());
+        // Symlinked directories are not followed, they could loop
+        bool directory = it->symlink_status(error).type() ==
+                         fs::file_type::directory;
+        if (rules_.Excluded(path, directory)) {
+          if (directory)
+            ++status_->excluded;
+          continue;
+        }
+        if (report)
+          Add(path, FileChange::Created);
+        if (directory)
+          queue.push_back(std::move(path));
+      }
+    }
+  }
+
+  bool AddWatch(const std::string &dir) {
+    if (watches_.size() >= watchBudget_)
+      return false;
+    std::string path = (root_ / fs::u8path(dir)).string();
+    int wd = inotify_add_watch(
+        inotify_, path.c_str(),
+        IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM |
+            IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR |
+            IN_DONT_FOLLOW | IN_EXCL_UNLINK);
+    if (wd < 0) {
+      // ENOSPC: the user's limit is used up by other programs
+      if (errno == ENOSPC)
+        watchBudget_ = watches_.size();
+      return false;
+    }
+    // The same directory under a new name keeps its watch
+    auto existing = watches_.find(wd);
+    if (existing != watches_.end())
+      paths_.erase(existing->second);
+    watches_[wd] = dir;
+    paths_[dir] = wd;
+    status_->watches = watches_.size();
+    return true;
+  }
+
+  // Drops the watches of dir and below, after it was deleted or moved away
+  void RemoveTree(const std::string &dir) {
+    auto remove = [this](std::map<std::string, int>::iterator it) {
+      inotify_rm_watch(inotify_, it->second);
+      watches_.erase(it->second);
+      return paths_.erase(it);
+    };
+    auto exact = paths_.find(dir);
+    if (exact != paths_.end())
+      remove(exact);
+    std::string prefix = dir + "/";
+    for (auto it = paths_.lower_bound(prefix);
+         it != paths_.end() && it->first.compare(0, prefix.size(), prefix) == 0;)
+      it = remove(it);
+    status_->watches = watches_.size();
+  }
+
+  // False once the root itself was deleted, moved or unmounted
+  bool ReadEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+      ssize_t length = read(inotify_, buffer, sizeof(buffer));
+      if (length <= 0)
+        return true;
+      for (ssize_t offset = 0; offset < length;) {
+        auto *event = reinterpret_cast<inotify_event *>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+          Overflow();
+          continue;
+        }
+        auto watch = watches_.find(event->wd);
+        if (watch == watches_.end())
+          continue;
+        if (watch->second.empty() &&
+            (event->mask &
+             (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED))) {
+          // Nothing under the old path is watched anymore
+          Overflow();
+          return false;
+        }
+        if (event->mask & IN_IGNORED) {
+          paths_.erase(watch->second);
+          watches_.erase(watch);
+          status_->watches = watches_.size();
+          continue;
+        }
+        // Events on the directory itself are reported by its parent
+        if (event->len == 0)
+          continue;
+
+        std::string path = Join(watch->second, event->name);
+        bool directory = event->mask & IN_ISDIR;
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          Report(path, FileChange::Created, directory);
+          if (directory && !rules_.Excluded(path, true))
+            AddTree(path, true);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          Report(path, FileChange::Deleted, directory);
+          if (directory)
+            RemoveTree(path);
+        } else if (!directory) {
+          Report(path, FileChange::Changed, false);
+        }
+      }
+    }
+  }
+#endif
+
+  fs::path root_;
+  std::string rootText_;
+  IgnoreRules rules_;
+  std::shared_ptr<Status> status_;
+  Coalescer coalescer_;
+  Clock::time_point firstEvent_;
+  Clock::time_point lastEvent_;
+  std::atomic<bool> stopping_{false};
+#ifdef _WIN32
+  HANDLE directory_ = INVALID_HANDLE_VALUE;
+  HANDLE stopEvent_ = nullptr;
+  OVERLAPPED overlapped_ = {};
+  // 64 KB is the most ReadDirectoryChangesW takes for network shares
+  alignas(DWORD) char buffer_[64 * 1024];
+#else
+  int inotify_ = -1;
+  int stopEvent_ = -1;
+  size_t watchBudget_ = 0;
+  std::unordered_map<int, std::string> watches_;
+  std::map<std::string, int> paths_; // sorted, for a directory's subtree
+#endif
+};
+
+FileWatcher &FileWatcher::GetInstance() {
+  static FileWatcher instance;
+  return instance;
+}
+
+FileWatcher::~FileWatcher() { Stop(); }
+
+bool FileWatcher::Watch(const std::string &root) {
+  std::lock_guard<std::mutex> control(controlMutex_);
+  StopWatching();
+
+  std::error_code error;
+  fs::path path = fs::absolute(fs::u8path(root), error).lexically_normal();
+  if (error || !fs::is_directory(path, error))
+    return false;
+  // No trailing separator, so paths are root + "/" + relative path
+  if (!path.has_filename() && path.has_parent_path() &&
+      path != path.root_path())
+    path = path.parent_path();
+
+  auto status = std::make_shared<Status>();
+  auto backend = std::make_shared<Backend>(path, status);
+  if (!backend->Open())
+    return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  root_ = path.generic_u8string();
+  status_ = status;
+  backend_ = backend;
+  thread_ = std::thread([this, backend] { backend->Run(*this); });
+  return true;
+}
+
+void FileWatcher::Stop() {
+  std::lock_guard<std::mutex> control(controlMutex_);
+  StopWatching();
+}
+
+void FileWatcher::StopWatching() {
+  std::shared_ptr<Backend> backend;
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    backend = std::move(backend_);
+    thread = std::move(thread_);
+    root_.clear();
+    status_.reset();
+  }
+  if (backend)
+    backend->Stop();
+  if (thread.joinable())
+    thread.join();
+}
+
+int FileWatcher::AddListener(Listener listener) {
+  std::lock_guard<std::mutex> lock(listenersMutex_);
+  int id = nextListener_++;
+  listeners_.emplace(id, std::move(listener));
+  return id;
+}
+
+void FileWatcher::RemoveListener(int id) {
+  std::lock_guard<std::mutex> lock(listenersMutex_);
+  listeners_.erase(id);
+}
+
+std::string FileWatcher::StatusJson() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!status_)
+    return "{\"root\":null}";
+  std::string out = "{\"root\":";
+  AppendJsonString(out, root_);
+  out += ",\"watches\":" + std::to_string(status_->watches.load()) +
+         ",\"excluded\":" + std::to_string(status_->excluded.load()) +
+         ",\"unwatched\":" + std::to_string(status_->unwatched.load()) +
+         ",\"ready\":" + (status_->ready ? "true" : "false") + "}";
+  return out;
+}
+
+void FileWatcher::Deliver(const FileEventBatch &batch) {
+  const std::vector<FileEvent> &events = batch.events;
+  if (events.empty() && !batch.overflow)
+    return;
+
+  size_t start = 0;
+  do {
+    size_t end = std::min(events.size(), start + kMaxEventChanges);
+    std::string data = "{\"changes\":[";
+    for (size_t i = start; i < end; ++i) {
+      if (i != start)
+        data.push_back(',');
+      data += "{\"path\":";
+      AppendJsonString(data, events[i].path);
+      data += ",\"type\":" +
+              std::to_string(static_cast<int>(events[i].change)) + "}";
+    }
+    data += std::string("],\"overflow\":") +
+            (batch.overflow ? "true" : "false") + "}";
+    EventBus::GetInstance().Publish("fs.changed", std::move(data));
+    start = end;
+  } while (start < events.size());
+
+  std::vector<Listener> listeners;
+  {
+    std::lock_guard<std::mutex> lock(listenersMutex_);
+    for (const auto &entry : listeners_)
+      listeners.push_back(entry.second);
+  }
+  for (const Listener &listener : listeners)
+    listener(batch);
+}
+
+} // namespace SimpleIPC
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SimpleIPC {
+
+// Same values as the language server protocol's FileChangeType, so batches
+// go to workspace/didChangeWatchedFiles unchanged
+enum class FileChange {
+  Created = 1,
+  Changed = 2,
+  Deleted = 3,
+};
+
+struct FileEvent {
+  std::string path; // absolute, UTF-8, '/' separated
+  FileChange change;
+};
+
+// A batch of coalesced changes. With overflow set the OS dropped events
+// and the batch is incomplete: anything under the root may have changed.
+struct FileEventBatch {
+  std::vector<FileEvent> events;
+  bool overflow = false;
+};
+
+// Watches the open workspace recursively and reports what changed outside
+// the editor. Events are held until the tree has been quiet for
+// kDebounceMs (at most kMaxLatencyMs) and coalesced per path: created then
+// modified is created, created then deleted is nothing, deleted then
+// created is changed, and a rename is a delete and a create. Deleting a
+// directory reports the directory alone, unless it was created again within
+// the batch. If the root itself is deleted or moved, a last batch with
+// overflow set is delivered and watching stops.
+//
+// Directories excluded by .gitignore files (nested ones too), .git and
+// node_modules are skipped. On Linux, where inotify needs a watch per
+// directory, that keeps dependency trees from using up the user's watch
+// limit; the watcher also stays within a share of that limit and, when a
+// tree is too big, watches the directories nearest the root and reports
+// the rest as unwatched. On Windows one ReadDirectoryChangesW handle covers
+// the tree and excluded paths are filtered out.
+//
+// Batches are published to the event bus as topic "fs.changed":
+//   {"changes": [{"path": "/ws/a.cpp", "type": 1}, ...], "overflow": false}
+// and passed to listeners, e.g. the language server client.
+class FileWatcher {
+public:
+  // Called on the watcher thread
+  using Listener = std::function<void(const FileEventBatch &batch)>;
+
+  static constexpr int kDebounceMs = 50;
+  static constexpr int kMaxLatencyMs = 500;
+  // Changes per "fs.changed" event; larger batches are split
+  static constexpr size_t kMaxEventChanges = 1000;
+
+  static FileWatcher &GetInstance();
+
+  // Starts watching root, replacing the current root. Fails if root is not
+  // a directory. Watch and Stop block until the previous watcher thread has
+  // exited, so listeners must not call them.
+  bool Watch(const std::string &root);
+  void Stop();
+
+  int AddListener(Listener listener);
+  void RemoveListener(int id);
+
+  // {"root": "/ws", "watches": n, "excluded": n, "unwatched": n,
+  //  "ready": true}. watches are the OS watches in use, excluded and
+  //  unwatched count directories skipped by the rules and the watch limit
+  //  (not their subdirectories); ready once the initial watches are set.
+  std::string StatusJson();
+
+private:
+  class Backend;
+  friend class Backend;
+
+  struct Status {
+    std::atomic<size_t> watches{0};
+    std::atomic<size_t> excluded{0};
+    std::atomic<size_t> unwatched{0};
+    std::atomic<bool> ready{false};
+  };
+
+  FileWatcher() = default;
+  ~FileWatcher();
+
+  void StopWatching();
+  void Deliver(const FileEventBatch &batch);
+
+  std::mutex controlMutex_; // held through Watch and Stop
+  std::mutex mutex_;        // the members below
+  std::string root_;
+  std::shared_ptr<Backend> backend_;
+  std::thread thread_;
+  std::shared_ptr<Status> status_;
+
+  std::mutex listenersMutex_;
+  std::map<int, Listener> listeners_;
+  int nextListener_ = 1;
+};
+
+} // namespace SimpleIPC
@@ -0,0 +1,599 @@
+#include "fsservice.hpp"
+#include "filewatcher.hpp"
+#include "simpleipc.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace SimpleIPC {
+
+namespace {
+
+std::string PathError(const char *what, const fs::path &path,
+                      const std::error_code &error = {}) {
+  std::string message = std::string(what) + " " + path.u8string();
+  if (error)
+    message += ": " + error.message();
+  return message;
+}
+
+// A file open for reading. Reads go straight from the file into the
+// caller's buffer at an explicit offset, so concurrent reads of one handle
+// don't share a file position. The size is the one the file had when
+// opened; a file that grows later reads as ending there.
+class OpenFile {
+public:
+  explicit OpenFile(const fs::path &path) {
+#ifdef _WIN32
+    file_ = CreateFileW(path.c_str(), GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+      throw std::runtime_error(PathError("Cannot open", path));
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+      CloseHandle(file_);
+      throw std::runtime_error(PathError("Cannot read the size of", path));
+    }
+    size_ = static_cast<uint64_t>(size.QuadPart);
+#else
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+      throw std::runtime_error(PathError(
+          "Cannot open", path, std::error_code(errno, std::generic_category())));
+    struct stat info;
+    if (fstat(fd_, &info) != 0 || !S_ISREG(info.st_mode)) {
+      close(fd_);
+      throw std::runtime_error(PathError("Not a regular file:", path));
+    }
+    size_ = static_cast<uint64_t>(info.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Files are mostly read front to back, a chunk at a time
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+  }
+
+  ~OpenFile() {
+#ifdef _WIN32
+    CloseHandle(file_);
+#else
+    close(fd_);
+#endif
+  }
+
+  OpenFile(const OpenFile &) = delete;
+  OpenFile &operator=(const OpenFile &) = delete;
+
+  uint64_t Size() const { return size_; }
+
+  // Reads up to length bytes at offset into out; returns the count read,
+  // which is short only at the end of the file (e.g. one truncated since it
+  // was opened)
+  size_t Read(uint64_t offset, uint64_t length, char *out) const {
+    size_t total = 0;
+    while (total < length) {
+      uint64_t position = offset + total;
+#ifdef _WIN32
+      DWORD chunk = static_cast<DWORD>(
+          std::min<uint64_t>(length - total, uint64_t(1) << 30));
+      OVERLAPPED overlapped = {};
+      overlapped.Offset = static_cast<DWORD>(position);
+      overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+      DWORD count = 0;
+      if (!ReadFile(file_, out + total, chunk, &count, &overlapped)) {
+        if (GetLastError() == ERROR_HANDLE_EOF)
+          break;
+        throw std::runtime_error("Cannot read the file");
+      }
+#else
+      ssize_t count = pread(fd_, out + total, length - total,
+                            static_cast<off_t>(position));
+      if (count < 0) {
+        if (errno == EINTR)
+          continue;
+        throw std::runtime_error(
+            "Cannot read the file: " +
+            std::error_code(errno, std::generic_category()).message());
+      }
+#endif
+      if (count == 0)
+        break;
+      total += static_cast<size_t>(count);
+    }
+    return total;
+  }
+
+private:
+  uint64_t size_ = 0;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+  int fd_ = -1;
+#endif
+};
+
+// A write in progress: the content goes to a temporary file next to the
+// target, which is renamed over it on commit. Discarded unless committed.
+class PendingWrite {
+public:
+  explicit PendingWrite(fs::path target) : target_(std::move(target)) {
+    // Through a symlink, the file it points to is replaced, not the link
+    std::error_code error;
+    if (fs::is_symlink(fs::symlink_status(target_, error))) {
+      fs::path resolved = fs::canonical(target_, error);
+      if (!error)
+        target_ = resolved;
+    }
+
+    std::random_device random;
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", random());
+    temp_ = target_;
+    temp_ += suffix;
+#ifdef _WIN32
+    file_ = _wfopen(temp_.c_str(), L"wb");
+#else
+    file_ = std::fopen(temp_.c_str(), "wb");
+#endif
+    if (!file_)
+      throw std::runtime_error(PathError(
+          "Cannot write", target_,
+          std::error_code(errno, std::generic_category())));
+  }
+
+  ~PendingWrite() {
+    if (file_) {
+      std::fclose(file_);
+      std::error_code ignored;
+      fs::remove(temp_, ignored);
+    }
+  }
+
+  PendingWrite(const PendingWrite &) = delete;
+  PendingWrite &operator=(const PendingWrite &) = delete;
+
+  uint64_t Append(std::string_view data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_)
+      throw std::runtime_error(PathError("Write already finished:", target_));
+    if (std::fwrite(data.data(), 1, data.size(), file_) != data.size())
+      throw std::runtime_error(PathError(
+          "Cannot write", target_,
+          std::error_code(errno, std::generic_category())));
+    written_ += data.size();
+    return written_;
+  }
+
+  // Flushes the content to disk and replaces the target with it
+  uint64_t Commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_)
+      throw std::runtime_error(PathError("Write already finished:", target_));
+    bool flushed = std::fflush(file_) == 0;
+#ifdef _WIN32
+    flushed = flushed && _commit(_fileno(file_)) == 0;
+#else
+    flushed = flushed && fsync(fileno(file_)) == 0;
+#endif
+    flushed = std::fclose(file_) == 0 && flushed;
+    file_ = nullptr;
+
+    std::error_code error;
+    if (flushed) {
+      // Keep the target's permissions, e.g. an executable script stays so
+      fs::file_status status = fs::status(target_, error);
+      if (!error && fs::exists(status))
+        fs::permissions(temp_, status.permissions(), error);
+      error.clear();
+      // Atomic on POSIX; MoveFileExW with MOVEFILE_REPLACE_EXISTING on Windows
+      fs::rename(temp_, target_, error);
+    }
+    if (!flushed || error) {
+      std::error_code ignored;
+      fs::remove(temp_, ignored);
+      throw std::runtime_error(PathError("Cannot write", target_, error));
+    }
+    return written_;
+  }
+
+private:
+  std::mutex mutex_;
+  fs::path target_;
+  fs::path temp_;
+  std::FILE *file_ = nullptr;
+  uint64_t written_ = 0;
+};
+
+// A directory listing in progress
+struct DirectoryCursor {
+  std::mutex mutex;
+  fs::path path;
+  fs::directory_iterator it;
+};
+
+std::atomic<uint64_t> g_next_handle{1};
+
+// Open objects of one kind by handle. Handles are never reused and come
+// from one counter, so a handle of one kind is never valid for another.
+// Pages that forget to close are bounded: opening one more than
+// kFsMaxHandles releases the oldest.
+template <typename T> class HandleTable {
+public:
+  uint64_t Add(std::shared_ptr<T> object) {
+    uint64_t handle = g_next_handle++;
+    std::shared_ptr<T> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (objects_.size() >= kFsMaxHandles) {
+      // Released outside the lock with the other locals
+      evicted = std::move(objects_.begin()->second);
+      objects_.erase(objects_.begin());
+    }
+    objects_.emplace(handle, std::move(object));
+    return handle;
+  }
+
+  std::shared_ptr<T> Get(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = objects_.find(handle);
+    if (it == objects_.end())
+      throw std::runtime_error("Invalid handle: " + std::to_string(handle));
+    return it->second;
+  }
+
+  std::shared_ptr<T> Remove(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = objects_.find(handle);
+    if (it == objects_.end())
+      return nullptr;
+    std::shared_ptr<T> object = std::move(it->second);
+    objects_.erase(it);
+    return object;
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<uint64_t, std::shared_ptr<T>> objects_;
+};
+
+HandleTable<OpenFile> g_files;
+HandleTable<PendingWrite> g_writes;
+HandleTable<DirectoryCursor> g_listings;
+
+// The fields of a request map. Each lookup scans from the start of the map,
+// so fields may come in any order.
+class Request {
+public:
+  explicit Request(CborReader &reader) : start_(reader) {
+    if (!start_.ReadMap(pairs_))
+      throw std::runtime_error("Request must be a map");
+  }
+
+  bool UInt(std::string_view key, uint64_t &value) const {
+    CborReader reader = start_;
+    return reader.FindKey(pairs_, key) && reader.ReadUInt(value);
+  }
+
+  uint64_t RequiredUInt(std::string_view key) const {
+    uint64_t value;
+    if (!UInt(key, value))
+      throw std::runtime_error("Missing " + std::string(key));
+    return value;
+  }
+
+  fs::path Path() const {
+    CborReader reader = start_;
+    std::string_view path;
+    if (!reader.FindKey(pairs_, "path") || !reader.ReadText(path) ||
+        path.empty())
+      throw std::runtime_error("Missing path");
+    return fs::u8path(path.begin(), path.end());
+  }
+
+  // Content to write, as bytes or text
+  std::string_view Data() const {
+    CborReader reader = start_;
+    std::string_view data;
+    if (!reader.FindKey(pairs_, "data") ||
+        !(reader.ReadBytes(data) || reader.ReadText(data)))
+      throw std::runtime_error("Missing data");
+    return data;
+  }
+
+private:
+  CborReader start_;
+  size_t pairs_ = 0;
+};
+
+const char *TypeName(fs::file_type type) {
+  switch (type) {
+  case fs::file_type::regular:
+    return "file";
+  case fs::file_type::directory:
+    return "dir";
+  default:
+    return "other";
+  }
+}
+
+// Milliseconds since the Unix epoch. C++17 has no conversion from the file
+// clock, so this goes through both clocks' current time.
+int64_t ToUnixMs(fs::file_time_type time) {
+  auto system = std::chrono::system_clock::now() +
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    time - fs::file_time_type::clock::now());
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             system.time_since_epoch())
+      .count();
+}
+
+void HandleStat(CborReader &reader, CborWriter &response) {
+  fs::path path = Request(reader).Path();
+  std::error_code error;
+  fs::file_status status = fs::status(path, error);
+  if (error)
+    throw std::runtime_error(PathError("Cannot stat", path, error));
+  uint64_t size = 0;
+  if (status.type() == fs::file_type::regular)
+    size = fs::file_size(path, error);
+  fs::file_time_type mtime = fs::last_write_time(path, error);
+
+  response.BeginMap(3);
+  response.Text("type");
+  response.Text(TypeName(status.type()));
+  response.Text("size");
+  response.UInt(size);
+  response.Text("mtime");
+  if (error)
+    response.Null();
+  else
+    response.Int(ToUnixMs(mtime));
+}
+
+void HandleOpen(CborReader &reader, CborWriter &response) {
+  auto file = std::make_shared<OpenFile>(Request(reader).Path());
+  uint64_t size = file->Size();
+  uint64_t handle = g_files.Add(std::move(file));
+
+  response.BeginMap(2);
+  response.Text("handle");
+  response.UInt(handle);
+  response.Text("size");
+  response.UInt(size);
+}
+
+// Reads from an open handle, or opens the path for this one read
+void HandleRead(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  std::shared_ptr<OpenFile> file;
+  uint64_t handle;
+  if (request.UInt("handle", handle))
+    file = g_files.Get(handle);
+  else
+    file = std::make_shared<OpenFile>(request.Path());
+
+  uint64_t offset = 0;
+  uint64_t length = kFsDefaultReadLength;
+  request.UInt("offset", offset);
+  request.UInt("length", length);
+  length = std::min(length, kFsMaxReadLength);
+  uint64_t size = file->Size();
+  uint64_t available = offset < size ? size - offset : 0;
+  length = std::min(length, available);
+
+  response.BeginMap(3);
+  response.Text("data");
+  // Straight from the file into the response
+  char *out = response.BytesInPlace(static_cast<size_t>(length));
+  size_t read = file->Read(offset, length, out);
+  if (read != length)
+    throw std::runtime_error("File was truncated while reading");
+  response.Text("size");
+  response.UInt(size);
+  response.Text("eof");
+  response.Bool(offset + length >= size);
+}
+
+void HandleClose(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  uint64_t handle = request.RequiredUInt("handle");
+  // Whatever kind it is
+  g_files.Remove(handle);
+  g_writes.Remove(handle);
+  g_listings.Remove(handle);
+  response.Null();
+}
+
+void HandleWrite(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  PendingWrite write(request.Path());
+  write.Append(request.Data());
+  uint64_t size = write.Commit();
+
+  response.BeginMap(1);
+  response.Text("size");
+  response.UInt(size);
+}
+
+void HandleWriteBegin(CborReader &reader, CborWriter &response) {
+  auto write = std::make_shared<PendingWrite>(Request(reader).Path());
+  uint64_t handle = g_writes.Add(std::move(write));
+
+  response.BeginMap(1);
+  response.Text("handle");
+  response.UInt(handle);
+}
+
+void HandleWriteChunk(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  std::shared_ptr<PendingWrite> write =
+      g_writes.Get(request.RequiredUInt("handle"));
+  uint64_t size = write->Append(request.Data());
+
+  response.BeginMap(1);
+  response.Text("size");
+  response.UInt(size);
+}
+
+void HandleWriteCommit(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  uint64_t handle = request.RequiredUInt("handle");
+  std::shared_ptr<PendingWrite> write = g_writes.Remove(handle);
+  if (!write)
+    throw std::runtime_error("Invalid handle: " + std::to_string(handle));
+  uint64_t size = write->Commit();
+
+  response.BeginMap(1);
+  response.Text("size");
+  response.UInt(size);
+}
+
+void HandleWriteAbort(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  // The temporary file goes with the last reference
+  g_writes.Remove(request.RequiredUInt("handle"));
+  response.Null();
+}
+
+struct ListedEntry {
+  std::string name;
+  fs::file_type type;
+  uint64_t size;
+};
+
+void HandleReadDir(CborReader &reader, CborWriter &response) {
+  Request request(reader);
+  uint64_t limit = kFsDefaultListLimit;
+  request.UInt("limit", limit);
+  limit = std::max<uint64_t>(1, std::min(limit, kFsMaxListLimit));
+
+  std::shared_ptr<DirectoryCursor> cursor;
+  uint64_t handle = 0;
+  if (request.UInt("cursor", handle)) {
+    cursor = g_listings.Get(handle);
+  } else {
+    cursor = std::make_shared<DirectoryCursor>();
+    cursor->path = request.Path();
+    std::error_code error;
+    cursor->it = fs::directory_iterator(
+        cursor->path, fs::directory_options::skip_permission_denied, error);
+    if (error)
+      throw std::runtime_error(PathError("Cannot list", cursor->path, error));
+  }
+
+  std::vector<ListedEntry> entries;
+  std::error_code error;
+  bool done;
+  {
+    std::lock_guard<std::mutex> lock(cursor->mutex);
+    for (; cursor->it != fs::directory_iterator() && entries.size() < limit;
+         cursor->it.increment(error)) {
+      if (error)
+        break;
+      const fs::directory_entry &entry = *cursor->it;
+      // The type comes with the listing on most platforms; size costs a
+      // stat on POSIX, so only files get one
+      std::error_code ignored;
+      fs::file_type type = entry.status(ignored).type();
+      uint64_t size = 0;
+      if (type == fs::file_type::regular)
+        size = entry.file_size(ignored);
+      entries.push_back({entry.path().filename().u8string(), type,
+                         size == static_cast<uintmax_t>(-1) ? 0 : size});
+    }
+    done = cursor->it == fs::directory_iterator();
+  }
+
+  // A listing that stops early would look complete, so fail the call
+  if (error) {
+    if (handle != 0)
+      g_listings.Remove(handle);
+    throw std::runtime_error(PathError("Cannot list", cursor->path, error));
+  }
+  if (done) {
+    if (handle != 0)
+      g_listings.Remove(handle);
+    handle = 0;
+  } else if (handle == 0) {
+    handle = g_listings.Add(std::move(cursor));
+  }
+
+  response.BeginMap(2);
+  response.Text("entries");
+  response.BeginArray(entries.size());
+  for (const ListedEntry &entry : entries) {
+    response.BeginMap(3);
+    response.Text("name");
+    response.Text(entry.name);
+    response.Text("type");
+    response.Text(TypeName(entry.type));
+    response.Text("size");
+    response.UInt(entry.size);
+  }
+  response.Text("cursor");
+  if (handle == 0)
+    response.Null();
+  else
+    response.UInt(handle);
+}
+
+// message is the workspace root; empty stops watching
+std::string HandleWatch(const std::string &message) {
+  FileWatcher &watcher = FileWatcher::GetInstance();
+  if (message.empty())
+    watcher.Stop();
+  else if (!watcher.Watch(message))
+    throw std::runtime_error("Cannot watch " + message);
+  return watcher.StatusJson();
+}
+
+std::string HandleWatchStatus(const std::string &) {
+  return FileWatcher::GetInstance().StatusJson();
+}
+
+} // namespace
+
+void RegisterFileSystemHandlers(IPCHandler &ipc) {
+  ipc.RegisterBinaryHandler("fs.stat", HandleStat);
+  ipc.RegisterBinaryHandler("fs.open", HandleOpen);
+  ipc.RegisterBinaryHandler("fs.read", HandleRead);
+  ipc.RegisterBinaryHandler("fs.close", HandleClose);
+  ipc.RegisterBinaryHandler("fs.write", HandleWrite);
+  ipc.RegisterBinaryHandler("fs.writeBegin", HandleWriteBegin);
+  // In order: the chunks of a write are appended as they arrive
+  ipc.RegisterBinaryHandler("fs.writeChunk", HandleWriteChunk,
+                            {HandlerThread::Worker, 1});
+  ipc.RegisterBinaryHandler("fs.writeCommit", HandleWriteCommit);
+  ipc.RegisterBinaryHandler("fs.writeAbort", HandleWriteAbort);
+  ipc.RegisterBinaryHandler("fs.readdir", HandleReadDir);
+  ipc.RegisterHandler("fs.watch", HandleWatch, {HandlerThread::Worker});
+  ipc.RegisterHandler("fs.watchStatus", HandleWatchStatus,
+                      {HandlerThread::Worker});
+}
+
+} // namespace SimpleIPC
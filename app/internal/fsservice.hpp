@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SimpleIPC {
+class IPCHandler;
+
+// File system methods of the binary channel, run on the IPC worker pool.
+// Requests and responses are CBOR maps; paths are UTF-8 and file contents
+// travel as byte strings. Failures (missing file, bad handle) fail the call
+// with a message.
+//
+//   fs.stat        {path} -> {type: "file" | "dir" | "other", size, mtime}
+//   fs.open        {path} -> {handle, size}
+//   fs.read        {handle | path, offset?, length?} -> {data, size, eof}
+//   fs.close       {handle}
+//   fs.write       {path, data} -> {size}
+//   fs.writeBegin  {path} -> {handle}
+//   fs.writeChunk  {handle, data} -> {size}
+//   fs.writeCommit {handle} -> {size}
+//   fs.writeAbort  {handle}
+//   fs.readdir     {path | cursor, limit?} -> {entries: [{name, type, size}],
+//                                              cursor | null}
+//
+// A read copies the requested range from the file once, straight into the
+// response; a large file is read in chunks as the page needs them instead
+// of in one copy. A file truncated while open fails the read. Writes go to a
+// temporary file next to the target that replaces it only once complete
+// and flushed to disk, so a crash or failed write never leaves it half
+// written. Directory listings come in batches of at most limit entries;
+// the cursor continues the listing, and a directory that can't be read to
+// the end fails the call rather than returning part of it.
+//
+// Two text methods control the workspace's FileWatcher, which publishes
+// changes as "fs.changed" events:
+//
+//   fs.watch       "<root>" -> status, or "" to stop
+//   fs.watchStatus ""       -> status (FileWatcher::StatusJson)
+void RegisterFileSystemHandlers(IPCHandler &ipc);
+
+// Limits of the methods above
+constexpr uint64_t kFsDefaultReadLength = uint64_t(1) << 20;
+constexpr uint64_t kFsMaxReadLength = uint64_t(16) << 20;
+constexpr uint64_t kFsDefaultListLimit = 500;
+constexpr uint64_t kFsMaxListLimit = 5000;
+// Open handles of each kind; opening more closes the oldest
+constexpr size_t kFsMaxHandles = 64;
+
+} // namespace SimpleIPC
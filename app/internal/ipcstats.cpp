@@ -0,0 +1,377 @@
+#include "ipcstats.hpp"
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace SimpleIPC {
+
+namespace {
+
+int Log2(uint64_t value) {
+  int bits = 0;
+  for (int step = 32; step > 0; step /= 2) {
+    if (value >> step) {
+      value >>= step;
+      bits += step;
+    }
+  }
+  return bits;
+}
+
+uint64_t CurrentProcessId() {
+#ifdef _WIN32
+  return GetCurrentProcessId();
+#else
+  return static_cast<uint64_t>(getpid());
+#endif
+}
+
+// The OS thread id, which is what CEF's traces show
+uint64_t CurrentThreadId() {
+#ifdef _WIN32
+  return GetCurrentThreadId();
+#elif defined(__APPLE__)
+  uint64_t id = 0;
+  pthread_threadid_np(nullptr, &id);
+  return id;
+#else
+  return static_cast<uint64_t>(syscall(SYS_gettid));
+#endif
+}
+
+struct MethodStats {
+  uint64_t calls = 0;
+  uint64_t errors = 0;
+  uint64_t cancelled = 0;
+  std::array<Histogram, static_cast<size_t>(IpcMetric::Count)> metrics;
+};
+
+struct TraceEvent {
+  uint32_t method;
+  const char *phase;
+  uint64_t start;
+  uint64_t end;
+  uint64_t asyncId;
+};
+
+struct ThreadBuffer {
+  std::mutex mutex;
+  uint64_t threadId = 0;
+  // By method id, allocated on first use
+  std::vector<std::unique_ptr<MethodStats>> methods;
+  std::vector<TraceEvent> trace; // ring of kTraceCapacity
+  size_t traceNext = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> ids;
+  // Kept after their threads exit, so their calls still count
+  std::vector<std::shared_ptr<ThreadBuffer>> threads;
+};
+
+Registry &GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+ThreadBuffer &LocalBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+    auto created = std::make_shared<ThreadBuffer>();
+    created->threadId = CurrentThreadId();
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+// With the buffer's mutex held
+MethodStats &StatsOf(ThreadBuffer &buffer, uint32_t method) {
+  if (method >= buffer.methods.size())
+    buffer.methods.resize(method + 1);
+  if (!buffer.methods[method])
+    buffer.methods[method] = std::make_unique<MethodStats>();
+  return *buffer.methods[method];
+}
+
+void AppendJsonString(std::string &out, const std::string &text) {
+  out.push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out.push_back('\\');
+    if (static_cast<unsigned char>(c) >= 0x20)
+      out.push_back(c);
+  }
+  out.push_back('"');
+}
+
+void AppendNumber(std::string &out, double value) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f", value);
+  out += text;
+}
+
+void AppendHistogram(std::string &out, const Histogram &histogram,
+                     double scale) {
+  out += "{\"count\":" + std::to_string(histogram.Count()) + ",\"mean\":";
+  AppendNumber(out, histogram.Mean() * scale);
+  const std::pair<const char *, double> quantiles[] = {
+      {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}};
+  for (const auto &quantile : quantiles) {
+    out += ",\"" + std::string(quantile.first) + "\":";
+    AppendNumber(out, histogram.Percentile(quantile.second) * scale);
+  }
+  out += ",\"max\":";
+  AppendNumber(out, histogram.Max() * scale);
+  out.push_back('}');
+}
+
+} // namespace
+
+void Histogram::Record(uint64_t value) {
+  ++buckets_[BucketOf(value)];
+  ++count_;
+  sum_ += value;
+  if (value > max_)
+    max_ = value;
+}
+
+void Histogram::Merge(const Histogram &other) {
+  for (size_t i = 0; i < kBuckets; ++i)
+    buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  if (other.max_ > max_)
+    max_ = other.max_;
+}
+
+uint64_t Histogram::Percentile(double quantile) const {
+  if (count_ == 0)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(quantile * count_ + 0.5);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // The last bucket also holds everything beyond 2^kMaxBits
+      if (i == kBuckets - 1)
+        return max_;
+      // Middle of the bucket
+      uint64_t width = i < kSubBuckets ? 1 : LowerBound(i + 1) - LowerBound(i);
+      uint64_t value = LowerBound(i) + (width - 1) / 2;
+      return value < max_ ? value : max_;
+    }
+  }
+  return max_;
+}
+
+size_t Histogram::BucketOf(uint64_t value) {
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+  int bits = Log2(value);
+  if (bits >= kMaxBits)
+    return kBuckets - 1;
+  int shift = bits - kSubBits;
+  size_t sub = static_cast<size_t>(value >> shift) - kSubBuckets;
+  return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::LowerBound(size_t bucket) {
+  size_t group = bucket / kSubBuckets;
+  uint64_t sub = bucket % kSubBuckets;
+  if (group == 0)
+    return sub;
+  return (kSubBuckets + sub) << (group - 1);
+}
+
+uint32_t IpcStats::MethodId(const std::string &name) {
+  Registry &registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto it = registry.ids.find(name);
+  if (it != registry.ids.end())
+    return it->second;
+  uint32_t id = static_cast<uint32_t>(registry.names.size());
+  registry.names.push_back(name);
+  registry.ids.emplace(name, id);
+  return id;
+}
+
+uint64_t IpcStats::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void IpcStats::Record(uint32_t method, IpcMetric metric, uint64_t value) {
+  ThreadBuffer &buffer = LocalBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  StatsOf(buffer, method).metrics[static_cast<size_t>(metric)].Record(value);
+}
+
+void IpcStats::CountCall(uint32_t method, bool success, bool cancelled) {
+  ThreadBuffer &buffer = LocalBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  MethodStats &stats = StatsOf(buffer, method);
+  ++stats.calls;
+  if (!success)
+    ++stats.errors;
+  if (cancelled)
+    ++stats.cancelled;
+}
+
+void IpcStats::Trace(uint32_t method, const char *phase, uint64_t start,
+                     uint64_t end, uint64_t asyncId) {
+  ThreadBuffer &buffer = LocalBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  TraceEvent event{method, phase, start, end, asyncId};
+  if (buffer.trace.size() < kTraceCapacity) {
+    buffer.trace.push_back(event);
+  } else {
+    buffer.trace[buffer.traceNext] = event;
+    buffer.traceNext = (buffer.traceNext + 1) % kTraceCapacity;
+  }
+}
+
+std::string IpcStats::ToJson() {
+  static const char *const kMetricNames[] = {
+      "queueWaitUs", "handlerUs",    "serializeUs",
+      "totalUs",     "requestBytes", "responseBytes"};
+  static_assert(std::size(kMetricNames) ==
+                    static_cast<size_t>(IpcMetric::Count),
+                "a name per metric");
+
+  std::vector<std::string> names;
+  std::vector<std::shared_ptr<ThreadBuffer>> threads;
+  {
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    names = registry.names;
+    threads = registry.threads;
+  }
+
+  std::vector<MethodStats> merged(names.size());
+  for (const auto &thread : threads) {
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    for (size_t i = 0; i < thread->methods.size() && i < merged.size(); ++i) {
+      if (!thread->methods[i])
+        continue;
+      const MethodStats &stats = *thread->methods[i];
+      merged[i].calls += stats.calls;
+      merged[i].errors += stats.errors;
+      merged[i].cancelled += stats.cancelled;
+      for (size_t m = 0; m < stats.metrics.size(); ++m)
+        merged[i].metrics[m].Merge(stats.metrics[m]);
+    }
+  }
+
+  std::string out = "{\"methods\":{";
+  bool first = true;
+  for (size_t i = 0; i < merged.size(); ++i) {
+    const MethodStats &stats = merged[i];
+    if (stats.calls == 0 && stats.metrics[0].Count() == 0)
+      continue;
+    if (!first)
+      out.push_back(',');
+    first = false;
+    AppendJsonString(out, names[i]);
+    out += ":{\"calls\":" + std::to_string(stats.calls) +
+           ",\"errors\":" + std::to_string(stats.errors) +
+           ",\"cancelled\":" + std::to_string(stats.cancelled);
+    for (size_t m = 0; m < stats.metrics.size(); ++m) {
+      bool bytes = m >= static_cast<size_t>(IpcMetric::RequestBytes);
+      out += ",\"" + std::string(kMetricNames[m]) + "\":";
+      AppendHistogram(out, stats.metrics[m], bytes ? 1.0 : 0.001);
+    }
+    out.push_back('}');
+  }
+  out += "}}";
+  return out;
+}
+
+std::string IpcStats::ToChromeTrace() {
+  std::vector<std::string> names;
+  std::vector<std::shared_ptr<ThreadBuffer>> threads;
+  {
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    names = registry.names;
+    threads = registry.threads;
+  }
+
+  std::string pid = std::to_string(CurrentProcessId());
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &thread : threads) {
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    std::string tid = std::to_string(thread->threadId);
+    for (const TraceEvent &event : thread->trace) {
+      const std::string &name =
+          event.method < names.size() ? names[event.method] : "unknown";
+      std::string common = ",\"cat\":\"ipc\",\"pid\":" + pid +
+                           ",\"tid\":" + tid + ",\"args\":{\"phase\":\"" +
+                           event.phase + "\"}";
+      if (!first)
+        out.push_back(',');
+      first = false;
+
+      out += "{\"name\":";
+      AppendJsonString(out, name);
+      if (event.asyncId == 0) {
+        out += common + ",\"ph\":\"X\",\"ts\":";
+        AppendNumber(out, event.start / 1000.0);
+        out += ",\"dur\":";
+        AppendNumber(out, (event.end - event.start) / 1000.0);
+        out.push_back('}');
+        continue;
+      }
+
+      // Begin and end of an async span
+      std::string id = ",\"id\":\"" + std::to_string(event.asyncId) + "\"";
+      out += common + id + ",\"ph\":\"b\",\"ts\":";
+      AppendNumber(out, event.start / 1000.0);
+      out += "},{\"name\":";
+      AppendJsonString(out, name);
+      out += common + id + ",\"ph\":\"e\",\"ts\":";
+      AppendNumber(out, event.end / 1000.0);
+      out.push_back('}');
+    }
+  }
+  out += "]}";
+  return out;
+}
+
+void IpcStats::Reset() {
+  std::vector<std::shared_ptr<ThreadBuffer>> threads;
+  {
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    threads = registry.threads;
+  }
+  for (const auto &thread : threads) {
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    thread->methods.clear();
+    thread->trace.clear();
+    thread->traceNext = 0;
+  }
+}
+
+} // namespace SimpleIPC
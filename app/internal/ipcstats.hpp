@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SimpleIPC {
+
+// Log-linear histogram in the style of HdrHistogram: values are kept to
+// within 1/16 (about 6%) of their magnitude, from 1 up to 2^40, in a fixed
+// array of counters. Recording is a bit scan and an increment.
+class Histogram {
+public:
+  static constexpr int kSubBits = 4;
+  static constexpr int kSubBuckets = 1 << kSubBits;
+  static constexpr int kMaxBits = 40;
+  static constexpr size_t kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+
+  void Record(uint64_t value);
+  void Merge(const Histogram &other);
+
+  uint64_t Count() const { return count_; }
+  uint64_t Max() const { return max_; }
+  double Mean() const { return count_ ? double(sum_) / count_ : 0.0; }
+  // Representative value of the bucket holding the quantile (0..1)
+  uint64_t Percentile(double quantile) const;
+
+private:
+  static size_t BucketOf(uint64_t value);
+  static uint64_t LowerBound(size_t bucket);
+
+  std::array<uint32_t, kBuckets> buckets_ = {};
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+};
+
+// What is measured about an IPC call. Times are in nanoseconds.
+enum class IpcMetric {
+  QueueWait,     // dispatch until the handler starts (slot and pool queue)
+  Handler,       // handler start until its response
+  Serialize,     // handing the response to CEF (router or process message)
+  Total,         // dispatch until the response is sent
+  RequestBytes,  // message size
+  ResponseBytes, // response size
+  Count
+};
+
+// Per-method call counters, histograms and a trace of recent calls.
+// Every thread records into its own buffer, so recording costs an
+// uncontended lock; Dump() and the exports merge the buffers.
+class IpcStats {
+public:
+  // Recent call phases kept per thread for the trace export
+  static constexpr size_t kTraceCapacity = 4096;
+
+  // Small id for a method name; the same name always gets the same id
+  static uint32_t MethodId(const std::string &name);
+
+  // Monotonic clock in nanoseconds. It is the clock Chromium's tracing
+  // uses on Windows and Linux, so exported traces line up with CEF's own.
+  static uint64_t Now();
+
+  static void Record(uint32_t method, IpcMetric metric, uint64_t value);
+  static void CountCall(uint32_t method, bool success, bool cancelled);
+  // One phase of a call ("handler", "respond") on this thread. With an
+  // asyncId the span may overlap others on the thread, e.g. a whole call
+  // from dispatch to response, and is exported as an async event.
+  static void Trace(uint32_t method, const char *phase, uint64_t start,
+                    uint64_t end, uint64_t asyncId = 0);
+
+  // {"methods": {"<name>": {"calls": n, "errors": n, "cancelled": n,
+  //   "queueWaitUs": {"count", "mean", "p50", "p90", "p99", "max"}, ...}}}
+  static std::string ToJson();
+  // Chrome trace event format, for chrome://tracing or Perfetto
+  static std::string ToChromeTrace();
+  static void Reset();
+};
+
+} // namespace SimpleIPC
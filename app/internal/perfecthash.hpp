@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace SimpleIPC {
+
+constexpr uint32_t Fnv1a(std::string_view text, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : text) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Collision-free hash of a fixed key set, built at compile time: the
+// constructor searches for a seed under which every key gets its own slot.
+// A lookup is one hash, one table read and one comparison.
+//
+//   static constexpr std::string_view kKeys[] = {"a", "b"};
+//   static constexpr PerfectHash<2, 4> kHash(kKeys);
+//   static_assert(kHash.Valid(), "no seed found; grow Slots");
+template <size_t N, size_t Slots> class PerfectHash {
+  static_assert(Slots >= N, "every key needs a slot");
+
+public:
+  constexpr explicit PerfectHash(const std::string_view (&keys)[N]) {
+    for (size_t i = 0; i < N; ++i)
+      keys_[i] = keys[i];
+    for (uint32_t seed = 0; seed < kMaxSeeds; ++seed) {
+      if (TrySeed(seed)) {
+        seed_ = seed;
+        valid_ = true;
+        return;
+      }
+    }
+  }
+
+  constexpr bool Valid() const { return valid_; }
+
+  // Index of key in the key set, or -1
+  constexpr int Find(std::string_view key) const {
+    int index = slots_[Fnv1a(key, seed_) % Slots];
+    return index >= 0 && keys_[index] == key ? index : -1;
+  }
+
+private:
+  static constexpr uint32_t kMaxSeeds = 4096;
+
+  constexpr bool TrySeed(uint32_t seed) {
+    for (size_t slot = 0; slot < Slots; ++slot)
+      slots_[slot] = -1;
+    for (size_t i = 0; i < N; ++i) {
+      size_t slot = Fnv1a(keys_[i], seed) % Slots;
+      if (slots_[slot] >= 0)
+        return false;
+      slots_[slot] = static_cast<int>(i);
+    }
+    return true;
+  }
+
+  std::string_view keys_[N] = {};
+  int slots_[Slots] = {};
+  uint32_t seed_ = 0;
+  bool valid_ = false;
+};
+
+} // namespace SimpleIPC
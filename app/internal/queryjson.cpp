@@ -0,0 +1,353 @@
+#include "queryjson.hpp"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace SimpleIPC {
+
+namespace {
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+void SkipSpace(std::string_view text, size_t &pos) {
+  while (pos < text.size() && IsSpace(text[pos]))
+    ++pos;
+}
+
+// pos is past the opening quote; on success it is past the closing one
+bool ScanString(std::string_view text, size_t &pos, std::string_view &contents,
+                bool &escaped) {
+  size_t start = pos;
+  escaped = false;
+  while (pos < text.size()) {
+    char c = text[pos];
+    if (c == '"') {
+      contents = text.substr(start, pos - start);
+      ++pos;
+      return true;
+    }
+    if (c == '\\') {
+      escaped = true;
+      pos += 2;
+      continue;
+    }
+    if (static_cast<unsigned char>(c) < 0x20)
+      return false;
+    ++pos;
+  }
+  return false;
+}
+
+// Nested object or array starting at pos
+bool SkipNested(std::string_view text, size_t &pos) {
+  int depth = 0;
+  while (pos < text.size()) {
+    char c = text[pos++];
+    if (c == '"') {
+      std::string_view contents;
+      bool escaped;
+      if (!ScanString(text, pos, contents, escaped))
+        return false;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0)
+        return true;
+    }
+  }
+  return false;
+}
+
+bool ParseNumber(std::string_view text, double &value) {
+  static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+  size_t pos = 0;
+  bool negative = pos < text.size() && text[pos] == '-';
+  if (negative)
+    ++pos;
+  if (pos >= text.size() || !IsDigit(text[pos]))
+    return false;
+
+  // Up to 19 significant digits fit the mantissa; more only scale it
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  for (; pos < text.size() && IsDigit(text[pos]); ++pos) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (text[pos] - '0');
+      if (mantissa != 0)
+        ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if (pos < text.size() && text[pos] == '.') {
+    ++pos;
+    if (pos >= text.size() || !IsDigit(text[pos]))
+      return false;
+    for (; pos < text.size() && IsDigit(text[pos]); ++pos) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (text[pos] - '0');
+        if (mantissa != 0)
+          ++digits;
+        --exponent;
+      }
+    }
+  }
+  if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+    ++pos;
+    bool negativeExponent = false;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+      negativeExponent = text[pos++] == '-';
+    if (pos >= text.size() || !IsDigit(text[pos]))
+      return false;
+    int written = 0;
+    for (; pos < text.size() && IsDigit(text[pos]); ++pos) {
+      if (written < 10000)
+        written = written * 10 + (text[pos] - '0');
+    }
+    exponent += negativeExponent ? -written : written;
+  }
+  if (pos != text.size())
+    return false;
+
+  value = static_cast<double>(mantissa);
+  if (exponent > 0) {
+    value *= exponent <= 22 ? kPowers[exponent] : std::pow(10.0, exponent);
+  } else if (exponent < 0) {
+    value /= -exponent <= 22 ? kPowers[-exponent] : std::pow(10.0, -exponent);
+  }
+  if (negative)
+    value = -value;
+  return true;
+}
+
+void AppendUtf8(std::string &out, uint32_t code) {
+  if (code < 0x80) {
+    out.push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+bool ReadHex4(std::string_view text, size_t pos, uint32_t &code) {
+  if (pos + 4 > text.size())
+    return false;
+  code = 0;
+  for (size_t i = pos; i < pos + 4; ++i) {
+    char c = text[i];
+    code <<= 4;
+    if (c >= '0' && c <= '9')
+      code |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      code |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      code |= c - 'A' + 10;
+    else
+      return false;
+  }
+  return true;
+}
+
+bool Unescape(std::string_view text, std::string &out) {
+  out.clear();
+  out.reserve(text.size());
+  for (size_t pos = 0; pos < text.size(); ++pos) {
+    char c = text[pos];
+    if (c != '\\') {
+      out.push_back(c);
+      continue;
+    }
+    if (++pos >= text.size())
+      return false;
+    switch (text[pos]) {
+    case '"':
+    case '\\':
+    case '/':
+      out.push_back(text[pos]);
+      break;
+    case 'b':
+      out.push_back('\b');
+      break;
+    case 'f':
+      out.push_back('\f');
+      break;
+    case 'n':
+      out.push_back('\n');
+      break;
+    case 'r':
+      out.push_back('\r');
+      break;
+    case 't':
+      out.push_back('\t');
+      break;
+    case 'u': {
+      uint32_t code;
+      if (!ReadHex4(text, pos + 1, code))
+        return false;
+      pos += 4;
+      // Surrogate pair
+      if (code >= 0xD800 && code < 0xDC00 && pos + 6 < text.size() &&
+          text[pos + 1] == '\\' && text[pos + 2] == 'u') {
+        uint32_t low;
+        if (ReadHex4(text, pos + 3, low) && low >= 0xDC00 && low < 0xE000) {
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          pos += 6;
+        }
+      }
+      AppendUtf8(out, code);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool QueryJson::Parse(std::string_view text) {
+  count_ = 0;
+  size_t pos = 0;
+  SkipSpace(text, pos);
+  if (pos >= text.size() || text[pos] != '{')
+    return false;
+  ++pos;
+  SkipSpace(text, pos);
+  if (pos < text.size() && text[pos] == '}') {
+    ++pos;
+  } else {
+    while (true) {
+      if (count_ == kMaxMembers || pos >= text.size() || text[pos] != '"')
+        return false;
+      Member &member = members_[count_];
+      bool keyEscaped;
+      ++pos;
+      if (!ScanString(text, pos, member.key, keyEscaped))
+        return false;
+      SkipSpace(text, pos);
+      if (pos >= text.size() || text[pos] != ':')
+        return false;
+      ++pos;
+      SkipSpace(text, pos);
+      if (pos >= text.size())
+        return false;
+
+      size_t start = pos;
+      char c = text[pos];
+      member.escaped = false;
+      if (c == '"') {
+        ++pos;
+        if (!ScanString(text, pos, member.value, member.escaped))
+          return false;
+        member.kind = Kind::String;
+      } else if (c == '-' || IsDigit(c)) {
+        while (pos < text.size() &&
+               (IsDigit(text[pos]) || text[pos] == '-' || text[pos] == '+' ||
+                text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E'))
+          ++pos;
+        member.value = text.substr(start, pos - start);
+        member.kind = Kind::Number;
+      } else if (c == '{' || c == '[') {
+        if (!SkipNested(text, pos))
+          return false;
+        member.value = text.substr(start, pos - start);
+        member.kind = Kind::Other;
+      } else {
+        std::string_view rest = text.substr(pos);
+        size_t length = rest.compare(0, 4, "true") == 0    ? 4
+                        : rest.compare(0, 5, "false") == 0 ? 5
+                        : rest.compare(0, 4, "null") == 0  ? 4
+                                                           : 0;
+        if (length == 0)
+          return false;
+        pos += length;
+        member.value = text.substr(start, length);
+        member.kind = Kind::Other;
+      }
+      ++count_;
+
+      SkipSpace(text, pos);
+      if (pos < text.size() && text[pos] == ',') {
+        ++pos;
+        SkipSpace(text, pos);
+        continue;
+      }
+      if (pos < text.size() && text[pos] == '}') {
+        ++pos;
+        break;
+      }
+      return false;
+    }
+  }
+  SkipSpace(text, pos);
+  return pos == text.size();
+}
+
+const QueryJson::Member *QueryJson::Find(std::string_view key) const {
+  // The last duplicate wins, as with JSON.parse
+  for (size_t i = count_; i > 0; --i) {
+    if (members_[i - 1].key == key)
+      return &members_[i - 1];
+  }
+  return nullptr;
+}
+
+bool QueryJson::GetString(std::string_view key, std::string_view &value,
+                          std::string &scratch) const {
+  const Member *member = Find(key);
+  if (!member || member->kind != Kind::String)
+    return false;
+  if (!member->escaped) {
+    value = member->value;
+    return true;
+  }
+  if (!Unescape(member->value, scratch))
+    return false;
+  value = scratch;
+  return true;
+}
+
+bool QueryJson::GetString(std::string_view key, std::string &value) const {
+  std::string_view view;
+  std::string scratch;
+  if (!GetString(key, view, scratch))
+    return false;
+  value.assign(view.data(), view.size());
+  return true;
+}
+
+bool QueryJson::GetDouble(std::string_view key, double &value) const {
+  const Member *member = Find(key);
+  return member && member->kind == Kind::Number &&
+         ParseNumber(member->value, value);
+}
+
+bool QueryJson::GetInt(std::string_view key, int &value) const {
+  double number;
+  if (!GetDouble(key, number) ||
+      !(number > std::numeric_limits<int>::min() - 1.0 &&
+        number < std::numeric_limits<int>::max() + 1.0))
+    return false;
+  value = static_cast<int>(number);
+  return true;
+}
+
+} // namespace SimpleIPC
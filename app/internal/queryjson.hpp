@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace SimpleIPC {
+
+// Reader for the small flat JSON objects the web UI sends through cefQuery
+// ({"type": "...", "x": 10, ...}). One pass over the text records where
+// each top-level member's value is; nothing is allocated and values are
+// only converted when asked for. Nested objects and arrays are skipped.
+class QueryJson {
+public:
+  static constexpr size_t kMaxMembers = 16;
+
+  // False when text is not a well-formed object or has more members
+  bool Parse(std::string_view text);
+
+  bool Has(std::string_view key) const { return Find(key) != nullptr; }
+
+  // String member. Values with escapes are decoded into scratch, which
+  // value then points into; others are views into the parsed text.
+  bool GetString(std::string_view key, std::string_view &value,
+                 std::string &scratch) const;
+  // Convenience for values that are kept anyway
+  bool GetString(std::string_view key, std::string &value) const;
+
+  bool GetDouble(std::string_view key, double &value) const;
+  // Numbers are truncated toward zero, as layout values may be fractional
+  bool GetInt(std::string_view key, int &value) const;
+
+private:
+  enum class Kind { String, Number, Other };
+
+  struct Member {
+    std::string_view key;   // raw, between the quotes
+    std::string_view value; // string contents without quotes, or the token
+    Kind kind;
+    bool escaped;
+  };
+
+  const Member *Find(std::string_view key) const;
+
+  Member members_[kMaxMembers];
+  size_t count_ = 0;
+};
+
+} // namespace SimpleIPC
@@ -1,12 +1,17 @@
 #include "simpleipc.hpp"
 #include "../client/client.hpp"
+#include "fsservice.hpp"
 #include "include/cef_parser.h"
+#include "include/cef_task.h"
 #include "include/cef_values.h"
 #include "include/cef_version.h"
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
 #include <ctime>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -17,31 +22,341 @@ extern std::unique_ptr<SDL3Window> g_sdl_window;
 
 namespace SimpleIPC {
 
-IPCHandler::IPCHandler() {
+namespace {
+
+// Runs a function on the thread it is posted to
+class FunctionTask : public CefTask {
+public:
+  explicit FunctionTask(std::function<void()> function)
+      : function_(std::move(function)) {}
+  void Execute() override { function_(); }
+
+private:
+  std::function<void()> function_;
+  IMPLEMENT_REFCOUNTING(FunctionTask);
+};
+
+} // namespace
+
+AsyncCall::AsyncCall(IPCHandler *owner, int64_t id, std::string method)
+    : owner_(owner), id_(id), method_(std::move(method)) {}
+
+AsyncCall::~AsyncCall() {
+  if (!completed_)
+    Fail("No response from " + method_);
+}
+
+void AsyncCall::Complete(std::string response) {
+  Finish(true, std::move(response));
+}
+
+void AsyncCall::Fail(std::string error) { Finish(false, std::move(error)); }
+
+void AsyncCall::Finish(bool success, std::string response) {
+  if (completed_.exchange(true))
+    return;
+  if (started_ != 0) {
+    uint64_t now = IpcStats::Now();
+    IpcStats::Record(statsId_, IpcMetric::Handler, now - started_);
+    IpcStats::Record(statsId_, IpcMetric::ResponseBytes, response.size());
+    IpcStats::Trace(statsId_, "handler", started_, now);
+  }
+  IPCHandler *owner = owner_;
+  int64_t id = id_;
+  if (CefCurrentlyOn(TID_UI)) {
+    owner->Finish(id, success, response);
+  } else {
+    CefPostTask(TID_UI, new FunctionTask([owner, id, success,
+                                          response = std::move(response)]() {
+                  owner->Finish(id, success, response);
+                }));
+  }
+}
+
+IPCHandler::IPCHandler() : table_(std::make_shared<HandlerTable>()) {
   // Register default handlers
-  RegisterHandler("ping", HandlePing);
-  RegisterHandler("getSystemInfo", HandleGetSystemInfo);
-  RegisterHandler("echo", HandleEcho);
-  RegisterHandler("resizeWindow", HandleResizeWindow);
+  RegisterHandler("ping", HandlePing, {HandlerThread::Worker});
+  RegisterHandler("getSystemInfo", HandleGetSystemInfo,
+                  {HandlerThread::Worker});
+  RegisterHandler("echo", HandleEcho, {HandlerThread::Worker});
+  RegisterHandler("ipcBenchPayload", HandleBenchPayload,
+                  {HandlerThread::Worker});
+  RegisterBinaryHandler("ipcBenchPayload", HandleBinaryBenchPayload);
+  // Resizes the SDL window, which only the UI thread may do
+  RegisterHandler("resizeWindow", HandleResizeWindow, {HandlerThread::UI});
+  RegisterHandler("ipc_stats", HandleIpcStats, {HandlerThread::Worker});
+  RegisterHandler("ipc_methods", HandleIpcMethods, {HandlerThread::Worker});
+  RegisterFileSystemHandlers(*this);
+}
+
+void IPCHandler::Dispatch(int64_t callId, const std::string &method,
+                          std::string message, ResponseCallback respond,
+                          bool binary) {
+  std::shared_ptr<const HandlerTable> table = Table();
+  uint32_t methodId;
+  if (!Resolve(*table, method, binary, methodId)) {
+    respond(false, "Unknown method: " + method);
+    return;
+  }
+
+  PendingCall &pending = calls_[callId];
+  pending.handler = table->byId[methodId];
+  pending.methodId = methodId;
+  pending.respond = std::move(respond);
+  pending.dispatched = IpcStats::Now();
+  IpcStats::Record(pending.handler->statsId, IpcMetric::RequestBytes,
+                   message.size());
+  pending.message = std::move(message);
+
+  size_t maxConcurrent = pending.handler->options.maxConcurrent;
+  MethodState &state = StateOf(methodId);
+  if (maxConcurrent != 0 && state.running >= maxConcurrent) {
+    state.waiting.push_back(callId);
+    return;
+  }
+  Start(callId, pending);
 }
 
-std::string IPCHandler::HandleCall(const std::string &method,
-                                   const std::string &message) {
-  auto it = handlers_.find(method);
-  if (it != handlers_.end()) {
+void IPCHandler::Cancel(int64_t callId) {
+  auto it = calls_.find(callId);
+  if (it == calls_.end())
+    return;
+  PendingCall &pending = it->second;
+
+  if (!pending.started) {
+    auto &waiting = StateOf(pending.methodId).waiting;
+    waiting.erase(std::remove(waiting.begin(), waiting.end(), callId),
+                  waiting.end());
+    IpcStats::CountCall(pending.handler->statsId, true, true);
+    calls_.erase(it);
+    return;
+  }
+
+  // The handler still holds its concurrency slot until it returns, so the
+  // entry stays until Finish()
+  pending.respond = nullptr;
+  if (auto call = pending.call.lock())
+    call->cancelled_ = true;
+}
+
+void IPCHandler::RegisterHandler(const std::string &method,
+                                 MessageHandler handler,
+                                 HandlerOptions options) {
+  Register(method, std::move(handler), nullptr, options);
+}
+
+void IPCHandler::RegisterAsyncHandler(const std::string &method,
+                                      AsyncMessageHandler handler,
+                                      HandlerOptions options) {
+  Register(method, nullptr, std::move(handler), options);
+}
+
+void IPCHandler::RegisterBinaryHandler(const std::string &method,
+                                       BinaryMessageHandler handler,
+                                       HandlerOptions options) {
+  options.binary = true;
+  RegisterHandler(
+      method,
+      [handler = std::move(handler)](const std::string &message) {
+        std::string response;
+        CborReader reader(message);
+        CborWriter writer(response);
+        handler(reader, writer);
+        return response;
+      },
+      options);
+}
+
+void IPCHandler::UnregisterHandler(const std::string &method, bool binary) {
+  std::lock_guard<std::mutex> lock(registerMutex_);
+  std::shared_ptr<const HandlerTable> current = Table();
+  const auto &ids = binary ? current->binaryIds : current->ids;
+  auto it = ids.find(method);
+  if (it == ids.end() || !current->byId[it->second])
+    return;
+  auto table = std::make_shared<HandlerTable>(*current);
+  table->byId[it->second] = nullptr;
+  std::atomic_store(&table_,
+                    std::shared_ptr<const HandlerTable>(std::move(table)));
+}
+
+bool IPCHandler::MethodId(const std::string &method, bool binary,
+                          uint32_t &id) const {
+  return Resolve(*Table(), method, binary, id);
+}
+
+std::string IPCHandler::DescribeMethods() const {
+  std::shared_ptr<const HandlerTable> table = Table();
+  std::ostringstream ss;
+  // Sorted, so the output is stable
+  auto write = [&](const std::unordered_map<std::string, uint32_t> &ids) {
+    std::map<std::string, uint32_t> sorted;
+    for (const auto &entry : ids) {
+      if (table->byId[entry.second])
+        sorted.insert(entry);
+    }
+    ss << "{";
+    bool first = true;
+    for (const auto &entry : sorted) {
+      ss << (first ? "" : ",") << "\"" << entry.first
+         << "\":" << entry.second;
+      first = false;
+    }
+    ss << "}";
+  };
+  ss << "{\"methods\":";
+  write(table->ids);
+  ss << ",\"binary\":";
+  write(table->binaryIds);
+  ss << "}";
+  return ss.str();
+}
+
+void IPCHandler::Shutdown() {
+  for (auto &entry : calls_) {
+    entry.second.respond = nullptr;
+    if (auto call = entry.second.call.lock())
+      call->cancelled_ = true;
+  }
+  if (workers_)
+    workers_->Shutdown();
+}
+
+void IPCHandler::Register(const std::string &method, MessageHandler sync,
+                          AsyncMessageHandler async, HandlerOptions options) {
+  auto handler = std::make_shared<Handler>();
+  handler->method = method;
+  handler->sync = std::move(sync);
+  handler->async = std::move(async);
+  handler->options = options;
+  handler->statsId =
+      IpcStats::MethodId(options.binary ? "binary:" + method : method);
+
+  std::lock_guard<std::mutex> lock(registerMutex_);
+  auto table = std::make_shared<HandlerTable>(*Table());
+  auto &ids = options.binary ? table->binaryIds : table->ids;
+  auto it = ids.find(method);
+  uint32_t id;
+  if (it != ids.end()) {
+    id = it->second;
+  } else {
+    id = static_cast<uint32_t>(table->byId.size());
+    ids.emplace(method, id);
+    table->byId.emplace_back();
+  }
+  table->byId[id] = std::move(handler);
+  std::atomic_store(&table_,
+                    std::shared_ptr<const HandlerTable>(std::move(table)));
+}
+
+std::shared_ptr<const IPCHandler::HandlerTable> IPCHandler::Table() const {
+  return std::atomic_load(&table_);
+}
+
+bool IPCHandler::Resolve(const HandlerTable &table, const std::string &method,
+                         bool binary, uint32_t &id) {
+  if (!method.empty() && method[0] == '#') {
+    char *end = nullptr;
+    unsigned long value = std::strtoul(method.c_str() + 1, &end, 10);
+    if (end == method.c_str() + 1 || *end != '\0' ||
+        value >= table.byId.size() || !table.byId[value] ||
+        table.byId[value]->options.binary != binary)
+      return false;
+    id = static_cast<uint32_t>(value);
+    return true;
+  }
+
+  const auto &ids = binary ? table.binaryIds : table.ids;
+  auto it = ids.find(method);
+  if (it == ids.end() || !table.byId[it->second])
+    return false;
+  id = it->second;
+  return true;
+}
+
+void IPCHandler::Start(int64_t callId, PendingCall &pending) {
+  const Handler &handler = *pending.handler;
+  auto call = std::make_shared<AsyncCall>(this, callId, handler.method);
+  call->statsId_ = handler.statsId;
+  pending.call = call;
+  pending.started = true;
+  ++StateOf(pending.methodId).running;
+
+  // Everything the job needs is copied out: on the UI thread it may
+  // complete inline and erase the pending entry
+  auto job = [sync = handler.sync, async = handler.async,
+              message = std::move(pending.message), call = std::move(call),
+              dispatched = pending.dispatched]() mutable {
+    call->started_ = IpcStats::Now();
+    IpcStats::Record(call->statsId_, IpcMetric::QueueWait,
+                     call->started_ - dispatched);
     try {
-      return it->second(message);
+      if (async) {
+        async(message, call);
+      } else {
+        call->Complete(sync(message));
+      }
     } catch (const std::exception &e) {
-      return "Error: " + std::string(e.what());
+      call->Fail(e.what());
     }
+    // From here on the handler's copies alone keep the call open
+    call.reset();
+  };
+
+  if (handler.options.thread == HandlerThread::UI) {
+    job();
   } else {
-    return "Error: Unknown method: " + method;
+    Workers().Post(std::move(job));
   }
 }
 
-void IPCHandler::RegisterHandler(const std::string &method,
-                                 MessageHandler handler) {
-  handlers_[method] = handler;
+void IPCHandler::Finish(int64_t callId, bool success,
+                        const std::string &response) {
+  auto it = calls_.find(callId);
+  if (it == calls_.end())
+    return;
+  ResponseCallback respond = std::move(it->second.respond);
+  uint32_t statsId = it->second.handler->statsId;
+  uint32_t methodId = it->second.methodId;
+  uint64_t dispatched = it->second.dispatched;
+  calls_.erase(it);
+
+  uint64_t responding = IpcStats::Now();
+  if (respond)
+    respond(success, response);
+
+  uint64_t now = IpcStats::Now();
+  IpcStats::CountCall(statsId, success, !respond);
+  if (respond) {
+    IpcStats::Record(statsId, IpcMetric::Serialize, now - responding);
+    IpcStats::Trace(statsId, "respond", responding, now);
+  }
+  IpcStats::Record(statsId, IpcMetric::Total, now - dispatched);
+  IpcStats::Trace(statsId, "call", dispatched, now,
+                  static_cast<uint64_t>(callId));
+
+  MethodState &state = StateOf(methodId);
+  if (state.running > 0)
+    --state.running;
+  if (!state.waiting.empty()) {
+    int64_t next = state.waiting.front();
+    state.waiting.pop_front();
+    auto nextIt = calls_.find(next);
+    if (nextIt != calls_.end())
+      Start(next, nextIt->second);
+  }
+}
+
+IPCHandler::MethodState &IPCHandler::StateOf(uint32_t methodId) {
+  if (methodId >= states_.size())
+    states_.resize(methodId + 1);
+  return states_[methodId];
+}
+
+WorkerPool &IPCHandler::Workers() {
+  if (!workers_)
+    workers_ = std::make_unique<WorkerPool>();
+  return *workers_;
 }
 
 IPCHandler &IPCHandler::GetInstance() {
@@ -56,11 +371,18 @@ void InitializeIPC(CefRefPtr<CefFrame> frame) {
   // Inject JavaScript code to create the nativeAPI object
   std::string js_code = R"(
             window.nativeAPI = {
-                call: function(method, message) {
+                // options.signal (an AbortSignal) cancels the call on the
+                // native side as well
+                call: function(method, message, options) {
                     // This will be handled by cefQuery in the browser process
                     return new Promise(function(resolve, reject) {
                         if (window.cefQuery) {
-                            window.cefQuery({
+                            var signal = options && options.signal;
+                            if (signal && signal.aborted) {
+                                reject(new Error('Aborted'));
+                                return;
+                            }
+                            var queryId = window.cefQuery({
                                 request: 'ipc_call:' + method + ':' + (message || ''),
                                 onSuccess: function(response) {
                                     resolve(response);
@@ -69,6 +391,12 @@ void InitializeIPC(CefRefPtr<CefFrame> frame) {
                                     reject(new Error(error_message));
                                 }
                             });
+                            if (signal) {
+                                signal.addEventListener('abort', function() {
+                                    window.cefQueryCancel(queryId);
+                                    reject(new Error('Aborted'));
+                                });
+                            }
                         } else {
                             reject(new Error('CEF Query not available'));
                         }
@@ -111,10 +439,67 @@ std::string HandleGetSystemInfo(const std::string &message) {
   return ss.str();
 }
 
+std::string HandleIpcMethods(const std::string &message) {
+  return IPCHandler::GetInstance().DescribeMethods();
+}
+
+std::string HandleIpcStats(const std::string &message) {
+  if (message == "trace")
+    return IpcStats::ToChromeTrace();
+  if (message == "reset") {
+    IpcStats::Reset();
+    return "{}";
+  }
+  return IpcStats::ToJson();
+}
+
 std::string HandleEcho(const std::string &message) {
   return "Echo: " + message;
 }
 
+namespace {
+
+constexpr size_t kMaxBenchPayload = size_t(64) << 20;
+
+// Printable filler, so the string path carries it without escaping
+void FillBenchPayload(char *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>('a' + i % 26);
+  }
+}
+
+} // namespace
+
+std::string HandleBenchPayload(const std::string &message) {
+  size_t size = std::min<size_t>(std::strtoull(message.c_str(), nullptr, 10),
+                                 kMaxBenchPayload);
+  std::string payload(size, '\0');
+  FillBenchPayload(&payload[0], size);
+  return payload;
+}
+
+void HandleBinaryBenchPayload(CborReader &request, CborWriter &response) {
+  uint64_t size = 0;
+  size_t received = 0;
+  size_t pairs;
+  if (request.ReadMap(pairs)) {
+    CborReader sizeReader = request;
+    if (sizeReader.FindKey(pairs, "size"))
+      sizeReader.ReadUInt(size);
+    std::string_view data;
+    if (request.FindKey(pairs, "data") && request.ReadBytes(data))
+      received = data.size();
+  }
+  size = std::min<uint64_t>(size, kMaxBenchPayload);
+
+  response.BeginMap(2);
+  response.Text("received");
+  response.UInt(received);
+  response.Text("data");
+  FillBenchPayload(response.BytesInPlace(static_cast<size_t>(size)),
+                   static_cast<size_t>(size));
+}
+
 std::string HandleResizeWindow(const std::string &message) {
   try {
     // Parse JSON using CEF's native JSON parser
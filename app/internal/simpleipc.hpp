@@ -2,30 +2,204 @@
 
 #include "include/cef_browser.h"
 #include "include/cef_frame.h"
+#include "binarycodec.hpp"
+#include "ipcstats.hpp"
+#include "workerpool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace SimpleIPC {
+class IPCHandler;
+
 // Message handler callback type
 using MessageHandler = std::function<std::string(const std::string &)>;
 
-// IPC Handler class for ExecuteJavaScript-based communication
+// Receives the response of a call on the UI thread; on failure (unknown
+// method, handler threw or gave no response) response is the error message
+using ResponseCallback =
+    std::function<void(bool success, const std::string &response)>;
+
+// Thread a handler is invoked on
+enum class HandlerThread {
+  UI,     // inline in OnQuery; for handlers that touch the window or browser
+  Worker, // IPC worker pool; the response is posted back to the UI thread
+};
+
+struct HandlerOptions {
+  HandlerThread thread = HandlerThread::UI;
+  // Calls of the method running at once, later ones wait in order; 0 is
+  // unlimited
+  size_t maxConcurrent = 0;
+  // Served on the binary channel: message and response are CBOR
+  bool binary = false;
+};
+
+// An IPC call in flight, handed to asynchronous handlers. Complete() may be
+// called from any thread; only the first response counts. If the page that
+// made the call navigates away or closes first, the call is cancelled and
+// its response is dropped, so long-running handlers should poll
+// IsCancelled(). A call released without a response answers with an error.
+class AsyncCall {
+public:
+  AsyncCall(IPCHandler *owner, int64_t id, std::string method);
+  ~AsyncCall();
+
+  const std::string &Method() const { return method_; }
+  bool IsCancelled() const { return cancelled_; }
+  void Complete(std::string response);
+  void Fail(std::string error);
+
+private:
+  friend class IPCHandler;
+
+  void Finish(bool success, std::string response);
+
+  IPCHandler *owner_;
+  int64_t id_;
+  std::string method_;
+  uint32_t statsId_ = 0;
+  uint64_t started_ = 0; // IpcStats::Now() when the handler started
+  std::atomic<bool> cancelled_{false};
+  std::atomic<bool> completed_{false};
+};
+
+using AsyncMessageHandler =
+    std::function<void(const std::string &, std::shared_ptr<AsyncCall>)>;
+
+// Handler on the binary channel; reads the request and writes one response
+// item. Throwing fails the call with the exception's message.
+using BinaryMessageHandler =
+    std::function<void(CborReader &request, CborWriter &response)>;
+
+// IPC Handler class for ExecuteJavaScript-based communication. Calls are
+// tracked on the CEF UI thread; handlers run there or on a worker pool
+// depending on how they were registered. Handlers may be registered from
+// any thread at any time: registration publishes a new immutable snapshot
+// of the handler table, which dispatching reads without locking.
+//
+// Every method has a numeric id, stable for the process's lifetime. Pages
+// resolve the ids once through "ipc_methods" and call "#<id>" instead of
+// the name.
 class IPCHandler {
 public:
   IPCHandler();
 
-  // Handle IPC call
-  std::string HandleCall(const std::string &method, const std::string &message);
+  // Starts a call; respond runs on the UI thread with the response unless
+  // the call is cancelled first. method is a name or "#<id>". callId
+  // identifies the call for Cancel() (the message router's query id). UI
+  // thread only.
+  void Dispatch(int64_t callId, const std::string &method,
+                std::string message, ResponseCallback respond,
+                bool binary = false);
+
+  // Id for a call that doesn't come through the message router, whose
+  // query ids are positive
+  int64_t ReserveCallId() { return --lastReservedId_; }
 
-  // Register a message handler
-  void RegisterHandler(const std::string &method, MessageHandler handler);
+  // Drops the response of a call and flags it cancelled; a call still
+  // waiting for a concurrency slot never runs. UI thread only.
+  void Cancel(int64_t callId);
+
+  // Register a message handler; it returns the response
+  void RegisterHandler(const std::string &method, MessageHandler handler,
+                       HandlerOptions options = {});
+
+  // Register a handler that answers through AsyncCall::Complete, possibly
+  // after returning
+  void RegisterAsyncHandler(const std::string &method,
+                            AsyncMessageHandler handler,
+                            HandlerOptions options = {HandlerThread::Worker});
+
+  // Register a handler for the binary channel (options.binary is implied)
+  void RegisterBinaryHandler(const std::string &method,
+                             BinaryMessageHandler handler,
+                             HandlerOptions options = {HandlerThread::Worker});
+
+  // Calls already started finish with the old handler; the method keeps its
+  // id for a later registration
+  void UnregisterHandler(const std::string &method, bool binary = false);
+
+  // Id of a registered method; false if there is none. Any thread.
+  bool MethodId(const std::string &method, bool binary, uint32_t &id) const;
+
+  // {"methods": {"<name>": id, ...}, "binary": {...}}. Any thread.
+  std::string DescribeMethods() const;
+
+  // Cancels every call and stops the worker pool; before CefShutdown
+  void Shutdown();
 
   // Get singleton instance
   static IPCHandler &GetInstance();
 
 private:
-  std::map<std::string, MessageHandler> handlers_;
+  friend class AsyncCall;
+
+  // A registered method; immutable once published
+  struct Handler {
+    std::string method;
+    MessageHandler sync;
+    AsyncMessageHandler async;
+    HandlerOptions options;
+    uint32_t statsId = 0;
+  };
+
+  struct HandlerTable {
+    // By method id; null once a method is unregistered
+    std::vector<std::shared_ptr<const Handler>> byId;
+    // Methods of the string and the binary channel are separate
+    std::unordered_map<std::string, uint32_t> ids;
+    std::unordered_map<std::string, uint32_t> binaryIds;
+  };
+
+  // Concurrency bookkeeping of a method, by id
+  struct MethodState {
+    size_t running = 0;
+    std::deque<int64_t> waiting;
+  };
+
+  struct PendingCall {
+    // As registered when the call was dispatched
+    std::shared_ptr<const Handler> handler;
+    uint32_t methodId = 0;
+    std::string message;
+    ResponseCallback respond; // empty once cancelled
+    // Owned by the handler once started, so a call it drops is answered
+    std::weak_ptr<AsyncCall> call;
+    bool started = false;
+    uint64_t dispatched = 0; // IpcStats::Now()
+  };
+
+  void Register(const std::string &method, MessageHandler sync,
+                AsyncMessageHandler async, HandlerOptions options);
+  // Current snapshot
+  std::shared_ptr<const HandlerTable> Table() const;
+  // Method id of a name or "#<id>" on the channel
+  static bool Resolve(const HandlerTable &table, const std::string &method,
+                      bool binary, uint32_t &id);
+
+  void Start(int64_t callId, PendingCall &pending);
+  // Response of a started call, on the UI thread
+  void Finish(int64_t callId, bool success, const std::string &response);
+  MethodState &StateOf(uint32_t methodId);
+  WorkerPool &Workers();
+
+  // Only accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<const HandlerTable> table_;
+  // Serializes registrations, each of which copies the table
+  std::mutex registerMutex_;
+
+  // UI thread only
+  std::vector<MethodState> states_;
+  std::unordered_map<int64_t, PendingCall> calls_;
+  std::unique_ptr<WorkerPool> workers_;
+  int64_t lastReservedId_ = 0;
 };
 
 // Initialize IPC system with ExecuteJavaScript
@@ -34,8 +208,19 @@ void InitializeIPC(CefRefPtr<CefFrame> frame);
 // Test methods
 std::string HandlePing(const std::string &message);
 std::string HandleGetSystemInfo(const std::string &message);
+// Per-method call statistics as JSON; "trace" gives recent calls in Chrome
+// trace event format instead and "reset" clears both
+std::string HandleIpcStats(const std::string &message);
+// Ids of the registered methods, see IPCHandler::DescribeMethods()
+std::string HandleIpcMethods(const std::string &message);
 std::string HandleEcho(const std::string &message);
 
+// Payloads for comparing the string and binary channels; the string path
+// takes a byte count, the binary one {size, data?} and answers
+// {received, data}
+std::string HandleBenchPayload(const std::string &message);
+void HandleBinaryBenchPayload(CborReader &request, CborWriter &response);
+
 // Window management methods
 std::string HandleResizeWindow(const std::string &message);
 } // namespace SimpleIPC
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "workerpool.hpp"
+#include <algorithm>
+
+namespace SimpleIPC {
+
+WorkerPool::WorkerPool(size_t threadCount) {
+  if (threadCount == 0) {
+    // Handlers mostly wait on disk or child processes; a few threads keep
+    // one slow call from queueing the rest without competing with CEF
+    size_t hardware = std::thread::hardware_concurrency();
+    threadCount = std::min<size_t>(4, std::max<size_t>(2, hardware / 2));
+  }
+  threads_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads_.emplace_back(&WorkerPool::Run, this);
+  }
+}
+
+WorkerPool::~WorkerPool() { Shutdown(); }
+
+void WorkerPool::Post(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_)
+      return;
+    queue_.push_back(std::move(job));
+  }
+  condition_.notify_one();
+}
+
+void WorkerPool::Shutdown() {
+  // Destroying a job can fail its call, which may post more work; do it
+  // outside the lock (Post drops jobs once stopping_ is set)
+  std::deque<Job> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_)
+      return;
+    stopping_ = true;
+    dropped.swap(queue_);
+  }
+  dropped.clear();
+  condition_.notify_all();
+  for (auto &thread : threads_) {
+    if (thread.joinable())
+      thread.join();
+  }
+}
+
+void WorkerPool::Run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_)
+        return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    job();
+  }
+}
+
+} // namespace SimpleIPC
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SimpleIPC {
+
+// Fixed set of threads running posted jobs in FIFO order, so that slow
+// native work (file reads, searches, toolchain queries) stays off the CEF
+// UI thread
+class WorkerPool {
+public:
+  using Job = std::function<void()>;
+
+  // threadCount 0 picks one from the hardware concurrency
+  explicit WorkerPool(size_t threadCount = 0);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  void Post(Job job);
+
+  // Drops jobs that have not started and waits for the running ones
+  void Shutdown();
+
+  size_t ThreadCount() const { return threads_.size(); }
+
+private:
+  void Run();
+
+  std::vector<std::thread> threads_;
+  std::deque<Job> queue_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_ = false;
+};
+
+} // namespace SimpleIPC
@@ -47,6 +47,8 @@
 #endif
 #include "client/app.hpp"
 #include "client/client.hpp"
+#include "internal/eventbus.hpp"
+#include "internal/filewatcher.hpp"
 #include "internal/simpleipc.hpp"
 #include "resources/resources.hpp"
 #include "utils/config.hpp"
@@ -643,6 +645,11 @@ int PlatformMain(int argc, char* argv[]) {
 
   Logger::LogMessage("Shutting down application...");
 
+  // Stop IPC workers while CEF can still take their posted responses
+  SimpleIPC::IPCHandler::GetInstance().Shutdown();
+  SimpleIPC::FileWatcher::GetInstance().Stop();
+  SimpleIPC::EventBus::GetInstance().Shutdown();
+
   // Cleanup
   g_client = nullptr;
 
@@ -0,0 +1,309 @@
+#include "compiledb.hpp"
+#include "jsonio.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace Hyperion {
+namespace Toolchain {
+
+namespace {
+
+std::string ToLower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return text;
+}
+
+bool EndsWith(const std::string &text, const std::string &suffix) {
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// "13", "18.1"
+bool IsVersion(const std::string &text) {
+  if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+  return std::all_of(text.begin(), text.end(), [](unsigned char c) {
+    return std::isdigit(c) || c == '.';
+  });
+}
+
+// Options whose value is passed as the following argument
+bool TakesSeparateValue(const std::string &arg) {
+  static const char *kOptions[] = {"-o",        "-I",          "-D",
+                                   "-U",        "-include",    "-isystem",
+                                   "-iquote",   "-idirafter",  "-imacros",
+                                   "-x",        "-MF",         "-MT",
+                                   "-MQ",       "-arch",       "-target",
+                                   "--sysroot", "-isysroot",   "-Xclang",
+                                   "-Xlinker",  "/Fo",         "/Fe"};
+  for (const char *option : kOptions) {
+    if (arg == option) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+bool CompilationDatabase::IsCompilerCommand(const std::string &command) {
+  std::string name =
+      ToLower(std::filesystem::path(command).filename().string());
+  if (EndsWith(name, ".exe")) {
+    name.resize(name.size() - 4);
+  }
+
+  // Versioned drivers (gcc-13, clang++-18, x86_64-linux-gnu-g++-12) are the
+  // driver followed by a numeric version. Tools sharing the prefix, like
+  // clang-format, clang-tidy or gcc-ar, are not compilers.
+  size_t dash = name.rfind('-');
+  if (dash != std::string::npos && IsVersion(name.substr(dash + 1))) {
+    name.resize(dash);
+  }
+
+  static const char *kCompilers[] = {"cc",  "c++",   "gcc",     "g++",
+                                     "clang", "clang++", "cl",  "clang-cl"};
+  for (const char *compiler : kCompilers) {
+    if (name == compiler) {
+      return true;
+    }
+  }
+
+  // Cross drivers: x86_64-w64-mingw32-g++, aarch64-linux-gnu-gcc
+  return EndsWith(name, "-gcc") || EndsWith(name, "-g++") ||
+         EndsWith(name, "-clang") || EndsWith(name, "-clang++");
+}
+
+bool CompilationDatabase::IsSourceFile(const std::string &path) {
+  std::string extension =
+      ToLower(std::filesystem::path(path).extension().string());
+  static const char *kExtensions[] = {".c",  ".cc", ".cpp", ".cxx", ".c++",
+                                      ".cp", ".m",  ".mm",  ".cu",  ".ixx",
+                                      ".cppm"};
+  for (const char *candidate : kExtensions) {
+    if (extension == candidate) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string>
+CompilationDatabase::SplitCommandLine(const std::string &command) {
+  std::vector<std::string> args;
+  std::string current;
+  bool inArg = false;
+  char quote = 0;
+
+  for (size_t i = 0; i < command.size(); ++i) {
+    char c = command[i];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      } else if (c == '\\' && quote == '"' && i + 1 < command.size() &&
+                 (command[i + 1] == '"' || command[i + 1] == '\\')) {
+        current += command[++i];
+      } else {
+        current += c;
+      }
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+      inArg = true;
+    } else if (c == '\\' && i + 1 < command.size() &&
+               (command[i + 1] == '"' || command[i + 1] == '\'' ||
+                command[i + 1] == ' ')) {
+      current += command[++i];
+      inArg = true;
+    } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      if (inArg) {
+        args.push_back(std::move(current));
+        current.clear();
+        inArg = false;
+      }
+    } else {
+      current += c;
+      inArg = true;
+    }
+  }
+  if (inArg) {
+    args.push_back(std::move(current));
+  }
+  return args;
+}
+
+std::string CompilationDatabase::MakeKey(const std::string &directory,
+                                         const std::string &file) {
+  std::filesystem::path path(file);
+  if (path.is_relative() && !directory.empty()) {
+    path = std::filesystem::path(directory) / path;
+  }
+  std::string key = path.lexically_normal().generic_string();
+#ifdef _WIN32
+  key = ToLower(key);
+#endif
+  return key;
+}
+
+size_t CompilationDatabase::RecordInvocation(
+    const std::string &directory, const std::string &compiler,
+    const std::vector<std::string> &arguments) {
+  if (!IsCompilerCommand(compiler)) {
+    return 0;
+  }
+
+  // Separate the source files from the shared flags
+  std::vector<std::string> sources;
+  std::vector<std::string> flags;
+  std::string output;
+  bool compileOnly = false;
+
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    const std::string &arg = arguments[i];
+    if (TakesSeparateValue(arg) && i + 1 < arguments.size()) {
+      if (arg == "-o" || arg == "/Fo") {
+        output = arguments[i + 1];
+      }
+      flags.push_back(arg);
+      flags.push_back(arguments[++i]);
+      continue;
+    }
+    if (arg == "-c" || arg == "/c") {
+      compileOnly = true;
+    }
+    if (!arg.empty() && arg[0] != '-' && IsSourceFile(arg)) {
+      sources.push_back(arg);
+    } else {
+      flags.push_back(arg);
+    }
+  }
+
+  for (const auto &source : sources) {
+    CompileCommand command;
+    command.directory = directory;
+    command.file = source;
+    command.arguments.reserve(flags.size() + 2);
+    command.arguments.push_back(compiler);
+    command.arguments.insert(command.arguments.end(), flags.begin(),
+                             flags.end());
+    command.arguments.push_back(source);
+    if (compileOnly && sources.size() == 1) {
+      command.output = output;
+    }
+    Upsert(command);
+  }
+  return sources.size();
+}
+
+void CompilationDatabase::Upsert(const CompileCommand &command) {
+  std::string key = MakeKey(command.directory, command.file);
+  auto it = m_index.find(key);
+  if (it != m_index.end()) {
+    CompileCommand &existing = m_commands[it->second];
+    if (existing.arguments == command.arguments &&
+        existing.directory == command.directory &&
+        existing.output == command.output) {
+      return;
+    }
+    existing = command;
+  } else {
+    m_index.emplace(std::move(key), m_commands.size());
+    m_commands.push_back(command);
+  }
+  m_dirty = true;
+}
+
+bool CompilationDatabase::Remove(const std::string &file,
+                                 const std::string &directory) {
+  auto it = m_index.find(MakeKey(directory, file));
+  if (it == m_index.end()) {
+    return false;
+  }
+
+  // Swap with the last entry to keep removal O(1)
+  size_t slot = it->second;
+  m_index.erase(it);
+  if (slot != m_commands.size() - 1) {
+    m_commands[slot] = std::move(m_commands.back());
+    m_index[MakeKey(m_commands[slot].directory, m_commands[slot].file)] = slot;
+  }
+  m_commands.pop_back();
+  m_dirty = true;
+  return true;
+}
+
+const CompileCommand *
+CompilationDatabase::Find(const std::string &file,
+                          const std::string &directory) const {
+  auto it = m_index.find(MakeKey(directory, file));
+  return it != m_index.end() ? &m_commands[it->second] : nullptr;
+}
+
+void CompilationDatabase::Clear() {
+  if (!m_commands.empty()) {
+    m_dirty = true;
+  }
+  m_commands.clear();
+  m_index.clear();
+}
+
+bool CompilationDatabase::LoadFromFile(const std::string &path) {
+  std::string contents;
+  if (!ReadFileToString(path, contents)) {
+    return false;
+  }
+
+  JsonValue root;
+  if (!ParseJson(contents, root, nullptr) || !root.IsArray()) {
+    return false;
+  }
+
+  for (const auto &entry : root.AsArray()) {
+    CompileCommand command;
+    command.directory = entry.GetString("directory");
+    command.file = entry.GetString("file");
+    command.output = entry.GetString("output");
+    command.arguments = entry.GetStringArray("arguments");
+    if (command.arguments.empty()) {
+      command.arguments = SplitCommandLine(entry.GetString("command"));
+    }
+    if (!command.file.empty() && !command.arguments.empty()) {
+      Upsert(command);
+    }
+  }
+  return true;
+}
+
+bool CompilationDatabase::SaveToFile(const std::string &path) {
+  std::string contents;
+  JsonWriter writer(contents);
+  writer.BeginArray();
+  for (const auto &command : m_commands) {
+    writer.BeginObject();
+    writer.Key("directory");
+    writer.String(command.directory);
+    writer.Key("file");
+    writer.String(command.file);
+    writer.Key("arguments");
+    writer.StringArray(command.arguments);
+    if (!command.output.empty()) {
+      writer.Key("output");
+      writer.String(command.output);
+    }
+    writer.EndObject();
+  }
+  writer.EndArray();
+  contents += '\n';
+
+  if (!WriteFileAtomically(path, contents)) {
+    return false;
+  }
+  m_dirty = false;
+  return true;
+}
+
+} // namespace Toolchain
+} // namespace Hyperion
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Hyperion {
+namespace Toolchain {
+
+// One translation unit entry of a compile_commands.json file
+struct CompileCommand {
+  std::string directory;
+  std::string file;
+  std::vector<std::string> arguments; // argv, including the compiler
+  std::string output;
+};
+
+// In-memory compilation database with O(1) lookup by source file. Entries
+// are replaced per translation unit, so recording a rebuild of one file never
+// rewrites the flags of the others.
+class CompilationDatabase {
+public:
+  // Splits a compiler invocation into one entry per source file it compiles.
+  // Returns the number of translation units recorded (0 for non-compile
+  // commands such as pure link steps).
+  size_t RecordInvocation(const std::string &directory,
+                          const std::string &compiler,
+                          const std::vector<std::string> &arguments);
+
+  void Upsert(const CompileCommand &command);
+  bool Remove(const std::string &file, const std::string &directory = "");
+  const CompileCommand *Find(const std::string &file,
+                             const std::string &directory = "") const;
+
+  const std::vector<CompileCommand> &GetCommands() const { return m_commands; }
+  size_t Size() const { return m_commands.size(); }
+  void Clear();
+
+  // Merges the entries of an existing compile_commands.json (e.g. one
+  // exported by CMake) into this database
+  bool LoadFromFile(const std::string &path);
+
+  // Writes compile_commands.json atomically and clears the dirty flag
+  bool SaveToFile(const std::string &path);
+
+  bool IsDirty() const { return m_dirty; }
+
+  static bool IsCompilerCommand(const std::string &command);
+  static bool IsSourceFile(const std::string &path);
+  static std::vector<std::string> SplitCommandLine(const std::string &command);
+
+private:
+  static std::string MakeKey(const std::string &directory,
+                             const std::string &file);
+
+  std::vector<CompileCommand> m_commands;
+  std::unordered_map<std::string, size_t> m_index;
+  bool m_dirty = false;
+};
+
+} // namespace Toolchain
+} // namespace Hyperion
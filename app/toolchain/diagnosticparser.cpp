@@ -0,0 +1,434 @@
+#include "diagnosticparser.hpp"
+#include <cctype>
+
+namespace Hyperion {
+namespace Toolchain {
+
+namespace {
+
+std::string_view TrimLeft(std::string_view text) {
+  size_t start = 0;
+  while (start < text.size() && (text[start] == ' ' || text[start] == '\t')) {
+    ++start;
+  }
+  return text.substr(start);
+}
+
+std::string_view Trim(std::string_view text) {
+  text = TrimLeft(text);
+  size_t end = text.size();
+  while (end > 0 && (text[end - 1] == ' ' || text[end - 1] == '\t' ||
+                     text[end - 1] == '\r')) {
+    --end;
+  }
+  return text.substr(0, end);
+}
+
+bool StartsWith(std::string_view text, std::string_view prefix) {
+  return text.size() >= prefix.size() &&
+         text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Parses a run of decimal digits starting at |pos|. Returns false when no
+// digit is present; |pos| is advanced past the digits otherwise.
+bool ParseNumber(std::string_view text, size_t &pos, uint32_t &value) {
+  size_t start = pos;
+  uint64_t result = 0;
+  while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+    result = result * 10 + static_cast<uint64_t>(text[pos] - '0');
+    if (result > UINT32_MAX) {
+      return false;
+    }
+    ++pos;
+  }
+  value = static_cast<uint32_t>(result);
+  return pos > start;
+}
+
+// Removes ANSI color sequences emitted by clang, rustc and tsc --pretty
+std::string StripAnsi(std::string_view line) {
+  std::string result;
+  result.reserve(line.size());
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == '\x1b' && i + 1 < line.size() && line[i + 1] == '[') {
+      i += 2;
+      while (i < line.size() &&
+             !std::isalpha(static_cast<unsigned char>(line[i]))) {
+        ++i;
+      }
+      continue;
+    }
+    result += line[i];
+  }
+  return result;
+}
+
+// Parses "<severity>[ code]: message" following a location
+bool ParseSeverityAndMessage(std::string_view rest, BuildDiagnostic &out) {
+  struct SeverityWord {
+    std::string_view word;
+    DiagnosticSeverity severity;
+  };
+  static const SeverityWord kWords[] = {
+      {"fatal error", DiagnosticSeverity::Error},
+      {"error", DiagnosticSeverity::Error},
+      {"warning", DiagnosticSeverity::Warning},
+      {"note", DiagnosticSeverity::Note},
+      {"remark", DiagnosticSeverity::Info},
+      {"info", DiagnosticSeverity::Info},
+  };
+
+  rest = TrimLeft(rest);
+  for (const auto &candidate : kWords) {
+    if (!StartsWith(rest, candidate.word)) {
+      continue;
+    }
+    std::string_view tail = rest.substr(candidate.word.size());
+    std::string code;
+
+    if (!tail.empty() && tail[0] == ' ') {
+      // MSVC / tsc style code: "error C2065: ..." or "error TS2304: ..."
+      size_t colon = tail.find(':');
+      if (colon == std::string_view::npos) {
+        return false;
+      }
+      std::string_view token = Trim(tail.substr(0, colon));
+      if (token.empty()) {
+        return false;
+      }
+      for (char c : token) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+          return false;
+        }
+      }
+      code.assign(token);
+      tail = tail.substr(colon);
+    }
+
+    if (tail.empty() || tail[0] != ':') {
+      return false;
+    }
+
+    std::string_view message = Trim(tail.substr(1));
+    // MSBuild appends the owning project: "... [C:\path\project.vcxproj]"
+    if (!message.empty() && message.back() == ']') {
+      size_t open = message.rfind(" [");
+      if (open != std::string_view::npos &&
+          message.find(".vcxproj", open) != std::string_view::npos) {
+        message = Trim(message.substr(0, open));
+      }
+    }
+
+    out.severity = candidate.severity;
+    out.code = std::move(code);
+    out.message.assign(message);
+    return true;
+  }
+  return false;
+}
+
+uint64_t HashDiagnostic(const BuildDiagnostic &diagnostic) {
+  // FNV-1a over the identifying fields
+  uint64_t hash = 1469598103934665603ULL;
+  auto mix = [&hash](const void *data, size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(diagnostic.file.data(), diagnostic.file.size());
+  mix(&diagnostic.line, sizeof(diagnostic.line));
+  mix(&diagnostic.column, sizeof(diagnostic.column));
+  mix(&diagnostic.severity, sizeof(diagnostic.severity));
+  mix(diagnostic.message.data(), diagnostic.message.size());
+  return hash;
+}
+
+} // namespace
+
+// DiagnosticSink implementation
+void DiagnosticSink::SetCallback(DiagnosticCallback callback) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_callback = std::move(callback);
+}
+
+bool DiagnosticSink::Submit(const BuildDiagnostic &diagnostic) {
+  DiagnosticCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_seen.insert(HashDiagnostic(diagnostic)).second) {
+      return false;
+    }
+    m_diagnostics.push_back(diagnostic);
+    if (diagnostic.severity == DiagnosticSeverity::Error) {
+      ++m_errorCount;
+    }
+    callback = m_callback;
+  }
+
+  // Invoke outside the lock so the callback may query the sink
+  if (callback) {
+    callback(diagnostic);
+  }
+  return true;
+}
+
+void DiagnosticSink::Reset() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_seen.clear();
+  m_diagnostics.clear();
+  m_errorCount = 0;
+}
+
+std::vector<BuildDiagnostic> DiagnosticSink::GetDiagnostics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_diagnostics;
+}
+
+size_t DiagnosticSink::GetErrorCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_errorCount;
+}
+
+// DiagnosticParser implementation
+DiagnosticParser::DiagnosticParser(std::shared_ptr<DiagnosticSink> sink)
+    : m_sink(std::move(sink)) {}
+
+DiagnosticParser::~DiagnosticParser() { Flush(); }
+
+void DiagnosticParser::Feed(std::string_view chunk) {
+  size_t start = 0;
+  while (start < chunk.size()) {
+    size_t newline = chunk.find('\n', start);
+    if (newline == std::string_view::npos) {
+      m_partialLine.append(chunk.substr(start));
+      return;
+    }
+
+    std::string_view line = chunk.substr(start, newline - start);
+    if (!m_partialLine.empty()) {
+      m_partialLine.append(line);
+      std::string completed;
+      completed.swap(m_partialLine);
+      ParseLine(completed);
+    } else {
+      ParseLine(line);
+    }
+    start = newline + 1;
+  }
+}
+
+void DiagnosticParser::Flush() {
+  if (!m_partialLine.empty()) {
+    std::string line;
+    line.swap(m_partialLine);
+    ParseLine(line);
+  }
+  m_hasPendingRust = false;
+}
+
+void DiagnosticParser::ParseLine(std::string_view rawLine) {
+  std::string stripped;
+  if (rawLine.find('\x1b') != std::string_view::npos) {
+    stripped = StripAnsi(rawLine);
+    rawLine = stripped;
+  }
+  std::string_view line = Trim(rawLine);
+  if (line.empty()) {
+    m_hasPendingRust = false;
+    return;
+  }
+
+  if (m_hasPendingRust && ParseRustLocation(line)) {
+    return;
+  }
+  m_hasPendingRust = false;
+
+  if (ParseRustHeader(line)) {
+    return;
+  }
+
+  // MSBuild prefixes node numbers in parallel builds: "3>file.cpp(1): ..."
+  size_t pos = 0;
+  uint32_t node = 0;
+  if (ParseNumber(line, pos, node) && pos < line.size() && line[pos] == '>') {
+    line = line.substr(pos + 1);
+  }
+
+  BuildDiagnostic diagnostic;
+  if (ParseColonLocation(line, diagnostic) ||
+      ParseParenLocation(line, diagnostic)) {
+    if (m_sink) {
+      m_sink->Submit(diagnostic);
+    }
+  }
+}
+
+bool DiagnosticParser::ParseRustHeader(std::string_view line) {
+  std::string_view rest;
+  DiagnosticSeverity severity;
+  if (StartsWith(line, "error")) {
+    rest = line.substr(5);
+    severity = DiagnosticSeverity::Error;
+  } else if (StartsWith(line, "warning")) {
+    rest = line.substr(7);
+    severity = DiagnosticSeverity::Warning;
+  } else {
+    return false;
+  }
+
+  std::string code;
+  if (!rest.empty() && rest[0] == '[') {
+    size_t close = rest.find(']');
+    if (close == std::string_view::npos) {
+      return false;
+    }
+    code.assign(rest.substr(1, close - 1));
+    rest = rest.substr(close + 1);
+  }
+  if (rest.empty() || rest[0] != ':') {
+    return false;
+  }
+
+  m_pendingRust = BuildDiagnostic();
+  m_pendingRust.severity = severity;
+  m_pendingRust.code = std::move(code);
+  m_pendingRust.message.assign(Trim(rest.substr(1)));
+  m_hasPendingRust = true;
+  return true;
+}
+
+bool DiagnosticParser::ParseRustLocation(std::string_view line) {
+  if (!StartsWith(line, "-->")) {
+    return false;
+  }
+  std::string_view location = Trim(line.substr(3));
+
+  // file:line:col, scanning from the end so drive letters are preserved
+  size_t colColon = location.rfind(':');
+  if (colColon == std::string_view::npos || colColon == 0) {
+    return false;
+  }
+  size_t lineColon = location.rfind(':', colColon - 1);
+  if (lineColon == std::string_view::npos || lineColon == 0) {
+    return false;
+  }
+
+  size_t pos = lineColon + 1;
+  uint32_t lineNumber = 0;
+  if (!ParseNumber(location, pos, lineNumber) || pos != colColon) {
+    return false;
+  }
+  pos = colColon + 1;
+  uint32_t column = 0;
+  if (!ParseNumber(location, pos, column) || pos != location.size()) {
+    return false;
+  }
+
+  m_pendingRust.file.assign(location.substr(0, lineColon));
+  m_pendingRust.line = lineNumber;
+  m_pendingRust.column = column;
+  m_hasPendingRust = false;
+  if (m_sink) {
+    m_sink->Submit(m_pendingRust);
+  }
+  return true;
+}
+
+bool DiagnosticParser::ParseColonLocation(std::string_view line,
+                                          BuildDiagnostic &out) {
+  // Skip a Windows drive prefix ("C:\")
+  size_t searchFrom = 0;
+  if (line.size() > 2 && std::isalpha(static_cast<unsigned char>(line[0])) &&
+      line[1] == ':' && (line[2] == '\\' || line[2] == '/')) {
+    searchFrom = 2;
+  }
+
+  for (size_t colon = line.find(':', searchFrom);
+       colon != std::string_view::npos; colon = line.find(':', colon + 1)) {
+    if (colon == 0) {
+      continue;
+    }
+
+    size_t pos = colon + 1;
+    uint32_t lineNumber = 0;
+    if (!ParseNumber(line, pos, lineNumber) || pos >= line.size()) {
+      continue;
+    }
+
+    uint32_t column = 0;
+    std::string_view rest;
+    if (line[pos] == ':') {
+      size_t colPos = pos + 1;
+      if (ParseNumber(line, colPos, column)) {
+        if (colPos < line.size() && line[colPos] == ':') {
+          rest = line.substr(colPos + 1);
+        } else if (StartsWith(line.substr(colPos), " - ")) {
+          rest = line.substr(colPos + 3); // tsc --pretty
+        } else {
+          continue;
+        }
+      } else {
+        rest = line.substr(pos + 1); // file:line: severity: ...
+      }
+    } else {
+      continue;
+    }
+
+    if (ParseSeverityAndMessage(rest, out)) {
+      out.file.assign(Trim(line.substr(0, colon)));
+      out.line = lineNumber;
+      out.column = column;
+      return !out.file.empty();
+    }
+  }
+  return false;
+}
+
+bool DiagnosticParser::ParseParenLocation(std::string_view line,
+                                          BuildDiagnostic &out) {
+  for (size_t paren = line.find('('); paren != std::string_view::npos;
+       paren = line.find('(', paren + 1)) {
+    if (paren == 0) {
+      continue;
+    }
+
+    // (line), (line,col) or (line,col,endLine,endCol)
+    size_t pos = paren + 1;
+    uint32_t numbers[4] = {0, 0, 0, 0};
+    int count = 0;
+    bool valid = true;
+    while (count < 4) {
+      if (!ParseNumber(line, pos, numbers[count])) {
+        valid = false;
+        break;
+      }
+      ++count;
+      if (pos < line.size() && line[pos] == ',') {
+        ++pos;
+        continue;
+      }
+      break;
+    }
+    if (!valid || pos >= line.size() || line[pos] != ')') {
+      continue;
+    }
+
+    std::string_view rest = TrimLeft(line.substr(pos + 1));
+    if (rest.empty() || rest[0] != ':') {
+      continue;
+    }
+
+    if (ParseSeverityAndMessage(rest.substr(1), out)) {
+      out.file.assign(Trim(line.substr(0, paren)));
+      out.line = numbers[0];
+      out.column = count > 1 ? numbers[1] : 0;
+      return !out.file.empty();
+    }
+  }
+  return false;
+}
+
+} // namespace Toolchain
+} // namespace Hyperion
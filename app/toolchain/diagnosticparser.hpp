@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace Hyperion {
+namespace Toolchain {
+
+enum class DiagnosticSeverity { Error, Warning, Note, Info };
+
+// A single compiler diagnostic recovered from build output
+struct BuildDiagnostic {
+  std::string file;
+  uint32_t line = 0;
+  uint32_t column = 0; // 0 = unknown
+  DiagnosticSeverity severity = DiagnosticSeverity::Error;
+  std::string code; // e.g. C2065, TS2304, E0425 (may be empty)
+  std::string message;
+};
+
+// Collects diagnostics from any number of parsers and drops duplicates, so
+// parallel jobs reporting the same header error only surface it once.
+// Thread-safe.
+class DiagnosticSink {
+public:
+  using DiagnosticCallback = std::function<void(const BuildDiagnostic &)>;
+
+  void SetCallback(DiagnosticCallback callback);
+
+  // Returns false if an identical diagnostic was already reported
+  bool Submit(const BuildDiagnostic &diagnostic);
+
+  void Reset();
+  std::vector<BuildDiagnostic> GetDiagnostics() const;
+  size_t GetErrorCount() const;
+
+private:
+  mutable std::mutex m_mutex;
+  std::unordered_set<uint64_t> m_seen;
+  std::vector<BuildDiagnostic> m_diagnostics;
+  size_t m_errorCount = 0;
+  DiagnosticCallback m_callback;
+};
+
+// Incremental parser for one output stream. Accepts arbitrary chunks as they
+// are read from the process pipe and emits each diagnostic as soon as its
+// line (or, for rustc, its location line) is complete. Understands:
+//   GCC/Clang:  file:line:col: error: message
+//   MSVC:       file(line,col): error C2065: message
+//   tsc:        file(line,col): error TS2304: message
+//               file:line:col - error TS2304: message
+//   rustc:      error[E0425]: message
+//                 --> file:line:col
+class DiagnosticParser {
+public:
+  explicit DiagnosticParser(std::shared_ptr<DiagnosticSink> sink);
+  ~DiagnosticParser();
+
+  void Feed(std::string_view chunk);
+
+  // Processes a trailing line that did not end with a newline
+  void Flush();
+
+private:
+  void ParseLine(std::string_view line);
+  bool ParseRustLocation(std::string_view line);
+  bool ParseParenLocation(std::string_view line, BuildDiagnostic &out);
+  bool ParseColonLocation(std::string_view line, BuildDiagnostic &out);
+  bool ParseRustHeader(std::string_view line);
+
+  std::shared_ptr<DiagnosticSink> m_sink;
+  std::string m_partialLine;
+
+  // rustc prints the message before the location
+  bool m_hasPendingRust = false;
+  BuildDiagnostic m_pendingRust;
+};
+
+} // namespace Toolchain
+} // namespace Hyperion
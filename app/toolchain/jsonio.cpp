@@ -0,0 +1,553 @@
+#include "jsonio.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace Hyperion {
+namespace Toolchain {
+
+namespace {
+constexpr int kMaxNestingDepth = 128;
+
+void AppendUtf8(std::string &out, uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    out += static_cast<char>(codepoint);
+  } else if (codepoint < 0x800) {
+    out += static_cast<char>(0xC0 | (codepoint >> 6));
+    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+  } else if (codepoint < 0x10000) {
+    out += static_cast<char>(0xE0 | (codepoint >> 12));
+    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (codepoint >> 18));
+    out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (codepoint & 0x3F));
+  }
+}
+} // namespace
+
+// JsonValue implementation
+const JsonValue *JsonValue::Find(const std::string &key) const {
+  if (m_type != Type::Object) {
+    return nullptr;
+  }
+  for (const auto &member : m_object) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+std::string JsonValue::GetString(const std::string &key,
+                                 const std::string &fallback) const {
+  const JsonValue *value = Find(key);
+  return (value && value->IsString()) ? value->m_string : fallback;
+}
+
+uint64_t JsonValue::GetUInt(const std::string &key, uint64_t fallback) const {
+  const JsonValue *value = Find(key);
+  if (!value || !value->IsNumber() || value->m_number < 0) {
+    return fallback;
+  }
+  return static_cast<uint64_t>(value->m_number);
+}
+
+bool JsonValue::GetBool(const std::string &key, bool fallback) const {
+  const JsonValue *value = Find(key);
+  return value ? value->AsBool(fallback) : fallback;
+}
+
+std::vector<std::string>
+JsonValue::GetStringArray(const std::string &key) const {
+  std::vector<std::string> result;
+  const JsonValue *value = Find(key);
+  if (!value || !value->IsArray()) {
+    return result;
+  }
+  result.reserve(value->m_array.size());
+  for (const auto &item : value->m_array) {
+    if (item.IsString()) {
+      result.push_back(item.m_string);
+    }
+  }
+  return result;
+}
+
+// Parser
+class JsonParser {
+public:
+  explicit JsonParser(const std::string &text)
+      : m_cur(text.c_str()), m_begin(text.c_str()),
+        m_end(text.c_str() + text.size()) {}
+
+  bool Parse(JsonValue &out, std::string *error) {
+    SkipWhitespace();
+    bool ok = ParseValue(out, 0);
+    if (ok) {
+      SkipWhitespace();
+      if (m_cur != m_end) {
+        ok = Fail("Trailing characters");
+      }
+    }
+    if (!ok && error) {
+      *error = m_error + " at offset " + std::to_string(m_cur - m_begin);
+    }
+    return ok;
+  }
+
+private:
+  bool Fail(const char *message) {
+    if (m_error.empty()) {
+      m_error = message;
+    }
+    return false;
+  }
+
+  void SkipWhitespace() {
+    while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\n' ||
+                             *m_cur == '\r' || *m_cur == '\t')) {
+      ++m_cur;
+    }
+  }
+
+  bool Consume(const char *literal) {
+    const char *p = m_cur;
+    while (*literal) {
+      if (p >= m_end || *p != *literal) {
+        return false;
+      }
+      ++p;
+      ++literal;
+    }
+    m_cur = p;
+    return true;
+  }
+
+  bool ParseValue(JsonValue &out, int depth) {
+    if (depth > kMaxNestingDepth) {
+      return Fail("Nesting too deep");
+    }
+    if (m_cur >= m_end) {
+      return Fail("Unexpected end of input");
+    }
+
+    switch (*m_cur) {
+    case '{':
+      return ParseObject(out, depth);
+    case '[':
+      return ParseArray(out, depth);
+    case '"':
+      out.m_type = JsonValue::Type::String;
+      return ParseString(out.m_string);
+    case 't':
+      out.m_type = JsonValue::Type::Bool;
+      out.m_bool = true;
+      return Consume("true") || Fail("Invalid literal");
+    case 'f':
+      out.m_type = JsonValue::Type::Bool;
+      out.m_bool = false;
+      return Consume("false") || Fail("Invalid literal");
+    case 'n':
+      out.m_type = JsonValue::Type::Null;
+      return Consume("null") || Fail("Invalid literal");
+    default:
+      return ParseNumber(out);
+    }
+  }
+
+  bool ParseObject(JsonValue &out, int depth) {
+    out.m_type = JsonValue::Type::Object;
+    ++m_cur; // '{'
+    SkipWhitespace();
+    if (m_cur < m_end && *m_cur == '}') {
+      ++m_cur;
+      return true;
+    }
+
+    while (true) {
+      SkipWhitespace();
+      if (m_cur >= m_end || *m_cur != '"') {
+        return Fail("Expected object key");
+      }
+      out.m_object.emplace_back();
+      auto &member = out.m_object.back();
+      if (!ParseString(member.first)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (m_cur >= m_end || *m_cur != ':') {
+        return Fail("Expected ':'");
+      }
+      ++m_cur;
+      SkipWhitespace();
+      if (!ParseValue(member.second, depth + 1)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (m_cur < m_end && *m_cur == ',') {
+        ++m_cur;
+        continue;
+      }
+      if (m_cur < m_end && *m_cur == '}') {
+        ++m_cur;
+        return true;
+      }
+      return Fail("Expected ',' or '}'");
+    }
+  }
+
+  bool ParseArray(JsonValue &out, int depth) {
+    out.m_type = JsonValue::Type::Array;
+    ++m_cur; // '['
+    SkipWhitespace();
+    if (m_cur < m_end && *m_cur == ']') {
+      ++m_cur;
+      return true;
+    }
+
+    while (true) {
+      SkipWhitespace();
+      out.m_array.emplace_back();
+      if (!ParseValue(out.m_array.back(), depth + 1)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (m_cur < m_end && *m_cur == ',') {
+        ++m_cur;
+        continue;
+      }
+      if (m_cur < m_end && *m_cur == ']') {
+        ++m_cur;
+        return true;
+      }
+      return Fail("Expected ',' or ']'");
+    }
+  }
+
+  bool ParseHex4(uint32_t &value) {
+    if (m_end - m_cur < 4) {
+      return Fail("Truncated unicode escape");
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+      char c = *m_cur++;
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= static_cast<uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        value |= static_cast<uint32_t>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        value |= static_cast<uint32_t>(c - 'A' + 10);
+      } else {
+        return Fail("Invalid unicode escape");
+      }
+    }
+    return true;
+  }
+
+  bool ParseString(std::string &out) {
+    ++m_cur; // opening quote
+    while (m_cur < m_end) {
+      // Copy unescaped runs in one go
+      const char *run = m_cur;
+      while (m_cur < m_end && *m_cur != '"' && *m_cur != '\\') {
+        if (static_cast<unsigned char>(*m_cur) < 0x20) {
+          return Fail("Control character in string");
+        }
+        ++m_cur;
+      }
+      out.append(run, m_cur - run);
+      if (m_cur >= m_end) {
+        break;
+      }
+      if (*m_cur == '"') {
+        ++m_cur;
+        return true;
+      }
+
+      // Escape sequence
+      ++m_cur;
+      if (m_cur >= m_end) {
+        break;
+      }
+      char escape = *m_cur++;
+      switch (escape) {
+      case '"':
+        out += '"';
+        break;
+      case '\\':
+        out += '\\';
+        break;
+      case '/':
+        out += '/';
+        break;
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        uint32_t codepoint;
+        if (!ParseHex4(codepoint)) {
+          return false;
+        }
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+          uint32_t low;
+          if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 ||
+              low > 0xDFFF) {
+            return Fail("Invalid surrogate pair");
+          }
+          codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+        AppendUtf8(out, codepoint);
+        break;
+      }
+      default:
+        return Fail("Invalid escape sequence");
+      }
+    }
+    return Fail("Unterminated string");
+  }
+
+  bool ParseNumber(JsonValue &out) {
+    const char *start = m_cur;
+    if (m_cur < m_end && *m_cur == '-') {
+      ++m_cur;
+    }
+    while (m_cur < m_end &&
+           ((*m_cur >= '0' && *m_cur <= '9') || *m_cur == '.' ||
+            *m_cur == 'e' || *m_cur == 'E' || *m_cur == '+' || *m_cur == '-')) {
+      ++m_cur;
+    }
+    if (m_cur == start) {
+      return Fail("Unexpected character");
+    }
+
+    char *parsedEnd = nullptr;
+    out.m_type = JsonValue::Type::Number;
+    out.m_number = std::strtod(start, &parsedEnd);
+    if (parsedEnd != m_cur) {
+      m_cur = start;
+      return Fail("Invalid number");
+    }
+    return true;
+  }
+
+  const char *m_cur;
+  const char *m_begin;
+  const char *m_end;
+  std::string m_error;
+};
+
+bool ParseJson(const std::string &text, JsonValue &out, std::string *error) {
+  out = JsonValue();
+  JsonParser parser(text);
+  return parser.Parse(out, error);
+}
+
+// JsonWriter implementation
+void AppendJsonString(std::string &out, const std::string &value) {
+  static const char kHex[] = "0123456789abcdef";
+  out += '"';
+  for (char c : value) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        out += "\\u00";
+        out += kHex[(c >> 4) & 0xF];
+        out += kHex[c & 0xF];
+      } else {
+        out += c;
+      }
+      break;
+    }
+  }
+  out += '"';
+}
+
+void JsonWriter::Newline() {
+  if (!m_pretty) {
+    return;
+  }
+  m_out += '\n';
+  m_out.append(m_hasElements.size() * 2, ' ');
+}
+
+void JsonWriter::BeforeValue() {
+  if (m_afterKey) {
+    m_afterKey = false;
+    return;
+  }
+  if (!m_hasElements.empty()) {
+    if (m_hasElements.back()) {
+      m_out += ',';
+    }
+    m_hasElements.back() = true;
+    Newline();
+  }
+}
+
+void JsonWriter::BeginObject() {
+  BeforeValue();
+  m_out += '{';
+  m_hasElements.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  bool hadElements = m_hasElements.back();
+  m_hasElements.pop_back();
+  if (hadElements) {
+    Newline();
+  }
+  m_out += '}';
+}
+
+void JsonWriter::BeginArray() {
+  BeforeValue();
+  m_out += '[';
+  m_hasElements.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  bool hadElements = m_hasElements.back();
+  m_hasElements.pop_back();
+  if (hadElements) {
+    Newline();
+  }
+  m_out += ']';
+}
+
+void JsonWriter::Key(const std::string &key) {
+  BeforeValue();
+  AppendJsonString(m_out, key);
+  m_out += m_pretty ? ": " : ":";
+  m_afterKey = true;
+}
+
+void JsonWriter::String(const std::string &value) {
+  BeforeValue();
+  AppendJsonString(m_out, value);
+}
+
+void JsonWriter::Number(double value) {
+  BeforeValue();
+  if (!std::isfinite(value)) {
+    m_out += "null";
+    return;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  m_out += buffer;
+}
+
+void JsonWriter::UInt(uint64_t value) {
+  BeforeValue();
+  m_out += std::to_string(value);
+}
+
+void JsonWriter::Bool(bool value) {
+  BeforeValue();
+  m_out += value ? "true" : "false";
+}
+
+void JsonWriter::Null() {
+  BeforeValue();
+  m_out += "null";
+}
+
+void JsonWriter::StringArray(const std::vector<std::string> &values) {
+  BeginArray();
+  for (const auto &value : values) {
+    String(value);
+  }
+  EndArray();
+}
+
+// File helpers
+bool WriteFileAtomically(const std::string &path, const std::string &contents) {
+  std::filesystem::path target(path);
+  std::filesystem::path temp = target;
+  temp += ".tmp";
+
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    file.flush();
+    if (!file) {
+      file.close();
+      std::error_code ignored;
+      std::filesystem::remove(temp, ignored);
+      return false;
+    }
+  }
+
+  // rename() replaces the destination in a single step on both Win32
+  // (MoveFileEx with MOVEFILE_REPLACE_EXISTING) and POSIX
+  std::error_code ec;
+  std::filesystem::rename(temp, target, ec);
+  if (ec) {
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+  return true;
+}
+
+bool ReadFileToString(const std::string &path, std::string &out) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size < 0) {
+    return false;
+  }
+  file.seekg(0, std::ios::beg);
+  out.resize(static_cast<size_t>(size));
+  if (size > 0) {
+    file.read(&out[0], size);
+  }
+  return static_cast<bool>(file);
+}
+
+} // namespace Toolchain
+} // namespace Hyperion
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Hyperion {
+namespace Toolchain {
+
+// Minimal JSON document model used for toolchain configuration and
+// compilation database files. Objects keep insertion order so files written
+// back out stay diff-friendly.
+class JsonValue {
+public:
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  JsonValue() = default;
+
+  Type GetType() const { return m_type; }
+  bool IsNull() const { return m_type == Type::Null; }
+  bool IsBool() const { return m_type == Type::Bool; }
+  bool IsNumber() const { return m_type == Type::Number; }
+  bool IsString() const { return m_type == Type::String; }
+  bool IsArray() const { return m_type == Type::Array; }
+  bool IsObject() const { return m_type == Type::Object; }
+
+  bool AsBool(bool fallback = false) const {
+    return m_type == Type::Bool ? m_bool : fallback;
+  }
+  double AsNumber(double fallback = 0.0) const {
+    return m_type == Type::Number ? m_number : fallback;
+  }
+  const std::string &AsString() const { return m_string; }
+  const std::vector<JsonValue> &AsArray() const { return m_array; }
+  const std::vector<std::pair<std::string, JsonValue>> &AsObject() const {
+    return m_object;
+  }
+
+  // Object member lookup, returns nullptr when missing or not an object
+  const JsonValue *Find(const std::string &key) const;
+
+  // Convenience accessors for object members
+  std::string GetString(const std::string &key,
+                        const std::string &fallback = "") const;
+  uint64_t GetUInt(const std::string &key, uint64_t fallback = 0) const;
+  bool GetBool(const std::string &key, bool fallback = false) const;
+  std::vector<std::string> GetStringArray(const std::string &key) const;
+
+private:
+  friend class JsonParser;
+
+  Type m_type = Type::Null;
+  bool m_bool = false;
+  double m_number = 0.0;
+  std::string m_string;
+  std::vector<JsonValue> m_array;
+  std::vector<std::pair<std::string, JsonValue>> m_object;
+};
+
+// Single-pass recursive descent parser. Returns false and fills |error| with
+// the byte offset of the failure on malformed input.
+bool ParseJson(const std::string &text, JsonValue &out, std::string *error);
+
+// Streaming JSON writer that escapes strings correctly and handles comma
+// placement, so callers never hand-format JSON.
+class JsonWriter {
+public:
+  explicit JsonWriter(std::string &out, bool pretty = true)
+      : m_out(out), m_pretty(pretty) {}
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+  void Key(const std::string &key);
+
+  void String(const std::string &value);
+  void Number(double value);
+  void UInt(uint64_t value);
+  void Bool(bool value);
+  void Null();
+
+  void StringArray(const std::vector<std::string> &values);
+
+private:
+  void BeforeValue();
+  void Newline();
+
+  std::string &m_out;
+  bool m_pretty;
+  // One entry per open container: true once the first element was written
+  std::vector<bool> m_hasElements;
+  bool m_afterKey = false;
+};
+
+// Appends |value| to |out| as a quoted, escaped JSON string
+void AppendJsonString(std::string &out, const std::string &value);
+
+// Writes |contents| to a temporary sibling file and renames it over |path|,
+// so readers never observe a partially written file.
+bool WriteFileAtomically(const std::string &path, const std::string &contents);
+
+// Reads a whole file into |out|
+bool ReadFileToString(const std::string &path, std::string &out);
+
+} // namespace Toolchain
+} // namespace Hyperion
@@ -0,0 +1,406 @@
+#include "resourcesampler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Hyperion {
+namespace Toolchain {
+
+namespace {
+constexpr size_t kMaxFinishedJobs = 64;
+
+#ifdef _WIN32
+uint64_t FileTimeToMs(const FILETIME &time) {
+  ULARGE_INTEGER value;
+  value.LowPart = time.dwLowDateTime;
+  value.HighPart = time.dwHighDateTime;
+  return value.QuadPart / 10000; // 100ns units
+}
+#else
+// Reads "Key:   123 kB" style values from /proc/<pid>/status
+uint64_t ReadStatusKb(const std::string &status, const char *key) {
+  size_t pos = status.find(key);
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  pos += std::char_traits<char>::length(key);
+  return std::strtoull(status.c_str() + pos, nullptr, 10) * 1024;
+}
+
+bool ReadWholeFile(const std::string &path, std::string &out) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  out = buffer.str();
+  return true;
+}
+
+uint64_t ReadCgroupMemory(uint32_t pid) {
+  // cgroup v2: a single "0::/path" line
+  std::string cgroup;
+  if (!ReadWholeFile("/proc/" + std::to_string(pid) + "/cgroup", cgroup)) {
+    return 0;
+  }
+  size_t pos = cgroup.find("0::");
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  size_t end = cgroup.find('\n', pos);
+  std::string path = cgroup.substr(pos + 3, end == std::string::npos
+                                                 ? std::string::npos
+                                                 : end - pos - 3);
+  std::string current;
+  if (!ReadWholeFile("/sys/fs/cgroup" + path + "/memory.current", current)) {
+    return 0;
+  }
+  return std::strtoull(current.c_str(), nullptr, 10);
+}
+#endif
+} // namespace
+
+struct ResourceSampler::Job {
+  std::string label;
+  uint32_t processId = 0;
+#ifdef _WIN32
+  HANDLE handle = nullptr;
+#endif
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
+  bool running = true;
+  uint64_t peakRssBytes = 0;
+  ResourceRing ring;
+
+  ~Job() {
+#ifdef _WIN32
+    if (handle) {
+      CloseHandle(handle);
+    }
+#endif
+  }
+};
+
+// ResourceRing implementation
+void ResourceRing::Push(const ResourceSample &sample) {
+  m_samples[m_next] = sample;
+  m_next = (m_next + 1) % kCapacity;
+  if (m_size < kCapacity) {
+    ++m_size;
+  }
+}
+
+std::vector<ResourceSample> ResourceRing::Snapshot() const {
+  std::vector<ResourceSample> result;
+  result.reserve(m_size);
+  size_t first = (m_next + kCapacity - m_size) % kCapacity;
+  for (size_t i = 0; i < m_size; ++i) {
+    result.push_back(m_samples[(first + i) % kCapacity]);
+  }
+  return result;
+}
+
+const ResourceSample *ResourceRing::Latest() const {
+  if (m_size == 0) {
+    return nullptr;
+  }
+  return &m_samples[(m_next + kCapacity - 1) % kCapacity];
+}
+
+// ResourceSampler implementation
+ResourceSampler::ResourceSampler(std::chrono::milliseconds interval)
+    : m_interval(interval) {}
+
+ResourceSampler::~ResourceSampler() { Stop(); }
+
+void ResourceSampler::Start() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_running) {
+    return;
+  }
+  m_running = true;
+  m_thread = std::thread(&ResourceSampler::Run, this);
+}
+
+void ResourceSampler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running) {
+      return;
+    }
+    m_running = false;
+  }
+  m_wakeCondition.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+bool ResourceSampler::Track(const std::string &jobId, uint32_t processId,
+                            const std::string &label) {
+  if (processId == 0) {
+    return false;
+  }
+
+  auto job = std::make_unique<Job>();
+  job->label = label;
+  job->processId = processId;
+  job->start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+  // Own handle so sampling keeps working whoever owns the process object
+  job->handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE,
+                            FALSE, processId);
+  if (!job->handle) {
+    return false;
+  }
+#endif
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_jobs[jobId] = std::move(job);
+  return true;
+}
+
+void ResourceSampler::Untrack(const std::string &jobId) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_jobs.erase(jobId);
+}
+
+bool ResourceSampler::GetSeries(const std::string &jobId,
+                                JobResourceSeries &series) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_jobs.find(jobId);
+  if (it == m_jobs.end()) {
+    return false;
+  }
+
+  const Job &job = *it->second;
+  series.jobId = jobId;
+  series.label = job.label;
+  series.processId = job.processId;
+  series.running = job.running;
+  series.peakRssBytes = job.peakRssBytes;
+  series.samples = job.ring.Snapshot();
+  if (const ResourceSample *latest = job.ring.Latest()) {
+    series.durationMs = latest->timestampMs;
+    series.cpuTimeMs = latest->cpuTimeMs;
+    series.ioReadBytes = latest->ioReadBytes;
+    series.ioWriteBytes = latest->ioWriteBytes;
+  }
+  return true;
+}
+
+std::vector<JobResourceSeries> ResourceSampler::GetSummaries() const {
+  std::vector<JobResourceSeries> summaries;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    summaries.reserve(m_jobs.size());
+    for (const auto &pair : m_jobs) {
+      const Job &job = *pair.second;
+      JobResourceSeries summary;
+      summary.jobId = pair.first;
+      summary.label = job.label;
+      summary.processId = job.processId;
+      summary.running = job.running;
+      summary.peakRssBytes = job.peakRssBytes;
+      if (const ResourceSample *latest = job.ring.Latest()) {
+        summary.durationMs = latest->timestampMs;
+        summary.cpuTimeMs = latest->cpuTimeMs;
+        summary.ioReadBytes = latest->ioReadBytes;
+        summary.ioWriteBytes = latest->ioWriteBytes;
+      }
+      summaries.push_back(std::move(summary));
+    }
+  }
+
+  std::sort(summaries.begin(), summaries.end(),
+            [](const JobResourceSeries &a, const JobResourceSeries &b) {
+              return a.cpuTimeMs > b.cpuTimeMs;
+            });
+  return summaries;
+}
+
+void ResourceSampler::Run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_running) {
+    lock.unlock();
+    SampleAll();
+    lock.lock();
+    m_wakeCondition.wait_for(lock, m_interval, [this] { return !m_running; });
+  }
+}
+
+void ResourceSampler::SampleAll() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+#ifdef _WIN32
+  // Thread counts come from one snapshot for all jobs per tick
+  std::unordered_map<DWORD, DWORD> threadCounts;
+  bool anyRunning = std::any_of(m_jobs.begin(), m_jobs.end(),
+                                [](const auto &pair) {
+                                  return pair.second->running;
+                                });
+  if (anyRunning) {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot != INVALID_HANDLE_VALUE) {
+      PROCESSENTRY32 entry = {};
+      entry.dwSize = sizeof(entry);
+      if (Process32First(snapshot, &entry)) {
+        do {
+          threadCounts[entry.th32ProcessID] = entry.cntThreads;
+        } while (Process32Next(snapshot, &entry));
+      }
+      CloseHandle(snapshot);
+    }
+  }
+#endif
+
+  auto now = std::chrono::steady_clock::now();
+  for (auto &pair : m_jobs) {
+    Job &job = *pair.second;
+    if (!job.running) {
+      continue;
+    }
+
+    ResourceSample sample;
+    bool exited = false;
+    if (SampleProcess(job, sample, exited)) {
+      sample.timestampMs = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(now -
+                                                                job.start)
+              .count());
+#ifdef _WIN32
+      auto threads = threadCounts.find(job.processId);
+      sample.threadCount = threads != threadCounts.end() ? threads->second : 0;
+#endif
+      job.peakRssBytes = std::max(job.peakRssBytes, sample.peakRssBytes);
+      job.ring.Push(sample);
+    }
+    if (exited) {
+      job.running = false;
+      job.end = now;
+    }
+  }
+
+  PruneFinishedJobs();
+}
+
+bool ResourceSampler::SampleProcess(Job &job, ResourceSample &sample,
+                                    bool &exited) {
+#ifdef _WIN32
+  exited = WaitForSingleObject(job.handle, 0) == WAIT_OBJECT_0;
+
+  FILETIME creation, exit, kernel, user;
+  if (GetProcessTimes(job.handle, &creation, &exit, &kernel, &user)) {
+    sample.cpuTimeMs = FileTimeToMs(kernel) + FileTimeToMs(user);
+  }
+
+  PROCESS_MEMORY_COUNTERS memory = {};
+  if (GetProcessMemoryInfo(job.handle, &memory, sizeof(memory))) {
+    sample.rssBytes = memory.WorkingSetSize;
+    sample.peakRssBytes = memory.PeakWorkingSetSize;
+  }
+
+  IO_COUNTERS io = {};
+  if (GetProcessIoCounters(job.handle, &io)) {
+    sample.ioReadBytes = io.ReadTransferCount;
+    sample.ioWriteBytes = io.WriteTransferCount;
+  }
+  return true;
+#else
+  const std::string procDir = "/proc/" + std::to_string(job.processId);
+
+  std::string stat;
+  if (!ReadWholeFile(procDir + "/stat", stat)) {
+    exited = true; // already reaped
+    return false;
+  }
+
+  // The command name may contain spaces; fields resume after the last ')'
+  size_t commEnd = stat.rfind(')');
+  if (commEnd == std::string::npos) {
+    return false;
+  }
+  std::istringstream fields(stat.substr(commEnd + 2));
+  std::string state;
+  fields >> state;
+  // Fields 4..13 precede utime (14) and stime (15); num_threads is 20
+  std::string skip;
+  for (int i = 4; i <= 13; ++i) {
+    fields >> skip;
+  }
+  uint64_t utime = 0, stime = 0;
+  fields >> utime >> stime;
+  for (int i = 16; i <= 19; ++i) {
+    fields >> skip;
+  }
+  uint32_t threads = 0;
+  fields >> threads;
+
+  static const long kTicksPerSecond = sysconf(_SC_CLK_TCK);
+  if (kTicksPerSecond > 0) {
+    sample.cpuTimeMs = (utime + stime) * 1000 /
+                       static_cast<uint64_t>(kTicksPerSecond);
+  }
+  sample.threadCount = threads;
+  exited = state == "Z" || state == "X";
+
+  std::string status;
+  if (ReadWholeFile(procDir + "/status", status)) {
+    sample.rssBytes = ReadStatusKb(status, "VmRSS:");
+    sample.peakRssBytes = ReadStatusKb(status, "VmHWM:");
+  }
+
+  // read_bytes/write_bytes count actual storage I/O; readable for our own
+  // children without extra privileges
+  std::string io;
+  if (ReadWholeFile(procDir + "/io", io)) {
+    auto readField = [&io](const char *key) -> uint64_t {
+      size_t pos = io.find(key);
+      if (pos == std::string::npos) {
+        return 0;
+      }
+      return std::strtoull(
+          io.c_str() + pos + std::char_traits<char>::length(key), nullptr, 10);
+    };
+    sample.ioReadBytes = readField("\nread_bytes:");
+    sample.ioWriteBytes = readField("\nwrite_bytes:");
+  }
+
+  sample.cgroupMemoryBytes = ReadCgroupMemory(job.processId);
+  return true;
+#endif
+}
+
+void ResourceSampler::PruneFinishedJobs() {
+  size_t finished = 0;
+  for (const auto &pair : m_jobs) {
+    if (!pair.second->running) {
+      ++finished;
+    }
+  }
+
+  while (finished > kMaxFinishedJobs) {
+    auto oldest = m_jobs.end();
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ++it) {
+      if (!it->second->running &&
+          (oldest == m_jobs.end() || it->second->end < oldest->second->end)) {
+        oldest = it;
+      }
+    }
+    m_jobs.erase(oldest);
+    --finished;
+  }
+}
+
+} // namespace Toolchain
+} // namespace Hyperion
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Hyperion {
+namespace Toolchain {
+
+// One point-in-time reading of a process' resource usage
+struct ResourceSample {
+  uint64_t timestampMs = 0; // since the job started being tracked
+  uint64_t cpuTimeMs = 0;   // user + kernel
+  uint64_t rssBytes = 0;
+  uint64_t peakRssBytes = 0;
+  uint64_t ioReadBytes = 0;
+  uint64_t ioWriteBytes = 0;
+  uint64_t cgroupMemoryBytes = 0; // Linux only, 0 when unavailable
+  uint32_t threadCount = 0;
+};
+
+// Fixed-size ring of samples; the oldest sample is overwritten when full
+class ResourceRing {
+public:
+  static constexpr size_t kCapacity = 240;
+
+  void Push(const ResourceSample &sample);
+  std::vector<ResourceSample> Snapshot() const; // oldest first
+  size_t Size() const { return m_size; }
+  const ResourceSample *Latest() const;
+
+private:
+  std::array<ResourceSample, kCapacity> m_samples;
+  size_t m_next = 0;
+  size_t m_size = 0;
+};
+
+// Time series and aggregates for one tracked job
+struct JobResourceSeries {
+  std::string jobId;
+  std::string label;
+  uint32_t processId = 0;
+  bool running = false;
+  uint64_t durationMs = 0;
+  uint64_t peakRssBytes = 0;
+  uint64_t cpuTimeMs = 0;
+  uint64_t ioReadBytes = 0;
+  uint64_t ioWriteBytes = 0;
+  std::vector<ResourceSample> samples; // empty in summaries
+};
+
+// Background thread that periodically samples every tracked process. Jobs
+// stay queryable after they exit so slow or memory-hungry build steps can be
+// inspected afterwards; the oldest finished jobs are dropped past a limit.
+class ResourceSampler {
+public:
+  explicit ResourceSampler(
+      std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+  ~ResourceSampler();
+
+  void Start();
+  void Stop();
+
+  bool Track(const std::string &jobId, uint32_t processId,
+             const std::string &label);
+  void Untrack(const std::string &jobId);
+
+  bool GetSeries(const std::string &jobId, JobResourceSeries &series) const;
+  // Aggregates only (no samples), most expensive CPU users first
+  std::vector<JobResourceSeries> GetSummaries() const;
+
+private:
+  struct Job;
+
+  void Run();
+  void SampleAll();
+  static bool SampleProcess(Job &job, ResourceSample &sample, bool &exited);
+  void PruneFinishedJobs();
+
+  std::chrono::milliseconds m_interval;
+  std::unordered_map<std::string, std::unique_ptr<Job>> m_jobs;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wakeCondition;
+  std::thread m_thread;
+  bool m_running = false;
+};
+
+} // namespace Toolchain
+} // namespace Hyperion
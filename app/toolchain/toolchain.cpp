@@ -1,4 +1,6 @@
 #include "toolchain.hpp"
+#include "jsonio.hpp"
+#include "warmpool.hpp"
 #include "windowed.hpp"
 #include <algorithm>
 #include <chrono>
@@ -17,6 +19,84 @@
 namespace Hyperion {
 namespace Toolchain {
 
+namespace {
+// Bump whenever the on-disk layout changes incompatibly. Files with a
+// different version are ignored and toolchains are re-detected.
+constexpr uint64_t kConfigSchemaVersion = 1;
+
+void WriteSandboxConfig(JsonWriter &writer, const SandboxConfig &config) {
+  writer.BeginObject();
+  writer.Key("name");
+  writer.String(config.name);
+  writer.Key("workingDirectory");
+  writer.String(config.workingDirectory);
+  writer.Key("toolchainPath");
+  writer.String(config.toolchainPath);
+  writer.Key("environmentVariables");
+  writer.StringArray(config.environmentVariables);
+  writer.Key("allowedPaths");
+  writer.StringArray(config.allowedPaths);
+  writer.Key("networkAccess");
+  writer.Bool(config.networkAccess);
+  writer.Key("fileSystemAccess");
+  writer.Bool(config.fileSystemAccess);
+  writer.Key("memoryLimit");
+  writer.UInt(config.memoryLimit);
+  writer.Key("timeLimit");
+  writer.UInt(config.timeLimit);
+  writer.EndObject();
+}
+
+SandboxConfig ReadSandboxConfig(const JsonValue &value) {
+  SandboxConfig config;
+  config.name = value.GetString("name");
+  config.workingDirectory = value.GetString("workingDirectory");
+  config.toolchainPath = value.GetString("toolchainPath");
+  config.environmentVariables = value.GetStringArray("environmentVariables");
+  config.allowedPaths = value.GetStringArray("allowedPaths");
+  config.networkAccess = value.GetBool("networkAccess", false);
+  config.fileSystemAccess = value.GetBool("fileSystemAccess", true);
+  config.memoryLimit = value.GetUInt("memoryLimit");
+  config.timeLimit = static_cast<uint32_t>(value.GetUInt("timeLimit"));
+  return config;
+}
+
+void WriteToolchainInfo(JsonWriter &writer, const ToolchainInfo &tc) {
+  writer.BeginObject();
+  writer.Key("id");
+  writer.String(tc.id);
+  writer.Key("name");
+  writer.String(tc.name);
+  writer.Key("version");
+  writer.String(tc.version);
+  writer.Key("description");
+  writer.String(tc.description);
+  writer.Key("executablePath");
+  writer.String(tc.executablePath);
+  writer.Key("supportedExtensions");
+  writer.StringArray(tc.supportedExtensions);
+  writer.Key("defaultSandbox");
+  WriteSandboxConfig(writer, tc.defaultSandbox);
+  writer.EndObject();
+}
+
+bool ReadToolchainInfo(const JsonValue &value, ToolchainInfo &tc) {
+  if (!value.IsObject()) {
+    return false;
+  }
+  tc.id = value.GetString("id");
+  tc.name = value.GetString("name");
+  tc.version = value.GetString("version");
+  tc.description = value.GetString("description");
+  tc.executablePath = value.GetString("executablePath");
+  tc.supportedExtensions = value.GetStringArray("supportedExtensions");
+  if (const JsonValue *sandbox = value.Find("defaultSandbox")) {
+    tc.defaultSandbox = ReadSandboxConfig(*sandbox);
+  }
+  return !tc.id.empty() && !tc.name.empty();
+}
+} // namespace
+
 // Windows-specific sandbox process implementation
 class WindowsSandboxProcess : public SandboxProcess {
 public:
@@ -117,14 +197,55 @@ public:
       result.exitCode = static_cast<int>(exitCode);
     }
 
-    result.executionTime = GetTickCount64() - m_startTime;
+    // Wall and CPU time come from the kernel's accounting rather than from
+    // when GetResult() happens to be called
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(m_processHandle, &creation, &exit, &kernel, &user)) {
+      ULARGE_INTEGER start, end;
+      start.LowPart = creation.dwLowDateTime;
+      start.HighPart = creation.dwHighDateTime;
+      if (IsRunning()) {
+        GetSystemTimeAsFileTime(&exit);
+      }
+      end.LowPart = exit.dwLowDateTime;
+      end.HighPart = exit.dwHighDateTime;
+      result.executionTime = (end.QuadPart - start.QuadPart) / 10000;
+
+      ULARGE_INTEGER kernelTime, userTime;
+      kernelTime.LowPart = kernel.dwLowDateTime;
+      kernelTime.HighPart = kernel.dwHighDateTime;
+      userTime.LowPart = user.dwLowDateTime;
+      userTime.HighPart = user.dwHighDateTime;
+      result.cpuTime = (kernelTime.QuadPart + userTime.QuadPart) / 10000;
+    } else {
+      result.executionTime = GetTickCount64() - m_startTime;
+    }
+    // Sampled before reading: once the child has exited nothing more can
+    // be written, so draining the pipes after this point gets all of it
+    bool exited = !IsRunning();
     result.stdoutData = ReadOutput();
     result.stderrData = ReadError();
+    if (exited) {
+      for (;;) {
+        std::string output = ReadOutput();
+        std::string error = ReadError();
+        if (output.empty() && error.empty()) {
+          break;
+        }
+        result.stdoutData += output;
+        result.stderrData += error;
+      }
+    }
+    if (m_outputListener && !m_outputEnded && exited) {
+      m_outputEnded = true;
+      m_outputListener("", false);
+      m_outputListener("", true);
+    }
 
     // Check memory usage
     PROCESS_MEMORY_COUNTERS pmc;
     if (GetProcessMemoryInfo(m_processHandle, &pmc, sizeof(pmc))) {
-      result.memoryUsed = pmc.WorkingSetSize;
+      result.memoryUsed = pmc.PeakWorkingSetSize;
       if (m_config.memoryLimit > 0 &&
           result.memoryUsed > m_config.memoryLimit) {
         result.memoryExceeded = true;
@@ -148,9 +269,34 @@ public:
     }
   }
 
-  std::string ReadOutput() override { return ReadFromPipe(m_stdoutRead); }
+  std::string ReadOutput() override {
+    std::string output = ReadFromPipe(m_stdoutRead);
+    if (m_outputListener && !output.empty()) {
+      m_outputListener(output, false);
+    }
+    return output;
+  }
+
+  std::string ReadError() override {
+    std::string error = ReadFromPipe(m_stderrRead);
+    if (m_outputListener && !error.empty()) {
+      m_outputListener(error, true);
+    }
+    return error;
+  }
+
+  void CloseInput() override {
+    if (m_stdinWrite) {
+      CloseHandle(m_stdinWrite);
+      m_stdinWrite = nullptr;
+    }
+  }
 
-  std::string ReadError() override { return ReadFromPipe(m_stderrRead); }
+  void SetOutputListener(OutputListener listener) override {
+    m_outputListener = std::move(listener);
+  }
+
+  uint32_t GetProcessId() const override { return m_processId; }
 
 private:
   std::string ReadFromPipe(HANDLE pipe) {
@@ -177,11 +323,19 @@ private:
   DWORD m_processId;
   SandboxConfig m_config;
   uint64_t m_startTime;
+  OutputListener m_outputListener;
+  bool m_outputEnded = false;
 };
 
 // ToolchainManager implementation
 ToolchainManager::ToolchainManager()
-    : m_ui(nullptr), m_initialized(false), m_nextProcessId(1) {}
+    : m_ui(nullptr), m_diagnostics(std::make_shared<DiagnosticSink>()),
+      m_warmPool(std::make_unique<WarmProcessPool>(
+          [](const WarmServerSpec &spec) -> std::unique_ptr<SandboxProcess> {
+            return std::make_unique<WindowsSandboxProcess>(
+                spec.executablePath, spec.arguments, spec.config);
+          })),
+      m_initialized(false), m_nextProcessId(1) {}
 
 ToolchainManager::~ToolchainManager() { Shutdown(); }
 
@@ -195,13 +349,15 @@ bool ToolchainManager::Initialize() {
   // Set default config path
   m_configPath = "toolchain_config.json";
 
-  // Detect system toolchains
-  DetectSystemToolchains();
-
-  // Load configuration if it exists
-  if (std::filesystem::exists(m_configPath)) {
-    LoadConfiguration(m_configPath);
+  // Restore the persisted registry; only fall back to probing the system
+  // when there is no usable configuration, since detection spawns a shell
+  // per candidate tool
+  if (!LoadConfiguration(m_configPath) || m_toolchains.empty()) {
+    DetectSystemToolchains();
   }
+  RegisterDefaultWarmServers();
+
+  m_resourceSampler.Start();
 
   m_initialized = true;
   std::cout << "Toolchain Manager initialized successfully" << std::endl;
@@ -222,9 +378,12 @@ void ToolchainManager::Shutdown() {
     }
   }
   m_activeProcesses.clear();
+  m_warmPool->Shutdown();
+  m_resourceSampler.Stop();
 
   // Save configuration
   SaveConfiguration();
+  FlushCompilationDatabase();
 
   m_initialized = false;
   std::cout << "Toolchain Manager shutdown complete" << std::endl;
@@ -256,6 +415,7 @@ bool ToolchainManager::UnregisterToolchain(const std::string &toolchainId) {
 
   std::string name = it->second.name;
   m_toolchains.erase(it);
+  m_warmPool->Unregister(toolchainId);
 
   if (m_onToolchainUnregistered) {
     m_onToolchainUnregistered(toolchainId, name);
@@ -296,6 +456,8 @@ std::unique_ptr<SandboxProcess> ToolchainManager::CreateSandboxProcess(
 
   auto process = std::make_unique<WindowsSandboxProcess>(
       toolchain->executablePath, arguments, config);
+  RecordCompileInvocation(toolchain->executablePath, arguments, config);
+  TrackResources(*process, toolchain->name);
   return process;
 }
 
@@ -338,6 +500,14 @@ bool ToolchainManager::OpenProject(const std::string &path) {
   CloseProject();
   m_currentProjectPath = path;
 
+  // Start from the database left by previous sessions so code intelligence
+  // has correct flags before the first build
+  m_compileDb.Clear();
+  m_compileDb.LoadFromFile(
+      (std::filesystem::path(path) / "compile_commands.json").string());
+  m_exportedDbWriteTime = {};
+  ImportExportedCompilationDatabase();
+
   if (m_onProjectOpened) {
     m_onProjectOpened(path, "");
   }
@@ -348,6 +518,7 @@ bool ToolchainManager::OpenProject(const std::string &path) {
 
 bool ToolchainManager::CloseProject() {
   if (!m_currentProjectPath.empty()) {
+    FlushCompilationDatabase();
     if (m_onProjectClosed) {
       m_onProjectClosed(m_currentProjectPath, "");
     }
@@ -366,7 +537,12 @@ ToolchainManager::BuildProject(const SandboxConfig &config) {
   // This is a simplified build - in reality, you'd parse the project file
   // and determine the appropriate build command based on the toolchain
   std::vector<std::string> args = {"build", m_currentProjectPath};
-  return ExecuteCommand("cmake", args, config);
+  ClearDiagnostics();
+  auto process = ExecuteCommand("cmake", args, config);
+  if (process) {
+    WatchDiagnostics(*process);
+  }
+  return process;
 }
 
 std::unique_ptr<SandboxProcess>
@@ -392,40 +568,173 @@ ToolchainManager::ExecuteCommand(const std::string &command,
 
   auto process =
       std::make_unique<WindowsSandboxProcess>(command, arguments, config);
+  RecordCompileInvocation(command, arguments, config);
+  TrackResources(*process, std::filesystem::path(command).filename().string());
   return process;
 }
 
-bool ToolchainManager::SaveConfiguration(const std::string &path) {
-  std::string configPath = path.empty() ? m_configPath : path;
-
-  std::ofstream file(configPath);
-  if (!file.is_open()) {
+bool ToolchainManager::RegisterWarmServer(const WarmServerSpec &spec) {
+  auto *toolchain = GetToolchain(spec.toolchainId);
+  if (!toolchain || spec.poolSize == 0 ||
+      !ValidateSandboxConfig(spec.config)) {
     return false;
   }
 
-  // Simple JSON-like format for configuration
-  file << "{\n";
-  file << "  \"toolchains\": [\n";
+  WarmServerSpec resolved = spec;
+  resolved.executablePath = toolchain->executablePath;
+  m_warmPool->Register(resolved);
+  return true;
+}
 
-  bool first = true;
-  for (const auto &pair : m_toolchains) {
-    if (!first)
-      file << ",\n";
-    first = false;
+std::unique_ptr<SandboxProcess>
+ToolchainManager::AcquireWarmProcess(const std::string &toolchainId) {
+  if (auto process = m_warmPool->Acquire(toolchainId)) {
+    return process;
+  }
+
+  // Miss: cold-start with the same arguments so callers see no difference
+  WarmServerSpec spec;
+  if (!m_warmPool->GetSpec(toolchainId, spec)) {
+    return nullptr;
+  }
+  return CreateSandboxProcess(toolchainId, spec.arguments, spec.config);
+}
+
+void ToolchainManager::ReleaseWarmProcess(
+    const std::string &toolchainId, std::unique_ptr<SandboxProcess> process) {
+  m_warmPool->Release(toolchainId, std::move(process));
+}
+
+std::unique_ptr<SandboxProcess>
+ToolchainManager::RunFile(const std::string &path,
+                          const std::string &toolchainId) {
+  auto *toolchain = GetToolchain(toolchainId);
+  if (!toolchain) {
+    return nullptr;
+  }
 
-    const auto &tc = pair.second;
-    file << "    {\n";
-    file << "      \"id\": \"" << tc.id << "\",\n";
-    file << "      \"name\": \"" << tc.name << "\",\n";
-    file << "      \"version\": \"" << tc.version << "\",\n";
-    file << "      \"description\": \"" << tc.description << "\",\n";
-    file << "      \"executablePath\": \"" << tc.executablePath << "\"\n";
-    file << "    }";
+  // Warm interpreters wait for the script's path on their first stdin line;
+  // the rest of stdin is left to the script
+  WarmServerSpec spec;
+  if (m_warmPool->GetSpec(toolchainId, spec) && spec.scriptLauncher &&
+      path.find_first_of("\r\n") == std::string::npos) {
+    if (auto process = AcquireWarmProcess(toolchainId)) {
+      // Pre-spawned processes are only tracked once they are put to work
+      TrackResources(*process, std::filesystem::path(path).filename().string());
+      process->SendInput(path + "\n");
+      return process;
+    }
   }
 
-  file << "\n  ]\n";
-  file << "}\n";
-  file.close();
+  return CreateSandboxProcess(toolchainId, {path}, toolchain->defaultSandbox);
+}
+
+void ToolchainManager::RegisterDefaultWarmServers() {
+  // Launchers that run the script named on the first stdin line the way a
+  // cold "python <path>" or "node <path>" would: argv, __file__, the
+  // script's directory on the import path and relative requires all refer
+  // to the script, and stdin stays open for it. Single quotes only, since
+  // arguments are passed double-quoted on the command line.
+  const std::pair<const char *, std::vector<std::string>> kDefaults[] = {
+      {"python",
+       {"-u", "-c",
+        "import os,runpy,sys;"
+        "p=sys.stdin.readline().rstrip('\\r\\n');"
+        "sys.argv=[p];"
+        "sys.path[0]=os.path.dirname(os.path.abspath(p));"
+        "runpy.run_path(p,run_name='__main__')"}},
+      {"node",
+       {"-e",
+        "const fs=require('fs'),b=Buffer.alloc(1),a=[];"
+        "for(;;){let n;"
+        "try{n=fs.readSync(0,b,0,1,null)}"
+        "catch(e){if(e.code==='EAGAIN')continue;throw e}"
+        "if(n!==1||b[0]===10)break;a.push(b[0])}"
+        "process.argv[1]=require('path').resolve("
+        "Buffer.from(a).toString().replace(/\\r$/,''));"
+        "require('module').runMain()"}},
+  };
+
+  for (const auto &entry : kDefaults) {
+    auto *toolchain = GetToolchain(entry.first);
+    if (!toolchain) {
+      continue;
+    }
+    WarmServerSpec spec;
+    spec.toolchainId = entry.first;
+    spec.arguments = entry.second;
+    // Same sandbox and working directory as a cold run
+    spec.config = toolchain->defaultSandbox;
+    spec.scriptLauncher = true;
+    RegisterWarmServer(spec);
+  }
+}
+
+void ToolchainManager::WatchDiagnostics(SandboxProcess &process) {
+  // stdout and stderr interleave independently, so each gets its own line
+  // buffer while sharing the de-duplicating sink
+  struct StreamParsers {
+    explicit StreamParsers(const std::shared_ptr<DiagnosticSink> &sink)
+        : out(sink), err(sink) {}
+    DiagnosticParser out;
+    DiagnosticParser err;
+  };
+  auto parsers = std::make_shared<StreamParsers>(m_diagnostics);
+
+  process.SetOutputListener(
+      [parsers](const std::string &chunk, bool isError) {
+        DiagnosticParser &parser = isError ? parsers->err : parsers->out;
+        // The end of the stream completes a last line without a newline
+        if (chunk.empty()) {
+          parser.Flush();
+        } else {
+          parser.Feed(chunk);
+        }
+      });
+}
+
+std::vector<BuildDiagnostic> ToolchainManager::GetDiagnostics() const {
+  return m_diagnostics->GetDiagnostics();
+}
+
+void ToolchainManager::ClearDiagnostics() { m_diagnostics->Reset(); }
+
+bool ToolchainManager::SaveConfiguration(const std::string &path) {
+  std::string configPath = path.empty() ? m_configPath : path;
+  if (configPath.empty()) {
+    return false;
+  }
+
+  // Sort by id so the file is stable across runs
+  std::vector<const ToolchainInfo *> toolchains;
+  toolchains.reserve(m_toolchains.size());
+  for (const auto &pair : m_toolchains) {
+    toolchains.push_back(&pair.second);
+  }
+  std::sort(toolchains.begin(), toolchains.end(),
+            [](const ToolchainInfo *a, const ToolchainInfo *b) {
+              return a->id < b->id;
+            });
+
+  std::string contents;
+  JsonWriter writer(contents);
+  writer.BeginObject();
+  writer.Key("schemaVersion");
+  writer.UInt(kConfigSchemaVersion);
+  writer.Key("toolchains");
+  writer.BeginArray();
+  for (const auto *tc : toolchains) {
+    WriteToolchainInfo(writer, *tc);
+  }
+  writer.EndArray();
+  writer.EndObject();
+  contents += '\n';
+
+  if (!WriteFileAtomically(configPath, contents)) {
+    std::cerr << "Failed to save configuration to: " << configPath
+              << std::endl;
+    return false;
+  }
 
   std::cout << "Configuration saved to: " << configPath << std::endl;
   return true;
@@ -434,18 +743,110 @@ bool ToolchainManager::SaveConfiguration(const std::string &path) {
 bool ToolchainManager::LoadConfiguration(const std::string &path) {
   std::string configPath = path.empty() ? m_configPath : path;
 
-  if (!std::filesystem::exists(configPath)) {
+  std::string contents;
+  if (configPath.empty() || !ReadFileToString(configPath, contents)) {
+    return false;
+  }
+
+  JsonValue root;
+  std::string error;
+  if (!ParseJson(contents, root, &error) || !root.IsObject()) {
+    std::cerr << "Invalid configuration file " << configPath << ": " << error
+              << std::endl;
+    return false;
+  }
+
+  uint64_t schemaVersion = root.GetUInt("schemaVersion");
+  if (schemaVersion != kConfigSchemaVersion) {
+    std::cerr << "Ignoring configuration with schema version "
+              << schemaVersion << " (expected " << kConfigSchemaVersion << ")"
+              << std::endl;
+    return false;
+  }
+
+  const JsonValue *toolchains = root.Find("toolchains");
+  if (!toolchains || !toolchains->IsArray()) {
     return false;
   }
 
-  // This is a simplified loader - in a real implementation,
-  // you'd use a proper JSON parser
+  for (const auto &entry : toolchains->AsArray()) {
+    ToolchainInfo info;
+    if (ReadToolchainInfo(entry, info)) {
+      RegisterToolchain(info);
+    }
+  }
+
   std::cout << "Configuration loaded from: " << configPath << std::endl;
   return true;
 }
 
+void ToolchainManager::RecordCompileInvocation(
+    const std::string &command, const std::vector<std::string> &arguments,
+    const SandboxConfig &config) {
+  std::string directory = config.workingDirectory;
+  if (directory.empty()) {
+    directory = m_currentProjectPath.empty()
+                    ? std::filesystem::current_path().string()
+                    : m_currentProjectPath;
+  }
+  m_compileDb.RecordInvocation(directory, command, arguments);
+}
+
+void ToolchainManager::ImportExportedCompilationDatabase() {
+  if (m_currentProjectPath.empty()) {
+    return;
+  }
+
+  // Pick up CMAKE_EXPORT_COMPILE_COMMANDS output whenever CMake rewrites it
+  std::filesystem::path exported = std::filesystem::path(m_currentProjectPath) /
+                                   "build" / "compile_commands.json";
+  std::error_code ec;
+  auto writeTime = std::filesystem::last_write_time(exported, ec);
+  if (ec || writeTime == m_exportedDbWriteTime) {
+    return;
+  }
+  if (m_compileDb.LoadFromFile(exported.string())) {
+    m_exportedDbWriteTime = writeTime;
+  }
+}
+
+bool ToolchainManager::FlushCompilationDatabase() {
+  if (!m_compileDb.IsDirty() || m_currentProjectPath.empty()) {
+    return false;
+  }
+  return m_compileDb.SaveToFile(
+      (std::filesystem::path(m_currentProjectPath) / "compile_commands.json")
+          .string());
+}
+
+bool ToolchainManager::GetResourceSeries(const std::string &jobId,
+                                         JobResourceSeries &series) const {
+  return m_resourceSampler.GetSeries(jobId, series);
+}
+
+std::vector<JobResourceSeries> ToolchainManager::GetResourceUsage() const {
+  return m_resourceSampler.GetSummaries();
+}
+
+void ToolchainManager::TrackResources(SandboxProcess &process,
+                                      const std::string &label) {
+  if (!process.GetJobId().empty()) {
+    return;
+  }
+  process.SetJobId(GenerateProcessId());
+  m_resourceSampler.Track(process.GetJobId(), process.GetProcessId(), label);
+}
+
 void ToolchainManager::Update() {
   CleanupFinishedProcesses();
+  m_warmPool->Update();
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - m_lastExportCheck > std::chrono::seconds(1)) {
+    m_lastExportCheck = now;
+    ImportExportedCompilationDatabase();
+  }
+  FlushCompilationDatabase();
 
   // Update UI if available
   if (m_ui) {
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "compiledb.hpp"
+#include "diagnosticparser.hpp"
+#include "resourcesampler.hpp"
+#include <chrono>
+#include <filesystem>
 #include <functional>
 #include <memory>
 #include <string>
@@ -11,6 +16,8 @@ namespace Toolchain {
 
 // Forward declarations
 class WindowedUI;
+class WarmProcessPool;
+struct WarmServerSpec;
 
 // Sandbox environment configuration
 struct SandboxConfig {
@@ -42,7 +49,8 @@ struct ExecutionResult {
   std::string stdoutData;
   std::string stderrData;
   uint64_t executionTime = 0; // milliseconds
-  uint64_t memoryUsed = 0;    // bytes
+  uint64_t memoryUsed = 0;    // peak working set, bytes
+  uint64_t cpuTime = 0;       // user + kernel, milliseconds
   bool timedOut = false;
   bool memoryExceeded = false;
 };
@@ -50,6 +58,12 @@ struct ExecutionResult {
 // Sandbox process handle
 class SandboxProcess {
 public:
+  // Receives every chunk read from the process pipes (isError = stderr).
+  // Once the process has exited and its pipes are drained, each stream ends
+  // with an empty chunk.
+  using OutputListener =
+      std::function<void(const std::string &chunk, bool isError)>;
+
   virtual ~SandboxProcess() = default;
   virtual bool IsRunning() const = 0;
   virtual void Terminate() = 0;
@@ -57,6 +71,16 @@ public:
   virtual void SendInput(const std::string &input) = 0;
   virtual std::string ReadOutput() = 0;
   virtual std::string ReadError() = 0;
+  virtual void CloseInput() {}
+  virtual void SetOutputListener(OutputListener /*listener*/) {}
+  virtual uint32_t GetProcessId() const { return 0; }
+
+  // Key under which the resource sampler records this process
+  void SetJobId(const std::string &jobId) { m_jobId = jobId; }
+  const std::string &GetJobId() const { return m_jobId; }
+
+protected:
+  std::string m_jobId;
 };
 
 // Main toolchain manager class
@@ -101,6 +125,34 @@ public:
                  const std::vector<std::string> &arguments,
                  const SandboxConfig &config = {});
 
+  // Warm worker processes: pre-spawned interpreters/daemons per toolchain
+  bool RegisterWarmServer(const WarmServerSpec &spec);
+  std::unique_ptr<SandboxProcess>
+  AcquireWarmProcess(const std::string &toolchainId);
+  void ReleaseWarmProcess(const std::string &toolchainId,
+                          std::unique_ptr<SandboxProcess> process);
+  // Runs a script through the toolchain's warm interpreter when available
+  std::unique_ptr<SandboxProcess> RunFile(const std::string &path,
+                                          const std::string &toolchainId);
+
+  // Build diagnostics parsed from compiler output as it streams in
+  void WatchDiagnostics(SandboxProcess &process);
+  std::vector<BuildDiagnostic> GetDiagnostics() const;
+  void ClearDiagnostics();
+
+  // Compilation database captured from compiler invocations, persisted as
+  // <project>/compile_commands.json for the language server
+  const CompilationDatabase &GetCompilationDatabase() const {
+    return m_compileDb;
+  }
+  bool FlushCompilationDatabase();
+
+  // Resource usage sampled while sandbox processes run; finished jobs stay
+  // available until pruned
+  bool GetResourceSeries(const std::string &jobId,
+                         JobResourceSeries &series) const;
+  std::vector<JobResourceSeries> GetResourceUsage() const;
+
   // Configuration
   bool SaveConfiguration(const std::string &path = "");
   bool LoadConfiguration(const std::string &path = "");
@@ -120,6 +172,9 @@ public:
   void SetOnProjectClosed(ToolchainEventCallback callback) {
     m_onProjectClosed = callback;
   }
+  void SetOnDiagnostic(DiagnosticSink::DiagnosticCallback callback) {
+    m_diagnostics->SetCallback(callback);
+  }
 
   // Update loop
   void Update();
@@ -130,6 +185,12 @@ private:
   bool ValidateSandboxConfig(const SandboxConfig &config);
   std::string GenerateProcessId();
   void CleanupFinishedProcesses();
+  void RecordCompileInvocation(const std::string &command,
+                               const std::vector<std::string> &arguments,
+                               const SandboxConfig &config);
+  void ImportExportedCompilationDatabase();
+  void RegisterDefaultWarmServers();
+  void TrackResources(SandboxProcess &process, const std::string &label);
 
   // Member variables
   WindowedUI *m_ui;
@@ -137,6 +198,14 @@ private:
   std::vector<std::unique_ptr<SandboxProcess>> m_activeProcesses;
   std::string m_currentProjectPath;
   std::string m_configPath;
+  std::shared_ptr<DiagnosticSink> m_diagnostics;
+  std::unique_ptr<WarmProcessPool> m_warmPool;
+  ResourceSampler m_resourceSampler;
+
+  // Compilation database state
+  CompilationDatabase m_compileDb;
+  std::filesystem::file_time_type m_exportedDbWriteTime;
+  std::chrono::steady_clock::time_point m_lastExportCheck;
 
   // Event callbacks
   ToolchainEventCallback m_onToolchainRegistered;
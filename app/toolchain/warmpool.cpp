@@ -0,0 +1,232 @@
+#include "warmpool.hpp"
+#include <iostream>
+
+namespace Hyperion {
+namespace Toolchain {
+
+WarmProcessPool::WarmProcessPool(SpawnFunction spawn)
+    : m_spawn(std::move(spawn)) {
+  m_refillThread = std::thread(&WarmProcessPool::RefillThread, this);
+}
+
+WarmProcessPool::~WarmProcessPool() { Shutdown(); }
+
+void WarmProcessPool::Register(const WarmServerSpec &spec) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Pool &pool = m_pools[spec.toolchainId];
+    pool.spec = spec;
+    pool.active = true;
+    pool.lastUsed = std::chrono::steady_clock::now();
+  }
+  m_refillCondition.notify_one();
+}
+
+void WarmProcessPool::Unregister(const std::string &toolchainId) {
+  std::deque<std::unique_ptr<SandboxProcess>> retired;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pools.find(toolchainId);
+    if (it == m_pools.end()) {
+      return;
+    }
+    retired.swap(it->second.idle);
+    m_pools.erase(it);
+  }
+  for (auto &process : retired) {
+    process->Terminate();
+  }
+}
+
+bool WarmProcessPool::HasSpec(const std::string &toolchainId) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pools.count(toolchainId) != 0;
+}
+
+bool WarmProcessPool::GetSpec(const std::string &toolchainId,
+                              WarmServerSpec &spec) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_pools.find(toolchainId);
+  if (it == m_pools.end()) {
+    return false;
+  }
+  spec = it->second.spec;
+  return true;
+}
+
+std::unique_ptr<SandboxProcess>
+WarmProcessPool::Acquire(const std::string &toolchainId) {
+  std::unique_ptr<SandboxProcess> process;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pools.find(toolchainId);
+    if (it == m_pools.end()) {
+      return nullptr;
+    }
+
+    Pool &pool = it->second;
+    pool.lastUsed = std::chrono::steady_clock::now();
+    pool.active = true;
+
+    // Skip entries that died while idle
+    while (!pool.idle.empty() && !process) {
+      process = std::move(pool.idle.front());
+      pool.idle.pop_front();
+      if (!process->IsRunning()) {
+        process.reset();
+        ++m_stats.evicted;
+      }
+    }
+
+    if (process) {
+      ++m_stats.hits;
+    } else {
+      ++m_stats.misses;
+    }
+  }
+
+  // Replace what was taken (or warm up after a miss) in the background
+  m_refillCondition.notify_one();
+  return process;
+}
+
+void WarmProcessPool::Release(const std::string &toolchainId,
+                              std::unique_ptr<SandboxProcess> process) {
+  if (!process) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pools.find(toolchainId);
+    if (it != m_pools.end() && it->second.spec.reusable &&
+        process->IsRunning() &&
+        it->second.idle.size() < it->second.spec.poolSize) {
+      it->second.idle.push_back(std::move(process));
+      return;
+    }
+  }
+
+  // Not reusable or not needed: discard outside the lock
+  process->Terminate();
+}
+
+void WarmProcessPool::Update() {
+  std::vector<std::unique_ptr<SandboxProcess>> retired;
+  auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &pair : m_pools) {
+      Pool &pool = pair.second;
+
+      // Health check: drop processes that exited on their own
+      for (auto it = pool.idle.begin(); it != pool.idle.end();) {
+        if (!(*it)->IsRunning()) {
+          it = pool.idle.erase(it);
+          ++m_stats.evicted;
+        } else {
+          ++it;
+        }
+      }
+
+      // Stop keeping a toolchain warm once nobody has used it for a while
+      if (pool.active && pool.spec.idleTimeoutSeconds > 0 &&
+          now - pool.lastUsed >
+              std::chrono::seconds(pool.spec.idleTimeoutSeconds)) {
+        pool.active = false;
+        m_stats.evicted += pool.idle.size();
+        for (auto &process : pool.idle) {
+          retired.push_back(std::move(process));
+        }
+        pool.idle.clear();
+      }
+    }
+  }
+
+  for (auto &process : retired) {
+    process->Terminate();
+  }
+  m_refillCondition.notify_one();
+}
+
+void WarmProcessPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopping) {
+      return;
+    }
+    m_stopping = true;
+  }
+  m_refillCondition.notify_all();
+  if (m_refillThread.joinable()) {
+    m_refillThread.join();
+  }
+
+  for (auto &pair : m_pools) {
+    for (auto &process : pair.second.idle) {
+      process->Terminate();
+    }
+  }
+  m_pools.clear();
+}
+
+WarmProcessPool::Stats WarmProcessPool::GetStats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+bool WarmProcessPool::NeedsRefill(const Pool &pool) const {
+  return pool.active && pool.idle.size() + pool.spawning < pool.spec.poolSize;
+}
+
+void WarmProcessPool::RefillThread() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stopping) {
+    // Find one pool that is below its target size
+    std::string toolchainId;
+    WarmServerSpec spec;
+    for (auto &pair : m_pools) {
+      if (NeedsRefill(pair.second)) {
+        toolchainId = pair.first;
+        spec = pair.second.spec;
+        ++pair.second.spawning;
+        break;
+      }
+    }
+
+    if (toolchainId.empty()) {
+      m_refillCondition.wait(lock);
+      continue;
+    }
+
+    // Process creation is the expensive part; keep it outside the lock
+    lock.unlock();
+    std::unique_ptr<SandboxProcess> process = m_spawn(spec);
+    lock.lock();
+
+    auto it = m_pools.find(toolchainId);
+    if (it == m_pools.end()) {
+      if (process) {
+        process->Terminate();
+      }
+      continue;
+    }
+
+    Pool &pool = it->second;
+    if (pool.spawning > 0) {
+      --pool.spawning;
+    }
+    if (process && process->IsRunning()) {
+      ++m_stats.spawned;
+      pool.idle.push_back(std::move(process));
+    } else {
+      // Don't spin on a toolchain that fails to start
+      std::cerr << "Failed to pre-spawn worker for " << toolchainId
+                << std::endl;
+      pool.active = false;
+    }
+  }
+}
+
+} // namespace Toolchain
+} // namespace Hyperion
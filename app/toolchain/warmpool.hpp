@@ -0,0 +1,89 @@
+#pragma once
+
+#include "toolchain.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Hyperion {
+namespace Toolchain {
+
+// Describes a process kept pre-spawned for a toolchain
+struct WarmServerSpec {
+  std::string toolchainId;
+  std::string executablePath; // filled from the toolchain on registration
+  std::vector<std::string> arguments;
+  SandboxConfig config;
+  size_t poolSize = 1;              // processes kept warm
+  uint32_t idleTimeoutSeconds = 300; // stop keeping warm after this long unused
+  // Daemons that accept multiple requests over stdin can be handed back with
+  // Release(); one-shot interpreters are consumed by each run
+  bool reusable = false;
+  // A launcher that reads one line with a script path from stdin and runs
+  // that script as if started with it; ToolchainManager::RunFile uses these
+  bool scriptLauncher = false;
+};
+
+// Keeps pre-spawned worker processes per toolchain so a run only pays for
+// handing input to an already started interpreter or daemon. Spawning
+// happens on a background thread; Acquire() never blocks on process start.
+class WarmProcessPool {
+public:
+  using SpawnFunction =
+      std::function<std::unique_ptr<SandboxProcess>(const WarmServerSpec &)>;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t spawned = 0;
+    uint64_t evicted = 0; // died, failed health check or idled out
+  };
+
+  explicit WarmProcessPool(SpawnFunction spawn);
+  ~WarmProcessPool();
+
+  void Register(const WarmServerSpec &spec);
+  void Unregister(const std::string &toolchainId);
+  bool HasSpec(const std::string &toolchainId) const;
+  bool GetSpec(const std::string &toolchainId, WarmServerSpec &spec) const;
+
+  // Returns a warm process, or nullptr on a miss (the caller cold-starts)
+  std::unique_ptr<SandboxProcess> Acquire(const std::string &toolchainId);
+
+  // Hands a reusable daemon back to the pool; dead or one-shot processes
+  // are discarded
+  void Release(const std::string &toolchainId,
+               std::unique_ptr<SandboxProcess> process);
+
+  // Health checks and idle eviction; call periodically
+  void Update();
+
+  void Shutdown();
+  Stats GetStats() const;
+
+private:
+  struct Pool {
+    WarmServerSpec spec;
+    std::deque<std::unique_ptr<SandboxProcess>> idle;
+    size_t spawning = 0;
+    bool active = true; // false once idled out, until the next Acquire
+    std::chrono::steady_clock::time_point lastUsed;
+  };
+
+  void RefillThread();
+  bool NeedsRefill(const Pool &pool) const;
+
+  SpawnFunction m_spawn;
+  std::unordered_map<std::string, Pool> m_pools;
+  Stats m_stats;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_refillCondition;
+  std::thread m_refillThread;
+  bool m_stopping = false;
+};
+
+} // namespace Toolchain
+} // namespace Hyperion
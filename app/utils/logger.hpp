@@ -23,4 +23,12 @@ public:
     static void LogMessage(const std::string& message);
     static void Initialize();
     static void Shutdown();
-};
\ No newline at end of file
+};
+
+// Debug output for hot paths: in release builds the message expression is
+// not even evaluated
+#ifndef NDEBUG
+#define LOG_DEBUG(message) Logger::Debug(message)
+#else
+#define LOG_DEBUG(message) ((void)0)
+#endif
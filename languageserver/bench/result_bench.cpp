@@ -0,0 +1,135 @@
+// Compares the C API result paths: owned JSON strings (lsp_completion +
+// lsp_free_string) against arena views in JSON and binary encoding.
+//
+// Usage: result_bench [iterations] [functions]
+// Generates a source file whose diagnostics and completion list are large,
+// waits for the first analysis and then times each path on the same data.
+
+#include "lsp_wrapper.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace miko::lsp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Result {
+    double microseconds = 0.0;
+    size_t bytes = 0;
+};
+
+template <typename Call>
+Result measure(int iterations, Call&& call) {
+    Result result;
+    // Warm up caches and let the arena reach its working size
+    for (int i = 0; i < 10; ++i) result.bytes = call();
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        result.bytes = call();
+    }
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    result.microseconds = elapsed.count() / iterations;
+    return result;
+}
+
+void report(const char* name, const Result& result, const Result& baseline) {
+    std::printf("  %-22s %10.2f us/op %10zu bytes  %6.2fx\n", name, result.microseconds, result.bytes,
+                baseline.microseconds / result.microseconds);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int functions = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "miko_result_bench";
+    std::filesystem::create_directories(root);
+    std::filesystem::path file = root / "bench.cpp";
+
+    // Every function produces an "equality comparison result unused"
+    // warning and a completion candidate
+    std::string text;
+    for (int i = 0; i < functions; ++i) {
+        text += "void function" + std::to_string(i) + "(int value) { value == " + std::to_string(i) + "; }\n";
+    }
+    text += "int main() {\n    \n}\n";
+    int completionLine = functions + 1;
+    std::ofstream(file) << text;
+
+    std::string uri = "file://" + file.generic_string();
+    LSPServer* server = lsp_create_server();
+    if (!lsp_initialize(server, root.string().c_str()) || !lsp_did_open(server, uri.c_str(), "cpp", text.c_str())) {
+        std::fprintf(stderr, "failed to open %s\n", file.string().c_str());
+        return 1;
+    }
+
+    // Wait for the first diagnostics pass
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(120);
+    size_t count = 0;
+    while (Clock::now() < deadline) {
+        char* json = lsp_diagnostics(server, uri.c_str());
+        count = json && std::strcmp(json, "[]") != 0;
+        lsp_free_string(json);
+        if (count) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    if (!count) {
+        std::fprintf(stderr, "no diagnostics produced\n");
+        return 1;
+    }
+
+    std::printf("%d iterations, %d functions\n\n", iterations, functions);
+
+    std::printf("diagnostics\n");
+    Result owned = measure(iterations, [&] {
+        char* json = lsp_diagnostics(server, uri.c_str());
+        size_t size = std::strlen(json);
+        lsp_free_string(json);
+        return size;
+    });
+    report("owned string", owned, owned);
+    report("view (json)", measure(iterations, [&] {
+        size_t size = 0;
+        lsp_diagnostics_view(server, uri.c_str(), LSP_RESULT_JSON, &size);
+        return size;
+    }), owned);
+    report("view (binary)", measure(iterations, [&] {
+        size_t size = 0;
+        lsp_diagnostics_view(server, uri.c_str(), LSP_RESULT_BINARY, &size);
+        return size;
+    }), owned);
+
+    // The first request parses; the timed ones are served from the
+    // completion cache, so the result path dominates
+    std::printf("\ncompletion\n");
+    owned = measure(iterations, [&] {
+        char* json = lsp_completion(server, uri.c_str(), completionLine, 4);
+        size_t size = std::strlen(json);
+        lsp_free_string(json);
+        return size;
+    });
+    report("owned string", owned, owned);
+    report("view (json)", measure(iterations, [&] {
+        size_t size = 0;
+        lsp_completion_view(server, uri.c_str(), completionLine, 4, LSP_RESULT_JSON, &size);
+        return size;
+    }), owned);
+    report("view (binary)", measure(iterations, [&] {
+        size_t size = 0;
+        lsp_completion_view(server, uri.c_str(), completionLine, 4, LSP_RESULT_BINARY, &size);
+        return size;
+    }), owned);
+
+    lsp_shutdown(server);
+    lsp_destroy_server(server);
+    return 0;
+}
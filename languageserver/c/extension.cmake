@@ -0,0 +1,116 @@
+# C extension manifest and project templates, installed next to the shared
+# LSP wrapper. Included from the languageserver CMakeLists.txt.
+set(C_LSP_OUTPUT_DIR "${CMAKE_BINARY_DIR}/c")
+
+# Create C LSP extension configuration
+set(C_LSP_CONFIG_FILE "${C_LSP_OUTPUT_DIR}/c_lsp_config.json")
+file(WRITE ${C_LSP_CONFIG_FILE} "{
+  \"name\": \"miko-c-lsp\",
+  \"version\": \"1.0.0\",
+  \"description\": \"C Language Server Protocol extension for Miko IDE\",
+  \"language\": \"c\",
+  \"server\": {
+    \"executable\": \"${CLANGD_EXECUTABLE}\",
+    \"args\": [
+      \"--background-index\",
+      \"--clang-tidy\",
+      \"--completion-style=detailed\",
+      \"--header-insertion=iwyu\",
+      \"--pch-storage=memory\",
+      \"--log=error\"
+    ],
+    \"initializationOptions\": {
+      \"clangdFileStatus\": true,
+      \"usePlaceholders\": true,
+      \"completeUnimported\": true,
+      \"semanticHighlighting\": true
+    }
+  },
+  \"fileExtensions\": [\"c\", \"h\"],
+  \"capabilities\": {
+    \"textDocumentSync\": 2,
+    \"completionProvider\": {
+      \"resolveProvider\": true,
+      \"triggerCharacters\": [\".\", \"->\", \":\", \"<\"]
+    },
+    \"hoverProvider\": true,
+    \"signatureHelpProvider\": {
+      \"triggerCharacters\": [\"(\", \",\"]
+    },
+    \"definitionProvider\": true,
+    \"referencesProvider\": true,
+    \"documentHighlightProvider\": true,
+    \"documentSymbolProvider\": true,
+    \"workspaceSymbolProvider\": true,
+    \"codeActionProvider\": true,
+    \"documentFormattingProvider\": true,
+    \"documentRangeFormattingProvider\": true,
+    \"renameProvider\": true,
+    \"foldingRangeProvider\": true,
+    \"semanticTokensProvider\": {
+      \"legend\": {
+        \"tokenTypes\": [\"namespace\", \"type\", \"class\", \"enum\", \"interface\", \"struct\", \"typeParameter\", \"parameter\", \"variable\", \"property\", \"enumMember\", \"event\", \"function\", \"method\", \"macro\", \"keyword\", \"modifier\", \"comment\", \"string\", \"number\", \"regexp\", \"operator\"],
+        \"tokenModifiers\": [\"declaration\", \"definition\", \"readonly\", \"static\", \"deprecated\", \"abstract\", \"async\", \"modification\", \"documentation\", \"defaultLibrary\"]
+      },
+      \"range\": true,
+      \"full\": {
+        \"delta\": true
+      }
+    }
+  }
+}")
+
+# Install configuration file
+install(FILES ${C_LSP_CONFIG_FILE} DESTINATION extensions/lsp/c/)
+
+# Create compile_commands.json template
+set(C_COMPILE_COMMANDS_TEMPLATE "${C_LSP_OUTPUT_DIR}/compile_commands_template.json")
+file(WRITE ${C_COMPILE_COMMANDS_TEMPLATE} "[
+  {
+    \"directory\": \"/path/to/project\",
+    \"command\": \"clang -I/usr/include -std=c11 -Wall -Wextra -c file.c\",
+    \"file\": \"file.c\"
+  }
+]")
+
+install(FILES ${C_COMPILE_COMMANDS_TEMPLATE} DESTINATION extensions/lsp/c/)
+
+# Create .clangd configuration template
+set(C_CLANGD_CONFIG_TEMPLATE "${C_LSP_OUTPUT_DIR}/clangd_config.yaml")
+file(WRITE ${C_CLANGD_CONFIG_TEMPLATE} "CompileFlags:
+  Add:
+    - -std=c11
+    - -Wall
+    - -Wextra
+    - -Wpedantic
+  Remove:
+    - -W*
+    - -f*
+
+Index:
+  Background: Build
+  StandardLibrary: Yes
+
+Completion:
+  AllScopes: Yes
+
+Hover:
+  ShowAKA: Yes
+
+InlayHints:
+  Enabled: Yes
+  ParameterNames: Yes
+  DeducedTypes: Yes
+
+Diagnostics:
+  ClangTidy:
+    Add:
+      - readability-*
+      - performance-*
+      - modernize-*
+      - bugprone-*
+    Remove:
+      - modernize-use-trailing-return-type
+")
+
+install(FILES ${C_CLANGD_CONFIG_TEMPLATE} DESTINATION extensions/lsp/c/)
@@ -0,0 +1,14 @@
+# C++ extension manifest and project templates, configured from cpp/config
+# when present. Included from the languageserver CMakeLists.txt.
+set(CPP_LSP_OUTPUT_DIR "${CMAKE_BINARY_DIR}/cpp")
+
+foreach(template cpp_lsp_config.json clangd_config.yaml compile_commands_template.json)
+    if(EXISTS "${CMAKE_CURRENT_LIST_DIR}/config/${template}.in")
+        configure_file(
+            "${CMAKE_CURRENT_LIST_DIR}/config/${template}.in"
+            "${CPP_LSP_OUTPUT_DIR}/${template}"
+            @ONLY
+        )
+        install(FILES "${CPP_LSP_OUTPUT_DIR}/${template}" DESTINATION extensions/lsp/cpp/)
+    endif()
+endforeach()
@@ -0,0 +1,159 @@
+#include "analysis_scheduler.hpp"
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+AnalysisScheduler::AnalysisScheduler(size_t workerCount, AnalysisFunction analyze)
+    : analyze_(std::move(analyze)) {
+    workerCount = std::max<size_t>(1, workerCount);
+    workers_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(&AnalysisScheduler::workerLoop, this);
+    }
+}
+
+AnalysisScheduler::~AnalysisScheduler() {
+    shutdown();
+}
+
+void AnalysisScheduler::schedule(const std::string& uri, std::chrono::milliseconds delay) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+
+        Entry& entry = entries_[uri];
+        if (entry.queued) {
+            // The queued run never started; the new one replaces it
+            ++stats_.superseded;
+        }
+        // A running analysis notices the new generation and bails out
+        entry.generation = nextGeneration_++;
+        entry.queued = true;
+        entry.due = Clock::now() + delay;
+        ++stats_.scheduled;
+    }
+    wakeCondition_.notify_one();
+}
+
+void AnalysisScheduler::cancel(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(uri);
+    if (it == entries_.end()) return;
+
+    if (it->second.queued) {
+        ++stats_.superseded;
+    }
+    if (it->second.running) {
+        // The worker removes the entry once the cancelled run returns
+        it->second.generation = nextGeneration_++;
+        it->second.queued = false;
+    } else {
+        entries_.erase(it);
+    }
+}
+
+bool AnalysisScheduler::isCurrent(const std::string& uri, uint64_t generation) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return false;
+    auto it = entries_.find(uri);
+    return it != entries_.end() && it->second.generation == generation;
+}
+
+void AnalysisScheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    wakeCondition_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+AnalysisStats AnalysisScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AnalysisStats result = stats_;
+    if (result.started > 0) {
+        result.averageQueueLatencyMs = totalQueueLatencyMs_ / static_cast<double>(result.started);
+    }
+    if (result.scheduled > 0) {
+        result.cancellationRate =
+            static_cast<double>(result.superseded + result.cancelled) / static_cast<double>(result.scheduled);
+    }
+    return result;
+}
+
+void AnalysisScheduler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        // Pick the ready entry that has waited longest; a URI that is
+        // already being analyzed waits for its running pass to finish
+        Clock::time_point now = Clock::now();
+        Clock::time_point nextDue = Clock::time_point::max();
+        auto ready = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            const Entry& entry = it->second;
+            if (!entry.queued || entry.running) continue;
+            if (entry.due <= now) {
+                if (ready == entries_.end() || entry.due < ready->second.due) {
+                    ready = it;
+                }
+            } else {
+                nextDue = std::min(nextDue, entry.due);
+            }
+        }
+
+        if (ready == entries_.end()) {
+            if (nextDue == Clock::time_point::max()) {
+                wakeCondition_.wait(lock);
+            } else {
+                wakeCondition_.wait_until(lock, nextDue);
+            }
+            continue;
+        }
+
+        std::string uri = ready->first;
+        Entry& entry = ready->second;
+        uint64_t generation = entry.generation;
+        entry.queued = false;
+        entry.running = true;
+
+        double latencyMs = std::chrono::duration<double, std::milli>(now - entry.due).count();
+        totalQueueLatencyMs_ += latencyMs;
+        stats_.maxQueueLatencyMs = std::max(stats_.maxQueueLatencyMs, latencyMs);
+        ++stats_.started;
+
+        lock.unlock();
+        analyze_(uri, generation, [this, &uri, generation]() { return !isCurrent(uri, generation); });
+        lock.lock();
+
+        auto it = entries_.find(uri);
+        if (it == entries_.end()) continue; // cleared by shutdown
+
+        if (it->second.generation == generation && !stopping_) {
+            ++stats_.completed;
+        } else {
+            ++stats_.cancelled;
+        }
+
+        it->second.running = false;
+        if (it->second.queued) {
+            // A newer generation arrived while running; let any worker take it
+            wakeCondition_.notify_one();
+        } else {
+            entries_.erase(it);
+        }
+    }
+}
+
+} // namespace lsp
+} // namespace miko
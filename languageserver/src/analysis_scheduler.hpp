@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// Scheduler counters; latencies measure the time an analysis waited for a
+// free worker after its debounce window elapsed
+struct AnalysisStats {
+    uint64_t scheduled = 0;   // schedule() calls
+    uint64_t started = 0;
+    uint64_t completed = 0;   // finished while still the latest generation
+    uint64_t superseded = 0;  // replaced before a worker picked them up
+    uint64_t cancelled = 0;   // replaced or closed while running
+    double averageQueueLatencyMs = 0.0;
+    double maxQueueLatencyMs = 0.0;
+    double cancellationRate = 0.0; // (superseded + cancelled) / scheduled
+};
+
+// Runs document analyses on a fixed pool of workers. Each URI has at most
+// one pending and one running analysis; rescheduling a URI restarts its
+// debounce window and bumps its generation, so stale work is either dropped
+// from the queue or told to stop through the cancellation check.
+class AnalysisScheduler {
+public:
+    // Returns true once the analysis being run has been superseded
+    using CancelCheck = std::function<bool()>;
+    using AnalysisFunction =
+        std::function<void(const std::string& uri, uint64_t generation, const CancelCheck& isCancelled)>;
+
+    AnalysisScheduler(size_t workerCount, AnalysisFunction analyze);
+    ~AnalysisScheduler();
+
+    AnalysisScheduler(const AnalysisScheduler&) = delete;
+    AnalysisScheduler& operator=(const AnalysisScheduler&) = delete;
+
+    // Queues an analysis of uri to start no earlier than delay from now
+    void schedule(const std::string& uri, std::chrono::milliseconds delay);
+
+    // Drops pending work for uri and cancels a running analysis
+    void cancel(const std::string& uri);
+
+    // Whether generation is still the newest one scheduled for uri
+    bool isCurrent(const std::string& uri, uint64_t generation) const;
+
+    // Stops accepting work, cancels running analyses and joins the workers
+    void shutdown();
+
+    AnalysisStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        uint64_t generation = 0;
+        bool queued = false;
+        bool running = false;
+        Clock::time_point due;
+    };
+
+    void workerLoop();
+
+    AnalysisFunction analyze_;
+    std::map<std::string, Entry> entries_;
+    uint64_t nextGeneration_ = 1;
+    bool stopping_ = false;
+
+    AnalysisStats stats_;
+    double totalQueueLatencyMs_ = 0.0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace lsp
+} // namespace miko
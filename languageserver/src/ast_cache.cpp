@@ -0,0 +1,117 @@
+#include "ast_cache.hpp"
+#include "parsed_unit.hpp"
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+AstCache::AstCache(size_t budget) : budget_(budget) {}
+
+AstCache::~AstCache() = default;
+
+std::unique_ptr<ParsedUnit> AstCache::take(const std::string& uri, uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(uri);
+    if (it == entries_.end() || it->second.key != key) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    std::unique_ptr<ParsedUnit> unit = std::move(it->second.unit);
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+    return unit;
+}
+
+void AstCache::put(const std::string& uri, int version, uint64_t key, std::unique_ptr<ParsedUnit> unit) {
+    if (!unit) return;
+    // Measured now rather than at parse time: using the AST deserializes
+    // declarations from the preamble and grows it
+    size_t bytes = unit->memoryUsage();
+
+    std::vector<std::unique_ptr<ParsedUnit>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(uri);
+        if (it != entries_.end() && it->second.version > version) {
+            evicted.push_back(std::move(unit));
+        } else if (bytes > budget_) {
+            // Would evict everything else and itself; keep what is cached
+            evicted.push_back(std::move(unit));
+        } else {
+            Entry& entry = entries_[uri];
+            if (entry.unit) {
+                bytes_ -= entry.bytes;
+                evicted.push_back(std::move(entry.unit));
+            }
+            entry.version = version;
+            entry.key = key;
+            entry.bytes = bytes;
+            entry.lastUsed = ++clock_;
+            entry.unit = std::move(unit);
+            bytes_ += bytes;
+            evict(evicted);
+        }
+    }
+}
+
+void AstCache::setVisible(const std::vector<std::string>& uris) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    visible_ = std::set<std::string>(uris.begin(), uris.end());
+}
+
+void AstCache::setBudget(size_t budget) {
+    std::vector<std::unique_ptr<ParsedUnit>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    evict(evicted);
+    // evicted is declared first, so it is destroyed after the lock is released
+}
+
+void AstCache::invalidate(const std::string& uri) {
+    std::unique_ptr<ParsedUnit> unit;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(uri);
+    if (it == entries_.end()) return;
+    bytes_ -= it->second.bytes;
+    unit = std::move(it->second.unit);
+    entries_.erase(it);
+}
+
+void AstCache::clear() {
+    std::map<std::string, Entry> entries;
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries.swap(entries_);
+    bytes_ = 0;
+}
+
+AstCache::Stats AstCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    for (const auto& entry : entries_) {
+        if (visible_.count(entry.first)) ++stats.visibleEntries;
+    }
+    stats.bytes = bytes_;
+    stats.budget = budget_;
+    return stats;
+}
+
+void AstCache::evict(std::vector<std::unique_ptr<ParsedUnit>>& evicted) {
+    while (bytes_ > budget_ && !entries_.empty()) {
+        // Hidden before visible, then least recently used
+        auto victim = std::min_element(entries_.begin(), entries_.end(), [this](const auto& a, const auto& b) {
+            bool aVisible = visible_.count(a.first) != 0;
+            bool bVisible = visible_.count(b.first) != 0;
+            if (aVisible != bVisible) return bVisible;
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        bytes_ -= victim->second.bytes;
+        evicted.push_back(std::move(victim->second.unit));
+        entries_.erase(victim);
+        ++stats_.evictions;
+    }
+}
+
+} // namespace lsp
+} // namespace miko
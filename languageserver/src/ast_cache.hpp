@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+class ParsedUnit;
+
+// Parsed units of the most recently used documents, kept within a memory
+// budget so that a session with hundreds of open tabs holds a bounded number
+// of ASTs. When over budget the least recently used unit goes first, but
+// documents shown in an editor are only evicted once no hidden one is left.
+// An evicted document is parsed again on demand, on top of its preamble.
+class AstCache {
+public:
+    static constexpr size_t kDefaultBudget = size_t(512) << 20;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t visibleEntries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    explicit AstCache(size_t budget = kDefaultBudget);
+    ~AstCache();
+
+    // The unit parsed for key (content and command line), or nullptr; the
+    // caller checks ParsedUnit::openFilesMatch. A unit is not safe to use
+    // from two threads, so the caller takes it out of the cache and hands it
+    // back with put() when done.
+    std::unique_ptr<ParsedUnit> take(const std::string& uri, uint64_t key);
+    // Caches unit as the latest AST of uri unless a newer version is
+    // already cached, then evicts down to the budget
+    void put(const std::string& uri, int version, uint64_t key, std::unique_ptr<ParsedUnit> unit);
+
+    // Documents currently shown in an editor; replaces the previous set
+    void setVisible(const std::vector<std::string>& uris);
+    void setBudget(size_t budget);
+
+    void invalidate(const std::string& uri);
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        int version = 0;
+        uint64_t key = 0;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+        std::unique_ptr<ParsedUnit> unit;
+    };
+
+    // Moves units out until within budget; they are destroyed by the
+    // caller after the lock is released, as tearing down an AST is slow
+    void evict(std::vector<std::unique_ptr<ParsedUnit>>& evicted);
+
+    size_t budget_;
+    size_t bytes_ = 0;
+    uint64_t clock_ = 0;
+    std::map<std::string, Entry> entries_;
+    std::set<std::string> visible_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,424 @@
+#include "background_indexer.hpp"
+#include <clang/AST/ASTContext.h>
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Index/IndexDataConsumer.h>
+#include <clang/Index/IndexSymbol.h>
+#include <clang/Index/IndexingAction.h>
+#include <clang/Index/USRGeneration.h>
+#include <clang/Lex/Lexer.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/SmallString.h>
+#include <filesystem>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+// Next to the shards, but not named *.idx so loadShards() skips it
+constexpr const char* kSearchIndexFile = "symbols.tri";
+
+uint64_t hashCommand(const clang::tooling::CompileCommand& command) {
+    std::string key = command.Directory;
+    for (const auto& arg : command.CommandLine) {
+        key += '\0';
+        key += arg;
+    }
+    return hashContent(key);
+}
+
+// Number of UTF-16 code units in a UTF-8 byte range
+uint32_t utf16Length(llvm::StringRef text) {
+    uint32_t units = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if ((c & 0xC0) == 0x80) continue;   // continuation byte
+        units += (c >= 0xF0) ? 2 : 1;       // 4-byte sequences need a surrogate pair
+    }
+    return units;
+}
+
+// Collects occurrences per file while a translation unit is indexed
+class ShardCollector : public clang::index::IndexDataConsumer {
+public:
+    ShardCollector(std::string workingDirectory, const std::atomic<bool>& stopping)
+        : workingDirectory_(std::move(workingDirectory)), stopping_(stopping) {}
+
+    void initialize(clang::ASTContext& context) override {
+        sourceManager_ = &context.getSourceManager();
+        langOpts_ = &context.getLangOpts();
+    }
+
+    bool handleDeclOccurrence(const clang::Decl* decl, clang::index::SymbolRoleSet roles,
+                              llvm::ArrayRef<clang::index::SymbolRelation>, clang::SourceLocation location,
+                              ASTNodeInfo) override {
+        // Returning false aborts indexing of the translation unit
+        if (stopping_) return false;
+
+        using clang::index::SymbolRole;
+        uint32_t mapped = 0;
+        if (roles & static_cast<clang::index::SymbolRoleSet>(SymbolRole::Declaration)) mapped |= IndexRoleDeclaration;
+        if (roles & static_cast<clang::index::SymbolRoleSet>(SymbolRole::Definition)) mapped |= IndexRoleDefinition;
+        if (roles & static_cast<clang::index::SymbolRoleSet>(SymbolRole::Reference)) mapped |= IndexRoleReference;
+        if (!mapped || !decl) return true;
+
+        location = sourceManager_->getFileLoc(location);
+        if (location.isInvalid()) return true;
+        FileShard* shard = shardFor(sourceManager_->getFileID(location));
+        if (!shard) return true;
+
+        llvm::SmallString<128> usr;
+        if (clang::index::generateUSRForDecl(decl, usr)) return true; // no USR
+
+        unsigned offset = sourceManager_->getFileOffset(location);
+        unsigned length = clang::Lexer::MeasureTokenLength(location, *sourceManager_, *langOpts_);
+        unsigned column = sourceManager_->getColumnNumber(shard->fileId, offset) - 1;
+        llvm::StringRef content = shard->content;
+
+        IndexOccurrence occurrence;
+        occurrence.line = sourceManager_->getLineNumber(shard->fileId, offset) - 1;
+        occurrence.column = utf16Length(content.substr(offset - column, column));
+        occurrence.endLine = occurrence.line;
+        occurrence.endColumn = occurrence.column + utf16Length(content.substr(offset, length));
+        occurrence.roles = mapped;
+
+        auto [it, inserted] = shard->symbols.try_emplace(usr.str().str());
+        ShardData::Symbol& symbol = it->second;
+        if (inserted) {
+            symbol.usr = it->first;
+            if (const auto* named = llvm::dyn_cast<clang::NamedDecl>(decl)) {
+                symbol.name = named->getNameAsString();
+            }
+            symbol.kind = static_cast<uint32_t>(clang::index::getSymbolInfo(decl).Kind);
+        }
+        symbol.occurrences.push_back(occurrence);
+        return true;
+    }
+
+    void finish() override {
+        // Record every file the translation unit read, including those
+        // without symbols (macro-only headers), for change detection
+        for (auto it = sourceManager_->fileinfo_begin(); it != sourceManager_->fileinfo_end(); ++it) {
+            dependencies_.insert(normalizeIndexPath(it->first.getName(), workingDirectory_));
+        }
+        sourceManager_ = nullptr;
+        langOpts_ = nullptr;
+    }
+
+    // Per-file shard data, ready to write
+    std::vector<ShardData> takeShards() {
+        std::vector<ShardData> result;
+        result.reserve(files_.size());
+        for (auto& [fileId, file] : files_) {
+            if (!file) continue;
+            ShardData data;
+            data.path = file->path;
+            data.contentHash = file->contentHash;
+            data.symbols.reserve(file->symbols.size());
+            for (auto& entry : file->symbols) {
+                data.symbols.push_back(std::move(entry.second));
+            }
+            result.push_back(std::move(data));
+        }
+        files_.clear();
+        return result;
+    }
+
+    const std::set<std::string>& dependencies() const { return dependencies_; }
+
+private:
+    struct FileShard {
+        clang::FileID fileId;
+        std::string path;
+        llvm::StringRef content; // owned by the SourceManager
+        uint64_t contentHash = 0;
+        std::map<std::string, ShardData::Symbol> symbols;
+    };
+
+    FileShard* shardFor(clang::FileID fileId) {
+        auto it = files_.find(fileId);
+        if (it != files_.end()) return it->second.get();
+
+        std::unique_ptr<FileShard> shard;
+        clang::OptionalFileEntryRef entry = sourceManager_->getFileEntryRefForID(fileId);
+        if (entry) {
+            shard = std::make_unique<FileShard>();
+            shard->fileId = fileId;
+            shard->path = normalizeIndexPath(entry->getName(), workingDirectory_);
+            shard->content = sourceManager_->getBufferData(fileId);
+            shard->contentHash = hashContent(shard->content);
+        }
+        // Remember files without an entry (builtins, scratch space) as null
+        FileShard* result = shard.get();
+        files_.emplace(fileId, std::move(shard));
+        return result;
+    }
+
+    std::string workingDirectory_;
+    const std::atomic<bool>& stopping_;
+    clang::SourceManager* sourceManager_ = nullptr;
+    const clang::LangOptions* langOpts_ = nullptr;
+    std::map<clang::FileID, std::unique_ptr<FileShard>> files_;
+    std::set<std::string> dependencies_;
+};
+
+}
+
+BackgroundIndexer::BackgroundIndexer(std::string indexDirectory, SymbolIndex& index, size_t workerCount)
+    : indexDirectory_(std::move(indexDirectory)), index_(index), workerCount_(std::max<size_t>(1, workerCount)) {}
+
+BackgroundIndexer::~BackgroundIndexer() {
+    stop();
+}
+
+void BackgroundIndexer::start(const clang::tooling::CompilationDatabase* database) {
+    std::error_code error;
+    std::filesystem::create_directories(indexDirectory_, error);
+    loadShards();
+
+    if (database) {
+        for (const auto& command : database->getAllCompileCommands()) {
+            push(command, false);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (workers_.empty()) {
+        for (size_t i = 0; i < workerCount_; ++i) {
+            workers_.emplace_back(&BackgroundIndexer::workerLoop, this);
+        }
+    }
+}
+
+void BackgroundIndexer::enqueue(const clang::tooling::CompileCommand& command) {
+    // The file changed on disk, so its session hash is stale
+    fileChanged(normalizeIndexPath(command.Filename, command.Directory));
+    push(command, true);
+}
+
+void BackgroundIndexer::fileChanged(const std::string& path) {
+    std::string key = normalizeIndexPath(path);
+    std::lock_guard<std::mutex> lock(fileHashesMutex_);
+    fileHashes_.erase(key);
+}
+
+void BackgroundIndexer::stop() {
+    {
+        // Under the lock, so a worker between checking stopping_ and
+        // waiting can't miss the wakeup
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeCondition_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    saveSearchIndex();
+}
+
+BackgroundIndexer::Stats BackgroundIndexer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BackgroundIndexer::loadShards() {
+    // Loaded first so shards it already covers are not tokenized again
+    std::string searchFile = (std::filesystem::path(indexDirectory_) / kSearchIndexFile).string();
+    if (index_.loadSearchIndex(searchFile)) {
+        std::lock_guard<std::mutex> lock(saveMutex_);
+        savedSearchGeneration_ = index_.searchGeneration();
+    }
+
+    std::error_code error;
+    uint64_t loaded = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(indexDirectory_, error)) {
+        if (entry.path().extension() != ".idx") continue;
+        if (auto shard = IndexShard::open(entry.path().string())) {
+            index_.add(std::move(shard));
+            ++loaded;
+        }
+    }
+    // Shards deleted since the search index was saved
+    index_.pruneSearchIndex();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.shardsLoaded += loaded;
+}
+
+void BackgroundIndexer::push(const clang::tooling::CompileCommand& command, bool force) {
+    std::string mainPath = normalizeIndexPath(command.Filename, command.Directory);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        if (!pending_.insert(mainPath).second) {
+            if (force) {
+                // Already queued; make sure it is not skipped as up to date
+                for (auto& task : queue_) {
+                    if (normalizeIndexPath(task.command.Filename, task.command.Directory) == mainPath) {
+                        task.force = true;
+                    }
+                }
+            }
+            return;
+        }
+        // Explicit requests (saves) jump ahead of the initial crawl
+        if (force) {
+            queue_.push_front({command, true});
+        } else {
+            queue_.push_back({command, false});
+        }
+        ++stats_.queued;
+    }
+    wakeCondition_.notify_one();
+}
+
+void BackgroundIndexer::workerLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeCondition_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            pending_.erase(normalizeIndexPath(task.command.Filename, task.command.Directory));
+        }
+
+        std::string mainPath = normalizeIndexPath(task.command.Filename, task.command.Directory);
+        bool upToDate = !task.force && isUpToDate(task.command, mainPath);
+        bool indexed = !upToDate && indexFile(task.command);
+
+        bool crawlDone = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (upToDate) {
+                ++stats_.upToDate;
+            } else if (indexed) {
+                ++stats_.indexed;
+            } else if (!stopping_) {
+                ++stats_.failed;
+            }
+            crawlDone = queue_.empty() && !crawlSaved_;
+            if (crawlDone) crawlSaved_ = true;
+        }
+        if (crawlDone) saveSearchIndex();
+    }
+}
+
+void BackgroundIndexer::saveSearchIndex() {
+    std::lock_guard<std::mutex> lock(saveMutex_);
+    uint64_t generation = index_.searchGeneration();
+    if (generation == savedSearchGeneration_) return;
+    std::string file = (std::filesystem::path(indexDirectory_) / kSearchIndexFile).string();
+    if (index_.saveSearchIndex(file)) savedSearchGeneration_ = generation;
+}
+
+bool BackgroundIndexer::isUpToDate(const clang::tooling::CompileCommand& command, const std::string& mainPath) {
+    std::shared_ptr<IndexShard> shard = index_.shard(mainPath);
+    if (!shard || shard->commandHash() != hashCommand(command) || shard->contentHash() != currentHash(mainPath)) {
+        return false;
+    }
+    for (const auto& dependency : shard->dependencies()) {
+        if (currentHash(shard->string(dependency.pathOffset).str()) != dependency.contentHash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BackgroundIndexer::indexFile(const clang::tooling::CompileCommand& command) {
+    auto collector = std::make_shared<ShardCollector>(command.Directory, stopping_);
+
+    clang::index::IndexingOptions options;
+    options.SystemSymbolFilter = clang::index::IndexingOptions::SystemSymbolFilterKind::DeclarationsOnly;
+    options.IndexFunctionLocals = false;
+
+    clang::FileSystemOptions fileSystemOptions;
+    fileSystemOptions.WorkingDir = command.Directory;
+    llvm::IntrusiveRefCntPtr<clang::FileManager> files(new clang::FileManager(fileSystemOptions));
+
+    std::vector<std::string> arguments = command.CommandLine;
+    if (arguments.empty()) return false;
+    arguments.insert(arguments.begin() + 1, "-fsyntax-only");
+
+    clang::IgnoringDiagConsumer diagnostics;
+    clang::tooling::ToolInvocation invocation(std::move(arguments),
+                                              clang::index::createIndexingAction(collector, options), files.get(),
+                                              std::make_shared<clang::PCHContainerOperations>());
+    invocation.setDiagnosticConsumer(&diagnostics);
+    // Parse errors still leave a usable AST; only a failed driver is fatal
+    bool ran = invocation.run();
+    if (stopping_) return false;
+
+    std::string mainPath = normalizeIndexPath(command.Filename, command.Directory);
+    std::vector<ShardData> shards = collector->takeShards();
+
+    // The main file's shard carries the dependency hashes used to decide
+    // whether the translation unit needs indexing again
+    bool haveMain = false;
+    for (auto& shard : shards) {
+        if (shard.path == mainPath) haveMain = true;
+    }
+    if (!haveMain) {
+        if (!ran) return false;
+        ShardData empty;
+        empty.path = mainPath;
+        empty.contentHash = currentHash(mainPath);
+        shards.push_back(std::move(empty));
+    }
+
+    for (auto& shard : shards) {
+        {
+            std::lock_guard<std::mutex> lock(fileHashesMutex_);
+            if (shard.contentHash != 0) fileHashes_[shard.path] = shard.contentHash;
+        }
+
+        if (shard.path == mainPath) {
+            shard.commandHash = hashCommand(command);
+            for (const auto& dependency : collector->dependencies()) {
+                if (dependency != mainPath) {
+                    shard.dependencies.emplace_back(dependency, currentHash(dependency));
+                }
+            }
+        } else {
+            // Headers are shared between translation units; keep the
+            // existing shard while the header itself is unchanged
+            std::shared_ptr<IndexShard> existing = index_.shard(shard.path);
+            if (existing && existing->contentHash() == shard.contentHash) continue;
+        }
+
+        // Unmap the old shard first; Windows cannot replace a mapped file
+        index_.remove(shard.path);
+        std::string file = (std::filesystem::path(indexDirectory_) / shardFileName(shard.path)).string();
+        if (IndexShard::write(file, std::move(shard))) {
+            index_.add(IndexShard::open(file));
+        }
+    }
+    return true;
+}
+
+uint64_t BackgroundIndexer::currentHash(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(fileHashesMutex_);
+        auto it = fileHashes_.find(path);
+        if (it != fileHashes_.end()) return it->second;
+    }
+
+    uint64_t hash = 0;
+    if (auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false)) {
+        hash = hashContent((*buffer)->getBuffer());
+    }
+
+    std::lock_guard<std::mutex> lock(fileHashesMutex_);
+    fileHashes_[path] = hash;
+    return hash;
+}
+
+} // namespace lsp
+} // namespace miko
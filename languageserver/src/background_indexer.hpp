@@ -0,0 +1,95 @@
+#pragma once
+
+#include "symbol_index.hpp"
+#include <clang/Tooling/CompilationDatabase.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// Indexes every translation unit of a compilation database on background
+// threads and keeps the per-file shards in indexDirectory up to date. On
+// start the existing shards are loaded first, so lookups work immediately;
+// only files whose content, dependencies or flags changed are re-parsed.
+// The workspace symbol search index is saved in the same directory once the
+// initial crawl is done and again on stop.
+class BackgroundIndexer {
+public:
+    struct Stats {
+        uint64_t queued = 0;
+        uint64_t indexed = 0;
+        uint64_t upToDate = 0;
+        uint64_t failed = 0;
+        uint64_t shardsLoaded = 0;
+    };
+
+    BackgroundIndexer(std::string indexDirectory, SymbolIndex& index, size_t workerCount);
+    ~BackgroundIndexer();
+
+    BackgroundIndexer(const BackgroundIndexer&) = delete;
+    BackgroundIndexer& operator=(const BackgroundIndexer&) = delete;
+
+    // Loads stored shards and queues every command in the database (which
+    // may be null when the project has none)
+    void start(const clang::tooling::CompilationDatabase* database);
+    // Queues one translation unit, e.g. after it was saved
+    void enqueue(const clang::tooling::CompileCommand& command);
+    // Forgets the session hash of a file changed on disk, e.g. a header
+    // edited outside the editor, so the next up-to-date check reads it again
+    void fileChanged(const std::string& path);
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Task {
+        clang::tooling::CompileCommand command;
+        bool force; // skip the up-to-date check
+    };
+
+    void loadShards();
+    void saveSearchIndex();
+    void push(const clang::tooling::CompileCommand& command, bool force);
+    void workerLoop();
+    bool isUpToDate(const clang::tooling::CompileCommand& command, const std::string& mainPath);
+    bool indexFile(const clang::tooling::CompileCommand& command);
+    uint64_t currentHash(const std::string& path);
+
+    std::string indexDirectory_;
+    SymbolIndex& index_;
+    size_t workerCount_;
+
+    std::deque<Task> queue_;
+    std::set<std::string> pending_; // main files in queue_
+    std::atomic<bool> stopping_{false};
+    bool crawlSaved_ = false;
+    Stats stats_;
+
+    // searchGeneration() of the index when the search index was last
+    // loaded or saved
+    uint64_t savedSearchGeneration_ = 0;
+    std::mutex saveMutex_;
+
+    // Hashes of files read during this session; shared headers are hashed
+    // once no matter how many translation units include them. An entry is
+    // trusted until enqueue() or fileChanged() reports the file changed;
+    // changes nobody reports are only seen by the next session.
+    std::map<std::string, uint64_t> fileHashes_;
+    std::mutex fileHashesMutex_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,339 @@
+#include "code_completion.hpp"
+#include "fuzzy_match.hpp"
+#include "preamble_cache.hpp"
+#include <clang/AST/Decl.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Lex/MacroInfo.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <clang/Sema/CodeCompleteConsumer.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+// How often the deadline is checked in loops over candidates. The first
+// stride always runs, so a slow parse still yields the likeliest results.
+constexpr size_t kDeadlineStride = 64;
+
+// LSP CompletionItemKind for a clang result
+int completionKind(const clang::CodeCompletionResult& result) {
+    switch (result.Kind) {
+    case clang::CodeCompletionResult::RK_Keyword:
+        return 14; // Keyword
+    case clang::CodeCompletionResult::RK_Pattern:
+        return 15; // Snippet
+    case clang::CodeCompletionResult::RK_Macro:
+        return 1;  // Text
+    case clang::CodeCompletionResult::RK_Declaration:
+        break;
+    }
+
+    switch (result.CursorKind) {
+    case CXCursor_FunctionDecl:
+    case CXCursor_FunctionTemplate:
+        return 3;  // Function
+    case CXCursor_CXXMethod:
+    case CXCursor_ConversionFunction:
+        return 2;  // Method
+    case CXCursor_Constructor:
+    case CXCursor_Destructor:
+        return 4;  // Constructor
+    case CXCursor_FieldDecl:
+        return 5;  // Field
+    case CXCursor_VarDecl:
+    case CXCursor_ParmDecl:
+        return 6;  // Variable
+    case CXCursor_ClassDecl:
+    case CXCursor_ClassTemplate:
+    case CXCursor_ClassTemplatePartialSpecialization:
+    case CXCursor_TypedefDecl:
+    case CXCursor_TypeAliasDecl:
+    case CXCursor_TypeAliasTemplateDecl:
+        return 7;  // Class
+    case CXCursor_StructDecl:
+    case CXCursor_UnionDecl:
+        return 22; // Struct
+    case CXCursor_EnumDecl:
+        return 13; // Enum
+    case CXCursor_EnumConstantDecl:
+        return 20; // EnumMember
+    case CXCursor_Namespace:
+    case CXCursor_NamespaceAlias:
+        return 9;  // Module
+    case CXCursor_TemplateTypeParameter:
+    case CXCursor_NonTypeTemplateParameter:
+    case CXCursor_TemplateTemplateParameter:
+        return 25; // TypeParameter
+    default:
+        return 1;  // Text
+    }
+}
+
+// The text a result inserts, available without building its completion
+// string; empty for results that cannot be typed (operators, anonymous)
+std::string typedName(const clang::CodeCompletionResult& result) {
+    switch (result.Kind) {
+    case clang::CodeCompletionResult::RK_Keyword:
+        return result.Keyword ? result.Keyword : "";
+    case clang::CodeCompletionResult::RK_Pattern:
+        return result.Pattern && result.Pattern->getTypedText() ? result.Pattern->getTypedText() : "";
+    case clang::CodeCompletionResult::RK_Macro:
+        return result.Macro ? result.Macro->getName().str() : "";
+    case clang::CodeCompletionResult::RK_Declaration:
+        if (!result.Declaration) return "";
+        if (const clang::IdentifierInfo* name = result.Declaration->getDeclName().getAsIdentifierInfo()) {
+            return name->getName().str();
+        }
+        return "";
+    }
+    return "";
+}
+
+// Collects the candidates matching the typed prefix, most likely first,
+// until the deadline or a cancellation
+class CandidateCollector : public clang::CodeCompleteConsumer {
+public:
+    CandidateCollector(const clang::CodeCompleteOptions& options, CompletionResults& results,
+                       CompletionClock::time_point deadline, const std::function<bool()>& isCancelled)
+        : clang::CodeCompleteConsumer(options),
+          tuInfo_(std::make_shared<clang::GlobalCodeCompletionAllocator>()),
+          results_(results),
+          deadline_(deadline),
+          isCancelled_(isCancelled) {}
+
+    void ProcessCodeCompleteResults(clang::Sema& sema, clang::CodeCompletionContext context,
+                                    clang::CodeCompletionResult* results, unsigned count) override {
+        FuzzyMatcher matcher(results_.prefix);
+
+        struct Match {
+            clang::CodeCompletionResult* result;
+            std::string name;
+        };
+        std::vector<Match> matches;
+        matches.reserve(count);
+        for (unsigned i = 0; i < count; ++i) {
+            clang::CodeCompletionResult& result = results[i];
+            if (result.Availability == CXAvailability_NotAvailable) continue;
+            std::string name = typedName(result);
+            if (name.empty()) continue;
+            if (!maskCovers(characterMask(name), matcher.mask()) || matcher.match(name) < 0) continue;
+            matches.push_back({&result, std::move(name)});
+        }
+
+        // Building completion strings is the expensive part, so do the
+        // likeliest first in case the budget runs out
+        std::stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+            return a.result->Priority < b.result->Priority;
+        });
+
+        results_.candidates.reserve(matches.size());
+        results_.masks.reserve(matches.size());
+        for (size_t i = 0; i < matches.size(); ++i) {
+            if (i > 0 && i % kDeadlineStride == 0 &&
+                (CompletionClock::now() > deadline_ || (isCancelled_ && isCancelled_()))) {
+                results_.complete = false;
+                break;
+            }
+
+            clang::CodeCompletionResult& result = *matches[i].result;
+            const clang::CodeCompletionString* string = result.CreateCodeCompletionString(
+                sema, context, getAllocator(), getCodeCompletionTUInfo(), /*IncludeBriefComments=*/true);
+            if (!string) continue;
+
+            CompletionCandidate candidate;
+            candidate.filterText = std::move(matches[i].name);
+            candidate.kind = completionKind(result);
+            candidate.priority = result.Priority;
+            for (const auto& chunk : *string) {
+                switch (chunk.Kind) {
+                case clang::CodeCompletionString::CK_ResultType:
+                    candidate.detail = chunk.Text;
+                    break;
+                case clang::CodeCompletionString::CK_Optional:
+                case clang::CodeCompletionString::CK_VerticalSpace:
+                    break;
+                case clang::CodeCompletionString::CK_HorizontalSpace:
+                    candidate.label += ' ';
+                    break;
+                default:
+                    if (chunk.Text) candidate.label += chunk.Text;
+                    break;
+                }
+            }
+            if (const char* comment = string->getBriefComment()) {
+                candidate.documentation = comment;
+            }
+
+            results_.masks.push_back(characterMask(candidate.filterText));
+            results_.candidates.push_back(std::move(candidate));
+        }
+    }
+
+    clang::CodeCompletionAllocator& getAllocator() override { return tuInfo_.getAllocator(); }
+    clang::CodeCompletionTUInfo& getCodeCompletionTUInfo() override { return tuInfo_; }
+
+private:
+    clang::CodeCompletionTUInfo tuInfo_;
+    CompletionResults& results_;
+    CompletionClock::time_point deadline_;
+    const std::function<bool()>& isCancelled_; // outlives the parse
+};
+}
+
+std::shared_ptr<const CompletionResults>
+runCodeCompletion(const ParseInputs& inputs, unsigned line, unsigned column, size_t offset,
+                  llvm::StringRef prefix, PreambleCache& preambles, CompletionClock::time_point deadline,
+                  const std::function<bool()>& isCancelled) {
+    if (isCancelled && isCancelled()) return nullptr;
+    std::shared_ptr<clang::CompilerInvocation> invocation = buildInvocation(inputs);
+    if (!invocation) return nullptr;
+
+    std::unique_ptr<llvm::MemoryBuffer> mainBuffer = llvm::MemoryBuffer::getMemBufferCopy(inputs.contents, inputs.path);
+
+    // The preamble is looked up with the plain invocation so completion
+    // shares it with diagnostics. It cannot be used when completing inside
+    // the #include block it was built from.
+    std::shared_ptr<const clang::PrecompiledPreamble> preamble;
+    clang::PreambleBounds bounds =
+        clang::ComputePreambleBounds(invocation->getLangOpts(), mainBuffer->getMemBufferRef(), 0);
+    if (offset >= bounds.Size) {
+        preamble = preambles.get(inputs.path, *invocation, *mainBuffer, inputs.vfs);
+        if (isCancelled && isCancelled()) return nullptr;
+    }
+
+    clang::CodeCompleteOptions options;
+    options.IncludeMacros = true;
+    options.IncludeCodePatterns = true;
+    options.IncludeGlobals = true;
+    options.IncludeBriefComments = true;
+    options.LoadExternal = true;
+
+    clang::FrontendOptions& frontend = invocation->getFrontendOpts();
+    frontend.CodeCompletionAt.FileName = inputs.path;
+    frontend.CodeCompletionAt.Line = line;
+    frontend.CodeCompletionAt.Column = column;
+    frontend.CodeCompleteOpts = options;
+    // Only the body containing the completion point is parsed
+    frontend.SkipFunctionBodies = true;
+    invocation->getLangOpts().SpellChecking = false;
+
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs = inputs.vfs;
+    if (preamble) {
+        preamble->AddImplicitPreamble(*invocation, vfs, mainBuffer.get());
+    }
+    invocation->getPreprocessorOpts().addRemappedFile(inputs.path, mainBuffer.release());
+
+    auto results = std::make_shared<CompletionResults>();
+    results->prefix = prefix.str();
+
+    clang::IgnoringDiagConsumer ignore;
+    clang::CompilerInstance compiler(invocation);
+    compiler.createDiagnostics(*vfs, &ignore, false);
+    compiler.createFileManager(vfs);
+    if (!compiler.createTarget()) return nullptr;
+    // The instance owns the consumer
+    compiler.setCodeCompletionConsumer(new CandidateCollector(options, *results, deadline, isCancelled));
+
+    clang::SyntaxOnlyAction action;
+    if (!action.BeginSourceFile(compiler, compiler.getFrontendOpts().Inputs[0])) return nullptr;
+    if (llvm::Error error = action.Execute()) {
+        llvm::consumeError(std::move(error));
+    }
+    action.EndSourceFile();
+    if (isCancelled && isCancelled()) return nullptr;
+    return results;
+}
+
+std::vector<const CompletionCandidate*>
+rankCompletions(const CompletionResults& results, llvm::StringRef prefix, size_t limit,
+                CompletionClock::time_point deadline, bool& incomplete,
+                const std::function<bool()>& isCancelled) {
+    FuzzyMatcher matcher(prefix);
+    const size_t count = results.candidates.size();
+
+    // Mask prefilter over the flat array; a simple loop the compiler
+    // vectorizes
+    std::vector<uint8_t> keep(count);
+    const uint64_t patternMask = matcher.mask();
+    const uint64_t* masks = results.masks.data();
+    for (size_t i = 0; i < count; ++i) {
+        keep[i] = (masks[i] & patternMask) == patternMask;
+    }
+
+    struct Scored {
+        float score;
+        const CompletionCandidate* candidate;
+    };
+    std::vector<Scored> scored;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0 && i % kDeadlineStride == 0 &&
+            (CompletionClock::now() > deadline || (isCancelled && isCancelled()))) {
+            incomplete = true;
+            break;
+        }
+        if (!keep[i]) continue;
+        const CompletionCandidate& candidate = results.candidates[i];
+        float match = matcher.match(candidate.filterText);
+        if (match < 0) continue;
+        // Match quality first, then clang's estimate of how likely the
+        // candidate is here (local variables before members before globals)
+        float quality = 2.0f / (1.0f + candidate.priority / 25.0f);
+        scored.push_back({match * quality, &candidate});
+    }
+
+    auto better = [](const Scored& a, const Scored& b) {
+        if (a.score != b.score) return a.score > b.score;
+        return a.candidate->label < b.candidate->label;
+    };
+    if (scored.size() > limit) {
+        std::partial_sort(scored.begin(), scored.begin() + limit, scored.end(), better);
+        scored.resize(limit);
+        incomplete = true;
+    } else {
+        std::sort(scored.begin(), scored.end(), better);
+    }
+
+    std::vector<const CompletionCandidate*> ranked;
+    ranked.reserve(scored.size());
+    for (const auto& entry : scored) {
+        ranked.push_back(entry.candidate);
+    }
+    return ranked;
+}
+
+std::shared_ptr<const CompletionResults> CompletionCache::find(const std::string& path, size_t anchor,
+                                                               uint64_t contextHash, llvm::StringRef prefix) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end()) return nullptr;
+    const Entry& entry = it->second;
+    // Candidates matching a longer prefix are a subset of those matching
+    // the one the entry was collected for
+    if (entry.anchor != anchor || entry.contextHash != contextHash || !prefix.starts_with(entry.results->prefix)) {
+        return nullptr;
+    }
+    return entry.results;
+}
+
+void CompletionCache::store(const std::string& path, size_t anchor, uint64_t contextHash,
+                            std::shared_ptr<const CompletionResults> results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[path] = Entry{anchor, contextHash, std::move(results)};
+}
+
+void CompletionCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(path);
+}
+
+void CompletionCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "parsed_unit.hpp"
+#include <llvm/ADT/StringRef.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+class PreambleCache;
+
+// One result of clang's code completion, converted while Sema was alive
+struct CompletionCandidate {
+    std::string label;      // name and signature, e.g. "push_back(const T &value)"
+    std::string filterText; // the identifier the user types
+    std::string detail;     // result type
+    std::string documentation;
+    int kind = 1;           // LSP CompletionItemKind
+    unsigned priority = 0;  // clang's; lower is more likely
+};
+
+// Candidates for one completion point. masks[i] is characterMask() of
+// candidates[i].filterText, stored apart so filtering scans a flat array.
+struct CompletionResults {
+    std::vector<CompletionCandidate> candidates;
+    std::vector<uint64_t> masks;
+    std::string prefix;   // filter the candidates were collected for
+    bool complete = true; // false when the deadline cut collection short
+};
+
+using CompletionClock = std::chrono::steady_clock;
+
+// Runs clang's code completion at line/column (1-based, bytes), which
+// should be the start of the identifier being typed so the results do not
+// depend on how much of it exists yet. offset is the same point as a byte
+// offset. Only candidates matching prefix are kept; once the deadline
+// passes no further candidates are converted and the results are marked
+// incomplete. isCancelled is polled along with the deadline. Returns
+// nullptr when the file cannot be parsed or the request was cancelled.
+std::shared_ptr<const CompletionResults>
+runCodeCompletion(const ParseInputs& inputs, unsigned line, unsigned column, size_t offset,
+                  llvm::StringRef prefix, PreambleCache& preambles, CompletionClock::time_point deadline,
+                  const std::function<bool()>& isCancelled = nullptr);
+
+// Filters results by prefix and returns at most limit candidates, best
+// first. incomplete is set when more candidates matched than were returned
+// or the deadline or a cancellation stopped the scan.
+std::vector<const CompletionCandidate*>
+rankCompletions(const CompletionResults& results, llvm::StringRef prefix, size_t limit,
+                CompletionClock::time_point deadline, bool& incomplete,
+                const std::function<bool()>& isCancelled = nullptr);
+
+// Last completion results per file. While the user keeps typing the same
+// identifier the cached candidates are filtered again instead of invoking
+// clang: the entry matches as long as the identifier start and all text
+// before it are unchanged and the typed prefix only grew.
+class CompletionCache {
+public:
+    std::shared_ptr<const CompletionResults> find(const std::string& path, size_t anchor, uint64_t contextHash,
+                                                  llvm::StringRef prefix) const;
+    void store(const std::string& path, size_t anchor, uint64_t contextHash,
+               std::shared_ptr<const CompletionResults> results);
+    void invalidate(const std::string& path);
+    void clear();
+
+private:
+    struct Entry {
+        size_t anchor = 0;
+        uint64_t contextHash = 0;
+        std::shared_ptr<const CompletionResults> results;
+    };
+
+    std::map<std::string, Entry> entries_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,97 @@
+#include "diagnostic_collector.hpp"
+#include "document_store.hpp"
+#include <clang/Basic/SourceManager.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm/ADT/SmallString.h>
+
+namespace miko {
+namespace lsp {
+
+void MainFileDiagnosticCollector::BeginSourceFile(const clang::LangOptions& langOpts, const clang::Preprocessor*) {
+    langOpts_ = &langOpts;
+}
+
+void MainFileDiagnosticCollector::EndSourceFile() {
+    langOpts_ = nullptr;
+}
+
+void MainFileDiagnosticCollector::HandleDiagnostic(clang::DiagnosticsEngine::Level level,
+                                                   const clang::Diagnostic& info) {
+    clang::DiagnosticConsumer::HandleDiagnostic(level, info);
+    if (level == clang::DiagnosticsEngine::Ignored) return;
+    if (!info.hasSourceManager() || info.getLocation().isInvalid()) return;
+
+    const clang::SourceManager& sm = info.getSourceManager();
+    clang::FileID mainFile = sm.getMainFileID();
+    clang::SourceLocation location = sm.getFileLoc(info.getLocation());
+
+    bool inInclude = false;
+    while (location.isValid() && sm.getFileID(location) != mainFile) {
+        location = sm.getFileLoc(sm.getIncludeLoc(sm.getFileID(location)));
+        inInclude = true;
+    }
+    if (location.isInvalid()) return;
+    // Notes only make sense next to the diagnostic they explain
+    if (inInclude && level == clang::DiagnosticsEngine::Note) return;
+
+    FileDiagnostic diagnostic;
+    diagnostic.begin = sm.getFileOffset(location);
+    diagnostic.end = diagnostic.begin;
+    if (!inInclude && info.getNumRanges() > 0) {
+        const clang::CharSourceRange& range = info.getRange(0);
+        clang::SourceLocation end = sm.getFileLoc(range.getEnd());
+        if (end.isValid() && sm.getFileID(end) == mainFile && sm.getFileOffset(end) >= diagnostic.begin) {
+            diagnostic.end = sm.getFileOffset(end);
+            if (range.isTokenRange() && langOpts_) {
+                diagnostic.end += clang::Lexer::MeasureTokenLength(end, sm, *langOpts_);
+            }
+        }
+    }
+    if (diagnostic.end == diagnostic.begin && langOpts_) {
+        // Underline at least the token at the location
+        diagnostic.end += clang::Lexer::MeasureTokenLength(location, sm, *langOpts_);
+    }
+
+    switch (level) {
+    case clang::DiagnosticsEngine::Error:
+    case clang::DiagnosticsEngine::Fatal:
+        diagnostic.severity = 1;
+        break;
+    case clang::DiagnosticsEngine::Warning:
+        diagnostic.severity = 2;
+        break;
+    default:
+        diagnostic.severity = 3;
+        break;
+    }
+
+    llvm::SmallString<256> message;
+    info.FormatDiagnostic(message);
+    diagnostic.message = inInclude ? "In included file: " + message.str().str() : message.str().str();
+    diagnostics_.push_back(std::move(diagnostic));
+}
+
+std::vector<FileDiagnostic> MainFileDiagnosticCollector::take() {
+    return std::move(diagnostics_);
+}
+
+std::vector<Diagnostic> toLspDiagnostics(const std::string& contents, const std::vector<FileDiagnostic>& diagnostics) {
+    std::vector<Diagnostic> result;
+    if (diagnostics.empty()) return result;
+
+    Document document(contents, 0);
+    result.reserve(diagnostics.size());
+    for (const auto& raw : diagnostics) {
+        Diagnostic diagnostic;
+        diagnostic.range.start = document.positionAt(raw.begin);
+        diagnostic.range.end = document.positionAt(raw.end);
+        diagnostic.severity = raw.severity;
+        diagnostic.message = raw.message;
+        diagnostic.source = "clang";
+        result.push_back(std::move(diagnostic));
+    }
+    return result;
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <clang/Basic/Diagnostic.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// A diagnostic in the main file, as byte offsets into its text
+struct FileDiagnostic {
+    size_t begin = 0;
+    size_t end = 0;
+    int severity = 1; // LSP DiagnosticSeverity
+    std::string message;
+};
+
+// Records diagnostics that land in the main file. Those raised inside
+// included headers are reported at the #include line, as other IDEs do.
+class MainFileDiagnosticCollector : public clang::DiagnosticConsumer {
+public:
+    void BeginSourceFile(const clang::LangOptions& langOpts, const clang::Preprocessor*) override;
+    void EndSourceFile() override;
+    void HandleDiagnostic(clang::DiagnosticsEngine::Level level, const clang::Diagnostic& info) override;
+
+    // What was recorded so far, in the order it was reported
+    std::vector<FileDiagnostic> take();
+
+private:
+    const clang::LangOptions* langOpts_ = nullptr;
+    std::vector<FileDiagnostic> diagnostics_;
+};
+
+// Converts byte offsets into LSP positions against the parsed text
+std::vector<Diagnostic> toLspDiagnostics(const std::string& contents, const std::vector<FileDiagnostic>& diagnostics);
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,268 @@
+#include "document_store.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+// Past this many pieces lookups cost more than rebuilding the buffer
+constexpr size_t kMaxPieces = 512;
+
+// Length in bytes of the UTF-8 sequence starting with lead
+size_t utf8SequenceLength(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead >> 5) == 0x6) return 2;
+    if ((lead >> 4) == 0xE) return 3;
+    if ((lead >> 3) == 0x1E) return 4;
+    return 1; // stray continuation byte; count it as one unit
+}
+
+// UTF-16 code units needed for the sequence starting with lead
+int utf16Units(unsigned char lead) {
+    return utf8SequenceLength(lead) == 4 ? 2 : 1;
+}
+}
+
+Document::Document(std::string text, int version) : version_(version) {
+    reset(std::move(text));
+}
+
+bool Document::applyChange(const TextDocumentContentChange& change) {
+    if (!change.hasRange) {
+        reset(change.text);
+        return true;
+    }
+
+    const Range& range = change.range;
+    if (range.start.line < 0 || range.end.line < range.start.line ||
+        (range.end.line == range.start.line && range.end.character < range.start.character)) {
+        return false;
+    }
+
+    size_t start = offsetAt(range.start);
+    size_t end = offsetAt(range.end);
+    replace(start, end, change.text);
+
+    if (pieces_.size() > kMaxPieces) {
+        compact();
+    }
+    return true;
+}
+
+const std::string& Document::text() const {
+    if (!cacheValid_) {
+        cache_.clear();
+        cache_.reserve(length_);
+        for (const auto& piece : pieces_) {
+            cache_.append(pieceData(piece), piece.length);
+        }
+        cacheValid_ = true;
+    }
+    return cache_;
+}
+
+std::string Document::substr(size_t offset, size_t count) const {
+    if (cacheValid_) {
+        return offset < cache_.size() ? cache_.substr(offset, count) : std::string();
+    }
+
+    std::string result;
+    size_t pieceOffset = 0;
+    for (const auto& piece : pieces_) {
+        if (count == 0) break;
+        size_t pieceEnd = pieceOffset + piece.length;
+        if (offset < pieceEnd) {
+            size_t from = offset - pieceOffset;
+            size_t take = std::min(count, piece.length - from);
+            result.append(pieceData(piece) + from, take);
+            offset += take;
+            count -= take;
+        }
+        pieceOffset = pieceEnd;
+    }
+    return result;
+}
+
+std::string Document::lineText(size_t line) const {
+    if (line >= lineStarts_.size()) return {};
+    size_t start = lineStarts_[line];
+    size_t end = line + 1 < lineStarts_.size() ? lineStarts_[line + 1] - 1 : length_;
+    std::string result = substr(start, end - start);
+    if (!result.empty() && result.back() == '\r') {
+        result.pop_back();
+    }
+    return result;
+}
+
+size_t Document::offsetAt(const Position& position) const {
+    if (position.line < 0) return 0;
+    size_t line = static_cast<size_t>(position.line);
+    if (line >= lineStarts_.size()) return length_;
+
+    std::string content = lineText(line);
+    size_t bytes = 0;
+    int units = 0;
+    while (bytes < content.size() && units < position.character) {
+        unsigned char lead = static_cast<unsigned char>(content[bytes]);
+        int width = utf16Units(lead);
+        if (units + width > position.character) break; // inside a surrogate pair
+        units += width;
+        bytes += std::min(utf8SequenceLength(lead), content.size() - bytes);
+    }
+    return lineStarts_[line] + bytes;
+}
+
+Position Document::positionAt(size_t offset) const {
+    offset = std::min(offset, length_);
+    auto it = std::upper_bound(lineStarts_.begin(), lineStarts_.end(), offset);
+    size_t line = static_cast<size_t>(it - lineStarts_.begin()) - 1;
+
+    std::string prefix = substr(lineStarts_[line], offset - lineStarts_[line]);
+    int units = 0;
+    for (size_t i = 0; i < prefix.size();) {
+        unsigned char lead = static_cast<unsigned char>(prefix[i]);
+        units += utf16Units(lead);
+        i += utf8SequenceLength(lead);
+    }
+
+    Position position;
+    position.line = static_cast<int>(line);
+    position.character = units;
+    return position;
+}
+
+void Document::replace(size_t start, size_t end, const std::string& text) {
+    start = std::min(start, length_);
+    end = std::clamp(end, start, length_);
+
+    // Rebuild the piece list around [start, end). Typing right after the
+    // most recent insertion just grows that piece.
+    std::vector<Piece> pieces;
+    pieces.reserve(pieces_.size() + 2);
+    auto insertText = [&]() {
+        if (text.empty()) return;
+        if (!pieces.empty() && pieces.back().added &&
+            pieces.back().start + pieces.back().length == add_.size()) {
+            pieces.back().length += text.size();
+        } else {
+            pieces.push_back({true, add_.size(), text.size()});
+        }
+        add_ += text;
+    };
+
+    bool inserted = false;
+    size_t pieceOffset = 0;
+    for (const auto& piece : pieces_) {
+        size_t pieceEnd = pieceOffset + piece.length;
+        if (pieceOffset < start) {
+            pieces.push_back({piece.added, piece.start, std::min(pieceEnd, start) - pieceOffset});
+        }
+        if (!inserted && pieceEnd > start) {
+            insertText();
+            inserted = true;
+        }
+        if (pieceEnd > end) {
+            size_t from = std::max(pieceOffset, end);
+            pieces.push_back({piece.added, piece.start + (from - pieceOffset), pieceEnd - from});
+        }
+        pieceOffset = pieceEnd;
+    }
+    if (!inserted) {
+        insertText(); // appending at the end
+    }
+    pieces_ = std::move(pieces);
+
+    // Update the line index: drop breaks inside the removed range, shift the
+    // ones after it and add the breaks from the inserted text
+    auto first = std::upper_bound(lineStarts_.begin(), lineStarts_.end(), start);
+    auto last = std::upper_bound(first, lineStarts_.end(), end);
+    long long delta = static_cast<long long>(text.size()) - static_cast<long long>(end - start);
+    for (auto it = last; it != lineStarts_.end(); ++it) {
+        *it = static_cast<size_t>(static_cast<long long>(*it) + delta);
+    }
+    std::vector<size_t> added;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') added.push_back(start + i + 1);
+    }
+    first = lineStarts_.erase(first, last);
+    lineStarts_.insert(first, added.begin(), added.end());
+
+    length_ = length_ - (end - start) + text.size();
+    cacheValid_ = false;
+}
+
+void Document::reset(std::string text) {
+    original_ = std::move(text);
+    add_.clear();
+    pieces_.clear();
+    if (!original_.empty()) {
+        pieces_.push_back({false, 0, original_.size()});
+    }
+    length_ = original_.size();
+
+    lineStarts_.assign(1, 0);
+    for (size_t i = 0; i < original_.size(); ++i) {
+        if (original_[i] == '\n') lineStarts_.push_back(i + 1);
+    }
+
+    cache_.clear();
+    cacheValid_ = false;
+}
+
+void Document::compact() {
+    std::string flat = text();
+    reset(std::move(flat));
+}
+
+const char* Document::pieceData(const Piece& piece) const {
+    return (piece.added ? add_.data() : original_.data()) + piece.start;
+}
+
+std::string uriToPath(const std::string& uri) {
+    const std::string scheme = "file://";
+    if (uri.compare(0, scheme.size(), scheme) != 0) return uri;
+
+    std::string path;
+    path.reserve(uri.size() - scheme.size());
+    for (size_t i = scheme.size(); i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() &&
+            std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+            path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+
+    // file:///C:/dir -> C:/dir
+    if (path.size() >= 3 && path[0] == '/' && std::isalpha(static_cast<unsigned char>(path[1])) && path[2] == ':') {
+        path.erase(0, 1);
+    }
+    return path;
+}
+
+std::string pathToUri(const std::string& path) {
+    static const char* kHex = "0123456789ABCDEF";
+    std::string uri = "file://";
+    if (path.empty() || (path[0] != '/' && path[0] != '\\')) {
+        uri += '/';
+    }
+    for (char c : path) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '\\') {
+            uri += '/';
+        } else if (std::isalnum(byte) || c == '/' || c == ':' || c == '-' || c == '_' || c == '.' || c == '~') {
+            uri += c;
+        } else {
+            uri += '%';
+            uri += kHex[byte >> 4];
+            uri += kHex[byte & 0xF];
+        }
+    }
+    return uri;
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// Text of an open document kept as a piece table, so an edit costs in
+// proportion to the edit and the number of pieces rather than the file size.
+// A byte-offset line index is maintained alongside for position lookups.
+// Positions follow the LSP default encoding: lines plus UTF-16 code units.
+class Document {
+public:
+    Document() = default;
+    Document(std::string text, int version);
+
+    // Applies one content change; a change without a range replaces the
+    // whole document. Returns false when the range is out of bounds.
+    bool applyChange(const TextDocumentContentChange& change);
+    void setVersion(int version) { version_ = version; }
+    // As sent in didOpen; empty when the document was opened by a change
+    void setLanguageId(std::string languageId) { languageId_ = std::move(languageId); }
+
+    const std::string& languageId() const { return languageId_; }
+    // Whether the text may differ from the file on disk; only modified
+    // documents need to shadow the file for other translation units
+    void setModified(bool modified) { modified_ = modified; }
+    bool modified() const { return modified_; }
+
+    int version() const { return version_; }
+    size_t length() const { return length_; }
+    size_t lineCount() const { return lineStarts_.size(); }
+
+    // Whole text; materialized once per version and cached
+    const std::string& text() const;
+    std::string substr(size_t offset, size_t count) const;
+    std::string lineText(size_t line) const; // without the line break
+
+    // Byte offset for a position, clamped to the line/document end
+    size_t offsetAt(const Position& position) const;
+    Position positionAt(size_t offset) const;
+
+private:
+    struct Piece {
+        bool added;   // from add_ rather than original_
+        size_t start; // into its buffer
+        size_t length;
+    };
+
+    void replace(size_t start, size_t end, const std::string& text);
+    void reset(std::string text);
+    void compact();
+    const char* pieceData(const Piece& piece) const;
+
+    std::string original_;
+    std::string add_;
+    std::vector<Piece> pieces_;
+    size_t length_ = 0;
+    std::vector<size_t> lineStarts_{0};
+    int version_ = 0;
+    std::string languageId_;
+    bool modified_ = true;
+
+    mutable std::string cache_;
+    mutable bool cacheValid_ = true;
+};
+
+// file:// URI <-> filesystem path (percent-decoding, Windows drive letters)
+std::string uriToPath(const std::string& uri);
+std::string pathToUri(const std::string& path);
+
+} // namespace lsp
+} // namespace miko
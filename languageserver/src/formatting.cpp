@@ -0,0 +1,419 @@
+#include "formatting.hpp"
+#include "document_store.hpp"
+#include <clang/Tooling/Core/Replacement.h>
+#include <llvm/Support/Path.h>
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+// Re-reading .clang-format at most this often keeps keystrokes from walking
+// the directory tree while still picking up edits to the file
+constexpr auto kStyleRefreshInterval = std::chrono::seconds(2);
+
+bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+           static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+size_t lineStartOf(llvm::StringRef text, size_t offset) {
+    size_t newline = text.rfind('\n', offset);
+    return newline == llvm::StringRef::npos ? 0 : newline + 1;
+}
+
+// Offset just past the line containing offset
+size_t lineEndOf(llvm::StringRef text, size_t offset) {
+    size_t newline = text.find('\n', offset);
+    return newline == llvm::StringRef::npos ? text.size() : newline + 1;
+}
+
+// Walks C/C++ source, skipping comments, string and character literals and
+// preprocessor lines, and reports what shapes its structure: '{', '}', ';'
+// and words ('w'). onToken(kind, offset, word) returns false to stop.
+template <typename Callback>
+void scanStructure(llvm::StringRef text, Callback&& onToken) {
+    const size_t n = text.size();
+    size_t i = 0;
+    size_t numberEnd = llvm::StringRef::npos; // where the last numeric literal ended
+    bool lineStart = true;                    // only whitespace so far on this line
+
+    auto skipBlockComment = [&] {
+        size_t close = text.find("*/", i + 2);
+        i = close == llvm::StringRef::npos ? n : close + 2;
+    };
+
+    while (i < n) {
+        char c = text[i];
+        if (c == '\n') {
+            lineStart = true;
+            ++i;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && text[i + 1] == '*') {
+            skipBlockComment();
+            continue;
+        }
+        if (c == '/' && i + 1 < n && text[i + 1] == '/') {
+            i = text.find('\n', i);
+            if (i == llvm::StringRef::npos) i = n;
+            continue;
+        }
+        if (c == '#' && lineStart) {
+            // Up to a line end that isn't escaped; #define bodies may hold braces
+            while (i < n && text[i] != '\n') {
+                if (text[i] == '\\' && i + 1 < n && (text[i + 1] == '\n' || text[i + 1] == '\r')) {
+                    i = lineEndOf(text, i);
+                } else if (text[i] == '/' && i + 1 < n && text[i + 1] == '*') {
+                    skipBlockComment();
+                } else {
+                    ++i;
+                }
+            }
+            continue;
+        }
+        lineStart = false;
+
+        if (c == '\'' && i == numberEnd) {
+            // Digit separator (1'000'000); the digits after it form the
+            // next word and extend the literal
+            ++i;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            ++i;
+            while (i < n && text[i] != c && text[i] != '\n') {
+                i += text[i] == '\\' ? 2 : 1;
+            }
+            ++i;
+            continue;
+        }
+        if (isIdentifierChar(c)) {
+            size_t start = i;
+            while (i < n && isIdentifierChar(text[i])) ++i;
+            llvm::StringRef word = text.slice(start, i);
+            if (isDigit(word.front())) {
+                numberEnd = i;
+                continue;
+            }
+            if (i < n && text[i] == '"' && word.back() == 'R' && word.size() <= 3) {
+                // Raw string: R"delim( ... )delim"
+                size_t open = text.find('(', i + 1);
+                if (open == llvm::StringRef::npos) {
+                    i = n;
+                    continue;
+                }
+                std::string terminator = ")" + text.slice(i + 1, open).str() + "\"";
+                size_t close = text.find(terminator, open + 1);
+                i = close == llvm::StringRef::npos ? n : close + terminator.size();
+                continue;
+            }
+            if (!onToken('w', start, word)) return;
+            continue;
+        }
+        if (c == '{' || c == '}' || c == ';') {
+            if (!onToken(c, i, llvm::StringRef())) return;
+        }
+        ++i;
+    }
+}
+
+// Offset of the last character that isn't whitespace in [begin, end), or
+// begin when there is none
+size_t lastNonSpace(llvm::StringRef text, size_t begin, size_t end) {
+    size_t last = text.slice(begin, end).find_last_not_of(" \t\r\n\f\v");
+    return last == llvm::StringRef::npos ? begin : begin + last;
+}
+
+bool isBlankLine(llvm::StringRef text, size_t lineStart) {
+    llvm::StringRef line = text.slice(lineStart, lineEndOf(text, lineStart));
+    return line.find_first_not_of(" \t\r\n\f\v") == llvm::StringRef::npos;
+}
+
+bool cancelled(const Formatter::CancelCheck& isCancelled) {
+    return isCancelled && isCancelled();
+}
+
+// sortIncludes and reformat over code, as clang-format -i does; nothing
+// when cancelled in between
+clang::tooling::Replacements formatCode(const clang::format::FormatStyle& style, llvm::StringRef code,
+                                        const std::vector<clang::tooling::Range>& ranges, llvm::StringRef path,
+                                        const Formatter::CancelCheck& isCancelled) {
+    clang::tooling::Replacements includes = clang::format::sortIncludes(style, code, ranges, path);
+    if (cancelled(isCancelled)) return {};
+    llvm::Expected<std::string> sorted = clang::tooling::applyAllReplacements(code, includes);
+    if (!sorted) {
+        llvm::consumeError(sorted.takeError());
+        return clang::format::reformat(style, code, ranges, path);
+    }
+    std::vector<clang::tooling::Range> shifted = clang::tooling::calculateRangesAfterReplacements(includes, ranges);
+    return includes.merge(clang::format::reformat(style, *sorted, shifted, path));
+}
+
+// Replacements made to code[base, ...) as edits of document; each is
+// trimmed to the bytes that differ, never splitting a UTF-8 sequence
+std::vector<TextEdit> toTextEdits(const Document& document, llvm::StringRef code, size_t base,
+                                  const clang::tooling::Replacements& replacements) {
+    std::vector<TextEdit> edits;
+    for (const clang::tooling::Replacement& replacement : replacements) {
+        size_t offset = base + replacement.getOffset();
+        llvm::StringRef before = code.substr(offset, replacement.getLength());
+        llvm::StringRef after = replacement.getReplacementText();
+
+        size_t prefix = 0;
+        size_t limit = std::min(before.size(), after.size());
+        while (prefix < limit && before[prefix] == after[prefix]) ++prefix;
+        while (prefix > 0 && prefix < before.size() && (static_cast<unsigned char>(before[prefix]) & 0xC0) == 0x80) {
+            --prefix;
+        }
+        size_t suffix = 0;
+        limit -= prefix;
+        while (suffix < limit && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) ++suffix;
+        while (suffix > 0 && (static_cast<unsigned char>(before[before.size() - suffix]) & 0xC0) == 0x80) {
+            --suffix;
+        }
+        if (prefix + suffix == before.size() && prefix + suffix == after.size()) continue;
+
+        TextEdit edit;
+        edit.range.start = document.positionAt(offset + prefix);
+        edit.range.end = document.positionAt(offset + before.size() - suffix);
+        edit.newText = after.slice(prefix, after.size() - suffix).str();
+        edits.push_back(std::move(edit));
+    }
+    return edits;
+}
+
+} // namespace
+
+std::pair<size_t, size_t> findFormatWindow(llvm::StringRef text, size_t editBegin, size_t editEnd,
+                                           const std::vector<llvm::StringRef>& transparentBlocks) {
+    const std::pair<size_t, size_t> whole(0, text.size());
+    size_t beginLine = lineStartOf(text, editBegin);
+    size_t lastCode = lastNonSpace(text, beginLine, std::max(editEnd, beginLine));
+
+    size_t windowBegin = 0;
+    bool failed = false;
+    bool found = false;
+    size_t windowEnd = text.size();
+
+    int depth = 0;
+    std::vector<bool> braces; // open braces, true for a transparent block
+    llvm::StringRef words[2]; // first words of the current top-level statement
+
+    // A top-level declaration or statement ends at offset
+    auto boundary = [&](size_t offset) {
+        words[0] = words[1] = llvm::StringRef();
+        if (offset < beginLine) {
+            windowBegin = lineEndOf(text, offset);
+            return true;
+        }
+        if (offset >= lastCode) {
+            windowEnd = lineEndOf(text, offset);
+            found = true;
+            return false;
+        }
+        return true;
+    };
+    auto isTransparent = [&] {
+        llvm::StringRef keyword = words[0] == "inline" ? words[1] : words[0];
+        return !keyword.empty() && llvm::is_contained(transparentBlocks, keyword);
+    };
+    // A brace of a transparent block bounds the window but never goes into
+    // it, as the window is formatted as if it were the whole file
+    auto transparentBrace = [&](size_t offset) {
+        if (offset < beginLine) return boundary(offset);
+        size_t line = lineStartOf(text, offset);
+        if (offset > lastCode && line > lastCode) {
+            windowEnd = line;
+            found = true;
+        } else {
+            failed = true;
+        }
+        return false;
+    };
+
+    scanStructure(text, [&](char kind, size_t offset, llvm::StringRef word) {
+        switch (kind) {
+        case 'w':
+            if (depth == 0) {
+                if (words[0].empty()) {
+                    words[0] = word;
+                } else if (words[1].empty()) {
+                    words[1] = word;
+                }
+            }
+            return true;
+        case '{':
+            if (depth == 0 && isTransparent()) {
+                braces.push_back(true);
+                return transparentBrace(offset);
+            }
+            braces.push_back(false);
+            ++depth;
+            return true;
+        case '}':
+            if (braces.empty()) {
+                failed = true;
+                return false;
+            }
+            if (braces.back()) {
+                braces.pop_back();
+                return transparentBrace(offset);
+            }
+            braces.pop_back();
+            --depth;
+            return depth == 0 ? boundary(offset) : true;
+        case ';':
+            return depth == 0 ? boundary(offset) : true;
+        }
+        return true;
+    });
+    if (failed) return whole;
+    if (!found) windowEnd = text.size();
+
+    // Leading blank lines would count as the start of the file to
+    // clang-format, which removes them
+    while (windowBegin < beginLine && isBlankLine(text, windowBegin)) {
+        windowBegin = lineEndOf(text, windowBegin);
+    }
+    return {windowBegin, windowEnd};
+}
+
+size_t matchingOpenBrace(llvm::StringRef text, size_t closeOffset) {
+    std::vector<size_t> open;
+    size_t match = closeOffset;
+    scanStructure(text, [&](char kind, size_t offset, llvm::StringRef) {
+        if (kind == '{') {
+            open.push_back(offset);
+        } else if (kind == '}') {
+            if (offset == closeOffset) {
+                if (!open.empty()) match = open.back();
+                return false;
+            }
+            if (!open.empty()) open.pop_back();
+        }
+        return offset < closeOffset;
+    });
+    return match;
+}
+
+std::vector<TextEdit> Formatter::formatDocument(const std::string& path, const Document& document,
+                                                const CancelCheck& isCancelled) {
+    clang::format::FormatStyle formatStyle = style(path);
+    if (formatStyle.DisableFormat || cancelled(isCancelled)) return {};
+
+    const std::string& code = document.text();
+    clang::tooling::Replacements replacements = formatCode(
+        formatStyle, code, {clang::tooling::Range(0, static_cast<unsigned>(code.size()))}, path, isCancelled);
+    if (cancelled(isCancelled)) return {};
+    return toTextEdits(document, code, 0, replacements);
+}
+
+std::vector<TextEdit> Formatter::formatRange(const std::string& path, const Document& document, const Range& range,
+                                             const CancelCheck& isCancelled) {
+    int lastLine = range.end.line;
+    // A selection of whole lines ends at the start of the next one
+    if (range.end.character == 0 && lastLine > range.start.line) --lastLine;
+    if (range.start.line < 0 || lastLine < range.start.line) return {};
+    return formatLines(path, document, static_cast<size_t>(range.start.line), static_cast<size_t>(lastLine),
+                       isCancelled);
+}
+
+std::vector<TextEdit> Formatter::formatOnType(const std::string& path, const Document& document,
+                                              const Position& position, llvm::StringRef ch,
+                                              const CancelCheck& isCancelled) {
+    if (position.line < 0) return {};
+    size_t line = static_cast<size_t>(position.line);
+
+    if (ch == "\n") {
+        // The new line holds the cursor and the editor's indentation; leave
+        // it alone and tidy the one that was just finished
+        if (line == 0) return {};
+        return formatLines(path, document, line - 1, line - 1, isCancelled);
+    }
+    if (ch == ";") return formatLines(path, document, line, line, isCancelled);
+    if (ch == "}") {
+        const std::string& code = document.text();
+        size_t cursor = document.offsetAt(position);
+        size_t close = llvm::StringRef(code).rfind('}', cursor);
+        if (close == llvm::StringRef::npos) return {};
+        size_t open = matchingOpenBrace(code, close);
+        size_t firstLine = static_cast<size_t>(document.positionAt(open).line);
+        return formatLines(path, document, std::min(firstLine, line), line, isCancelled);
+    }
+    return {};
+}
+
+std::vector<TextEdit> Formatter::formatLines(const std::string& path, const Document& document, size_t firstLine,
+                                             size_t lastLine, const CancelCheck& isCancelled) {
+    clang::format::FormatStyle formatStyle = style(path);
+    if (formatStyle.DisableFormat || cancelled(isCancelled)) return {};
+
+    const std::string& code = document.text();
+    size_t begin = document.offsetAt(Position{static_cast<int>(firstLine), 0});
+    size_t end = lastLine + 1 < document.lineCount() ? document.offsetAt(Position{static_cast<int>(lastLine + 1), 0})
+                                                     : code.size();
+
+    // Blocks whose content clang-format keeps at the outer indentation
+    std::vector<llvm::StringRef> transparentBlocks;
+    if (formatStyle.NamespaceIndentation == clang::format::FormatStyle::NI_None) {
+        transparentBlocks.push_back("namespace");
+    }
+    if (formatStyle.IndentExternBlock == clang::format::FormatStyle::IEBS_NoIndent ||
+        (formatStyle.IndentExternBlock == clang::format::FormatStyle::IEBS_AfterExternBlock &&
+         !formatStyle.BraceWrapping.AfterExternBlock)) {
+        transparentBlocks.push_back("extern");
+    }
+
+    auto [windowBegin, windowEnd] = findFormatWindow(code, begin, end, transparentBlocks);
+    llvm::StringRef window = llvm::StringRef(code).slice(windowBegin, windowEnd);
+    clang::tooling::Range range(static_cast<unsigned>(begin - windowBegin), static_cast<unsigned>(end - begin));
+    clang::tooling::Replacements replacements = formatCode(formatStyle, window, {range}, path, isCancelled);
+    if (cancelled(isCancelled)) return {};
+    return toTextEdits(document, code, windowBegin, replacements);
+}
+
+void Formatter::invalidateStyles() {
+    std::lock_guard<std::mutex> lock(stylesMutex_);
+    styles_.clear();
+}
+
+clang::format::FormatStyle Formatter::style(const std::string& path) {
+    std::string key = llvm::sys::path::parent_path(path).str();
+    key += '\0';
+    key += llvm::sys::path::extension(path).lower();
+
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(stylesMutex_);
+        auto it = styles_.find(key);
+        if (it != styles_.end() && now - it->second.loaded < kStyleRefreshInterval) return it->second.style;
+    }
+
+    // No code: guessing the language of a .h from its content would make
+    // the style depend on the text and defeat the cache
+    llvm::Expected<clang::format::FormatStyle> loaded = clang::format::getStyle(
+        clang::format::DefaultFormatStyle, path, clang::format::DefaultFallbackStyle, "", nullptr);
+    clang::format::FormatStyle formatStyle = clang::format::getLLVMStyle();
+    if (loaded) {
+        formatStyle = std::move(*loaded);
+    } else {
+        llvm::consumeError(loaded.takeError());
+    }
+
+    std::lock_guard<std::mutex> lock(stylesMutex_);
+    styles_[key] = CachedStyle{formatStyle, now};
+    return formatStyle;
+}
+
+} // namespace lsp
+} // namespace miko
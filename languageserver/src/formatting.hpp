@@ -0,0 +1,74 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <clang/Format/Format.h>
+#include <llvm/ADT/StringRef.h>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+class Document;
+
+// Byte range [begin, end) of whole lines around [editBegin, editEnd) that
+// can be formatted on its own: the top-level declarations the edit touches.
+// Blocks in transparentBlocks ("namespace", "extern") don't count as
+// nesting when their content is not indented, so an edit in a function
+// inside a namespace still only takes that function. Returns the whole
+// text when braces don't balance or the edit touches such a block's braces.
+std::pair<size_t, size_t> findFormatWindow(llvm::StringRef text, size_t editBegin, size_t editEnd,
+                                           const std::vector<llvm::StringRef>& transparentBlocks);
+
+// Offset of the '{' that the '}' at closeOffset closes, or closeOffset
+// itself when it has no match
+size_t matchingOpenBrace(llvm::StringRef text, size_t closeOffset);
+
+// In-process clang-format. Results are the replacements clang-format makes,
+// trimmed to the characters that actually change and mapped to LSP ranges,
+// so unchanged text is never sent back. Range and on-type formatting only
+// hand clang-format the declarations around the edit (findFormatWindow),
+// which keeps them cheap on large files. isCancelled is checked between
+// the steps of a run, which then returns no edits.
+class Formatter {
+public:
+    using CancelCheck = std::function<bool()>;
+
+    // Whole document, #include blocks sorted as well
+    std::vector<TextEdit> formatDocument(const std::string& path, const Document& document,
+                                         const CancelCheck& isCancelled = nullptr);
+    // Lines the range touches
+    std::vector<TextEdit> formatRange(const std::string& path, const Document& document, const Range& range,
+                                      const CancelCheck& isCancelled = nullptr);
+    // After ch was typed at position: "\n" formats the line just finished,
+    // ";" the current line and "}" the block it closes
+    std::vector<TextEdit> formatOnType(const std::string& path, const Document& document, const Position& position,
+                                       llvm::StringRef ch, const CancelCheck& isCancelled = nullptr);
+
+    // Forgets the .clang-format files read so far
+    void invalidateStyles();
+
+private:
+    struct CachedStyle {
+        clang::format::FormatStyle style;
+        std::chrono::steady_clock::time_point loaded;
+    };
+
+    // Style from the nearest .clang-format, LLVM when there is none
+    clang::format::FormatStyle style(const std::string& path);
+    std::vector<TextEdit> formatLines(const std::string& path, const Document& document, size_t firstLine,
+                                      size_t lastLine, const CancelCheck& isCancelled);
+
+    // Keyed by directory and extension (the extension picks the language)
+    std::map<std::string, CachedStyle> styles_;
+    std::mutex stylesMutex_;
+};
+
+} // namespace lsp
+} // namespace miko
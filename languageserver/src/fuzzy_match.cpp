@@ -0,0 +1,120 @@
+#include "fuzzy_match.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+// Longer inputs are truncated; nobody types a 32 character filter
+constexpr size_t kMaxPattern = 32;
+constexpr size_t kMaxWord = 128;
+
+constexpr int kNoMatch = std::numeric_limits<int>::min() / 2;
+constexpr int kBoundaryBonus = 2;
+constexpr int kConsecutiveBonus = 3;
+constexpr int kCaseBonus = 1;
+constexpr int kGapPenalty = 1;
+constexpr int kMaxLeadingPenalty = 3;
+
+inline char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+inline bool isLower(char c) { return c >= 'a' && c <= 'z'; }
+inline bool isUpper(char c) { return c >= 'A' && c <= 'Z'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isAlnum(char c) { return isLower(c) || isUpper(c) || isDigit(c); }
+
+inline unsigned maskBit(char c) {
+    c = toLower(c);
+    if (isLower(c)) return static_cast<unsigned>(c - 'a');
+    if (isDigit(c)) return 26 + static_cast<unsigned>(c - '0');
+    if (c == '_') return 36;
+    return 63;
+}
+
+// Start of a word inside an identifier: after a separator, at a lower to
+// upper case change, or where letters and digits meet
+inline bool isWordStart(llvm::StringRef word, size_t i) {
+    if (i == 0) return true;
+    char previous = word[i - 1];
+    char current = word[i];
+    if (!isAlnum(previous)) return isAlnum(current);
+    if (isLower(previous) && isUpper(current)) return true;
+    return isDigit(previous) != isDigit(current);
+}
+}
+
+uint64_t characterMask(llvm::StringRef text) {
+    uint64_t mask = 0;
+    for (char c : text) {
+        mask |= uint64_t(1) << maskBit(c);
+    }
+    return mask;
+}
+
+FuzzyMatcher::FuzzyMatcher(llvm::StringRef pattern)
+    : pattern_(pattern.take_front(kMaxPattern).str()) {
+    lowerPattern_.reserve(pattern_.size());
+    for (char c : pattern_) {
+        lowerPattern_.push_back(toLower(c));
+    }
+    mask_ = characterMask(pattern_);
+}
+
+float FuzzyMatcher::match(llvm::StringRef word) const {
+    size_t m = pattern_.size();
+    if (m == 0) return 1.0f;
+    word = word.take_front(kMaxWord);
+    size_t n = word.size();
+    if (n < m) return -1.0f;
+
+    bool wordStart[kMaxWord];
+    for (size_t j = 0; j < n; ++j) {
+        wordStart[j] = isWordStart(word, j);
+    }
+
+    // score[j]: best score with the current pattern character matched at
+    // word[j]; one row per pattern character, only the last row is kept
+    int previous[kMaxWord];
+    int current[kMaxWord];
+    for (size_t i = 0; i < m; ++i) {
+        int bestBefore = kNoMatch; // best of previous[0 .. j-2]
+        bool any = false;
+        for (size_t j = 0; j < n; ++j) {
+            current[j] = kNoMatch;
+            if (i > 0 && j >= 2) bestBefore = std::max(bestBefore, previous[j - 2]);
+            if (toLower(word[j]) != lowerPattern_[i]) continue;
+
+            int charScore = 1 + (wordStart[j] ? kBoundaryBonus : 0) + (word[j] == pattern_[i] ? kCaseBonus : 0);
+            int best;
+            if (i == 0) {
+                best = -std::min<int>(static_cast<int>(j), kMaxLeadingPenalty);
+            } else {
+                best = kNoMatch;
+                if (j >= 1 && previous[j - 1] != kNoMatch) best = previous[j - 1] + kConsecutiveBonus;
+                if (bestBefore != kNoMatch) best = std::max(best, bestBefore - kGapPenalty);
+                if (best == kNoMatch) continue;
+            }
+            current[j] = best + charScore;
+            any = true;
+        }
+        if (!any) return -1.0f;
+        std::copy(current, current + n, previous);
+    }
+
+    int score = kNoMatch;
+    for (size_t j = 0; j < n; ++j) {
+        score = std::max(score, previous[j]);
+    }
+
+    // Normalize by a perfect match: every character at a word start with
+    // the right case, all of them consecutive
+    int perfect = static_cast<int>(m) * (1 + kBoundaryBonus + kCaseBonus) + static_cast<int>(m - 1) * kConsecutiveBonus;
+    float normalized = static_cast<float>(std::max(score, 1)) / static_cast<float>(perfect);
+    return std::min(normalized, 1.0f);
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <string>
+
+namespace miko {
+namespace lsp {
+
+// Set of the characters in text, case-folded: one bit per letter, digit and
+// '_', with every other character sharing the top bit. A word can only
+// match a pattern if its mask covers the pattern's, which rejects most
+// candidates with a single AND. Keeping the masks of a candidate list in
+// their own contiguous array lets that test run as a vectorized loop.
+uint64_t characterMask(llvm::StringRef text);
+
+inline bool maskCovers(uint64_t wordMask, uint64_t patternMask) {
+    return (wordMask & patternMask) == patternMask;
+}
+
+// Case-insensitive subsequence matcher for completion filtering. Matches
+// at word starts ("gfs" in "getFileSize", "fs" in "file_size") and runs of
+// consecutive characters score higher, as do exact-case and prefix matches.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(llvm::StringRef pattern);
+
+    bool empty() const { return pattern_.empty(); }
+    uint64_t mask() const { return mask_; }
+
+    // Score in (0, 1], or a negative value when pattern is not a
+    // subsequence of word. An empty pattern matches everything with 1.
+    float match(llvm::StringRef word) const;
+
+private:
+    std::string pattern_;
+    std::string lowerPattern_;
+    uint64_t mask_ = 0;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,341 @@
+#include "jsonrpc.hpp"
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cerrno>
+
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+namespace miko {
+namespace lsp {
+
+namespace {
+// Refuse absurd lengths rather than trying to buffer them
+constexpr size_t kMaxMessageSize = 256u << 20;
+
+#ifdef _WIN32
+long readFd(int fd, char* buffer, size_t size) {
+    return _read(fd, buffer, static_cast<unsigned>(std::min<size_t>(size, 1u << 30)));
+}
+
+long writeFd(int fd, const char* data, size_t size) {
+    return _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30)));
+}
+#else
+long readFd(int fd, char* buffer, size_t size) {
+    return static_cast<long>(::read(fd, buffer, size));
+}
+
+long writeFd(int fd, const char* data, size_t size) {
+    return static_cast<long>(::write(fd, data, size));
+}
+#endif
+}
+
+void MessageFramer::append(const char* data, size_t size) {
+    // Drop what has been returned before growing the buffer
+    if (consumed_ > 0 && consumed_ >= buffer_.size() / 2) {
+        buffer_.erase(0, consumed_);
+        consumed_ = 0;
+    }
+    buffer_.append(data, size);
+}
+
+bool MessageFramer::next(std::string& body) {
+    if (failed_) return false;
+
+    llvm::StringRef pending = llvm::StringRef(buffer_).drop_front(consumed_);
+    size_t headerEnd = pending.find("\r\n\r\n");
+    if (headerEnd == llvm::StringRef::npos) return false;
+
+    // Content-Type is optional and always utf-8 in practice; only the
+    // length matters
+    llvm::StringRef headers = pending.take_front(headerEnd);
+    size_t length = 0;
+    bool haveLength = false;
+    while (!headers.empty()) {
+        llvm::StringRef line;
+        std::tie(line, headers) = headers.split("\r\n");
+        auto [name, value] = line.split(':');
+        if (name.trim().equals_insensitive("Content-Length")) {
+            unsigned long long parsed = 0;
+            if (value.trim().getAsInteger(10, parsed) || parsed > kMaxMessageSize) {
+                failed_ = true;
+                return false;
+            }
+            length = static_cast<size_t>(parsed);
+            haveLength = true;
+        }
+    }
+    if (!haveLength) {
+        failed_ = true;
+        return false;
+    }
+
+    size_t bodyStart = headerEnd + 4;
+    if (pending.size() < bodyStart + length) return false;
+
+    body.assign(pending.data() + bodyStart, length);
+    consumed_ += bodyStart + length;
+    if (consumed_ == buffer_.size()) {
+        buffer_.clear();
+        consumed_ = 0;
+    }
+    return true;
+}
+
+std::string frameMessage(llvm::StringRef body) {
+    std::string framed = "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    framed.append(body.data(), body.size());
+    return framed;
+}
+
+RpcConnection::RpcConnection(int inputFd, int outputFd) : inputFd_(inputFd), outputFd_(outputFd) {
+#ifdef _WIN32
+    // Text mode would turn \n into \r\n and break Content-Length
+    _setmode(inputFd_, _O_BINARY);
+    _setmode(outputFd_, _O_BINARY);
+#endif
+}
+
+bool RpcConnection::read(std::string& body) {
+    char chunk[64 * 1024];
+    while (!framer_.next(body)) {
+        if (framer_.failed()) return false;
+        long count = readFd(inputFd_, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        framer_.append(chunk, static_cast<size_t>(count));
+    }
+    return true;
+}
+
+bool RpcConnection::write(llvm::StringRef body) {
+    std::string framed = frameMessage(body);
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    const char* data = framed.data();
+    size_t remaining = framed.size();
+    while (remaining > 0) {
+        long count = writeFd(outputFd_, data, remaining);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        remaining -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+RpcDispatcher::RpcDispatcher(size_t workerCount) {
+    workers_.reserve(workerCount);
+    for (size_t i = 0; i < std::max<size_t>(1, workerCount); ++i) {
+        workers_.emplace_back(&RpcDispatcher::workerLoop, this);
+    }
+}
+
+RpcDispatcher::~RpcDispatcher() {
+    shutdown();
+}
+
+void RpcDispatcher::onRequest(std::string method, RequestHandler handler, bool ordered) {
+    requests_[std::move(method)] = RequestEntry{std::move(handler), ordered};
+}
+
+void RpcDispatcher::onNotification(std::string method, NotificationHandler handler) {
+    notifications_[std::move(method)] = std::move(handler);
+}
+
+void RpcDispatcher::dispatch(llvm::StringRef message, const Output& output) {
+    llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(message);
+    if (!parsed) {
+        llvm::consumeError(parsed.takeError());
+        output(errorResponse(nullptr, {RpcParseError, "Parse error"}));
+        return;
+    }
+
+    llvm::json::Object* object = parsed->getAsObject();
+    std::optional<llvm::StringRef> method = object ? object->getString("method") : std::nullopt;
+    llvm::json::Value* id = object ? object->get("id") : nullptr;
+    if (!method) {
+        // Responses to server-initiated requests are not used yet
+        if (!id) output(errorResponse(nullptr, {RpcInvalidRequest, "Invalid Request"}));
+        return;
+    }
+
+    llvm::json::Value params = nullptr;
+    if (llvm::json::Value* value = object->get("params")) params = std::move(*value);
+
+    if (!id) {
+        if (*method == "$/cancelRequest") {
+            cancel(params);
+            return;
+        }
+        auto it = notifications_.find(method->str());
+        // Unknown notifications, including other $/ ones, are ignored
+        if (it != notifications_.end()) it->second(params);
+        return;
+    }
+
+    auto entry = requests_.find(method->str());
+    if (entry == requests_.end()) {
+        output(errorResponse(*id, {RpcMethodNotFound, "Method not found: " + method->str()}));
+        return;
+    }
+
+    Pending request{&entry->second.handler, std::move(*id), std::move(params),
+                    std::make_shared<std::atomic<bool>>(false)};
+    if (entry->second.ordered) {
+        output(run(request));
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        inFlight_[idKey(request.id)] = request.cancelled;
+        queue_.emplace_back(std::move(request), output);
+    }
+    wakeCondition_.notify_one();
+}
+
+std::string RpcDispatcher::dispatchSync(llvm::StringRef message) {
+    llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(message);
+    if (!parsed) {
+        llvm::consumeError(parsed.takeError());
+        return errorResponse(nullptr, {RpcParseError, "Parse error"});
+    }
+
+    llvm::json::Object* object = parsed->getAsObject();
+    llvm::json::Value* id = object ? object->get("id") : nullptr;
+    std::optional<llvm::StringRef> method = object ? object->getString("method") : std::nullopt;
+    auto entry = method ? requests_.find(method->str()) : requests_.end();
+    if (!id || entry == requests_.end()) {
+        // Notifications and errors are cheap; reuse the general path
+        std::string response;
+        dispatch(message, [&response](std::string reply) { response = std::move(reply); });
+        return response;
+    }
+
+    llvm::json::Value params = nullptr;
+    if (llvm::json::Value* value = object->get("params")) params = std::move(*value);
+    Pending request{&entry->second.handler, std::move(*id), std::move(params),
+                    std::make_shared<std::atomic<bool>>(false)};
+    return run(request);
+}
+
+void RpcDispatcher::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idleCondition_.wait(lock, [this] { return queue_.empty() && active_ == 0; });
+}
+
+void RpcDispatcher::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && workers_.empty()) return;
+        stopping_ = true;
+        // Queued requests are dropped unanswered; running ones are told to stop
+        queue_.clear();
+        for (auto& [key, cancelled] : inFlight_) {
+            cancelled->store(true);
+        }
+    }
+    wakeCondition_.notify_all();
+    idleCondition_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+void RpcDispatcher::workerLoop() {
+    while (true) {
+        std::pair<Pending, Output> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeCondition_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            ++active_;
+        }
+
+        std::string response = run(task.first);
+        task.second(std::move(response));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inFlight_.erase(idKey(task.first.id));
+            --active_;
+        }
+        idleCondition_.notify_all();
+    }
+}
+
+std::string RpcDispatcher::run(Pending& request) {
+    std::shared_ptr<std::atomic<bool>> cancelled = request.cancelled;
+    if (cancelled->load()) {
+        return errorResponse(request.id, {RpcRequestCancelled, "Request cancelled"});
+    }
+
+    // The handler streams its result into a buffer of its own, so a failed
+    // handler never leaves half a response behind
+    std::string result;
+    RpcError error;
+    {
+        llvm::raw_string_ostream stream(result);
+        llvm::json::OStream out(stream);
+        error = (*request.handler)(request.params, out, [cancelled] { return cancelled->load(); });
+    }
+    if (!error && cancelled->load()) error = {RpcRequestCancelled, "Request cancelled"};
+    if (error) return errorResponse(request.id, error);
+
+    std::string response;
+    llvm::raw_string_ostream stream(response);
+    stream << R"({"jsonrpc":"2.0","id":)" << request.id << R"(,"result":)";
+    stream << (result.empty() ? llvm::StringRef("null") : llvm::StringRef(result)) << '}';
+    stream.flush();
+    return response;
+}
+
+void RpcDispatcher::cancel(const llvm::json::Value& params) {
+    const llvm::json::Object* object = params.getAsObject();
+    const llvm::json::Value* id = object ? object->get("id") : nullptr;
+    if (!id) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inFlight_.find(idKey(*id));
+    if (it != inFlight_.end()) it->second->store(true);
+}
+
+std::string RpcDispatcher::idKey(const llvm::json::Value& id) {
+    // Ids are numbers or strings; the serialized form tells 1 from "1"
+    std::string key;
+    llvm::raw_string_ostream stream(key);
+    stream << id;
+    stream.flush();
+    return key;
+}
+
+std::string RpcDispatcher::errorResponse(const llvm::json::Value& id, const RpcError& error) {
+    std::string response;
+    llvm::raw_string_ostream stream(response);
+    llvm::json::OStream out(stream);
+    out.object([&] {
+        out.attribute("jsonrpc", "2.0");
+        out.attribute("id", id);
+        out.attributeObject("error", [&] {
+            out.attribute("code", error.code);
+            out.attribute("message", error.message);
+        });
+    });
+    stream.flush();
+    return response;
+}
+
+} // namespace lsp
+} // namespace miko
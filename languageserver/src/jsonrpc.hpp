@@ -0,0 +1,146 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/JSON.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// JSON-RPC / LSP error codes
+enum RpcErrorCode {
+    RpcParseError = -32700,
+    RpcInvalidRequest = -32600,
+    RpcMethodNotFound = -32601,
+    RpcInvalidParams = -32602,
+    RpcInternalError = -32603,
+    RpcServerNotInitialized = -32002,
+    RpcRequestCancelled = -32800,
+};
+
+struct RpcError {
+    int code = 0; // 0 means success
+    std::string message;
+
+    explicit operator bool() const { return code != 0; }
+};
+
+// Splits a byte stream into message bodies framed by LSP base protocol
+// headers ("Content-Length: N\r\n\r\n" followed by N bytes). Input may
+// arrive in chunks of any size; bodies are returned once complete.
+class MessageFramer {
+public:
+    void append(const char* data, size_t size);
+    // Moves the next complete body into body; false until one is buffered
+    bool next(std::string& body);
+    // Set when a header block had no usable Content-Length
+    bool failed() const { return failed_; }
+
+private:
+    std::string buffer_;
+    size_t consumed_ = 0; // bytes of buffer_ already returned
+    bool failed_ = false;
+};
+
+std::string frameMessage(llvm::StringRef body);
+
+// Reads and writes framed messages on a pair of file descriptors (stdio or
+// pipes). Writes may come from any thread.
+class RpcConnection {
+public:
+    RpcConnection(int inputFd, int outputFd);
+
+    // Blocks for the next message; false at end of input or on a framing error
+    bool read(std::string& body);
+    bool write(llvm::StringRef body);
+
+private:
+    int inputFd_;
+    int outputFd_;
+    MessageFramer framer_;
+    std::mutex writeMutex_;
+};
+
+// Routes JSON-RPC messages to registered handlers. Notifications and
+// requests registered as ordered run on the calling thread, in arrival
+// order; other requests run on a worker pool, so responses can be sent out
+// of order. In-flight requests can be cancelled with $/cancelRequest.
+class RpcDispatcher {
+public:
+    // Returns true once the client cancelled the request
+    using CancelCheck = std::function<bool()>;
+    // Writes exactly one JSON value, the result, to out. On error the
+    // output is discarded and the error is sent instead.
+    using RequestHandler =
+        std::function<RpcError(const llvm::json::Value& params, llvm::json::OStream& out, const CancelCheck& isCancelled)>;
+    using NotificationHandler = std::function<void(const llvm::json::Value& params)>;
+    // Receives serialized responses, unframed
+    using Output = std::function<void(std::string message)>;
+
+    explicit RpcDispatcher(size_t workerCount);
+    ~RpcDispatcher();
+
+    RpcDispatcher(const RpcDispatcher&) = delete;
+    RpcDispatcher& operator=(const RpcDispatcher&) = delete;
+
+    void onRequest(std::string method, RequestHandler handler, bool ordered = false);
+    void onNotification(std::string method, NotificationHandler handler);
+
+    // Handles one message; responses go to output when ready
+    void dispatch(llvm::StringRef message, const Output& output);
+    // Handles one message to completion on the calling thread and returns
+    // the response, or an empty string for notifications
+    std::string dispatchSync(llvm::StringRef message);
+
+    // Waits until every request handed to the pool has been answered
+    void drain();
+    // Cancels in-flight requests and joins the workers
+    void shutdown();
+
+private:
+    struct RequestEntry {
+        RequestHandler handler;
+        bool ordered = false;
+    };
+
+    struct Pending {
+        const RequestHandler* handler = nullptr;
+        llvm::json::Value id = nullptr;
+        llvm::json::Value params = nullptr;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    void workerLoop();
+    std::string run(Pending& request);
+    void cancel(const llvm::json::Value& params);
+
+    static std::string idKey(const llvm::json::Value& id);
+    static std::string errorResponse(const llvm::json::Value& id, const RpcError& error);
+
+    std::map<std::string, RequestEntry> requests_;
+    std::map<std::string, NotificationHandler> notifications_;
+
+    // Requests waiting for or running on a worker, by id
+    std::map<std::string, std::shared_ptr<std::atomic<bool>>> inFlight_;
+    std::deque<std::pair<Pending, Output>> queue_;
+    size_t active_ = 0;
+    bool stopping_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable idleCondition_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,133 @@
+#include "language_options.hpp"
+#include <llvm/Support/Path.h>
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+// Other spellings clients use for the built-in languages
+llvm::StringRef canonicalLanguageId(llvm::StringRef languageId) {
+    if (languageId == "c++" || languageId == "cxx") return "cpp";
+    return languageId;
+}
+
+bool readStrings(const llvm::json::Object& object, llvm::StringRef key, std::vector<std::string>& out) {
+    const llvm::json::Value* value = object.get(key);
+    if (!value) return true;
+    const llvm::json::Array* array = value->getAsArray();
+    if (!array) return false;
+
+    std::vector<std::string> strings;
+    strings.reserve(array->size());
+    for (const llvm::json::Value& entry : *array) {
+        auto string = entry.getAsString();
+        if (!string) return false;
+        strings.push_back(string->str());
+    }
+    out = std::move(strings);
+    return true;
+}
+
+bool readString(const llvm::json::Object& object, llvm::StringRef key, std::string& out) {
+    const llvm::json::Value* value = object.get(key);
+    if (!value) return true;
+    auto string = value->getAsString();
+    if (!string) return false;
+    out = string->str();
+    return true;
+}
+
+} // namespace
+
+LanguageRegistry::LanguageRegistry() {
+    LanguageOptions c;
+    c.languageId = "c";
+    c.extensions = {"c"};
+    c.driver = "clang";
+    c.standard = "c17";
+
+    LanguageOptions cpp;
+    cpp.languageId = "cpp";
+    cpp.extensions = {"cpp", "cc", "cxx", "c++", "h", "hpp", "hh", "hxx", "inl", "ipp"};
+    cpp.driver = "clang++";
+    cpp.standard = "c++17";
+
+    // C last, so .c stays C even if the C++ list is extended with it
+    languages_.push_back(std::move(cpp));
+    languages_.push_back(std::move(c));
+}
+
+void LanguageRegistry::set(LanguageOptions options) {
+    options.languageId = canonicalLanguageId(options.languageId).str();
+    for (std::string& extension : options.extensions) {
+        extension = llvm::StringRef(extension).ltrim('.').lower();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(languages_.begin(), languages_.end(), [&](const LanguageOptions& language) {
+        return language.languageId == options.languageId;
+    });
+    if (it != languages_.end()) {
+        *it = std::move(options);
+    } else {
+        languages_.push_back(std::move(options));
+    }
+}
+
+LanguageOptions LanguageRegistry::options(llvm::StringRef languageId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (const LanguageOptions* language = find(canonicalLanguageId(languageId))) return *language;
+    LanguageOptions options;
+    options.languageId = canonicalLanguageId(languageId).str();
+    return options;
+}
+
+LanguageOptions LanguageRegistry::resolve(llvm::StringRef path, llvm::StringRef languageId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (const LanguageOptions* language = find(canonicalLanguageId(languageId))) return *language;
+
+    std::string extension = llvm::sys::path::extension(path).ltrim('.').lower();
+    if (!extension.empty()) {
+        for (auto it = languages_.rbegin(); it != languages_.rend(); ++it) {
+            if (llvm::is_contained(it->extensions, extension)) return *it;
+        }
+    }
+    if (const LanguageOptions* language = find("cpp")) return *language;
+    return languages_.front();
+}
+
+const LanguageOptions* LanguageRegistry::find(llvm::StringRef languageId) const {
+    if (languageId.empty()) return nullptr;
+    for (const LanguageOptions& language : languages_) {
+        if (language.languageId == languageId) return &language;
+    }
+    return nullptr;
+}
+
+clang::tooling::CompileCommand fallbackCompileCommand(const std::string& directory, const std::string& path,
+                                                      const LanguageOptions& language) {
+    std::vector<std::string> arguments{language.driver.empty() ? "clang++" : language.driver};
+    if (!language.standard.empty()) arguments.push_back("-std=" + language.standard);
+    arguments.push_back("-I" + directory);
+    arguments.push_back(path);
+
+    clang::tooling::CompileCommand command(directory, path, std::move(arguments), "");
+    addLanguageFlags(command, language);
+    return command;
+}
+
+void addLanguageFlags(clang::tooling::CompileCommand& command, const LanguageOptions& language) {
+    // Options may follow the input file; a "--" ends them, so insert before it
+    auto end = std::find(command.CommandLine.begin(), command.CommandLine.end(), "--");
+    command.CommandLine.insert(end, language.flags.begin(), language.flags.end());
+}
+
+bool parseLanguageOptions(const llvm::json::Object& object, LanguageOptions& options) {
+    return readStrings(object, "extensions", options.extensions) && readString(object, "driver", options.driver) &&
+           readString(object, "standard", options.standard) && readStrings(object, "flags", options.flags);
+}
+
+} // namespace lsp
+} // namespace miko
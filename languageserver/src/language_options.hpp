@@ -0,0 +1,51 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/JSON.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// The languages hosted by one server. C and C++ documents share the
+// document store, preamble cache, analysis workers and symbol index; only
+// their command lines differ. Analyses read it while the client may
+// reconfigure it, so every access is locked.
+class LanguageRegistry {
+public:
+    // Starts with C for .c files and C++ for everything else, headers
+    // included, unless the client says otherwise through the languageId
+    LanguageRegistry();
+
+    void set(LanguageOptions options);
+    // Current options of languageId; a language not registered yet starts
+    // out empty, so a partial update can be applied on top either way
+    LanguageOptions options(llvm::StringRef languageId) const;
+
+    // Options for a document: by languageId when it names a known language,
+    // otherwise by extension, otherwise C++
+    LanguageOptions resolve(llvm::StringRef path, llvm::StringRef languageId) const;
+
+private:
+    const LanguageOptions* find(llvm::StringRef languageId) const;
+
+    std::vector<LanguageOptions> languages_; // later entries win extensions
+    mutable std::mutex mutex_;
+};
+
+// Command for a file the compilation database doesn't list
+clang::tooling::CompileCommand fallbackCompileCommand(const std::string& directory, const std::string& path,
+                                                      const LanguageOptions& language);
+// Appends the language's flags, so they take precedence over the command's
+void addLanguageFlags(clang::tooling::CompileCommand& command, const LanguageOptions& language);
+
+// Reads {"extensions", "driver", "standard", "flags"} into options; members
+// the object leaves out keep their value. False on a member of the wrong type.
+bool parseLanguageOptions(const llvm::json::Object& object, LanguageOptions& options);
+
+} // namespace lsp
+} // namespace miko
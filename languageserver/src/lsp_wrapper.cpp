@@ -0,0 +1,1717 @@
+#include "lsp_wrapper.hpp"
+#include "analysis_scheduler.hpp"
+#include "ast_cache.hpp"
+#include "background_indexer.hpp"
+#include "code_completion.hpp"
+#include "document_store.hpp"
+#include "formatting.hpp"
+#include "jsonrpc.hpp"
+#include "language_options.hpp"
+#include "parsed_unit.hpp"
+#include "preamble_cache.hpp"
+#include "result_arena.hpp"
+#include "semantic_tokens.hpp"
+#include "symbol_index.hpp"
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Parse/ParseAST.h>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/ASTConsumer.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+// Quiet period after an edit before the document is re-analyzed
+constexpr std::chrono::milliseconds kChangeDebounce(300);
+// Completion answers within this budget, with partial results if need be
+constexpr std::chrono::milliseconds kCompletionBudget(50);
+constexpr size_t kMaxCompletionItems = 100;
+constexpr size_t kMaxWorkspaceSymbols = 100;
+
+inline bool isIdentifierChar(char c) {
+    // Bytes of multi-byte UTF-8 sequences count, for extended identifiers
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool parsePosition(const llvm::json::Object* obj, Position& position) {
+    if (!obj) return false;
+    auto line = obj->getInteger("line");
+    auto character = obj->getInteger("character");
+    if (!line || !character) return false;
+    position.line = static_cast<int>(*line);
+    position.character = static_cast<int>(*character);
+    return true;
+}
+
+bool parseRange(const llvm::json::Object* obj, Range& range) {
+    return obj && parsePosition(obj->getObject("start"), range.start) &&
+           parsePosition(obj->getObject("end"), range.end);
+}
+
+bool parseTextDocumentPosition(const llvm::json::Value& params, TextDocumentPositionParams& result) {
+    const llvm::json::Object* obj = params.getAsObject();
+    if (!obj) return false;
+    const llvm::json::Object* textDocument = obj->getObject("textDocument");
+    auto uri = textDocument ? textDocument->getString("uri") : std::nullopt;
+    if (!uri) return false;
+    result.textDocument.uri = uri->str();
+    return parsePosition(obj->getObject("position"), result.position);
+}
+
+// Results are streamed straight to the output instead of being built as a
+// json::Object tree first; completion and reference lists get large
+void writeRange(llvm::json::OStream& out, const Range& range) {
+    out.object([&] {
+        out.attributeObject("start", [&] {
+            out.attribute("line", range.start.line);
+            out.attribute("character", range.start.character);
+        });
+        out.attributeObject("end", [&] {
+            out.attribute("line", range.end.line);
+            out.attribute("character", range.end.character);
+        });
+    });
+}
+
+void writeLocations(llvm::json::OStream& out, const std::vector<Location>& locations) {
+    out.array([&] {
+        for (const auto& location : locations) {
+            out.object([&] {
+                out.attribute("uri", location.uri);
+                out.attributeBegin("range");
+                writeRange(out, location.range);
+                out.attributeEnd();
+            });
+        }
+    });
+}
+
+void writeTextEdits(llvm::json::OStream& out, const std::vector<TextEdit>& edits) {
+    out.array([&] {
+        for (const auto& edit : edits) {
+            out.object([&] {
+                out.attributeBegin("range");
+                writeRange(out, edit.range);
+                out.attributeEnd();
+                out.attribute("newText", edit.newText);
+            });
+        }
+    });
+}
+
+void writeCompletionList(llvm::json::OStream& out, const CompletionList& list) {
+    out.object([&] {
+        out.attribute("isIncomplete", list.isIncomplete);
+        out.attributeArray("items", [&] {
+            char sortText[16];
+            for (size_t i = 0; i < list.items.size(); ++i) {
+                const CompletionItem& item = list.items[i];
+                out.object([&] {
+                    out.attribute("label", item.label);
+                    out.attribute("detail", item.detail);
+                    out.attribute("documentation", item.documentation);
+                    out.attribute("insertText", item.insertText);
+                    out.attribute("kind", item.kind);
+                    // Keep the server's ranking when the client sorts
+                    std::snprintf(sortText, sizeof(sortText), "%04zu", i);
+                    out.attribute("sortText", sortText);
+                });
+            }
+        });
+    });
+}
+
+void writeHover(llvm::json::OStream& out, const HoverResult& hover) {
+    out.object([&] {
+        out.attribute("contents", hover.contents);
+        out.attributeBegin("range");
+        writeRange(out, hover.range);
+        out.attributeEnd();
+    });
+}
+
+void writeDiagnostics(llvm::json::OStream& out, const std::vector<Diagnostic>& diagnostics) {
+    out.array([&] {
+        for (const auto& diag : diagnostics) {
+            out.object([&] {
+                out.attributeBegin("range");
+                writeRange(out, diag.range);
+                out.attributeEnd();
+                out.attribute("severity", diag.severity);
+                out.attribute("message", diag.message);
+                out.attribute("source", diag.source);
+            });
+        }
+    });
+}
+
+void writeSymbols(llvm::json::OStream& out, const std::vector<SymbolInformation>& symbols) {
+    out.array([&] {
+        for (const auto& symbol : symbols) {
+            out.object([&] {
+                out.attribute("name", symbol.name);
+                out.attribute("kind", symbol.kind);
+                out.attributeObject("location", [&] {
+                    out.attribute("uri", symbol.location.uri);
+                    out.attributeBegin("range");
+                    writeRange(out, symbol.location.range);
+                    out.attributeEnd();
+                });
+            });
+        }
+    });
+}
+
+void writeTokenData(llvm::json::OStream& out, const std::vector<uint32_t>& data) {
+    out.array([&] {
+        for (uint32_t value : data) {
+            out.value(static_cast<int64_t>(value));
+        }
+    });
+}
+
+void writeSemanticTokens(llvm::json::OStream& out, const SemanticTokens& tokens) {
+    if (tokens.resultId.empty()) {
+        out.value(nullptr);
+        return;
+    }
+    out.object([&] {
+        out.attribute("resultId", tokens.resultId);
+        out.attributeBegin("data");
+        writeTokenData(out, tokens.data);
+        out.attributeEnd();
+    });
+}
+
+void writeMemoryUsage(llvm::json::OStream& out, const MemoryUsage& usage) {
+    auto hitRate = [](uint64_t hits, uint64_t misses) {
+        return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+    };
+    out.object([&] {
+        out.attributeObject("ast", [&] {
+            out.attribute("bytes", static_cast<int64_t>(usage.astBytes));
+            out.attribute("budget", static_cast<int64_t>(usage.astBudget));
+            out.attribute("entries", static_cast<int64_t>(usage.astEntries));
+            out.attribute("visibleEntries", static_cast<int64_t>(usage.astVisibleEntries));
+            out.attribute("hits", static_cast<int64_t>(usage.astHits));
+            out.attribute("misses", static_cast<int64_t>(usage.astMisses));
+            out.attribute("evictions", static_cast<int64_t>(usage.astEvictions));
+            out.attribute("hitRate", hitRate(usage.astHits, usage.astMisses));
+        });
+        out.attributeObject("preambles", [&] {
+            out.attribute("bytes", static_cast<int64_t>(usage.preambleBytes));
+            out.attribute("entries", static_cast<int64_t>(usage.preambleEntries));
+            out.attribute("hits", static_cast<int64_t>(usage.preambleHits));
+            out.attribute("builds", static_cast<int64_t>(usage.preambleBuilds));
+            out.attribute("hitRate", hitRate(usage.preambleHits, usage.preambleBuilds));
+        });
+        out.attributeObject("documents", [&] {
+            out.attribute("count", static_cast<int64_t>(usage.documents));
+            out.attribute("bytes", static_cast<int64_t>(usage.documentBytes));
+        });
+    });
+}
+
+void writeSemanticTokensDelta(llvm::json::OStream& out, const SemanticTokensDelta& delta) {
+    if (delta.resultId.empty()) {
+        out.value(nullptr);
+        return;
+    }
+    out.object([&] {
+        out.attribute("resultId", delta.resultId);
+        if (delta.full) {
+            out.attributeBegin("data");
+            writeTokenData(out, delta.data);
+            out.attributeEnd();
+            return;
+        }
+        out.attributeArray("edits", [&] {
+            for (const auto& edit : delta.edits) {
+                out.object([&] {
+                    out.attribute("start", static_cast<int64_t>(edit.start));
+                    out.attribute("deleteCount", static_cast<int64_t>(edit.deleteCount));
+                    out.attributeBegin("data");
+                    writeTokenData(out, edit.data);
+                    out.attributeEnd();
+                });
+            }
+        });
+    });
+}
+
+constexpr uint32_t kBinaryResultMagic = 0x31424C4D; // "MLB1"
+enum BinaryResultType : uint16_t { BinaryCompletion = 1, BinaryDiagnostics = 2 };
+
+void encodeCompletionList(llvm::raw_ostream& os, const CompletionList& list) {
+    BinaryWriter out(os);
+    out.u32(kBinaryResultMagic);
+    out.u16(BinaryCompletion);
+    out.u16(list.isIncomplete ? 1 : 0);
+    out.u32(static_cast<uint32_t>(list.items.size()));
+    for (const auto& item : list.items) {
+        out.u32(static_cast<uint32_t>(item.kind));
+        out.string(item.label);
+        out.string(item.detail);
+        out.string(item.insertText);
+        out.string(item.documentation);
+    }
+}
+
+void encodeDiagnostics(llvm::raw_ostream& os, const std::vector<Diagnostic>& diagnostics) {
+    BinaryWriter out(os);
+    out.u32(kBinaryResultMagic);
+    out.u16(BinaryDiagnostics);
+    out.u16(0);
+    out.u32(static_cast<uint32_t>(diagnostics.size()));
+    for (const auto& diag : diagnostics) {
+        out.u32(static_cast<uint32_t>(diag.range.start.line));
+        out.u32(static_cast<uint32_t>(diag.range.start.character));
+        out.u32(static_cast<uint32_t>(diag.range.end.line));
+        out.u32(static_cast<uint32_t>(diag.range.end.character));
+        out.u32(static_cast<uint32_t>(diag.severity));
+        out.string(diag.message);
+        out.string(diag.source);
+    }
+}
+
+// Serializes into the server's result arena and returns the view
+template <typename Writer>
+const char* writeView(LSPServer* server, size_t* length, Writer&& write) {
+    ResultArena& arena = server->resultArena();
+    write(arena.begin());
+    return arena.finish(length);
+}
+
+template <typename Writer>
+const char* jsonView(LSPServer* server, size_t* length, Writer&& write) {
+    return writeView(server, length, [&](llvm::raw_ostream& os) {
+        llvm::json::OStream out(os);
+        write(out);
+    });
+}
+
+TextDocumentPositionParams positionParams(const char* uri, int line, int character) {
+    TextDocumentPositionParams params;
+    params.textDocument.uri = std::string(uri);
+    params.position.line = line;
+    params.position.character = character;
+    return params;
+}
+
+template <typename Writer>
+std::string toJson(Writer&& write) {
+    std::string result;
+    llvm::raw_string_ostream os(result);
+    {
+        llvm::json::OStream out(os);
+        write(out);
+    }
+    os.flush();
+    return result;
+}
+
+char* toCString(const std::string& value) {
+    char* cstr = new char[value.length() + 1];
+    std::strcpy(cstr, value.c_str());
+    return cstr;
+}
+}
+
+// Implementation class using PIMPL pattern
+class LSPServer::Impl {
+public:
+    Impl() : initialized_(false), shutdown_(false) {
+        // Requests that only read state run concurrently; lifecycle
+        // requests and notifications keep their order
+        size_t workers = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+        dispatcher_ = std::make_unique<RpcDispatcher>(workers);
+        registerHandlers();
+    }
+    
+    ~Impl() {
+        dispatcher_->shutdown();
+        shutdown();
+    }
+    
+    bool initialize(const std::string& rootPath, const LSPCapabilities& capabilities) {
+        if (initialized_) return false;
+        
+        rootPath_ = rootPath;
+        capabilities_ = capabilities;
+        
+        // Initialize clang tooling
+        std::string errorMessage;
+        compilationDatabase_ = clang::tooling::JSONCompilationDatabase::loadFromDirectory(
+            rootPath, errorMessage);
+        // Without a database (or for files it doesn't list) compileCommandFor()
+        // falls back to a default command line
+        
+        // Half the cores, but at least one and at most four, so analysis
+        // never starves the editor
+        size_t workers = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+        scheduler_ = std::make_unique<AnalysisScheduler>(
+            workers, [this](const std::string& uri, uint64_t generation,
+                            const AnalysisScheduler::CancelCheck& isCancelled) {
+                runDiagnostics(uri, generation, isCancelled);
+            });
+        
+        // Indexing is throughput work: leave one core for the editor and
+        // the latency-sensitive analyses above
+        size_t indexWorkers = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+        indexer_ = std::make_unique<BackgroundIndexer>(rootPath + "/.cache/miko/index", index_, indexWorkers);
+        indexer_->start(compilationDatabase_.get());
+        
+        initialized_ = true;
+        return true;
+    }
+    
+    void shutdown() {
+        if (!initialized_ || shutdown_) return;
+        
+        shutdown_ = true;
+        // Join the workers before the state they use goes away
+        if (indexer_) {
+            indexer_->stop();
+            indexer_.reset();
+        }
+        if (scheduler_) {
+            scheduler_->shutdown();
+            scheduler_.reset();
+        }
+        asts_.clear();
+        preambles_.clear();
+        completionCache_.clear();
+        semanticTokens_.clear();
+        std::lock_guard<std::mutex> documentsLock(documentsMutex_);
+        std::lock_guard<std::mutex> diagnosticsLock(diagnosticsMutex_);
+        documents_.clear();
+        diagnostics_.clear();
+        initialized_ = false;
+    }
+    
+    void setLanguageOptions(const LanguageOptions& options) {
+        languages_.set(options);
+        if (!initialized_) return;
+        
+        // Results computed under the old command lines are stale
+        std::vector<std::string> uris;
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            for (const auto& entry : documents_) uris.push_back(entry.first);
+        }
+        for (const std::string& uri : uris) {
+            completionCache_.invalidate(uriToPath(uri));
+            semanticTokens_.invalidate(uri);
+            asts_.invalidate(uri);
+            scheduler_->schedule(uri, std::chrono::milliseconds(0));
+        }
+    }
+    
+    LanguageOptions languageOptions(const std::string& languageId) const {
+        return languages_.options(languageId);
+    }
+    
+    bool didOpen(const std::string& uri, const std::string& languageId, const std::string& text) {
+        if (!initialized_) return false;
+        
+        // Usually opened as saved; then the file on disk already says the same
+        auto onDisk = llvm::MemoryBuffer::getFile(uriToPath(uri), /*IsText=*/false,
+                                                  /*RequiresNullTerminator=*/false);
+        bool modified = !onDisk || (*onDisk)->getBuffer() != text;
+        
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            Document document(text, 0);
+            document.setLanguageId(languageId);
+            document.setModified(modified);
+            documents_[uri] = std::move(document);
+        }
+        
+        scheduler_->schedule(uri, std::chrono::milliseconds(0));
+        return true;
+    }
+    
+    bool didChange(const std::string& uri, const std::string& text) {
+        TextDocumentContentChange change;
+        change.text = text;
+        
+        int version = 0;
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it != documents_.end()) version = it->second.version() + 1;
+        }
+        return didChange(uri, version, {change});
+    }
+    
+    bool didChange(const std::string& uri, int version, const std::vector<TextDocumentContentChange>& changes) {
+        if (!initialized_) return false;
+        
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it == documents_.end()) {
+                // Range edits need a base text; a full replacement opens it
+                if (changes.empty() || changes.front().hasRange) return false;
+            }
+            
+            // Changes apply in order, each against the result of the last.
+            // A rejected change leaves the document and its version as they
+            // were: a single change fails before modifying anything, several
+            // go to a copy that replaces the document once all applied.
+            if (it != documents_.end() && changes.size() == 1) {
+                if (!it->second.applyChange(changes.front())) return false;
+            } else {
+                Document updated = it != documents_.end() ? it->second : Document();
+                for (const auto& change : changes) {
+                    if (!updated.applyChange(change)) return false;
+                }
+                if (it == documents_.end()) {
+                    it = documents_.emplace(uri, std::move(updated)).first;
+                } else {
+                    it->second = std::move(updated);
+                }
+            }
+            it->second.setVersion(version);
+            it->second.setModified(true);
+        }
+        
+        // Coalesce bursts of keystrokes into one analysis of the final text
+        scheduler_->schedule(uri, kChangeDebounce);
+        return true;
+    }
+    
+    bool didSave(const std::string& uri) {
+        if (!initialized_) return false;
+        
+        // Run full analysis on save, skipping any pending debounce
+        scheduler_->schedule(uri, std::chrono::milliseconds(0));
+        std::string languageId;
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it != documents_.end()) {
+                languageId = it->second.languageId();
+                it->second.setModified(false);
+            }
+        }
+        // The saved content is what the indexer reads from disk
+        std::string path = uriToPath(uri);
+        indexer_->enqueue(compileCommandFor(path, languageId));
+        llvm::StringRef filename = llvm::sys::path::filename(path);
+        if (filename == ".clang-format" || filename == "_clang-format") {
+            formatter_.invalidateStyles();
+        }
+        return true;
+    }
+    
+    bool didClose(const std::string& uri) {
+        if (!initialized_) return false;
+        
+        scheduler_->cancel(uri);
+        preambles_.invalidate(uriToPath(uri));
+        completionCache_.invalidate(uriToPath(uri));
+        semanticTokens_.invalidate(uri);
+        asts_.invalidate(uri);
+        
+        std::lock_guard<std::mutex> documentsLock(documentsMutex_);
+        std::lock_guard<std::mutex> diagnosticsLock(diagnosticsMutex_);
+        documents_.erase(uri);
+        diagnostics_.erase(uri);
+        
+        return true;
+    }
+    
+    CompletionList completion(const TextDocumentPositionParams& params,
+                              const std::function<bool()>& isCancelled = nullptr) {
+        CompletionList list;
+        if (!initialized_) return list;
+        
+        CompletionClock::time_point deadline = CompletionClock::now() + kCompletionBudget;
+        const std::string& uri = params.textDocument.uri;
+        
+        std::string text;
+        std::string languageId;
+        size_t cursor = 0;
+        unsigned line = 0;
+        size_t lineStart = 0;
+        std::map<std::string, std::string> openFiles;
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it == documents_.end()) return list;
+            const Document& document = it->second;
+            text = document.text();
+            languageId = document.languageId();
+            cursor = document.offsetAt(params.position);
+            line = static_cast<unsigned>(document.positionAt(cursor).line);
+            lineStart = document.offsetAt(Position{static_cast<int>(line), 0});
+            openFiles = snapshotModifiedFiles();
+        }
+        
+        // Complete at the start of the identifier under the cursor, so every
+        // keystroke within it maps to the same cache entry
+        size_t anchor = cursor;
+        while (anchor > lineStart && isIdentifierChar(text[anchor - 1])) {
+            --anchor;
+        }
+        std::string prefix = text.substr(anchor, cursor - anchor);
+        uint64_t contextHash = llvm::xxh3_64bits(llvm::StringRef(text).take_front(anchor));
+        
+        std::string path = uriToPath(uri);
+        std::shared_ptr<const CompletionResults> results = completionCache_.find(path, anchor, contextHash, prefix);
+        if (!results) {
+            clang::tooling::CompileCommand command = compileCommandFor(path, languageId);
+            
+            ParseInputs inputs;
+            inputs.path = path;
+            inputs.contents = std::move(text);
+            inputs.directory = command.Directory;
+            inputs.arguments = std::move(command.CommandLine);
+            inputs.vfs = buildOverlayFileSystem(openFiles);
+            
+            results = runCodeCompletion(inputs, line + 1, static_cast<unsigned>(anchor - lineStart) + 1, anchor,
+                                        prefix, preambles_, deadline, isCancelled);
+            if (!results) return list;
+            // Partial results would hide candidates from later keystrokes
+            if (results->complete) {
+                completionCache_.store(path, anchor, contextHash, results);
+            }
+        }
+        
+        list.isIncomplete = !results->complete;
+        for (const CompletionCandidate* candidate :
+             rankCompletions(*results, prefix, kMaxCompletionItems, deadline, list.isIncomplete, isCancelled)) {
+            CompletionItem item;
+            item.label = candidate->label;
+            item.detail = candidate->detail;
+            item.documentation = candidate->documentation;
+            item.insertText = candidate->filterText;
+            item.kind = candidate->kind;
+            list.items.push_back(std::move(item));
+        }
+        
+        return list;
+    }
+    
+    HoverResult hover(const TextDocumentPositionParams& params) {
+        HoverResult result;
+        
+        if (!initialized_) return result;
+        
+        // Basic hover information
+        result.contents = "C/C++ symbol information";
+        result.range.start = params.position;
+        result.range.end = params.position;
+        result.range.end.character += 5; // Approximate word length
+        
+        return result;
+    }
+    
+    std::vector<Location> definition(const TextDocumentPositionParams& params) {
+        if (!initialized_) return {};
+        
+        std::string usr = index_.usrAt(uriToPath(params.textDocument.uri), params.position);
+        if (usr.empty()) return {};
+        
+        // Symbols defined outside the project (or not indexed yet) still
+        // have a declaration to jump to
+        std::vector<IndexLocation> found = index_.lookup(usr, IndexRoleDefinition);
+        if (found.empty()) found = index_.lookup(usr, IndexRoleDeclaration);
+        return toLocations(found);
+    }
+    
+    std::vector<Location> references(const TextDocumentPositionParams& params,
+                                     const std::function<bool()>& isCancelled = nullptr) {
+        if (!initialized_) return {};
+        
+        std::string usr = index_.usrAt(uriToPath(params.textDocument.uri), params.position);
+        if (usr.empty()) return {};
+        
+        return toLocations(
+            index_.lookup(usr, IndexRoleDeclaration | IndexRoleDefinition | IndexRoleReference, isCancelled));
+    }
+    
+    static std::vector<Location> toLocations(const std::vector<IndexLocation>& found) {
+        std::vector<Location> locations;
+        locations.reserve(found.size());
+        for (const auto& location : found) {
+            locations.push_back({pathToUri(location.path), location.range});
+        }
+        return locations;
+    }
+    
+    std::vector<SymbolInformation> workspaceSymbol(const std::string& query,
+                                                   const std::function<bool()>& isCancelled = nullptr) {
+        std::vector<SymbolInformation> symbols;
+        if (!initialized_) return symbols;
+        
+        for (auto& result : index_.searchSymbols(query, kMaxWorkspaceSymbols, isCancelled)) {
+            SymbolInformation symbol;
+            symbol.name = std::move(result.name);
+            symbol.kind = result.kind;
+            symbol.location = {pathToUri(result.path), result.range};
+            symbols.push_back(std::move(symbol));
+        }
+        return symbols;
+    }
+    
+    std::vector<Diagnostic> getDiagnostics(const std::string& uri) {
+        std::lock_guard<std::mutex> lock(diagnosticsMutex_);
+        auto it = diagnostics_.find(uri);
+        if (it != diagnostics_.end()) {
+            return it->second;
+        }
+        return {};
+    }
+    
+    SemanticTokens semanticTokens(const std::string& uri, const std::function<bool()>& isCancelled = nullptr) {
+        SemanticTokens result;
+        SemanticTokensCache::Data tokens = currentSemanticTokens(uri, isCancelled);
+        if (!tokens) return result;
+        
+        result.resultId = semanticTokens_.publish(uri, tokens);
+        result.data = *tokens;
+        return result;
+    }
+    
+    SemanticTokensDelta semanticTokensDelta(const std::string& uri, const std::string& previousResultId,
+                                            const std::function<bool()>& isCancelled = nullptr) {
+        SemanticTokensDelta result;
+        SemanticTokensCache::Data tokens = currentSemanticTokens(uri, isCancelled);
+        if (!tokens) return result;
+        
+        SemanticTokensCache::Data previous = semanticTokens_.sent(uri, previousResultId);
+        result.resultId = semanticTokens_.publish(uri, tokens);
+        if (previous) {
+            result.edits = diffSemanticTokens(*previous, *tokens);
+        } else {
+            result.full = true;
+            result.data = *tokens;
+        }
+        return result;
+    }
+    
+    std::vector<TextEdit> formatDocument(const std::string& uri, const std::function<bool()>& isCancelled = nullptr) {
+        Document document;
+        if (!copyDocument(uri, document)) return {};
+        return formatter_.formatDocument(uriToPath(uri), document, isCancelled);
+    }
+    
+    std::vector<TextEdit> formatRange(const std::string& uri, const Range& range,
+                                      const std::function<bool()>& isCancelled = nullptr) {
+        Document document;
+        if (!copyDocument(uri, document)) return {};
+        return formatter_.formatRange(uriToPath(uri), document, range, isCancelled);
+    }
+    
+    std::vector<TextEdit> formatOnType(const std::string& uri, const Position& position, const std::string& ch,
+                                       const std::function<bool()>& isCancelled = nullptr) {
+        Document document;
+        if (!copyDocument(uri, document)) return {};
+        return formatter_.formatOnType(uriToPath(uri), document, position, ch, isCancelled);
+    }
+    
+    // Copy of an open document, so clang-format runs without holding the lock
+    bool copyDocument(const std::string& uri, Document& document) {
+        if (!initialized_) return false;
+        std::lock_guard<std::mutex> lock(documentsMutex_);
+        auto it = documents_.find(uri);
+        if (it == documents_.end()) return false;
+        document = it->second;
+        return true;
+    }
+    
+    std::string processMessage(const std::string& jsonMessage) {
+        return dispatcher_->dispatchSync(jsonMessage);
+    }
+    
+    int serve(int inputFd, int outputFd) {
+        RpcConnection connection(inputFd, outputFd);
+        RpcDispatcher::Output reply = [&connection](std::string message) { connection.write(message); };
+        // Diagnostics are pushed to the client as notifications
+        std::function<void(const std::string&)> previousCallback =
+            exchangeMessageCallback([&connection](const std::string& message) { connection.write(message); });
+        
+        std::string message;
+        while (!exitRequested_ && connection.read(message)) {
+            dispatcher_->dispatch(message, reply);
+        }
+        
+        // Answer what is in flight, then stop the analyses that could still
+        // publish through the connection
+        dispatcher_->drain();
+        shutdown();
+        exchangeMessageCallback(std::move(previousCallback));
+        // The protocol asks for a failure code when exit comes without shutdown
+        return shutdownRequested_ ? 0 : 1;
+    }
+    
+    void setMessageCallback(std::function<void(const std::string&)> callback) {
+        exchangeMessageCallback(std::move(callback));
+    }
+    
+    // Analyses call the callback on scheduler threads, under the same lock
+    std::function<void(const std::string&)> exchangeMessageCallback(std::function<void(const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(diagnosticsMutex_);
+        std::swap(messageCallback_, callback);
+        return callback;
+    }
+    
+    AnalysisStats analysisStats() const {
+        return scheduler_ ? scheduler_->stats() : AnalysisStats{};
+    }
+    
+    void setVisibleDocuments(const std::vector<std::string>& uris) {
+        asts_.setVisible(uris);
+    }
+    
+    void setAstCacheBudget(size_t bytes) {
+        asts_.setBudget(bytes);
+    }
+    
+    MemoryUsage memoryUsage() {
+        MemoryUsage usage;
+        AstCache::Stats asts = asts_.stats();
+        usage.astBytes = asts.bytes;
+        usage.astBudget = asts.budget;
+        usage.astEntries = asts.entries;
+        usage.astVisibleEntries = asts.visibleEntries;
+        usage.astHits = asts.hits;
+        usage.astMisses = asts.misses;
+        usage.astEvictions = asts.evictions;
+        
+        PreambleCache::Stats preambles = preambles_.stats();
+        usage.preambleBytes = preambles.bytes;
+        usage.preambleEntries = preambles.entries;
+        usage.preambleHits = preambles.hits;
+        usage.preambleBuilds = preambles.builds;
+        
+        std::lock_guard<std::mutex> lock(documentsMutex_);
+        usage.documents = documents_.size();
+        for (const auto& entry : documents_) usage.documentBytes += entry.second.length();
+        return usage;
+    }
+    
+    ResultArena& resultArena() {
+        return resultArena_;
+    }
+
+private:
+    void registerHandlers() {
+        RpcDispatcher& rpc = *dispatcher_;
+        
+        rpc.onRequest("initialize", [this](const llvm::json::Value& params, llvm::json::OStream& out,
+                                           const RpcDispatcher::CancelCheck&) {
+            const llvm::json::Object* obj = params.getAsObject();
+            if (!initialized_ && obj) {
+                std::string rootPath;
+                if (auto rootUri = obj->getString("rootUri")) {
+                    rootPath = uriToPath(rootUri->str());
+                } else if (auto path = obj->getString("rootPath")) {
+                    rootPath = path->str();
+                }
+                const llvm::json::Object* initOptions = obj->getObject("initializationOptions");
+                if (auto budget = initOptions ? initOptions->getInteger("astCacheBudgetMB") : std::nullopt) {
+                    if (*budget > 0) setAstCacheBudget(static_cast<size_t>(*budget) << 20);
+                }
+                // initializationOptions.languages: {"<languageId>": {options}}
+                const llvm::json::Object* languages = initOptions ? initOptions->getObject("languages") : nullptr;
+                if (languages) {
+                    for (const auto& [id, value] : *languages) {
+                        const llvm::json::Object* object = value.getAsObject();
+                        if (!object) continue;
+                        LanguageOptions options = languages_.options(id);
+                        if (parseLanguageOptions(*object, options)) setLanguageOptions(options);
+                    }
+                }
+                if (!rootPath.empty()) initialize(rootPath, LSPCapabilities());
+            }
+            out.value(createInitializeResult());
+            return RpcError{};
+        }, /*ordered=*/true);
+        
+        rpc.onRequest("shutdown", [this](const llvm::json::Value&, llvm::json::OStream& out,
+                                         const RpcDispatcher::CancelCheck&) {
+            shutdownRequested_ = true;
+            out.value(nullptr);
+            return RpcError{};
+        }, /*ordered=*/true);
+        
+        rpc.onNotification("initialized", [](const llvm::json::Value&) {});
+        rpc.onNotification("exit", [this](const llvm::json::Value&) { exitRequested_ = true; });
+        
+        // Changes on disk, e.g. from the editor's workspace file watcher
+        rpc.onNotification("workspace/didChangeWatchedFiles", [this](const llvm::json::Value& params) {
+            const llvm::json::Object* obj = params.getAsObject();
+            const llvm::json::Array* changes = obj ? obj->getArray("changes") : nullptr;
+            if (!changes || !initialized_ || !indexer_) return;
+            for (const auto& entry : *changes) {
+                const llvm::json::Object* change = entry.getAsObject();
+                auto uri = change ? change->getString("uri") : std::nullopt;
+                if (uri) indexer_->fileChanged(uriToPath(uri->str()));
+            }
+        });
+        
+        for (const char* method : {"textDocument/didOpen", "textDocument/didChange",
+                                   "textDocument/didSave", "textDocument/didClose"}) {
+            std::string name = method;
+            rpc.onNotification(name, [this, name](const llvm::json::Value& params) {
+                handleDocumentNotification(name, params.getAsObject());
+            });
+        }
+        
+        onPositionRequest("textDocument/completion", [this](const TextDocumentPositionParams& params,
+                                                            llvm::json::OStream& out,
+                                                            const RpcDispatcher::CancelCheck& isCancelled) {
+            writeCompletionList(out, completion(params, isCancelled));
+        });
+        onPositionRequest("textDocument/hover", [this](const TextDocumentPositionParams& params,
+                                                       llvm::json::OStream& out, const RpcDispatcher::CancelCheck&) {
+            writeHover(out, hover(params));
+        });
+        onPositionRequest("textDocument/definition", [this](const TextDocumentPositionParams& params,
+                                                            llvm::json::OStream& out,
+                                                            const RpcDispatcher::CancelCheck&) {
+            writeLocations(out, definition(params));
+        });
+        onPositionRequest("textDocument/references", [this](const TextDocumentPositionParams& params,
+                                                            llvm::json::OStream& out,
+                                                            const RpcDispatcher::CancelCheck& isCancelled) {
+            writeLocations(out, references(params, isCancelled));
+        });
+        rpc.onRequest("workspace/symbol", [this](const llvm::json::Value& params, llvm::json::OStream& out,
+                                                 const RpcDispatcher::CancelCheck& isCancelled) {
+            if (!initialized_) return RpcError{RpcServerNotInitialized, "Server not initialized"};
+            const llvm::json::Object* obj = params.getAsObject();
+            auto query = obj ? obj->getString("query") : std::nullopt;
+            if (!query) return RpcError{RpcInvalidParams, "Invalid params"};
+            writeSymbols(out, workspaceSymbol(query->str(), isCancelled));
+            return RpcError{};
+        });
+        // Not part of LSP: the editor reports which documents are on screen
+        // so their ASTs outlive those of background tabs
+        rpc.onNotification("$/visibleDocuments", [this](const llvm::json::Value& params) {
+            const llvm::json::Object* obj = params.getAsObject();
+            const llvm::json::Array* uris = obj ? obj->getArray("uris") : nullptr;
+            if (!uris) return;
+            std::vector<std::string> visible;
+            for (const auto& uri : *uris) {
+                if (auto string = uri.getAsString()) visible.push_back(string->str());
+            }
+            setVisibleDocuments(visible);
+        });
+        rpc.onRequest("$/memoryUsage", [this](const llvm::json::Value&, llvm::json::OStream& out,
+                                              const RpcDispatcher::CancelCheck&) {
+            writeMemoryUsage(out, memoryUsage());
+            return RpcError{};
+        });
+        onDocumentRequest("textDocument/semanticTokens/full", [this](const std::string& uri,
+                                                                     const llvm::json::Object&,
+                                                                     llvm::json::OStream& out,
+                                                                     const RpcDispatcher::CancelCheck& isCancelled) {
+            writeSemanticTokens(out, semanticTokens(uri, isCancelled));
+        });
+        onDocumentRequest("textDocument/semanticTokens/full/delta", [this](const std::string& uri,
+                                                                           const llvm::json::Object& params,
+                                                                           llvm::json::OStream& out,
+                                                                           const RpcDispatcher::CancelCheck& isCancelled) {
+            auto previousResultId = params.getString("previousResultId");
+            writeSemanticTokensDelta(
+                out, semanticTokensDelta(uri, previousResultId ? previousResultId->str() : "", isCancelled));
+        });
+        onDocumentRequest("textDocument/formatting", [this](const std::string& uri, const llvm::json::Object&,
+                                                            llvm::json::OStream& out,
+                                                            const RpcDispatcher::CancelCheck& isCancelled) {
+            writeTextEdits(out, formatDocument(uri, isCancelled));
+        });
+        onDocumentRequest("textDocument/rangeFormatting", [this](const std::string& uri,
+                                                                 const llvm::json::Object& params,
+                                                                 llvm::json::OStream& out,
+                                                                 const RpcDispatcher::CancelCheck& isCancelled) {
+            Range range;
+            if (!parseRange(params.getObject("range"), range)) {
+                out.array([] {});
+                return;
+            }
+            writeTextEdits(out, formatRange(uri, range, isCancelled));
+        });
+        onDocumentRequest("textDocument/onTypeFormatting", [this](const std::string& uri,
+                                                                  const llvm::json::Object& params,
+                                                                  llvm::json::OStream& out,
+                                                                  const RpcDispatcher::CancelCheck& isCancelled) {
+            Position position;
+            auto ch = params.getString("ch");
+            if (!parsePosition(params.getObject("position"), position) || !ch) {
+                out.array([] {});
+                return;
+            }
+            writeTextEdits(out, formatOnType(uri, position, ch->str(), isCancelled));
+        });
+    }
+    
+    // Registers a request whose params carry a textDocument
+    void onDocumentRequest(std::string method,
+                           std::function<void(const std::string& uri, const llvm::json::Object& params,
+                                              llvm::json::OStream&, const RpcDispatcher::CancelCheck&)> handler) {
+        dispatcher_->onRequest(std::move(method), [this, handler](const llvm::json::Value& params,
+                                                                  llvm::json::OStream& out,
+                                                                  const RpcDispatcher::CancelCheck& isCancelled) {
+            if (!initialized_) return RpcError{RpcServerNotInitialized, "Server not initialized"};
+            const llvm::json::Object* obj = params.getAsObject();
+            const llvm::json::Object* textDocument = obj ? obj->getObject("textDocument") : nullptr;
+            auto uri = textDocument ? textDocument->getString("uri") : std::nullopt;
+            if (!uri) return RpcError{RpcInvalidParams, "Invalid params"};
+            handler(uri->str(), *obj, out, isCancelled);
+            return RpcError{};
+        });
+    }
+    
+    // Registers a request taking TextDocumentPositionParams
+    void onPositionRequest(std::string method,
+                           std::function<void(const TextDocumentPositionParams&, llvm::json::OStream&,
+                                              const RpcDispatcher::CancelCheck&)> handler) {
+        dispatcher_->onRequest(std::move(method), [this, handler](const llvm::json::Value& params,
+                                                                  llvm::json::OStream& out,
+                                                                  const RpcDispatcher::CancelCheck& isCancelled) {
+            if (!initialized_) return RpcError{RpcServerNotInitialized, "Server not initialized"};
+            TextDocumentPositionParams position;
+            if (!parseTextDocumentPosition(params, position)) return RpcError{RpcInvalidParams, "Invalid params"};
+            handler(position, out, isCancelled);
+            return RpcError{};
+        });
+    }
+    
+    void handleDocumentNotification(llvm::StringRef method, const llvm::json::Object* params) {
+        if (!params) return;
+        const llvm::json::Object* textDocument = params->getObject("textDocument");
+        if (!textDocument) return;
+        auto uri = textDocument->getString("uri");
+        if (!uri) return;
+        
+        if (method == "textDocument/didOpen") {
+            auto languageId = textDocument->getString("languageId");
+            auto text = textDocument->getString("text");
+            if (!text) return;
+            didOpen(uri->str(), languageId ? languageId->str() : "", text->str());
+            auto version = textDocument->getInteger("version");
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri->str());
+            if (version && it != documents_.end()) {
+                it->second.setVersion(static_cast<int>(*version));
+            }
+        } else if (method == "textDocument/didChange") {
+            const llvm::json::Array* contentChanges = params->getArray("contentChanges");
+            if (!contentChanges) return;
+            
+            // A malformed entry rejects the whole notification; applying the
+            // rest would put later ranges against the wrong text
+            std::vector<TextDocumentContentChange> changes;
+            changes.reserve(contentChanges->size());
+            for (const auto& entry : *contentChanges) {
+                const llvm::json::Object* changeObj = entry.getAsObject();
+                if (!changeObj) return;
+                auto text = changeObj->getString("text");
+                if (!text) return;
+                
+                TextDocumentContentChange change;
+                change.text = text->str();
+                change.hasRange = parseRange(changeObj->getObject("range"), change.range);
+                // A range that doesn't parse is not a full replacement
+                if (!change.hasRange && changeObj->get("range")) return;
+                changes.push_back(std::move(change));
+            }
+            
+            auto version = textDocument->getInteger("version");
+            didChange(uri->str(), version ? static_cast<int>(*version) : 0, changes);
+        } else if (method == "textDocument/didSave") {
+            didSave(uri->str());
+        } else if (method == "textDocument/didClose") {
+            didClose(uri->str());
+        }
+    }
+    
+    void runDiagnostics(const std::string& uri, uint64_t generation,
+                        const AnalysisScheduler::CancelCheck& isCancelled) {
+        // Analyze a snapshot of the latest text; edits made meanwhile bump
+        // the generation and schedule another pass
+        DocumentSnapshot snapshot;
+        if (!snapshotDocument(uri, snapshot)) return;
+        
+        uint64_t astKey = 0;
+        std::unique_ptr<ParsedUnit> unit = parseSnapshot(snapshot, astKey, isCancelled);
+        if (!unit) return;
+        std::vector<Diagnostic> diags = unit->diagnostics();
+        // The AST is at hand; have the tokens ready for the client's
+        // request that usually follows an edit
+        if (capabilities_.semanticTokens && !isCancelled()) {
+            semanticTokens_.store(uri, snapshot.version, snapshot.contentHash,
+                                  std::make_shared<const std::vector<uint32_t>>(collectSemanticTokens(*unit)));
+        }
+        // Still valid for its snapshot even when this pass was superseded
+        asts_.put(uri, snapshot.version, astKey, std::move(unit));
+        if (isCancelled()) return;
+        
+        std::lock_guard<std::mutex> lock(diagnosticsMutex_);
+        // Never let a superseded pass overwrite newer results
+        if (!scheduler_->isCurrent(uri, generation)) return;
+        diagnostics_[uri] = diags;
+        
+        // Notify callback if set
+        if (messageCallback_) {
+            std::string notification = createDiagnosticsNotification(uri, diags);
+            messageCallback_(notification);
+        }
+    }
+    
+    // Tokens for the document as it is now: cached when this version was
+    // already analyzed, otherwise computed from a fresh parse. nullptr once
+    // isCancelled() reports the request was cancelled.
+    SemanticTokensCache::Data currentSemanticTokens(const std::string& uri,
+                                                    const std::function<bool()>& isCancelled) {
+        if (!initialized_ || !capabilities_.semanticTokens) return nullptr;
+        
+        // Most requests follow an analysis that left the tokens cached;
+        // those need no snapshot
+        int version = 0;
+        uint64_t contentHash = 0;
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it == documents_.end()) return nullptr;
+            version = it->second.version();
+            contentHash = llvm::xxh3_64bits(it->second.text());
+        }
+        if (SemanticTokensCache::Data cached = semanticTokens_.find(uri, version, contentHash)) {
+            return cached;
+        }
+        
+        DocumentSnapshot snapshot;
+        if (!snapshotDocument(uri, snapshot)) return nullptr;
+        
+        uint64_t astKey = 0;
+        std::unique_ptr<ParsedUnit> unit = parseSnapshot(snapshot, astKey, isCancelled);
+        if (!unit) return nullptr;
+        if (isCancelled && isCancelled()) {
+            // The parse is still good for the next request
+            asts_.put(uri, snapshot.version, astKey, std::move(unit));
+            return nullptr;
+        }
+        auto tokens = std::make_shared<const std::vector<uint32_t>>(collectSemanticTokens(*unit));
+        semanticTokens_.store(uri, snapshot.version, snapshot.contentHash, tokens);
+        asts_.put(uri, snapshot.version, astKey, std::move(unit));
+        return tokens;
+    }
+    
+    // What an analysis of an open document reads, copied under the lock
+    struct DocumentSnapshot {
+        std::string uri;
+        std::string text;
+        std::string languageId;
+        int version = 0;
+        uint64_t contentHash = 0;
+        std::map<std::string, std::string> openFiles; // modified documents only
+        std::map<std::string, uint64_t> openFileHashes;
+    };
+    
+    bool snapshotDocument(const std::string& uri, DocumentSnapshot& snapshot) {
+        {
+            std::lock_guard<std::mutex> lock(documentsMutex_);
+            auto it = documents_.find(uri);
+            if (it == documents_.end()) return false;
+            snapshot.uri = uri;
+            snapshot.text = it->second.text();
+            snapshot.languageId = it->second.languageId();
+            snapshot.version = it->second.version();
+            snapshot.openFiles = snapshotModifiedFiles();
+        }
+        snapshot.contentHash = llvm::xxh3_64bits(snapshot.text);
+        for (const auto& [path, text] : snapshot.openFiles) {
+            snapshot.openFileHashes.emplace(path, llvm::xxh3_64bits(text));
+        }
+        return true;
+    }
+    
+    // The snapshot's AST: the cached one when it was parsed from the same
+    // text and command line and the open documents it read are unchanged,
+    // otherwise a new parse on top of the preamble. astKey is what the unit
+    // goes back into asts_ under.
+    std::unique_ptr<ParsedUnit> parseSnapshot(const DocumentSnapshot& snapshot, uint64_t& astKey,
+                                              const std::function<bool()>& isCancelled) {
+        std::string path = uriToPath(snapshot.uri);
+        clang::tooling::CompileCommand command = compileCommandFor(path, snapshot.languageId);
+        astKey = static_cast<uint64_t>(llvm::hash_combine(
+            snapshot.contentHash, command.Directory,
+            llvm::hash_combine_range(command.CommandLine.begin(), command.CommandLine.end())));
+        // Edits to documents it doesn't include leave a cached unit valid
+        std::unique_ptr<ParsedUnit> cached = asts_.take(snapshot.uri, astKey);
+        if (cached && cached->openFilesMatch(snapshot.openFileHashes)) return cached;
+        
+        ParseInputs inputs;
+        inputs.path = path;
+        inputs.contents = snapshot.text;
+        inputs.directory = command.Directory;
+        inputs.arguments = std::move(command.CommandLine);
+        inputs.vfs = buildOverlayFileSystem(snapshot.openFiles);
+        inputs.openFileHashes = snapshot.openFileHashes;
+        return ParsedUnit::build(inputs, preambles_, isCancelled);
+    }
+    
+    // Path -> text of the open documents that differ from disk, for the VFS
+    // overlay; documentsMutex_ must be held. The others read the same from
+    // disk, so leaving them out changes nothing a parse or the per-path
+    // preamble's reuse check sees. The document being analyzed is passed
+    // as the main file's contents instead.
+    std::map<std::string, std::string> snapshotModifiedFiles() const {
+        std::map<std::string, std::string> openFiles;
+        for (const auto& [uri, document] : documents_) {
+            if (document.modified()) openFiles[uriToPath(uri)] = document.text();
+        }
+        return openFiles;
+    }
+    
+    // The database's command when it lists the file, otherwise one built
+    // from the document's language options
+    clang::tooling::CompileCommand compileCommandFor(const std::string& path, const std::string& languageId) {
+        LanguageOptions language = languages_.resolve(path, languageId);
+        if (compilationDatabase_) {
+            std::vector<clang::tooling::CompileCommand> commands = compilationDatabase_->getCompileCommands(path);
+            if (!commands.empty()) {
+                addLanguageFlags(commands.front(), language);
+                return std::move(commands.front());
+            }
+        }
+        return fallbackCompileCommand(rootPath_, path, language);
+    }
+    
+    llvm::json::Object createInitializeResult() {
+        llvm::json::Object capabilities;
+        capabilities["textDocumentSync"] = llvm::json::Object{
+            {"openClose", true},
+            {"change", 2}, // Incremental
+            {"save", true}
+        };
+        capabilities["completionProvider"] = llvm::json::Object{{"triggerCharacters", llvm::json::Array{".", "->", "::"}}};
+        capabilities["hoverProvider"] = true;
+        capabilities["definitionProvider"] = true;
+        capabilities["referencesProvider"] = true;
+        capabilities["workspaceSymbolProvider"] = capabilities_.workspaceSymbol;
+        capabilities["documentFormattingProvider"] = capabilities_.documentFormatting;
+        capabilities["documentRangeFormattingProvider"] = capabilities_.documentRangeFormatting;
+        if (capabilities_.documentFormatting) {
+            capabilities["documentOnTypeFormattingProvider"] = llvm::json::Object{
+                {"firstTriggerCharacter", "}"},
+                {"moreTriggerCharacter", llvm::json::Array{";", "\n"}}
+            };
+        }
+        if (capabilities_.semanticTokens) {
+            llvm::json::Array tokenTypes;
+            for (const char* name : semanticTokenTypeNames()) tokenTypes.push_back(name);
+            llvm::json::Array tokenModifiers;
+            for (const char* name : semanticTokenModifierNames()) tokenModifiers.push_back(name);
+            capabilities["semanticTokensProvider"] = llvm::json::Object{
+                {"legend", llvm::json::Object{{"tokenTypes", std::move(tokenTypes)},
+                                              {"tokenModifiers", std::move(tokenModifiers)}}},
+                {"full", llvm::json::Object{{"delta", true}}}
+            };
+        }
+        
+        llvm::json::Object serverInfo;
+        serverInfo["name"] = "Miko C/C++ LSP";
+        serverInfo["version"] = "1.0.0";
+        
+        llvm::json::Object result;
+        result["capabilities"] = std::move(capabilities);
+        result["serverInfo"] = std::move(serverInfo);
+        
+        return result;
+    }
+    
+    std::string createDiagnosticsNotification(const std::string& uri, const std::vector<Diagnostic>& diagnostics) {
+        return toJson([&](llvm::json::OStream& out) {
+            out.object([&] {
+                out.attribute("jsonrpc", "2.0");
+                out.attribute("method", "textDocument/publishDiagnostics");
+                out.attributeObject("params", [&] {
+                    out.attribute("uri", uri);
+                    out.attributeBegin("diagnostics");
+                    writeDiagnostics(out, diagnostics);
+                    out.attributeEnd();
+                });
+            });
+        });
+    }
+    
+    std::atomic<bool> initialized_;
+    bool shutdown_;
+    std::atomic<bool> shutdownRequested_{false};
+    std::atomic<bool> exitRequested_{false};
+    std::string rootPath_;
+    LSPCapabilities capabilities_;
+    
+    std::unique_ptr<clang::tooling::CompilationDatabase> compilationDatabase_;
+    LanguageRegistry languages_;
+    
+    std::map<std::string, Document> documents_;
+    std::mutex documentsMutex_;
+    
+    std::map<std::string, std::vector<Diagnostic>> diagnostics_;
+    std::mutex diagnosticsMutex_;
+    
+    std::unique_ptr<AnalysisScheduler> scheduler_;
+    PreambleCache preambles_;
+    CompletionCache completionCache_;
+    AstCache asts_;
+    SemanticTokensCache semanticTokens_;
+    Formatter formatter_;
+    
+    SymbolIndex index_;
+    std::unique_ptr<BackgroundIndexer> indexer_;
+    
+    std::function<void(const std::string&)> messageCallback_; // guarded by diagnosticsMutex_
+    
+    std::unique_ptr<RpcDispatcher> dispatcher_;
+    ResultArena resultArena_;
+};
+
+// LSPServer implementation
+LSPServer::LSPServer() : pImpl(std::make_unique<Impl>()) {}
+
+LSPServer::~LSPServer() = default;
+
+bool LSPServer::initialize(const std::string& rootPath, const LSPCapabilities& capabilities) {
+    return pImpl->initialize(rootPath, capabilities);
+}
+
+void LSPServer::shutdown() {
+    pImpl->shutdown();
+}
+
+void LSPServer::setLanguageOptions(const LanguageOptions& options) {
+    pImpl->setLanguageOptions(options);
+}
+
+LanguageOptions LSPServer::languageOptions(const std::string& languageId) const {
+    return pImpl->languageOptions(languageId);
+}
+
+void LSPServer::setVisibleDocuments(const std::vector<std::string>& uris) {
+    pImpl->setVisibleDocuments(uris);
+}
+
+void LSPServer::setAstCacheBudget(size_t bytes) {
+    pImpl->setAstCacheBudget(bytes);
+}
+
+MemoryUsage LSPServer::memoryUsage() const {
+    return pImpl->memoryUsage();
+}
+
+bool LSPServer::didOpen(const std::string& uri, const std::string& languageId, const std::string& text) {
+    return pImpl->didOpen(uri, languageId, text);
+}
+
+bool LSPServer::didChange(const std::string& uri, const std::string& text) {
+    return pImpl->didChange(uri, text);
+}
+
+bool LSPServer::didChange(const std::string& uri, int version, const std::vector<TextDocumentContentChange>& changes) {
+    return pImpl->didChange(uri, version, changes);
+}
+
+bool LSPServer::didSave(const std::string& uri) {
+    return pImpl->didSave(uri);
+}
+
+bool LSPServer::didClose(const std::string& uri) {
+    return pImpl->didClose(uri);
+}
+
+CompletionList LSPServer::completion(const TextDocumentPositionParams& params) {
+    return pImpl->completion(params);
+}
+
+HoverResult LSPServer::hover(const TextDocumentPositionParams& params) {
+    return pImpl->hover(params);
+}
+
+std::vector<Location> LSPServer::definition(const TextDocumentPositionParams& params) {
+    return pImpl->definition(params);
+}
+
+std::vector<Location> LSPServer::references(const TextDocumentPositionParams& params) {
+    return pImpl->references(params);
+}
+
+std::vector<Diagnostic> LSPServer::diagnostics(const std::string& uri) {
+    return pImpl->getDiagnostics(uri);
+}
+
+std::vector<SymbolInformation> LSPServer::workspaceSymbol(const std::string& query) {
+    return pImpl->workspaceSymbol(query);
+}
+
+SemanticTokens LSPServer::semanticTokens(const std::string& uri) {
+    return pImpl->semanticTokens(uri);
+}
+
+SemanticTokensDelta LSPServer::semanticTokensDelta(const std::string& uri, const std::string& previousResultId) {
+    return pImpl->semanticTokensDelta(uri, previousResultId);
+}
+
+std::vector<TextEdit> LSPServer::formatDocument(const std::string& uri) {
+    return pImpl->formatDocument(uri);
+}
+
+std::vector<TextEdit> LSPServer::formatRange(const std::string& uri, const Range& range) {
+    return pImpl->formatRange(uri, range);
+}
+
+std::vector<TextEdit> LSPServer::formatOnType(const std::string& uri, const Position& position,
+                                              const std::string& ch) {
+    return pImpl->formatOnType(uri, position, ch);
+}
+
+std::string LSPServer::processMessage(const std::string& jsonMessage) {
+    return pImpl->processMessage(jsonMessage);
+}
+
+int LSPServer::serve(int inputFd, int outputFd) {
+    return pImpl->serve(inputFd, outputFd);
+}
+
+void LSPServer::setMessageCallback(std::function<void(const std::string&)> callback) {
+    pImpl->setMessageCallback(callback);
+}
+
+AnalysisStats LSPServer::analysisStats() const {
+    return pImpl->analysisStats();
+}
+
+ResultArena& LSPServer::resultArena() {
+    return pImpl->resultArena();
+}
+
+// C API implementation
+extern "C" {
+    LSPServer* lsp_create_server() {
+        return new LSPServer();
+    }
+    
+    void lsp_destroy_server(LSPServer* server) {
+        delete server;
+    }
+    
+    bool lsp_initialize(LSPServer* server, const char* rootPath) {
+        if (!server || !rootPath) return false;
+        LSPCapabilities caps; // Use default capabilities
+        return server->initialize(std::string(rootPath), caps);
+    }
+    
+    void lsp_shutdown(LSPServer* server) {
+        if (server) server->shutdown();
+    }
+    
+    bool lsp_set_language_options(LSPServer* server, const char* languageId, const char* optionsJson) {
+        if (!server || !languageId || !*languageId || !optionsJson) return false;
+        llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(optionsJson);
+        if (!parsed) {
+            llvm::consumeError(parsed.takeError());
+            return false;
+        }
+        const llvm::json::Object* object = parsed->getAsObject();
+        LanguageOptions options = server->languageOptions(languageId);
+        if (!object || !parseLanguageOptions(*object, options)) return false;
+        server->setLanguageOptions(options);
+        return true;
+    }
+    
+    bool lsp_did_open(LSPServer* server, const char* uri, const char* languageId, const char* text) {
+        if (!server || !uri || !languageId || !text) return false;
+        return server->didOpen(std::string(uri), std::string(languageId), std::string(text));
+    }
+    
+    bool lsp_did_change(LSPServer* server, const char* uri, const char* text) {
+        if (!server || !uri || !text) return false;
+        return server->didChange(std::string(uri), std::string(text));
+    }
+    
+    bool lsp_did_change_range(LSPServer* server, const char* uri, int version,
+                              int startLine, int startChar, int endLine, int endChar, const char* text) {
+        if (!server || !uri || !text) return false;
+        
+        TextDocumentContentChange change;
+        change.hasRange = true;
+        change.range.start.line = startLine;
+        change.range.start.character = startChar;
+        change.range.end.line = endLine;
+        change.range.end.character = endChar;
+        change.text = text;
+        return server->didChange(std::string(uri), version, {change});
+    }
+    
+    bool lsp_did_save(LSPServer* server, const char* uri) {
+        if (!server || !uri) return false;
+        return server->didSave(std::string(uri));
+    }
+    
+    bool lsp_did_close(LSPServer* server, const char* uri) {
+        if (!server || !uri) return false;
+        return server->didClose(std::string(uri));
+    }
+    
+    char* lsp_completion(LSPServer* server, const char* uri, int line, int character) {
+        if (!server || !uri) return nullptr;
+        
+        TextDocumentPositionParams params;
+        params.textDocument.uri = std::string(uri);
+        params.position.line = line;
+        params.position.character = character;
+        
+        CompletionList list = server->completion(params);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeCompletionList(out, list); }));
+    }
+    
+    char* lsp_hover(LSPServer* server, const char* uri, int line, int character) {
+        if (!server || !uri) return nullptr;
+        
+        TextDocumentPositionParams params;
+        params.textDocument.uri = std::string(uri);
+        params.position.line = line;
+        params.position.character = character;
+        
+        HoverResult hover = server->hover(params);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeHover(out, hover); }));
+    }
+    
+    char* lsp_definition(LSPServer* server, const char* uri, int line, int character) {
+        if (!server || !uri) return nullptr;
+        
+        TextDocumentPositionParams params;
+        params.textDocument.uri = std::string(uri);
+        params.position.line = line;
+        params.position.character = character;
+        
+        std::vector<Location> locations = server->definition(params);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeLocations(out, locations); }));
+    }
+    
+    char* lsp_references(LSPServer* server, const char* uri, int line, int character) {
+        if (!server || !uri) return nullptr;
+        
+        TextDocumentPositionParams params;
+        params.textDocument.uri = std::string(uri);
+        params.position.line = line;
+        params.position.character = character;
+        
+        std::vector<Location> locations = server->references(params);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeLocations(out, locations); }));
+    }
+    
+    char* lsp_diagnostics(LSPServer* server, const char* uri) {
+        if (!server || !uri) return nullptr;
+        
+        std::vector<Diagnostic> diagnostics = server->diagnostics(std::string(uri));
+        return toCString(toJson([&](llvm::json::OStream& out) { writeDiagnostics(out, diagnostics); }));
+    }
+    
+    char* lsp_workspace_symbol(LSPServer* server, const char* query) {
+        if (!server || !query) return nullptr;
+        
+        std::vector<SymbolInformation> symbols = server->workspaceSymbol(std::string(query));
+        return toCString(toJson([&](llvm::json::OStream& out) { writeSymbols(out, symbols); }));
+    }
+    
+    char* lsp_semantic_tokens(LSPServer* server, const char* uri) {
+        if (!server || !uri) return nullptr;
+        
+        SemanticTokens tokens = server->semanticTokens(std::string(uri));
+        return toCString(toJson([&](llvm::json::OStream& out) { writeSemanticTokens(out, tokens); }));
+    }
+    
+    char* lsp_semantic_tokens_delta(LSPServer* server, const char* uri, const char* previousResultId) {
+        if (!server || !uri) return nullptr;
+        
+        SemanticTokensDelta delta = server->semanticTokensDelta(std::string(uri), previousResultId ? previousResultId : "");
+        return toCString(toJson([&](llvm::json::OStream& out) { writeSemanticTokensDelta(out, delta); }));
+    }
+    
+    char* lsp_format_document(LSPServer* server, const char* uri) {
+        if (!server || !uri) return nullptr;
+        
+        std::vector<TextEdit> edits = server->formatDocument(std::string(uri));
+        return toCString(toJson([&](llvm::json::OStream& out) { writeTextEdits(out, edits); }));
+    }
+    
+    char* lsp_format_range(LSPServer* server, const char* uri, int startLine, int startChar, int endLine, int endChar) {
+        if (!server || !uri) return nullptr;
+        
+        Range range;
+        range.start.line = startLine;
+        range.start.character = startChar;
+        range.end.line = endLine;
+        range.end.character = endChar;
+        
+        std::vector<TextEdit> edits = server->formatRange(std::string(uri), range);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeTextEdits(out, edits); }));
+    }
+    
+    char* lsp_format_on_type(LSPServer* server, const char* uri, int line, int character, const char* ch) {
+        if (!server || !uri || !ch) return nullptr;
+        
+        std::vector<TextEdit> edits = server->formatOnType(std::string(uri), Position{line, character}, ch);
+        return toCString(toJson([&](llvm::json::OStream& out) { writeTextEdits(out, edits); }));
+    }
+    
+    char* lsp_process_message(LSPServer* server, const char* jsonMessage) {
+        if (!server || !jsonMessage) return nullptr;
+        
+        auto response = server->processMessage(std::string(jsonMessage));
+        
+        char* cstr = new char[response.length() + 1];
+        std::strcpy(cstr, response.c_str());
+        return cstr;
+    }
+    
+#ifndef __EMSCRIPTEN__
+    int lsp_serve(LSPServer* server, int inputFd, int outputFd) {
+        if (!server) return 1;
+        return server->serve(inputFd, outputFd);
+    }
+#endif
+    
+    char* lsp_analysis_stats(LSPServer* server) {
+        if (!server) return nullptr;
+        
+        auto stats = server->analysisStats();
+        
+        llvm::json::Object obj;
+        obj["scheduled"] = static_cast<int64_t>(stats.scheduled);
+        obj["started"] = static_cast<int64_t>(stats.started);
+        obj["completed"] = static_cast<int64_t>(stats.completed);
+        obj["superseded"] = static_cast<int64_t>(stats.superseded);
+        obj["cancelled"] = static_cast<int64_t>(stats.cancelled);
+        obj["averageQueueLatencyMs"] = stats.averageQueueLatencyMs;
+        obj["maxQueueLatencyMs"] = stats.maxQueueLatencyMs;
+        obj["cancellationRate"] = stats.cancellationRate;
+        
+        std::string result;
+        llvm::raw_string_ostream os(result);
+        os << llvm::json::Value(std::move(obj));
+        
+        char* cstr = new char[result.length() + 1];
+        std::strcpy(cstr, result.c_str());
+        return cstr;
+    }
+    
+    void lsp_set_visible_documents(LSPServer* server, const char* const* uris, int count) {
+        if (!server || (!uris && count > 0)) return;
+        std::vector<std::string> visible;
+        for (int i = 0; i < count; ++i) {
+            if (uris[i]) visible.emplace_back(uris[i]);
+        }
+        server->setVisibleDocuments(visible);
+    }
+    
+    void lsp_set_ast_cache_budget(LSPServer* server, size_t bytes) {
+        if (server) server->setAstCacheBudget(bytes);
+    }
+    
+    char* lsp_memory_usage(LSPServer* server) {
+        if (!server) return nullptr;
+        MemoryUsage usage = server->memoryUsage();
+        return toCString(toJson([&](llvm::json::OStream& out) { writeMemoryUsage(out, usage); }));
+    }
+    
+    const char* lsp_completion_view(LSPServer* server, const char* uri, int line, int character,
+                                    int format, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        CompletionList list = server->completion(positionParams(uri, line, character));
+        if (format == LSP_RESULT_BINARY) {
+            return writeView(server, length, [&](llvm::raw_ostream& os) { encodeCompletionList(os, list); });
+        }
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeCompletionList(out, list); });
+    }
+    
+    const char* lsp_hover_view(LSPServer* server, const char* uri, int line, int character, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        HoverResult hover = server->hover(positionParams(uri, line, character));
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeHover(out, hover); });
+    }
+    
+    const char* lsp_definition_view(LSPServer* server, const char* uri, int line, int character, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        std::vector<Location> locations = server->definition(positionParams(uri, line, character));
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeLocations(out, locations); });
+    }
+    
+    const char* lsp_references_view(LSPServer* server, const char* uri, int line, int character, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        std::vector<Location> locations = server->references(positionParams(uri, line, character));
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeLocations(out, locations); });
+    }
+    
+    const char* lsp_diagnostics_view(LSPServer* server, const char* uri, int format, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        std::vector<Diagnostic> diagnostics = server->diagnostics(std::string(uri));
+        if (format == LSP_RESULT_BINARY) {
+            return writeView(server, length, [&](llvm::raw_ostream& os) { encodeDiagnostics(os, diagnostics); });
+        }
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeDiagnostics(out, diagnostics); });
+    }
+    
+    const char* lsp_workspace_symbol_view(LSPServer* server, const char* query, size_t* length) {
+        if (!server || !query) return nullptr;
+        
+        std::vector<SymbolInformation> symbols = server->workspaceSymbol(std::string(query));
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeSymbols(out, symbols); });
+    }
+    
+    const char* lsp_semantic_tokens_view(LSPServer* server, const char* uri, size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        SemanticTokens tokens = server->semanticTokens(std::string(uri));
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeSemanticTokens(out, tokens); });
+    }
+    
+    const char* lsp_semantic_tokens_delta_view(LSPServer* server, const char* uri, const char* previousResultId,
+                                               size_t* length) {
+        if (!server || !uri) return nullptr;
+        
+        SemanticTokensDelta delta = server->semanticTokensDelta(std::string(uri), previousResultId ? previousResultId : "");
+        return jsonView(server, length, [&](llvm::json::OStream& out) { writeSemanticTokensDelta(out, delta); });
+    }
+    
+    void lsp_free_string(char* str) {
+        delete[] str;
+    }
+}
+
+} // namespace lsp
+} // namespace miko
\ No newline at end of file
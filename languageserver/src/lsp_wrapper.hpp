@@ -0,0 +1,364 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <map>
+#include "analysis_scheduler.hpp"
+
+#ifdef _WIN32
+    #ifdef LSP_WRAPPER_EXPORTS
+        #define LSP_API __declspec(dllexport)
+    #else
+        #define LSP_API __declspec(dllimport)
+    #endif
+#else
+    #define LSP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __EMSCRIPTEN__
+    #include <emscripten.h>
+    #define WASM_EXPORT EMSCRIPTEN_KEEPALIVE
+#else
+    #define WASM_EXPORT
+#endif
+
+namespace miko {
+namespace lsp {
+
+class ResultArena;
+
+// LSP Message Types
+enum class MessageType {
+    Request,
+    Response,
+    Notification
+};
+
+// LSP Request/Response structure
+struct LSPMessage {
+    MessageType type;
+    std::string method;
+    std::string id;
+    std::string params;
+    std::string result;
+    std::string error;
+};
+
+// LSP Capabilities
+struct LSPCapabilities {
+    bool textDocumentSync = true;
+    bool completion = true;
+    bool hover = true;
+    bool signatureHelp = true;
+    bool definition = true;
+    bool references = true;
+    bool documentHighlight = true;
+    bool documentSymbol = true;
+    bool workspaceSymbol = true;
+    bool codeAction = true;
+    bool documentFormatting = true;
+    bool documentRangeFormatting = true;
+    bool rename = true;
+    bool foldingRange = true;
+    bool semanticTokens = true;
+};
+
+// Settings for one language served by the shared core. A document's language
+// is its languageId, or the one claiming its extension when the client sent
+// none. The driver and standard build the command for files the compilation
+// database doesn't list; flags are appended to every command of the language.
+struct LanguageOptions {
+    std::string languageId;              // "c", "cpp"
+    std::vector<std::string> extensions; // lower case, without the dot
+    std::string driver;                  // "clang", "clang++"
+    std::string standard;                // -std= value, e.g. "c17"
+    std::vector<std::string> flags;
+};
+
+// Document position
+struct Position {
+    int line;
+    int character;
+};
+
+// Document range
+struct Range {
+    Position start;
+    Position end;
+};
+
+// Location in a document
+struct Location {
+    std::string uri;
+    Range range;
+};
+
+// Replacement of range by newText; an empty range inserts
+struct TextEdit {
+    Range range;
+    std::string newText;
+};
+
+// Text document content change; without a range the text replaces the
+// whole document (TextDocumentSyncKind.Full)
+struct TextDocumentContentChange {
+    bool hasRange = false;
+    Range range;
+    std::string text;
+};
+
+// Text document identifier
+struct TextDocumentIdentifier {
+    std::string uri;
+};
+
+// Text document position params
+struct TextDocumentPositionParams {
+    TextDocumentIdentifier textDocument;
+    Position position;
+};
+
+// Completion item
+struct CompletionItem {
+    std::string label;
+    std::string detail;
+    std::string documentation;
+    std::string insertText;
+    int kind;
+};
+
+// Completion result; incomplete lists should be requested again as the
+// user keeps typing rather than filtered on the client
+struct CompletionList {
+    bool isIncomplete = false;
+    std::vector<CompletionItem> items;
+};
+
+// Hover result
+struct HoverResult {
+    std::string contents;
+    Range range;
+};
+
+// Diagnostic
+struct Diagnostic {
+    Range range;
+    std::string message;
+    int severity;
+    std::string source;
+};
+
+// Workspace symbol search result
+struct SymbolInformation {
+    std::string name;
+    int kind; // LSP SymbolKind
+    Location location;
+};
+
+// Semantic tokens in the LSP relative encoding: five integers per token
+// (delta line, delta start character, length, type, modifier bits)
+struct SemanticTokens {
+    std::string resultId;
+    std::vector<uint32_t> data;
+};
+
+// Replaces deleteCount integers at start in the previous result's data
+struct SemanticTokensEdit {
+    uint32_t start = 0;
+    uint32_t deleteCount = 0;
+    std::vector<uint32_t> data;
+};
+
+// Answer to a delta request: edits against the previous result, or the
+// full data when that result is no longer known
+struct SemanticTokensDelta {
+    std::string resultId;
+    bool full = false;
+    std::vector<uint32_t> data;
+    std::vector<SemanticTokensEdit> edits;
+};
+
+// Memory held by the server's caches ($/memoryUsage). Parsed ASTs are kept
+// within astBudget; preambles are shared by every parse of their file.
+struct MemoryUsage {
+    size_t astBytes = 0;
+    size_t astBudget = 0;
+    size_t astEntries = 0;
+    size_t astVisibleEntries = 0;
+    uint64_t astHits = 0;
+    uint64_t astMisses = 0;
+    uint64_t astEvictions = 0;
+    size_t preambleBytes = 0;
+    size_t preambleEntries = 0;
+    uint64_t preambleHits = 0;
+    uint64_t preambleBuilds = 0;
+    size_t documents = 0;
+    size_t documentBytes = 0;
+};
+
+// LSP Server Interface
+class LSP_API LSPServer {
+public:
+    LSPServer();
+    virtual ~LSPServer();
+
+    // Initialize the LSP server
+    bool initialize(const std::string& rootPath, const LSPCapabilities& capabilities);
+    
+    // Shutdown the server
+    void shutdown();
+    
+    // Adds a language or replaces the options of one with the same
+    // languageId; open documents of that language are analyzed again
+    void setLanguageOptions(const LanguageOptions& options);
+    // Current options of languageId, empty for one not registered yet
+    LanguageOptions languageOptions(const std::string& languageId) const;
+    
+    // Documents shown in an editor, whose ASTs are evicted last
+    void setVisibleDocuments(const std::vector<std::string>& uris);
+    // Memory the cached ASTs of open documents may use, in bytes
+    void setAstCacheBudget(size_t bytes);
+    MemoryUsage memoryUsage() const;
+    
+    // Document lifecycle
+    bool didOpen(const std::string& uri, const std::string& languageId, const std::string& text);
+    bool didChange(const std::string& uri, const std::string& text);
+    // All or nothing: if any change is rejected, none apply and the version
+    // stays as it was
+    bool didChange(const std::string& uri, int version, const std::vector<TextDocumentContentChange>& changes);
+    bool didSave(const std::string& uri);
+    bool didClose(const std::string& uri);
+    
+    // Language features
+    CompletionList completion(const TextDocumentPositionParams& params);
+    HoverResult hover(const TextDocumentPositionParams& params);
+    std::vector<Location> definition(const TextDocumentPositionParams& params);
+    std::vector<Location> references(const TextDocumentPositionParams& params);
+    std::vector<Diagnostic> diagnostics(const std::string& uri);
+    std::vector<SymbolInformation> workspaceSymbol(const std::string& query);
+    SemanticTokens semanticTokens(const std::string& uri);
+    SemanticTokensDelta semanticTokensDelta(const std::string& uri, const std::string& previousResultId);
+    
+    // Formatting; the edits only cover text clang-format changes
+    std::vector<TextEdit> formatDocument(const std::string& uri);
+    std::vector<TextEdit> formatRange(const std::string& uri, const Range& range);
+    // ch ("\n", ";" or "}") was just typed before position
+    std::vector<TextEdit> formatOnType(const std::string& uri, const Position& position, const std::string& ch);
+    
+    // Process LSP message
+    std::string processMessage(const std::string& jsonMessage);
+    
+    // Runs the LSP base protocol (Content-Length framed JSON-RPC) over the
+    // descriptors, e.g. stdin/stdout or pipes, until the client sends exit.
+    // Returns the process exit code the protocol asks for.
+    int serve(int inputFd, int outputFd);
+    
+    // Set message callback for async responses
+    void setMessageCallback(std::function<void(const std::string&)> callback);
+    
+    // Background analysis queue metrics
+    AnalysisStats analysisStats() const;
+    
+    // Buffer behind the C API's *_view results
+    ResultArena& resultArena();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+// C-style API for DLL/WASM exports
+extern "C" {
+    // Server lifecycle
+    LSP_API WASM_EXPORT LSPServer* lsp_create_server();
+    LSP_API WASM_EXPORT void lsp_destroy_server(LSPServer* server);
+    LSP_API WASM_EXPORT bool lsp_initialize(LSPServer* server, const char* rootPath);
+    LSP_API WASM_EXPORT void lsp_shutdown(LSPServer* server);
+    // optionsJson: {"extensions": [...], "driver": "...", "standard": "...",
+    // "flags": [...]}; omitted members keep their current value
+    LSP_API WASM_EXPORT bool lsp_set_language_options(LSPServer* server, const char* languageId,
+                                                      const char* optionsJson);
+    
+    // Document operations
+    LSP_API WASM_EXPORT bool lsp_did_open(LSPServer* server, const char* uri, const char* languageId, const char* text);
+    LSP_API WASM_EXPORT bool lsp_did_change(LSPServer* server, const char* uri, const char* text);
+    // Incremental edit; positions are UTF-16 based as in LSP
+    LSP_API WASM_EXPORT bool lsp_did_change_range(LSPServer* server, const char* uri, int version,
+                                                  int startLine, int startChar, int endLine, int endChar,
+                                                  const char* text);
+    LSP_API WASM_EXPORT bool lsp_did_save(LSPServer* server, const char* uri);
+    LSP_API WASM_EXPORT bool lsp_did_close(LSPServer* server, const char* uri);
+    
+    // Language features (returns JSON strings)
+    LSP_API WASM_EXPORT char* lsp_completion(LSPServer* server, const char* uri, int line, int character);
+    LSP_API WASM_EXPORT char* lsp_hover(LSPServer* server, const char* uri, int line, int character);
+    LSP_API WASM_EXPORT char* lsp_definition(LSPServer* server, const char* uri, int line, int character);
+    LSP_API WASM_EXPORT char* lsp_references(LSPServer* server, const char* uri, int line, int character);
+    LSP_API WASM_EXPORT char* lsp_diagnostics(LSPServer* server, const char* uri);
+    LSP_API WASM_EXPORT char* lsp_workspace_symbol(LSPServer* server, const char* query);
+    // Semantic tokens as {resultId, data}; the delta variant answers with
+    // {resultId, edits} against previousResultId when it is still known
+    LSP_API WASM_EXPORT char* lsp_semantic_tokens(LSPServer* server, const char* uri);
+    LSP_API WASM_EXPORT char* lsp_semantic_tokens_delta(LSPServer* server, const char* uri, const char* previousResultId);
+    
+    // Formatting, as a JSON array of TextEdits
+    LSP_API WASM_EXPORT char* lsp_format_document(LSPServer* server, const char* uri);
+    LSP_API WASM_EXPORT char* lsp_format_range(LSPServer* server, const char* uri, int startLine, int startChar, int endLine, int endChar);
+    LSP_API WASM_EXPORT char* lsp_format_on_type(LSPServer* server, const char* uri, int line, int character, const char* ch);
+    
+    // Message processing
+    LSP_API WASM_EXPORT char* lsp_process_message(LSPServer* server, const char* jsonMessage);
+#ifndef __EMSCRIPTEN__
+    // Blocking server loop over file descriptors (0 and 1 for stdio)
+    LSP_API int lsp_serve(LSPServer* server, int inputFd, int outputFd);
+#endif
+    
+    // Analysis metrics (returns JSON string)
+    LSP_API WASM_EXPORT char* lsp_analysis_stats(LSPServer* server);
+    
+    // AST cache: documents shown in an editor (replacing the previous set),
+    // the memory budget, and usage as JSON (same as $/memoryUsage)
+    LSP_API WASM_EXPORT void lsp_set_visible_documents(LSPServer* server, const char* const* uris, int count);
+    LSP_API WASM_EXPORT void lsp_set_ast_cache_budget(LSPServer* server, size_t bytes);
+    LSP_API WASM_EXPORT char* lsp_memory_usage(LSPServer* server);
+    
+    // Zero-copy results. The result is written into a buffer owned by the
+    // server and returned as a pointer to *length bytes (NUL-terminated,
+    // not counted). It stays valid until the next *_view call on the same
+    // server and must not be freed; in WASM it can be read directly from
+    // the module heap. Calls on one server must not overlap.
+    //
+    // format is LSP_RESULT_JSON (same JSON as the functions above) or, for
+    // completion and diagnostics, LSP_RESULT_BINARY. The binary encoding is
+    // little-endian; str is a u32 byte length followed by UTF-8 bytes:
+    //   header:     u32 magic 'MLB1', u16 type (1 completion, 2 diagnostics),
+    //               u16 flags (bit 0: isIncomplete), u32 count
+    //   completion: u32 kind, str label, str detail, str insertText,
+    //               str documentation
+    //   diagnostic: u32 startLine, u32 startCharacter, u32 endLine,
+    //               u32 endCharacter, u32 severity, str message, str source
+    enum { LSP_RESULT_JSON = 0, LSP_RESULT_BINARY = 1 };
+    LSP_API WASM_EXPORT const char* lsp_completion_view(LSPServer* server, const char* uri, int line, int character,
+                                                        int format, size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_hover_view(LSPServer* server, const char* uri, int line, int character,
+                                                   size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_definition_view(LSPServer* server, const char* uri, int line, int character,
+                                                        size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_references_view(LSPServer* server, const char* uri, int line, int character,
+                                                        size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_diagnostics_view(LSPServer* server, const char* uri, int format,
+                                                         size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_workspace_symbol_view(LSPServer* server, const char* query, size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_semantic_tokens_view(LSPServer* server, const char* uri, size_t* length);
+    LSP_API WASM_EXPORT const char* lsp_semantic_tokens_delta_view(LSPServer* server, const char* uri,
+                                                                   const char* previousResultId, size_t* length);
+    
+    // Memory management
+    LSP_API WASM_EXPORT void lsp_free_string(char* str);
+}
+
+} // namespace lsp
+} // namespace miko
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "parsed_unit.hpp"
+#include "diagnostic_collector.hpp"
+#include "preamble_cache.hpp"
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/ExternalASTSource.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Lex/HeaderSearch.h>
+#include <clang/Lex/PreprocessingRecord.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/xxhash.h>
+#include <algorithm>
+#include <mutex>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+uint64_t pathKey(llvm::StringRef path) {
+    llvm::SmallString<256> normalized(path);
+    llvm::sys::path::remove_dots(normalized, /*remove_dot_dot=*/true);
+    llvm::sys::path::native(normalized);
+    return llvm::xxh3_64bits(normalized);
+}
+
+// Remembers every path looked up through it, so a cached unit can tell
+// which open documents it depends on
+class LookupRecorder : public llvm::vfs::ProxyFileSystem {
+public:
+    explicit LookupRecorder(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+        : ProxyFileSystem(std::move(fs)) {}
+
+    llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine& path) override {
+        record(path);
+        return ProxyFileSystem::status(path);
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine& path) override {
+        record(path);
+        return ProxyFileSystem::openFileForRead(path);
+    }
+
+    std::vector<uint64_t> takeLookups() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::sort(lookups_.begin(), lookups_.end());
+        lookups_.erase(std::unique(lookups_.begin(), lookups_.end()), lookups_.end());
+        return std::move(lookups_);
+    }
+
+private:
+    void record(const llvm::Twine& path) {
+        llvm::SmallString<256> absolute;
+        path.toVector(absolute);
+        makeAbsolute(absolute);
+        uint64_t key = pathKey(absolute);
+        std::lock_guard<std::mutex> lock(mutex_);
+        lookups_.push_back(key);
+    }
+
+    std::mutex mutex_;
+    std::vector<uint64_t> lookups_;
+};
+
+} // namespace
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+buildOverlayFileSystem(const std::map<std::string, std::string>& openFiles) {
+    auto memory = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+    for (const auto& [path, text] : openFiles) {
+        memory->addFile(path, 0, llvm::MemoryBuffer::getMemBufferCopy(text, path));
+    }
+
+    auto overlay = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(llvm::vfs::getRealFileSystem());
+    overlay->pushOverlay(memory);
+    return overlay;
+}
+
+std::shared_ptr<clang::CompilerInvocation> buildInvocation(const ParseInputs& inputs) {
+    std::vector<const char*> argv;
+    argv.reserve(inputs.arguments.size() + 1);
+    for (const auto& arg : inputs.arguments) {
+        argv.push_back(arg.c_str());
+    }
+    argv.push_back("-fsyntax-only");
+
+    // Driver errors (unknown flags and the like) should not stop analysis
+    clang::DiagnosticOptions invocationDiagOptions;
+    clang::IgnoringDiagConsumer ignore;
+    clang::CreateInvocationOptions options;
+    options.Diags = clang::CompilerInstance::createDiagnostics(*inputs.vfs, invocationDiagOptions, &ignore, false);
+    options.VFS = inputs.vfs;
+    options.RecoverOnError = true;
+    std::shared_ptr<clang::CompilerInvocation> invocation = clang::createInvocation(argv, options);
+    if (!invocation || invocation->getFrontendOpts().Inputs.empty()) return nullptr;
+
+    invocation->getFileSystemOpts().WorkingDir = inputs.directory;
+    invocation->getFrontendOpts().DisableFree = false;
+    return invocation;
+}
+
+ParsedUnit::ParsedUnit() = default;
+
+ParsedUnit::~ParsedUnit() {
+    if (action_ && action_->isCurrentFile()) {
+        action_->EndSourceFile();
+    }
+}
+
+std::unique_ptr<ParsedUnit> ParsedUnit::build(const ParseInputs& inputs, PreambleCache& preambles,
+                                              const std::function<bool()>& isCancelled) {
+    if (isCancelled && isCancelled()) return nullptr;
+
+    std::shared_ptr<clang::CompilerInvocation> invocation = buildInvocation(inputs);
+    if (!invocation) return nullptr;
+
+    std::unique_ptr<llvm::MemoryBuffer> mainBuffer = llvm::MemoryBuffer::getMemBufferCopy(inputs.contents, inputs.path);
+
+    std::unique_ptr<ParsedUnit> unit(new ParsedUnit());
+    // The preamble's headers are looked up here too: when it is built, or
+    // when its reuse check confirms they are unchanged
+    auto recorder = llvm::makeIntrusiveRefCnt<LookupRecorder>(inputs.vfs);
+    std::vector<FileDiagnostic> preambleDiagnostics;
+    unit->preamble_ = preambles.get(inputs.path, *invocation, *mainBuffer, recorder, &preambleDiagnostics);
+    if (isCancelled && isCancelled()) return nullptr;
+
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs = recorder;
+    if (unit->preamble_) {
+        // Points the preprocessor at the preamble and skips the main file's
+        // header prefix; may wrap the VFS to serve the in-memory PCH
+        unit->preamble_->AddImplicitPreamble(*invocation, vfs, mainBuffer.get());
+    }
+    // Parse exactly the snapshot we were given; the preprocessor takes
+    // ownership of the buffer
+    invocation->getPreprocessorOpts().addRemappedFile(inputs.path, mainBuffer.release());
+
+    unit->collector_ = std::make_unique<MainFileDiagnosticCollector>();
+    unit->clang_ = std::make_unique<clang::CompilerInstance>(invocation);
+    unit->clang_->createDiagnostics(*vfs, unit->collector_.get(), false);
+    unit->clang_->createFileManager(vfs);
+    if (!unit->clang_->createTarget()) return nullptr;
+
+    unit->action_ = std::make_unique<clang::SyntaxOnlyAction>();
+    if (!unit->action_->BeginSourceFile(*unit->clang_, unit->clang_->getFrontendOpts().Inputs[0])) {
+        return nullptr;
+    }
+    if (llvm::Error error = unit->action_->Execute()) {
+        llvm::consumeError(std::move(error));
+    }
+
+    // The parse skips the preamble's part of the file, so what it reported
+    // comes from the preamble build, which may be an earlier one
+    std::vector<FileDiagnostic> diagnostics = std::move(preambleDiagnostics);
+    for (FileDiagnostic& diagnostic : unit->collector_->take()) {
+        diagnostics.push_back(std::move(diagnostic));
+    }
+    unit->diagnostics_ = toLspDiagnostics(inputs.contents, diagnostics);
+    unit->lookedUp_ = recorder->takeLookups();
+    for (const auto& [path, hash] : inputs.openFileHashes) {
+        if (std::binary_search(unit->lookedUp_.begin(), unit->lookedUp_.end(), pathKey(path))) {
+            unit->openInputs_.emplace(path, hash);
+        }
+    }
+    return unit;
+}
+
+bool ParsedUnit::openFilesMatch(const std::map<std::string, uint64_t>& openFileHashes) const {
+    // Each document read is still open and unchanged...
+    for (const auto& [path, hash] : openInputs_) {
+        auto it = openFileHashes.find(path);
+        if (it == openFileHashes.end() || it->second != hash) return false;
+    }
+    // ...and no other document now shadows a path the parse looked up
+    for (const auto& [path, hash] : openFileHashes) {
+        if (openInputs_.count(path)) continue;
+        if (std::binary_search(lookedUp_.begin(), lookedUp_.end(), pathKey(path))) return false;
+    }
+    return true;
+}
+
+clang::ASTContext& ParsedUnit::astContext() {
+    return clang_->getASTContext();
+}
+
+clang::Preprocessor& ParsedUnit::preprocessor() {
+    return clang_->getPreprocessor();
+}
+
+clang::SourceManager& ParsedUnit::sourceManager() {
+    return clang_->getSourceManager();
+}
+
+size_t ParsedUnit::memoryUsage() const {
+    const clang::ASTContext& context = clang_->getASTContext();
+    size_t total = context.getASTAllocatedMemory() + context.getSideTableAllocatedMemory();
+    total += context.Idents.getAllocator().getTotalMemory();
+    total += context.Selectors.getTotalMemory();
+
+    const clang::SourceManager& sm = clang_->getSourceManager();
+    total += sm.getContentCacheSize() + sm.getDataStructureSizes();
+    total += sm.getMemoryBufferSizes().malloc_bytes;
+    if (clang::ExternalASTSource* external = context.getExternalSource()) {
+        total += external->getMemoryBufferSizes().malloc_bytes;
+    }
+
+    const clang::Preprocessor& pp = clang_->getPreprocessor();
+    total += pp.getTotalMemory() + pp.getHeaderSearchInfo().getTotalMemory();
+    if (clang::PreprocessingRecord* record = pp.getPreprocessingRecord()) {
+        total += record->getTotalMemory();
+    }
+    return total;
+}
+
+} // namespace lsp
+} // namespace miko
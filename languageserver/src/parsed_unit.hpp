@@ -0,0 +1,92 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class CompilerInstance;
+class CompilerInvocation;
+class FrontendAction;
+class PrecompiledPreamble;
+class Preprocessor;
+class SourceManager;
+}
+
+namespace miko {
+namespace lsp {
+
+class MainFileDiagnosticCollector;
+class PreambleCache;
+
+// Everything needed to parse one main file
+struct ParseInputs {
+    std::string path;
+    std::string contents;
+    std::string directory;
+    std::vector<std::string> arguments; // driver command line, argv[0] first
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs;
+    // Content hash of each open document in vfs's overlay, by path
+    std::map<std::string, uint64_t> openFileHashes;
+};
+
+// Builds a VFS where open documents shadow the files on disk, so unsaved
+// edits to headers are seen by every translation unit that includes them
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+buildOverlayFileSystem(const std::map<std::string, std::string>& openFiles);
+
+// cc1 invocation for a syntax-only parse of inputs; nullptr when the driver
+// cannot make sense of the arguments
+std::shared_ptr<clang::CompilerInvocation> buildInvocation(const ParseInputs& inputs);
+
+// A main file parsed on top of its cached preamble. The AST stays alive for
+// as long as the unit does.
+class ParsedUnit {
+public:
+    ~ParsedUnit();
+
+    // Returns nullptr when no compiler invocation can be created from the
+    // arguments or when isCancelled() reports the work is no longer wanted
+    static std::unique_ptr<ParsedUnit> build(const ParseInputs& inputs, PreambleCache& preambles,
+                                             const std::function<bool()>& isCancelled);
+
+    const std::vector<Diagnostic>& diagnostics() const { return diagnostics_; }
+    // Whether the open documents this unit read (headers in its preamble
+    // too) are as they were when it was parsed, given the hashes of the
+    // documents that now shadow files on disk
+    bool openFilesMatch(const std::map<std::string, uint64_t>& openFileHashes) const;
+    bool usedPreamble() const { return preamble_ != nullptr; }
+
+    // Heap held by the AST, source manager and preprocessor, excluding the
+    // preamble, which is shared with later parses of the file. Grows as
+    // declarations are deserialized from the preamble on first use.
+    size_t memoryUsage() const;
+
+    clang::ASTContext& astContext();
+    clang::Preprocessor& preprocessor();
+    clang::SourceManager& sourceManager();
+
+private:
+    ParsedUnit();
+
+    std::shared_ptr<const clang::PrecompiledPreamble> preamble_;
+    std::unique_ptr<MainFileDiagnosticCollector> collector_;
+    std::unique_ptr<clang::CompilerInstance> clang_;
+    std::unique_ptr<clang::FrontendAction> action_;
+    std::vector<Diagnostic> diagnostics_;
+    // Hashes of every path the parse looked up, sorted; failed lookups
+    // count, since opening a document there would change the result
+    std::vector<uint64_t> lookedUp_;
+    // The documents of ParseInputs::openFileHashes it read
+    std::map<std::string, uint64_t> openInputs_;
+};
+
+} // namespace lsp
+} // namespace miko
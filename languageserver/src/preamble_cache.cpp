@@ -0,0 +1,141 @@
+#include "preamble_cache.hpp"
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <algorithm>
+
+namespace miko {
+namespace lsp {
+
+PreambleCache::PreambleCache(size_t maxEntries) : maxEntries_(std::max<size_t>(1, maxEntries)) {}
+
+std::shared_ptr<const clang::PrecompiledPreamble>
+PreambleCache::get(const std::string& path, const clang::CompilerInvocation& invocation,
+                   const llvm::MemoryBuffer& mainFile, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs,
+                   std::vector<FileDiagnostic>* diagnostics) {
+    if (diagnostics) diagnostics->clear();
+    clang::PreambleBounds bounds =
+        clang::ComputePreambleBounds(invocation.getLangOpts(), mainFile.getMemBufferRef(), 0);
+    if (bounds.Size == 0) return nullptr;
+
+    std::string flagsKey = makeFlagsKey(invocation);
+    std::shared_ptr<std::mutex> buildLock;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto preamble = findReusable(path, flagsKey, invocation, mainFile, bounds, *vfs, diagnostics)) {
+            return preamble;
+        }
+        std::shared_ptr<std::mutex>& slot = buildLocks_[path];
+        if (!slot) slot = std::make_shared<std::mutex>();
+        buildLock = slot;
+    }
+
+    // Build outside mutex_, so other files keep going meanwhile. Another
+    // request for this file waits here and then reuses what was built.
+    std::lock_guard<std::mutex> building(*buildLock);
+    auto release = [&] {
+        // The map's reference and ours; a waiter holds a third
+        if (buildLock.use_count() == 2) buildLocks_.erase(path);
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto preamble = findReusable(path, flagsKey, invocation, mainFile, bounds, *vfs, diagnostics)) {
+            release();
+            return preamble;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    clang::DiagnosticOptions diagnosticOptions;
+    MainFileDiagnosticCollector collector;
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagnosticsEngine =
+        clang::CompilerInstance::createDiagnostics(*vfs, diagnosticOptions, &collector, false);
+    clang::PreambleCallbacks callbacks;
+
+    llvm::ErrorOr<clang::PrecompiledPreamble> built = clang::PrecompiledPreamble::Build(
+        invocation, &mainFile, bounds, *diagnosticsEngine, vfs,
+        std::make_shared<clang::PCHContainerOperations>(),
+        /*StoreInMemory=*/true, /*StoragePath=*/"", callbacks);
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    release();
+    stats_.lastBuildMs = elapsedMs;
+    if (!built) {
+        ++stats_.failures;
+        entries_.erase(path);
+        return nullptr;
+    }
+    ++stats_.builds;
+
+    Entry& entry = entries_[path];
+    entry.flagsKey = std::move(flagsKey);
+    entry.preamble = std::make_shared<const clang::PrecompiledPreamble>(std::move(*built));
+    entry.diagnostics = collector.take();
+    entry.lastUsed = std::chrono::steady_clock::now();
+    auto preamble = entry.preamble;
+    if (diagnostics) *diagnostics = entry.diagnostics;
+    evictIfNeeded();
+    return preamble;
+}
+
+std::shared_ptr<const clang::PrecompiledPreamble>
+PreambleCache::findReusable(const std::string& path, const std::string& flagsKey,
+                            const clang::CompilerInvocation& invocation, const llvm::MemoryBuffer& mainFile,
+                            const clang::PreambleBounds& bounds, llvm::vfs::FileSystem& vfs,
+                            std::vector<FileDiagnostic>* diagnostics) {
+    auto it = entries_.find(path);
+    if (it == entries_.end() || it->second.flagsKey != flagsKey ||
+        !it->second.preamble->CanReuse(invocation, mainFile.getMemBufferRef(), bounds, vfs)) {
+        return nullptr;
+    }
+    it->second.lastUsed = std::chrono::steady_clock::now();
+    ++stats_.hits;
+    if (diagnostics) *diagnostics = it->second.diagnostics;
+    return it->second.preamble;
+}
+
+void PreambleCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(path);
+}
+
+void PreambleCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+PreambleCache::Stats PreambleCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    for (const auto& entry : entries_) {
+        stats.bytes += entry.second.preamble->getSize();
+    }
+    return stats;
+}
+
+std::string PreambleCache::makeFlagsKey(const clang::CompilerInvocation& invocation) {
+    // The cc1 arguments capture every option that affects the preamble
+    std::string key;
+    for (const std::string& arg : invocation.getCC1CommandLine()) {
+        key += arg;
+        key += '\0';
+    }
+    return key;
+}
+
+void PreambleCache::evictIfNeeded() {
+    while (entries_.size() > maxEntries_) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        entries_.erase(oldest);
+    }
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "diagnostic_collector.hpp"
+#include <clang/Frontend/PrecompiledPreamble.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+class CompilerInvocation;
+}
+
+namespace miko {
+namespace lsp {
+
+// Caches the compiled header prefix (preamble) of each translation unit.
+// An entry is reused as long as the flags are the same and clang confirms
+// the preamble text and every file it depends on are unchanged, so edits
+// below the #include block only reparse the main file.
+//
+// Thread-safe: diagnostics, completion and semantic tokens may ask for the
+// same file at once. Builds of one file are serialized, so a request that
+// arrives while a preamble is being built waits for it and reuses it
+// instead of building its own; other files build in parallel.
+class PreambleCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t builds = 0;
+        uint64_t failures = 0;
+        double lastBuildMs = 0.0;
+        size_t entries = 0;
+        size_t bytes = 0; // of the cached preambles
+    };
+
+    explicit PreambleCache(size_t maxEntries = 16);
+
+    // Returns a preamble matching the invocation and main file contents,
+    // building (and caching) a new one when the cached one is stale.
+    // Returns nullptr when the file has no preamble or building fails; the
+    // caller then parses without one. A parse on top of the preamble skips
+    // its part of the main file, so the diagnostics raised there when it
+    // was built (a missing header, errors inside included ones) are stored
+    // with it and copied to diagnostics if given.
+    std::shared_ptr<const clang::PrecompiledPreamble>
+    get(const std::string& path, const clang::CompilerInvocation& invocation,
+        const llvm::MemoryBuffer& mainFile, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs,
+        std::vector<FileDiagnostic>* diagnostics = nullptr);
+
+    void invalidate(const std::string& path);
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string flagsKey;
+        std::shared_ptr<const clang::PrecompiledPreamble> preamble;
+        // Offsets are valid in every main file the preamble is reused for,
+        // since reuse requires its part of the text to be unchanged
+        std::vector<FileDiagnostic> diagnostics;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    static std::string makeFlagsKey(const clang::CompilerInvocation& invocation);
+    // The cached preamble if it can be reused; call with mutex_ held
+    std::shared_ptr<const clang::PrecompiledPreamble>
+    findReusable(const std::string& path, const std::string& flagsKey, const clang::CompilerInvocation& invocation,
+                 const llvm::MemoryBuffer& mainFile, const clang::PreambleBounds& bounds, llvm::vfs::FileSystem& vfs,
+                 std::vector<FileDiagnostic>* diagnostics);
+    void evictIfNeeded();
+
+    size_t maxEntries_;
+    std::map<std::string, Entry> entries_;
+    // Held while building a file's preamble; dropped when nobody waits
+    std::map<std::string, std::shared_ptr<std::mutex>> buildLocks_;
+    Stats stats_;
+    mutable std::mutex mutex_; // the members above
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,40 @@
+#include "result_arena.hpp"
+#include <llvm/Support/EndianStream.h>
+#include <cassert>
+
+namespace miko {
+namespace lsp {
+
+llvm::raw_ostream& ResultArena::begin() {
+    [[maybe_unused]] bool overlapping = writing_.exchange(true, std::memory_order_acquire);
+    assert(!overlapping && "concurrent *_view calls on one LSPServer");
+    // clear() keeps the capacity; that reuse is the point of the arena
+    buffer_.clear();
+    return stream_;
+}
+
+const char* ResultArena::finish(size_t* length) {
+    size_t size = buffer_.size();
+    // The terminator stays in memory past the end without being counted
+    buffer_.push_back('\0');
+    buffer_.pop_back();
+    if (length) *length = size;
+    writing_.store(false, std::memory_order_release);
+    return buffer_.data();
+}
+
+void BinaryWriter::u16(uint16_t value) {
+    llvm::support::endian::write<uint16_t>(out_, value, llvm::endianness::little);
+}
+
+void BinaryWriter::u32(uint32_t value) {
+    llvm::support::endian::write<uint32_t>(out_, value, llvm::endianness::little);
+}
+
+void BinaryWriter::string(llvm::StringRef value) {
+    u32(static_cast<uint32_t>(value.size()));
+    out_ << value;
+}
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace miko {
+namespace lsp {
+
+// Scratch memory for results handed out by the C API. Every call resets
+// the arena and serializes its result straight into it, so once the buffer
+// has grown to the usual result size no allocation or copy is needed and
+// the caller receives a view instead of an owned string. A view stays
+// valid until the next call that writes into the same arena.
+//
+// Not thread-safe: each LSPServer owns one arena, and its *_view calls must
+// come one at a time (from any thread), with the caller done reading a view
+// before making the next call. Debug builds assert that no two results are
+// written at once.
+class ResultArena {
+public:
+    ResultArena() : stream_(buffer_) {}
+
+    ResultArena(const ResultArena&) = delete;
+    ResultArena& operator=(const ResultArena&) = delete;
+
+    // Starts a new result, invalidating the previous view
+    llvm::raw_ostream& begin();
+    // The bytes written since begin(), followed by a NUL that is not
+    // counted in length
+    const char* finish(size_t* length);
+
+    size_t capacity() const { return buffer_.capacity(); }
+
+private:
+    llvm::SmallVector<char, 0> buffer_;
+    llvm::raw_svector_ostream stream_;
+    // Between begin() and finish(), for the overlap assertion
+    std::atomic<bool> writing_{false};
+};
+
+// Little-endian writer for the compact binary result encoding
+class BinaryWriter {
+public:
+    explicit BinaryWriter(llvm::raw_ostream& out) : out_(out) {}
+
+    void u16(uint16_t value);
+    void u32(uint32_t value);
+    // Length-prefixed (u32) UTF-8 bytes
+    void string(llvm::StringRef value);
+
+private:
+    llvm::raw_ostream& out_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,402 @@
+#include "semantic_tokens.hpp"
+#include "parsed_unit.hpp"
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Lex/Lexer.h>
+#include <clang/Lex/Preprocessor.h>
+#include <algorithm>
+#include <optional>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+constexpr const char* kTokenTypes[] = {
+    "namespace", "type", "class", "enum", "struct", "typeParameter", "parameter",
+    "variable", "property", "enumMember", "function", "method", "macro",
+};
+
+constexpr const char* kTokenModifiers[] = {
+    "declaration", "definition", "readonly", "static", "deprecated", "abstract", "defaultLibrary",
+};
+
+// Sent results remembered per document for delta requests
+constexpr size_t kSentResults = 3;
+
+// A token before conversion to LSP positions
+struct RawToken {
+    unsigned offset = 0; // bytes into the main file
+    unsigned length = 0; // bytes
+    uint32_t type = 0;
+    uint32_t modifiers = 0;
+};
+
+const clang::NamedDecl* templatedOrSelf(const clang::NamedDecl* decl) {
+    if (const auto* templ = llvm::dyn_cast<clang::TemplateDecl>(decl)) {
+        if (const clang::NamedDecl* pattern = templ->getTemplatedDecl()) return pattern;
+    }
+    return decl;
+}
+
+std::optional<SemanticTokenType> classify(const clang::NamedDecl* decl) {
+    if (llvm::isa<clang::TemplateTypeParmDecl, clang::TemplateTemplateParmDecl>(decl)) return TokenTypeParameter;
+    decl = templatedOrSelf(decl);
+    if (llvm::isa<clang::NamespaceDecl, clang::NamespaceAliasDecl>(decl)) return TokenNamespace;
+    if (llvm::isa<clang::NonTypeTemplateParmDecl, clang::ParmVarDecl>(decl)) return TokenParameter;
+    if (llvm::isa<clang::TypedefNameDecl>(decl)) return TokenType;
+    if (const auto* record = llvm::dyn_cast<clang::RecordDecl>(decl)) {
+        return record->isClass() ? TokenClass : TokenStruct;
+    }
+    if (llvm::isa<clang::EnumDecl>(decl)) return TokenEnum;
+    if (llvm::isa<clang::EnumConstantDecl>(decl)) return TokenEnumMember;
+    if (llvm::isa<clang::FieldDecl, clang::IndirectFieldDecl>(decl)) return TokenProperty;
+    if (const auto* var = llvm::dyn_cast<clang::VarDecl>(decl)) {
+        return var->isStaticDataMember() ? TokenProperty : TokenVariable;
+    }
+    if (llvm::isa<clang::CXXMethodDecl>(decl)) return TokenMethod;
+    if (llvm::isa<clang::FunctionDecl>(decl)) return TokenFunction;
+    return std::nullopt;
+}
+
+uint32_t modifiersOf(const clang::NamedDecl* decl, const clang::SourceManager& sm) {
+    uint32_t modifiers = 0;
+    if (decl->isDeprecated()) modifiers |= ModifierDeprecated;
+    if (sm.isInSystemHeader(decl->getLocation())) modifiers |= ModifierDefaultLibrary;
+
+    decl = templatedOrSelf(decl);
+    if (const auto* var = llvm::dyn_cast<clang::VarDecl>(decl)) {
+        if (var->getType().isConstQualified() || var->isConstexpr()) modifiers |= ModifierReadonly;
+        if (var->isStaticDataMember() || var->isStaticLocal() || var->getStorageClass() == clang::SC_Static) {
+            modifiers |= ModifierStatic;
+        }
+    } else if (const auto* field = llvm::dyn_cast<clang::FieldDecl>(decl)) {
+        if (field->getType().isConstQualified()) modifiers |= ModifierReadonly;
+    } else if (llvm::isa<clang::EnumConstantDecl>(decl)) {
+        modifiers |= ModifierReadonly;
+    } else if (const auto* method = llvm::dyn_cast<clang::CXXMethodDecl>(decl)) {
+        if (method->isStatic()) modifiers |= ModifierStatic;
+        if (method->isPureVirtual()) modifiers |= ModifierAbstract;
+    } else if (const auto* record = llvm::dyn_cast<clang::CXXRecordDecl>(decl)) {
+        const clang::CXXRecordDecl* definition = record->getDefinition();
+        if (definition && definition->isAbstract()) modifiers |= ModifierAbstract;
+    }
+    return modifiers;
+}
+
+bool isDefinition(const clang::NamedDecl* decl) {
+    decl = templatedOrSelf(decl);
+    if (const auto* var = llvm::dyn_cast<clang::VarDecl>(decl)) {
+        return var->isThisDeclarationADefinition() != clang::VarDecl::DeclarationOnly;
+    }
+    if (const auto* function = llvm::dyn_cast<clang::FunctionDecl>(decl)) {
+        return function->isThisDeclarationADefinition();
+    }
+    if (const auto* tag = llvm::dyn_cast<clang::TagDecl>(decl)) {
+        return tag->isThisDeclarationADefinition();
+    }
+    return false;
+}
+
+// Collects declarations and references to them spelled in the main file
+class TokenCollector : public clang::RecursiveASTVisitor<TokenCollector> {
+public:
+    explicit TokenCollector(clang::ASTContext& context)
+        : sm_(context.getSourceManager()), langOpts_(context.getLangOpts()) {}
+
+    bool VisitNamedDecl(clang::NamedDecl* decl) {
+        // Constructors, destructors and operators have no identifier; the
+        // pattern of a template is visited on its own
+        if (decl->isImplicit() || !decl->getDeclName().isIdentifier()) return true;
+        if (llvm::isa<clang::TemplateDecl>(decl) && !llvm::isa<clang::TemplateTemplateParmDecl>(decl)) return true;
+
+        uint32_t modifiers = ModifierDeclaration;
+        if (isDefinition(decl)) modifiers |= ModifierDefinition;
+        add(decl->getLocation(), decl, modifiers);
+        return true;
+    }
+
+    bool VisitNamespaceAliasDecl(clang::NamespaceAliasDecl* alias) {
+        add(alias->getTargetNameLoc(), alias->getAliasedNamespace());
+        return true;
+    }
+
+    bool VisitUsingDirectiveDecl(clang::UsingDirectiveDecl* directive) {
+        add(directive->getIdentLocation(), directive->getNominatedNamespaceAsWritten());
+        return true;
+    }
+
+    bool VisitDeclRefExpr(clang::DeclRefExpr* expr) {
+        if (expr->getNameInfo().getName().isIdentifier()) add(expr->getLocation(), expr->getDecl());
+        return true;
+    }
+
+    bool VisitMemberExpr(clang::MemberExpr* expr) {
+        if (expr->getMemberNameInfo().getName().isIdentifier()) add(expr->getMemberLoc(), expr->getMemberDecl());
+        return true;
+    }
+
+    bool VisitTagTypeLoc(clang::TagTypeLoc loc) {
+        add(loc.getNameLoc(), loc.getDecl());
+        return true;
+    }
+
+    bool VisitTypedefTypeLoc(clang::TypedefTypeLoc loc) {
+        add(loc.getNameLoc(), loc.getTypedefNameDecl());
+        return true;
+    }
+
+    bool VisitTemplateTypeParmTypeLoc(clang::TemplateTypeParmTypeLoc loc) {
+        add(loc.getNameLoc(), loc.getDecl());
+        return true;
+    }
+
+    bool VisitInjectedClassNameTypeLoc(clang::InjectedClassNameTypeLoc loc) {
+        add(loc.getNameLoc(), loc.getDecl());
+        return true;
+    }
+
+    bool VisitTemplateSpecializationTypeLoc(clang::TemplateSpecializationTypeLoc loc) {
+        add(loc.getTemplateNameLoc(), loc.getTypePtr()->getTemplateName().getAsTemplateDecl());
+        return true;
+    }
+
+    bool TraverseNestedNameSpecifierLoc(clang::NestedNameSpecifierLoc loc) {
+        // Type qualifiers are visited as type locs; namespaces are not
+        if (loc) {
+            if (const clang::NamedDecl* ns = loc.getNestedNameSpecifier()->getAsNamespace()) {
+                add(loc.getLocalBeginLoc(), ns);
+            }
+        }
+        return clang::RecursiveASTVisitor<TokenCollector>::TraverseNestedNameSpecifierLoc(loc);
+    }
+
+    std::vector<RawToken> take() { return std::move(tokens_); }
+
+private:
+    void add(clang::SourceLocation location, const clang::NamedDecl* decl, uint32_t modifiers = 0) {
+        if (!decl || location.isInvalid()) return;
+        std::optional<SemanticTokenType> type = classify(decl);
+        if (!type) return;
+
+        // Names passed as macro arguments are spelled in the file; names
+        // produced by the macro body are not
+        if (location.isMacroID()) {
+            if (!sm_.isMacroArgExpansion(location)) return;
+            location = sm_.getSpellingLoc(location);
+        }
+        if (sm_.getFileID(location) != sm_.getMainFileID()) return;
+
+        unsigned length = clang::Lexer::MeasureTokenLength(location, sm_, langOpts_);
+        if (length == 0) return;
+        tokens_.push_back({sm_.getFileOffset(location), length, *type, modifiers | modifiersOf(decl, sm_)});
+    }
+
+    const clang::SourceManager& sm_;
+    const clang::LangOptions& langOpts_;
+    std::vector<RawToken> tokens_;
+};
+
+// Macro names are gone from the AST; find them by lexing the main file and
+// asking the preprocessor which identifiers named a macro at that point
+void collectMacros(clang::Preprocessor& pp, std::vector<RawToken>& tokens) {
+    const clang::SourceManager& sm = pp.getSourceManager();
+    clang::FileID mainFile = sm.getMainFileID();
+    clang::Lexer lexer(mainFile, sm.getBufferOrFake(mainFile), sm, pp.getLangOpts());
+
+    enum { Text, AfterHash, MacroName, SkipLine } state = Text;
+    uint32_t nameModifiers = 0;
+    clang::Token token;
+    do {
+        lexer.LexFromRawLexer(token);
+        if (token.isAtStartOfLine()) {
+            state = token.is(clang::tok::hash) ? AfterHash : Text;
+            if (state == AfterHash) continue;
+        }
+        if (state == SkipLine || token.isNot(clang::tok::raw_identifier)) continue;
+
+        llvm::StringRef name = token.getRawIdentifier();
+        unsigned offset = sm.getFileOffset(token.getLocation());
+        if (state == AfterHash) {
+            // Header names and pragma arguments are not references
+            if (name == "define" || name == "undef" || name == "ifdef" || name == "ifndef" ||
+                name == "elifdef" || name == "elifndef") {
+                nameModifiers = name == "define" ? (ModifierDeclaration | ModifierDefinition) : 0;
+                state = MacroName;
+            } else {
+                state = (name == "if" || name == "elif") ? Text : SkipLine;
+            }
+        } else if (state == MacroName) {
+            tokens.push_back({offset, token.getLength(), TokenMacro, nameModifiers});
+            // The replacement list of a #define may use other macros
+            state = nameModifiers ? Text : SkipLine;
+        } else {
+            const clang::IdentifierInfo* info = pp.getIdentifierInfo(name);
+            if (info && info->hadMacroDefinition() && pp.getMacroDefinitionAtLoc(info, token.getLocation())) {
+                tokens.push_back({offset, token.getLength(), TokenMacro, 0});
+            }
+        }
+    } while (token.isNot(clang::tok::eof));
+}
+
+// Converts sorted tokens into the LSP relative encoding against text
+std::vector<uint32_t> encodeTokens(const std::vector<RawToken>& tokens, llvm::StringRef text) {
+    std::vector<uint32_t> data;
+    data.reserve(tokens.size() * 5);
+
+    // Scan forward once, tracking the UTF-16 column of offset
+    size_t offset = 0;
+    uint32_t line = 0;
+    uint32_t column = 0;
+    uint32_t lastLine = 0;
+    uint32_t lastColumn = 0;
+    auto units = [](unsigned char c) -> uint32_t {
+        if ((c & 0xC0) == 0x80) return 0; // continuation byte
+        return c >= 0xF0 ? 2 : 1;         // 4-byte sequences need a surrogate pair
+    };
+
+    for (const RawToken& token : tokens) {
+        if (token.offset + token.length > text.size()) break;
+        for (; offset < token.offset; ++offset) {
+            if (text[offset] == '\n') {
+                ++line;
+                column = 0;
+            } else {
+                column += units(static_cast<unsigned char>(text[offset]));
+            }
+        }
+
+        // LSP tokens cannot span lines (an escaped newline inside a name)
+        llvm::StringRef spelling = text.substr(token.offset, token.length);
+        if (spelling.contains('\n')) continue;
+        uint32_t length = 0;
+        for (char c : spelling) {
+            length += units(static_cast<unsigned char>(c));
+        }
+
+        data.push_back(line - lastLine);
+        data.push_back(line == lastLine ? column - lastColumn : column);
+        data.push_back(length);
+        data.push_back(token.type);
+        data.push_back(token.modifiers);
+        lastLine = line;
+        lastColumn = column;
+    }
+    return data;
+}
+
+} // namespace
+
+llvm::ArrayRef<const char*> semanticTokenTypeNames() {
+    return kTokenTypes;
+}
+
+llvm::ArrayRef<const char*> semanticTokenModifierNames() {
+    return kTokenModifiers;
+}
+
+std::vector<uint32_t> collectSemanticTokens(ParsedUnit& unit) {
+    clang::ASTContext& context = unit.astContext();
+    clang::SourceManager& sm = unit.sourceManager();
+
+    // noload_decls() keeps the preamble's declarations from being
+    // deserialized; those already loaded are skipped by location
+    TokenCollector collector(context);
+    for (clang::Decl* decl : context.getTranslationUnitDecl()->noload_decls()) {
+        if (sm.isWrittenInMainFile(sm.getExpansionLoc(decl->getLocation()))) {
+            collector.TraverseDecl(decl);
+        }
+    }
+    std::vector<RawToken> tokens = collector.take();
+    collectMacros(unit.preprocessor(), tokens);
+
+    // A name can be seen twice (a declaration is also a type loc); keep the
+    // entry with the most modifiers, which is the declaration
+    std::sort(tokens.begin(), tokens.end(), [](const RawToken& a, const RawToken& b) {
+        if (a.offset != b.offset) return a.offset < b.offset;
+        return a.modifiers > b.modifiers;
+    });
+    tokens.erase(std::unique(tokens.begin(), tokens.end(),
+                             [](const RawToken& a, const RawToken& b) { return a.offset == b.offset; }),
+                 tokens.end());
+
+    return encodeTokens(tokens, sm.getBufferData(sm.getMainFileID()));
+}
+
+std::vector<SemanticTokensEdit> diffSemanticTokens(const std::vector<uint32_t>& previous,
+                                                   const std::vector<uint32_t>& current) {
+    size_t prefix = 0;
+    while (prefix < previous.size() && prefix < current.size() && previous[prefix] == current[prefix]) {
+        ++prefix;
+    }
+    if (prefix == previous.size() && prefix == current.size()) return {};
+
+    // Positions are relative, so an edit usually changes a handful of
+    // integers around it and leaves the rest of the file identical
+    size_t suffix = 0;
+    while (suffix < previous.size() - prefix && suffix < current.size() - prefix &&
+           previous[previous.size() - 1 - suffix] == current[current.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    SemanticTokensEdit edit;
+    edit.start = static_cast<uint32_t>(prefix);
+    edit.deleteCount = static_cast<uint32_t>(previous.size() - prefix - suffix);
+    edit.data.assign(current.begin() + prefix, current.end() - suffix);
+    return {std::move(edit)};
+}
+
+SemanticTokensCache::Data SemanticTokensCache::find(const std::string& uri, int version,
+                                                    uint64_t contentHash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(uri);
+    if (it == entries_.end() || !it->second.tokens) return nullptr;
+    const Entry& entry = it->second;
+    if (entry.version != version || entry.contentHash != contentHash) return nullptr;
+    return entry.tokens;
+}
+
+void SemanticTokensCache::store(const std::string& uri, int version, uint64_t contentHash, Data tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[uri];
+    entry.version = version;
+    entry.contentHash = contentHash;
+    entry.tokens = std::move(tokens);
+}
+
+std::string SemanticTokensCache::publish(const std::string& uri, const Data& tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[uri];
+    if (!entry.sent.empty() && entry.sent.back().second == tokens) return entry.sent.back().first;
+
+    std::string resultId = std::to_string(nextResultId_++);
+    entry.sent.emplace_back(resultId, tokens);
+    if (entry.sent.size() > kSentResults) entry.sent.pop_front();
+    return resultId;
+}
+
+SemanticTokensCache::Data SemanticTokensCache::sent(const std::string& uri, const std::string& resultId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(uri);
+    if (it == entries_.end()) return nullptr;
+    for (const auto& [id, tokens] : it->second.sent) {
+        if (id == resultId) return tokens;
+    }
+    return nullptr;
+}
+
+void SemanticTokensCache::invalidate(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(uri);
+}
+
+void SemanticTokensCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+} // namespace lsp
+} // namespace miko
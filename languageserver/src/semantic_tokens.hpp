@@ -0,0 +1,97 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <llvm/ADT/ArrayRef.h>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+class ParsedUnit;
+
+// Indices into semanticTokenTypeNames(), the legend sent in initialize
+enum SemanticTokenType : uint32_t {
+    TokenNamespace,
+    TokenType,
+    TokenClass,
+    TokenEnum,
+    TokenStruct,
+    TokenTypeParameter,
+    TokenParameter,
+    TokenVariable,
+    TokenProperty,
+    TokenEnumMember,
+    TokenFunction,
+    TokenMethod,
+    TokenMacro,
+};
+
+// Bits of the modifier set; bit i is semanticTokenModifierNames()[i]
+enum SemanticTokenModifier : uint32_t {
+    ModifierDeclaration = 1u << 0,
+    ModifierDefinition = 1u << 1,
+    ModifierReadonly = 1u << 2,
+    ModifierStatic = 1u << 3,
+    ModifierDeprecated = 1u << 4,
+    ModifierAbstract = 1u << 5,
+    ModifierDefaultLibrary = 1u << 6,
+};
+
+llvm::ArrayRef<const char*> semanticTokenTypeNames();
+llvm::ArrayRef<const char*> semanticTokenModifierNames();
+
+// Classifies the names in the unit's main file (declarations, references,
+// type names, namespaces and macros) and returns them in the LSP relative
+// encoding: five integers per token, sorted by position, columns in UTF-16
+// code units
+std::vector<uint32_t> collectSemanticTokens(ParsedUnit& unit);
+
+// Edits turning previous into current: the common prefix and suffix are
+// kept and the differing middle is replaced in one edit. Empty when equal.
+std::vector<SemanticTokensEdit> diffSemanticTokens(const std::vector<uint32_t>& previous,
+                                                   const std::vector<uint32_t>& current);
+
+// Semantic tokens per document. The latest computed tokens are kept for the
+// document version and content they were computed from, so requests and
+// re-analyses of an unchanged document share one computation. Results sent
+// to the client are remembered by result ID for the next delta request.
+class SemanticTokensCache {
+public:
+    using Data = std::shared_ptr<const std::vector<uint32_t>>;
+
+    // Tokens computed for exactly this snapshot, or nullptr
+    Data find(const std::string& uri, int version, uint64_t contentHash) const;
+    void store(const std::string& uri, int version, uint64_t contentHash, Data tokens);
+
+    // Records tokens as sent and returns their result ID; sending the same
+    // tokens again reuses the ID
+    std::string publish(const std::string& uri, const Data& tokens);
+    // Tokens sent under resultId, or nullptr once forgotten
+    Data sent(const std::string& uri, const std::string& resultId) const;
+
+    void invalidate(const std::string& uri);
+    void clear();
+
+private:
+    struct Entry {
+        int version = 0;
+        uint64_t contentHash = 0;
+        Data tokens;
+        // Recent results, newest last; a client may still hold one that
+        // was superseded by a request it abandoned
+        std::deque<std::pair<std::string, Data>> sent;
+    };
+
+    std::map<std::string, Entry> entries_;
+    uint64_t nextResultId_ = 1;
+    mutable std::mutex mutex_;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,352 @@
+#include "symbol_index.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <tuple>
+
+namespace miko {
+namespace lsp {
+
+struct IndexShard::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dependencyCount;
+    uint64_t contentHash;
+    uint64_t commandHash;
+    uint32_t pathOffset;
+    uint32_t symbolCount;
+    uint32_t occurrenceCount;
+    uint32_t stringTableSize;
+    uint8_t reserved[16];
+};
+
+namespace {
+constexpr char kShardMagic[8] = {'M', 'I', 'K', 'O', 'I', 'D', 'X', '\0'};
+
+static_assert(sizeof(IndexOccurrence) == 20, "index format changed");
+static_assert(sizeof(IndexSymbolRecord) == 20, "index format changed");
+static_assert(sizeof(IndexDependencyRecord) == 16, "index format changed");
+
+// Deduplicating string table builder
+class StringTable {
+public:
+    uint32_t add(const std::string& value) {
+        auto it = offsets_.find(value);
+        if (it != offsets_.end()) return it->second;
+        uint32_t offset = static_cast<uint32_t>(data_.size());
+        data_.append(value);
+        data_.push_back('\0');
+        offsets_.emplace(value, offset);
+        return offset;
+    }
+
+    const std::string& data() const { return data_; }
+
+private:
+    std::string data_;
+    std::map<std::string, uint32_t> offsets_;
+};
+
+bool contains(const IndexOccurrence& occurrence, const Position& position) {
+    uint32_t line = static_cast<uint32_t>(position.line);
+    uint32_t character = static_cast<uint32_t>(position.character);
+    if (line < occurrence.line || line > occurrence.endLine) return false;
+    if (line == occurrence.line && character < occurrence.column) return false;
+    // Inclusive end so a cursor just after an identifier still hits it
+    if (line == occurrence.endLine && character > occurrence.endColumn) return false;
+    return true;
+}
+}
+
+std::shared_ptr<IndexShard> IndexShard::open(const std::string& file) {
+    // Large shards are mapped rather than read
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+        llvm::MemoryBuffer::getFile(file, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) return nullptr;
+
+    const char* data = (*buffer)->getBufferStart();
+    size_t size = (*buffer)->getBufferSize();
+    if (size < sizeof(Header)) return nullptr;
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header->magic, kShardMagic, sizeof(kShardMagic)) != 0 ||
+        header->version != kIndexFormatVersion) {
+        return nullptr;
+    }
+
+    uint64_t dependencyBytes = uint64_t(header->dependencyCount) * sizeof(IndexDependencyRecord);
+    uint64_t symbolBytes = uint64_t(header->symbolCount) * sizeof(IndexSymbolRecord);
+    uint64_t occurrenceBytes = uint64_t(header->occurrenceCount) * sizeof(IndexOccurrence);
+    uint64_t expected = sizeof(Header) + dependencyBytes + symbolBytes + occurrenceBytes + header->stringTableSize;
+    if (expected != size) return nullptr;
+
+    std::shared_ptr<IndexShard> shard(new IndexShard());
+    const char* cursor = data + sizeof(Header);
+    shard->dependencies_ = llvm::ArrayRef<IndexDependencyRecord>(
+        reinterpret_cast<const IndexDependencyRecord*>(cursor), header->dependencyCount);
+    cursor += dependencyBytes;
+    shard->symbols_ = llvm::ArrayRef<IndexSymbolRecord>(
+        reinterpret_cast<const IndexSymbolRecord*>(cursor), header->symbolCount);
+    cursor += symbolBytes;
+    shard->occurrences_ = llvm::ArrayRef<IndexOccurrence>(
+        reinterpret_cast<const IndexOccurrence*>(cursor), header->occurrenceCount);
+    cursor += occurrenceBytes;
+    shard->strings_ = llvm::StringRef(cursor, header->stringTableSize);
+
+    for (const auto& symbol : shard->symbols_) {
+        if (uint64_t(symbol.firstOccurrence) + symbol.occurrenceCount > header->occurrenceCount) {
+            return nullptr;
+        }
+    }
+
+    shard->buffer_ = std::move(*buffer);
+    return shard;
+}
+
+bool IndexShard::write(const std::string& file, ShardData data) {
+    std::sort(data.symbols.begin(), data.symbols.end(),
+              [](const ShardData::Symbol& a, const ShardData::Symbol& b) { return a.usr < b.usr; });
+
+    StringTable strings;
+    Header header = {};
+    std::memcpy(header.magic, kShardMagic, sizeof(kShardMagic));
+    header.version = kIndexFormatVersion;
+    header.contentHash = data.contentHash;
+    header.commandHash = data.commandHash;
+    header.pathOffset = strings.add(data.path);
+
+    std::vector<IndexDependencyRecord> dependencies;
+    dependencies.reserve(data.dependencies.size());
+    for (const auto& [path, hash] : data.dependencies) {
+        dependencies.push_back({strings.add(path), 0, hash});
+    }
+
+    std::vector<IndexSymbolRecord> symbols;
+    std::vector<IndexOccurrence> occurrences;
+    symbols.reserve(data.symbols.size());
+    for (auto& symbol : data.symbols) {
+        auto& list = symbol.occurrences;
+        std::sort(list.begin(), list.end(), [](const IndexOccurrence& a, const IndexOccurrence& b) {
+            return std::tie(a.line, a.column) < std::tie(b.line, b.column);
+        });
+
+        IndexSymbolRecord record;
+        record.usrOffset = strings.add(symbol.usr);
+        record.nameOffset = strings.add(symbol.name);
+        record.kind = symbol.kind;
+        record.firstOccurrence = static_cast<uint32_t>(occurrences.size());
+        for (const auto& occurrence : list) {
+            // The same location can be reported once per role
+            if (occurrences.size() > record.firstOccurrence && occurrences.back().line == occurrence.line &&
+                occurrences.back().column == occurrence.column) {
+                occurrences.back().roles |= occurrence.roles;
+                continue;
+            }
+            occurrences.push_back(occurrence);
+        }
+        record.occurrenceCount = static_cast<uint32_t>(occurrences.size()) - record.firstOccurrence;
+        symbols.push_back(record);
+    }
+
+    if (strings.data().size() > std::numeric_limits<uint32_t>::max()) return false;
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.symbolCount = static_cast<uint32_t>(symbols.size());
+    header.occurrenceCount = static_cast<uint32_t>(occurrences.size());
+    header.stringTableSize = static_cast<uint32_t>(strings.data().size());
+
+    return writeFileAtomically(file, [&](llvm::raw_ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(dependencies.data()),
+                  dependencies.size() * sizeof(IndexDependencyRecord));
+        out.write(reinterpret_cast<const char*>(symbols.data()), symbols.size() * sizeof(IndexSymbolRecord));
+        out.write(reinterpret_cast<const char*>(occurrences.data()), occurrences.size() * sizeof(IndexOccurrence));
+        out.write(strings.data().data(), strings.data().size());
+    });
+}
+
+const IndexShard::Header& IndexShard::header() const {
+    return *reinterpret_cast<const Header*>(buffer_->getBufferStart());
+}
+
+llvm::StringRef IndexShard::path() const {
+    return string(header().pathOffset);
+}
+
+uint64_t IndexShard::contentHash() const {
+    return header().contentHash;
+}
+
+uint64_t IndexShard::commandHash() const {
+    return header().commandHash;
+}
+
+llvm::ArrayRef<IndexOccurrence> IndexShard::occurrences(const IndexSymbolRecord& symbol) const {
+    return occurrences_.slice(symbol.firstOccurrence, symbol.occurrenceCount);
+}
+
+llvm::StringRef IndexShard::string(uint32_t offset) const {
+    if (offset >= strings_.size()) return {};
+    llvm::StringRef rest = strings_.drop_front(offset);
+    return rest.take_until([](char c) { return c == '\0'; });
+}
+
+const IndexSymbolRecord* IndexShard::findSymbol(llvm::StringRef usr) const {
+    auto it = std::lower_bound(symbols_.begin(), symbols_.end(), usr,
+                               [this](const IndexSymbolRecord& symbol, llvm::StringRef value) {
+                                   return string(symbol.usrOffset) < value;
+                               });
+    if (it == symbols_.end() || string(it->usrOffset) != usr) return nullptr;
+    return &*it;
+}
+
+const IndexSymbolRecord* IndexShard::symbolAt(const Position& position) const {
+    const IndexSymbolRecord* best = nullptr;
+    uint64_t bestSpan = std::numeric_limits<uint64_t>::max();
+    for (const auto& symbol : symbols_) {
+        for (const auto& occurrence : occurrences(symbol)) {
+            if (!contains(occurrence, position)) continue;
+            uint64_t span = (uint64_t(occurrence.endLine - occurrence.line) << 32) +
+                            (occurrence.endColumn - occurrence.column);
+            if (span < bestSpan) {
+                best = &symbol;
+                bestSpan = span;
+            }
+        }
+    }
+    return best;
+}
+
+void SymbolIndex::add(std::shared_ptr<IndexShard> shard) {
+    if (!shard) return;
+    std::string path = shard->path().str();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!search_.contains(path, shard->contentHash(), shard->commandHash())) {
+        search_.update(*shard);
+        ++searchGeneration_;
+    }
+    shards_[path] = std::move(shard);
+}
+
+void SymbolIndex::remove(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    shards_.erase(path);
+    search_.remove(path);
+    ++searchGeneration_;
+}
+
+std::shared_ptr<IndexShard> SymbolIndex::shard(const std::string& path) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = shards_.find(path);
+    return it != shards_.end() ? it->second : nullptr;
+}
+
+size_t SymbolIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return shards_.size();
+}
+
+std::string SymbolIndex::usrAt(const std::string& path, const Position& position) const {
+    std::shared_ptr<IndexShard> fileShard = shard(normalizeIndexPath(path));
+    if (!fileShard) return {};
+    const IndexSymbolRecord* symbol = fileShard->symbolAt(position);
+    return symbol ? fileShard->string(symbol->usrOffset).str() : std::string();
+}
+
+std::vector<IndexLocation> SymbolIndex::lookup(llvm::StringRef usr, uint32_t roleMask,
+                                               const std::function<bool()>& isCancelled) const {
+    std::vector<IndexLocation> locations;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& [path, fileShard] : shards_) {
+        if (isCancelled && isCancelled()) return {};
+        const IndexSymbolRecord* symbol = fileShard->findSymbol(usr);
+        if (!symbol) continue;
+        for (const auto& occurrence : fileShard->occurrences(*symbol)) {
+            if (!(occurrence.roles & roleMask)) continue;
+            IndexLocation location;
+            location.path = path;
+            location.range.start = {static_cast<int>(occurrence.line), static_cast<int>(occurrence.column)};
+            location.range.end = {static_cast<int>(occurrence.endLine), static_cast<int>(occurrence.endColumn)};
+            locations.push_back(std::move(location));
+        }
+    }
+    return locations;
+}
+
+std::vector<SymbolSearchResult> SymbolIndex::searchSymbols(llvm::StringRef query, size_t limit,
+                                                           const std::function<bool()>& isCancelled) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return search_.search(query, limit, isCancelled);
+}
+
+bool SymbolIndex::loadSearchIndex(const std::string& file) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!search_.load(file)) return false;
+    ++searchGeneration_;
+    return true;
+}
+
+bool SymbolIndex::saveSearchIndex(const std::string& file) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return search_.save(file);
+}
+
+void SymbolIndex::pruneSearchIndex() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& path : search_.paths()) {
+        if (shards_.count(path)) continue;
+        search_.remove(path);
+        ++searchGeneration_;
+    }
+}
+
+uint64_t SymbolIndex::searchGeneration() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return searchGeneration_;
+}
+
+std::string normalizeIndexPath(llvm::StringRef path, llvm::StringRef workingDirectory) {
+    llvm::SmallString<256> normalized(path);
+    if (!llvm::sys::path::is_absolute(normalized) && !workingDirectory.empty()) {
+        llvm::sys::fs::make_absolute(workingDirectory, normalized);
+    }
+    llvm::sys::path::remove_dots(normalized, /*remove_dot_dot=*/true);
+    std::string result = normalized.str().str();
+    std::replace(result.begin(), result.end(), '\\', '/');
+    return result;
+}
+
+std::string shardFileName(llvm::StringRef path) {
+    return (llvm::sys::path::filename(path) + "." + llvm::utohexstr(hashContent(path)) + ".idx").str();
+}
+
+uint64_t hashContent(llvm::StringRef content) {
+    return llvm::xxh3_64bits(content);
+}
+
+bool writeFileAtomically(const std::string& file, llvm::function_ref<void(llvm::raw_ostream&)> write) {
+    // Ends in .tmp, so loadShards() skips leftovers of a crash
+    int fd = -1;
+    llvm::SmallString<256> temporary;
+    if (llvm::sys::fs::createUniqueFile(file + "-%%%%%%%%.tmp", fd, temporary)) return false;
+    bool written;
+    {
+        llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+        write(out);
+        out.close();
+        written = !out.has_error();
+        // An unchecked error would abort in the destructor
+        out.clear_error();
+    }
+    if (written && !llvm::sys::fs::rename(temporary, file)) return true;
+    llvm::sys::fs::remove(temporary);
+    return false;
+}
+
+} // namespace lsp
+} // namespace miko
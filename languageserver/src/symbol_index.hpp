@@ -0,0 +1,158 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include "symbol_search.hpp"
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+// Bits of IndexOccurrence::roles
+enum IndexRole : uint32_t {
+    IndexRoleDeclaration = 1u << 0,
+    IndexRoleDefinition = 1u << 1,
+    IndexRoleReference = 1u << 2,
+};
+
+// On-disk records. Shards are read in place from a mapped file, so these
+// layouts are the file format; bump kIndexFormatVersion when they change.
+struct IndexOccurrence {
+    uint32_t line;
+    uint32_t column;    // UTF-16 code units, like LSP positions
+    uint32_t endLine;
+    uint32_t endColumn;
+    uint32_t roles;
+};
+
+struct IndexSymbolRecord {
+    uint32_t usrOffset;  // into the string table
+    uint32_t nameOffset;
+    uint32_t kind;       // clang::index::SymbolKind
+    uint32_t firstOccurrence;
+    uint32_t occurrenceCount;
+};
+
+struct IndexDependencyRecord {
+    uint32_t pathOffset;
+    uint32_t reserved;
+    uint64_t contentHash;
+};
+
+constexpr uint32_t kIndexFormatVersion = 1;
+
+// Shard contents as produced by the indexer before serialization
+struct ShardData {
+    struct Symbol {
+        std::string usr;
+        std::string name;
+        uint32_t kind = 0;
+        std::vector<IndexOccurrence> occurrences;
+    };
+
+    std::string path;
+    uint64_t contentHash = 0;
+    uint64_t commandHash = 0; // only meaningful for main files
+    std::vector<Symbol> symbols;
+    // Files the translation unit read, with their hashes when indexed; lets
+    // a main file's shard be validated without reparsing
+    std::vector<std::pair<std::string, uint64_t>> dependencies;
+};
+
+// Index data for the symbols occurring in one source file, backed by a
+// memory-mapped file. Symbols are sorted by USR and each symbol's
+// occurrences are contiguous.
+class IndexShard {
+public:
+    static std::shared_ptr<IndexShard> open(const std::string& file);
+    static bool write(const std::string& file, ShardData data);
+
+    llvm::StringRef path() const;
+    uint64_t contentHash() const;
+    uint64_t commandHash() const;
+
+    llvm::ArrayRef<IndexSymbolRecord> symbols() const { return symbols_; }
+    llvm::ArrayRef<IndexOccurrence> occurrences(const IndexSymbolRecord& symbol) const;
+    llvm::ArrayRef<IndexDependencyRecord> dependencies() const { return dependencies_; }
+    llvm::StringRef string(uint32_t offset) const;
+
+    const IndexSymbolRecord* findSymbol(llvm::StringRef usr) const;
+    // Innermost symbol occurrence covering position, or nullptr
+    const IndexSymbolRecord* symbolAt(const Position& position) const;
+
+private:
+    struct Header;
+
+    IndexShard() = default;
+    const Header& header() const;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer_;
+    llvm::ArrayRef<IndexDependencyRecord> dependencies_;
+    llvm::ArrayRef<IndexSymbolRecord> symbols_;
+    llvm::ArrayRef<IndexOccurrence> occurrences_;
+    llvm::StringRef strings_;
+};
+
+// A file location returned by index queries
+struct IndexLocation {
+    std::string path;
+    Range range;
+};
+
+// All loaded shards, keyed by source path. Readers take a shared lock;
+// shards are replaced whole when a file is re-indexed. The symbol names of
+// every shard are also kept in a SymbolSearchIndex for workspace/symbol.
+class SymbolIndex {
+public:
+    void add(std::shared_ptr<IndexShard> shard);
+    void remove(const std::string& path);
+    std::shared_ptr<IndexShard> shard(const std::string& path) const;
+    size_t size() const;
+
+    // USR of the symbol at position in path, empty if none
+    std::string usrAt(const std::string& path, const Position& position) const;
+    // Occurrences of usr whose roles intersect roleMask; nothing once
+    // isCancelled() reports the request was cancelled
+    std::vector<IndexLocation> lookup(llvm::StringRef usr, uint32_t roleMask,
+                                      const std::function<bool()>& isCancelled = nullptr) const;
+
+    // Workspace symbols whose name fuzzy-matches query, best first
+    std::vector<SymbolSearchResult> searchSymbols(llvm::StringRef query, size_t limit,
+                                                  const std::function<bool()>& isCancelled = nullptr) const;
+    // Loads a saved search index; add() then skips shards it already covers
+    bool loadSearchIndex(const std::string& file);
+    bool saveSearchIndex(const std::string& file) const;
+    // Drops search entries of files that have no shard
+    void pruneSearchIndex();
+    // Bumped whenever the search index changes, to know when to save it
+    uint64_t searchGeneration() const;
+
+private:
+    std::map<std::string, std::shared_ptr<IndexShard>> shards_;
+    SymbolSearchIndex search_;
+    uint64_t searchGeneration_ = 0;
+    mutable std::shared_mutex mutex_;
+};
+
+// Absolute, dot-free path with forward slashes; the key used for shards
+std::string normalizeIndexPath(llvm::StringRef path, llvm::StringRef workingDirectory = "");
+// File name of the shard for path inside the index directory
+std::string shardFileName(llvm::StringRef path);
+uint64_t hashContent(llvm::StringRef content);
+// Writes file through a uniquely named temporary next to it and renames it
+// into place, so readers never map a partial file and concurrent writers
+// of the same file don't write into each other's temporary. The temporary
+// is removed when writing or renaming fails.
+bool writeFileAtomically(const std::string& file, llvm::function_ref<void(llvm::raw_ostream&)> write);
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,521 @@
+#include "symbol_search.hpp"
+#include "fuzzy_match.hpp"
+#include "symbol_index.hpp"
+#include <clang/Index/IndexSymbol.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <tuple>
+
+namespace miko {
+namespace lsp {
+
+namespace {
+
+struct SearchHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fileCount;
+    uint32_t entryCount;
+    uint32_t tokenCount;
+    uint32_t postingCount;
+    uint32_t stringTableSize;
+    uint8_t reserved[8];
+};
+
+struct SearchFileRecord {
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint64_t contentHash;
+    uint64_t commandHash;
+};
+
+struct SearchTokenRecord {
+    uint32_t token;
+    uint32_t count; // ids that follow in the posting array
+};
+
+constexpr char kSearchMagic[8] = {'M', 'I', 'K', 'O', 'S', 'Y', 'M', '\0'};
+constexpr uint32_t kSearchFormatVersion = 1;
+
+// Postings visited between checks for a cancelled request
+constexpr size_t kCancelStride = 4096;
+// Longer names are only tokenized up to here
+constexpr size_t kMaxTokenizedLength = 64;
+// Dead entries tolerated before the arrays are rebuilt
+constexpr size_t kMinCompaction = 4096;
+
+uint32_t token(uint32_t length, unsigned char a, unsigned char b = 0, unsigned char c = 0) {
+    return (length << 24) | (uint32_t(a) << 16) | (uint32_t(b) << 8) | c;
+}
+
+bool isWordStart(llvm::StringRef name, size_t i) {
+    if (i == 0) return true;
+    char previous = name[i - 1];
+    char current = name[i];
+    if (llvm::isUpper(current) && !llvm::isUpper(previous)) return true;
+    if (llvm::isDigit(current) != llvm::isDigit(previous) && llvm::isAlnum(current)) return true;
+    return llvm::isAlnum(current) && !llvm::isAlnum(previous);
+}
+
+// Trigrams of name along paths that advance to the next character or jump
+// to the next word start, plus the prefix tokens short queries use
+void nameTokens(llvm::StringRef name, std::vector<uint32_t>& tokens) {
+    tokens.clear();
+    name = name.take_front(kMaxTokenizedLength);
+    const size_t n = name.size();
+    if (n == 0) return;
+
+    llvm::SmallVector<unsigned char, 64> lower(n);
+    llvm::SmallVector<size_t, 64> nextWord(n); // first word start after i, or n
+    size_t next = n;
+    for (size_t i = n; i-- > 0;) {
+        lower[i] = static_cast<unsigned char>(llvm::toLower(name[i]));
+        nextWord[i] = next;
+        if (isWordStart(name, i)) next = i;
+    }
+
+    auto forEachSuccessor = [&](size_t i, auto&& visit) {
+        if (i + 1 < n) visit(i + 1);
+        if (nextWord[i] < n && nextWord[i] != i + 1) visit(nextWord[i]);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        forEachSuccessor(i, [&](size_t j) {
+            forEachSuccessor(j, [&](size_t k) { tokens.push_back(token(3, lower[i], lower[j], lower[k])); });
+        });
+    }
+
+    tokens.push_back(token(1, lower[0]));
+    if (n > 1) tokens.push_back(token(2, lower[0], lower[1]));
+    if (nextWord[0] < n) tokens.push_back(token(2, lower[0], lower[nextWord[0]]));
+
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+}
+
+// A query of one or two characters matches name prefixes; longer ones
+// need all of their consecutive trigrams
+void queryTokens(llvm::StringRef query, std::vector<uint32_t>& tokens) {
+    tokens.clear();
+    query = query.take_front(kMaxTokenizedLength);
+    std::string lower = query.lower();
+    auto at = [&](size_t i) { return static_cast<unsigned char>(lower[i]); };
+    if (lower.size() == 1) {
+        tokens.push_back(token(1, at(0)));
+    } else if (lower.size() == 2) {
+        tokens.push_back(token(2, at(0), at(1)));
+    } else {
+        for (size_t i = 0; i + 2 < lower.size(); ++i) {
+            tokens.push_back(token(3, at(i), at(i + 1), at(i + 2)));
+        }
+    }
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+}
+
+} // namespace
+
+int lspSymbolKind(uint32_t indexKind) {
+    using clang::index::SymbolKind;
+    switch (static_cast<SymbolKind>(indexKind)) {
+    case SymbolKind::Module: return 2;
+    case SymbolKind::Namespace:
+    case SymbolKind::NamespaceAlias: return 3;
+    case SymbolKind::Macro: return 14;
+    case SymbolKind::Enum: return 10;
+    case SymbolKind::Struct:
+    case SymbolKind::Union: return 23;
+    case SymbolKind::Class:
+    case SymbolKind::TypeAlias:
+    case SymbolKind::Extension: return 5;
+    case SymbolKind::Protocol:
+    case SymbolKind::Concept: return 11;
+    case SymbolKind::Function:
+    case SymbolKind::ConversionFunction: return 12;
+    case SymbolKind::Variable: return 13;
+    case SymbolKind::Field: return 8;
+    case SymbolKind::EnumConstant: return 22;
+    case SymbolKind::InstanceMethod:
+    case SymbolKind::ClassMethod:
+    case SymbolKind::StaticMethod: return 6;
+    case SymbolKind::InstanceProperty:
+    case SymbolKind::ClassProperty:
+    case SymbolKind::StaticProperty: return 7;
+    case SymbolKind::Constructor:
+    case SymbolKind::Destructor: return 9;
+    default: return 0;
+    }
+}
+
+void SymbolSearchIndex::update(const IndexShard& shard) {
+    remove(shard.path());
+
+    uint32_t fileId = static_cast<uint32_t>(files_.size());
+    File file;
+    file.path = shard.path().str();
+    file.contentHash = shard.contentHash();
+    file.commandHash = shard.commandHash();
+    fileIds_[file.path] = fileId;
+    files_.push_back(std::move(file));
+
+    for (const auto& symbol : shard.symbols()) {
+        int kind = lspSymbolKind(symbol.kind);
+        llvm::StringRef symbolName = shard.string(symbol.nameOffset);
+        if (!kind || symbolName.empty()) continue;
+
+        // Listed where the file defines the symbol, or declares it if it
+        // has no definition here
+        const IndexOccurrence* site = nullptr;
+        for (const auto& occurrence : shard.occurrences(symbol)) {
+            if (occurrence.roles & IndexRoleDefinition) {
+                site = &occurrence;
+                break;
+            }
+            if (!site && (occurrence.roles & IndexRoleDeclaration)) site = &occurrence;
+        }
+        if (!site) continue;
+
+        Entry entry = {};
+        entry.file = fileId;
+        entry.kind = static_cast<uint32_t>(kind);
+        entry.line = site->line;
+        entry.column = site->column;
+        entry.endLine = site->endLine;
+        entry.endColumn = site->endColumn;
+        entry.usrHash = hashContent(shard.string(symbol.usrOffset));
+        entry.flags = (site->roles & IndexRoleDefinition) ? EntryDefinition : 0;
+        addEntry(entry, symbolName);
+    }
+
+    if (dead_ > kMinCompaction && dead_ > entries_.size() / 2) compact();
+}
+
+void SymbolSearchIndex::remove(llvm::StringRef path) {
+    auto it = fileIds_.find(path);
+    if (it == fileIds_.end()) return;
+    File& file = files_[it->second];
+    for (uint32_t id : file.entries) {
+        entries_[id].flags |= EntryDead;
+    }
+    dead_ += file.entries.size();
+    file.entries.clear();
+    file.entries.shrink_to_fit();
+    fileIds_.erase(it);
+}
+
+bool SymbolSearchIndex::contains(llvm::StringRef path, uint64_t contentHash, uint64_t commandHash) const {
+    auto it = fileIds_.find(path);
+    if (it == fileIds_.end()) return false;
+    const File& file = files_[it->second];
+    return file.contentHash == contentHash && file.commandHash == commandHash;
+}
+
+std::vector<std::string> SymbolSearchIndex::paths() const {
+    std::vector<std::string> result;
+    result.reserve(fileIds_.size());
+    for (const auto& entry : fileIds_) {
+        result.push_back(entry.getKey().str());
+    }
+    return result;
+}
+
+void SymbolSearchIndex::addEntry(Entry entry, llvm::StringRef entryName) {
+    if (names_.size() + entryName.size() > std::numeric_limits<uint32_t>::max()) return;
+    entry.nameOffset = static_cast<uint32_t>(names_.size());
+    entry.nameLength = static_cast<uint32_t>(entryName.size());
+    names_.append(entryName.data(), entryName.size());
+
+    uint32_t id = static_cast<uint32_t>(entries_.size());
+    entries_.push_back(entry);
+    masks_.push_back(characterMask(entryName));
+    files_[entry.file].entries.push_back(id);
+
+    // Ids only grow, so every posting list stays sorted
+    std::vector<uint32_t> tokens;
+    nameTokens(entryName, tokens);
+    for (uint32_t value : tokens) {
+        postings_[value].push_back(id);
+    }
+}
+
+void SymbolSearchIndex::compact() {
+    std::vector<Entry> entries = std::move(entries_);
+    std::string names = std::move(names_);
+    std::vector<File> files = std::move(files_);
+    llvm::StringMap<uint32_t> fileIds = std::move(fileIds_);
+    entries_.clear();
+    masks_.clear();
+    names_.clear();
+    files_.clear();
+    fileIds_.clear();
+    postings_.clear();
+    dead_ = 0;
+
+    for (const auto& live : fileIds) {
+        const File& old = files[live.getValue()];
+        uint32_t fileId = static_cast<uint32_t>(files_.size());
+        fileIds_[old.path] = fileId;
+        files_.push_back(File{old.path, old.contentHash, old.commandHash, {}});
+        for (uint32_t id : old.entries) {
+            Entry entry = entries[id];
+            entry.file = fileId;
+            addEntry(entry, llvm::StringRef(names).substr(entry.nameOffset, entry.nameLength));
+        }
+    }
+}
+
+std::vector<SymbolSearchResult> SymbolSearchIndex::search(llvm::StringRef query, size_t limit,
+                                                          const std::function<bool()>& isCancelled) const {
+    size_t qualifier = query.rfind("::");
+    if (qualifier != llvm::StringRef::npos) query = query.drop_front(qualifier + 2);
+    query = query.trim();
+    if (query.empty() || limit == 0) return {};
+
+    std::vector<uint32_t> tokens;
+    queryTokens(query, tokens);
+    std::vector<const std::vector<uint32_t>*> lists;
+    lists.reserve(tokens.size());
+    for (uint32_t value : tokens) {
+        auto it = postings_.find(value);
+        if (it == postings_.end()) return {};
+        lists.push_back(&it->second);
+    }
+    // Drive the intersection from the most selective token
+    std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+    FuzzyMatcher matcher(query);
+    const uint64_t patternMask = matcher.mask();
+
+    struct Scored {
+        float score;
+        uint32_t id;
+    };
+    // Best first; the ranking does not depend on the order symbols were
+    // indexed in
+    auto better = [this](const Scored& a, const Scored& b) {
+        if (a.score != b.score) return a.score > b.score;
+        const Entry& left = entries_[a.id];
+        const Entry& right = entries_[b.id];
+        if (left.nameLength != right.nameLength) return left.nameLength < right.nameLength;
+        if (int order = name(left).compare(name(right))) return order < 0;
+        if (left.file != right.file) return files_[left.file].path < files_[right.file].path;
+        return std::tie(left.line, left.column) < std::tie(right.line, right.column);
+    };
+    // Every candidate is scored; the heap keeps the best limit of them with
+    // the worst at the front
+    std::vector<Scored> best;
+    llvm::DenseMap<uint64_t, uint32_t> byUsr; // symbols in best, one entry each
+    std::vector<size_t> cursors(lists.size(), 0);
+    bool exhausted = false;
+    size_t visited = 0;
+    for (uint32_t id : *lists.front()) {
+        if (++visited % kCancelStride == 0 && isCancelled && isCancelled()) return {};
+        bool inAll = true;
+        for (size_t i = 1; i < lists.size() && inAll; ++i) {
+            const std::vector<uint32_t>& list = *lists[i];
+            auto it = std::lower_bound(list.begin() + cursors[i], list.end(), id);
+            cursors[i] = static_cast<size_t>(it - list.begin());
+            exhausted = it == list.end();
+            inAll = !exhausted && *it == id;
+        }
+        if (exhausted) break;
+        if (!inAll) continue;
+
+        const Entry& entry = entries_[id];
+        if ((entry.flags & EntryDead) || !maskCovers(masks_[id], patternMask)) continue;
+        float score = matcher.match(name(entry));
+        if (score < 0) continue;
+        Scored candidate{score, id};
+
+        auto existing = byUsr.find(entry.usrHash);
+        if (existing != byUsr.end()) {
+            // Prefer the definition over declarations in headers. Entries of
+            // one symbol share its name, so the score and rank are the same.
+            if ((entry.flags & EntryDefinition) && !(entries_[existing->second].flags & EntryDefinition)) {
+                for (Scored& kept : best) {
+                    if (kept.id == existing->second) kept.id = id;
+                }
+                existing->second = id;
+                // Its location, which breaks ties, changed
+                std::make_heap(best.begin(), best.end(), better);
+            }
+            continue;
+        }
+        if (best.size() == limit) {
+            if (!better(candidate, best.front())) continue;
+            std::pop_heap(best.begin(), best.end(), better);
+            byUsr.erase(entries_[best.back().id].usrHash);
+            best.pop_back();
+        }
+        best.push_back(candidate);
+        std::push_heap(best.begin(), best.end(), better);
+        byUsr[entry.usrHash] = id;
+    }
+    std::sort_heap(best.begin(), best.end(), better);
+
+    std::vector<SymbolSearchResult> results;
+    results.reserve(best.size());
+    for (const Scored& scored : best) {
+        const Entry& entry = entries_[scored.id];
+        SymbolSearchResult result;
+        result.name = name(entry).str();
+        result.path = files_[entry.file].path;
+        result.kind = static_cast<int>(entry.kind);
+        result.range.start = {static_cast<int>(entry.line), static_cast<int>(entry.column)};
+        result.range.end = {static_cast<int>(entry.endLine), static_cast<int>(entry.endColumn)};
+        result.score = scored.score;
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+bool SymbolSearchIndex::save(const std::string& file) const {
+    // Only live entries are written, renumbered in their current order so
+    // the posting lists stay sorted
+    std::vector<uint32_t> fileMap(files_.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<SearchFileRecord> files;
+    std::string strings;
+    for (const auto& live : fileIds_) {
+        const File& source = files_[live.getValue()];
+        fileMap[live.getValue()] = static_cast<uint32_t>(files.size());
+        files.push_back({static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(source.path.size()),
+                         source.contentHash, source.commandHash});
+        strings += source.path;
+    }
+
+    std::vector<uint32_t> entryMap(entries_.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<Entry> entries;
+    entries.reserve(size());
+    for (size_t id = 0; id < entries_.size(); ++id) {
+        Entry entry = entries_[id];
+        if (entry.flags & EntryDead) continue;
+        entryMap[id] = static_cast<uint32_t>(entries.size());
+        entry.file = fileMap[entry.file];
+        entry.nameOffset = static_cast<uint32_t>(strings.size());
+        strings += name(entries_[id]);
+        entries.push_back(entry);
+    }
+    if (strings.size() > std::numeric_limits<uint32_t>::max()) return false;
+
+    std::vector<SearchTokenRecord> tokens;
+    uint64_t postingCount = 0;
+    for (const auto& [value, list] : postings_) {
+        uint32_t count = 0;
+        for (uint32_t id : list) {
+            if (entryMap[id] != std::numeric_limits<uint32_t>::max()) ++count;
+        }
+        if (count == 0) continue;
+        tokens.push_back({value, count});
+        postingCount += count;
+    }
+    if (postingCount > std::numeric_limits<uint32_t>::max()) return false;
+
+    SearchHeader header = {};
+    std::memcpy(header.magic, kSearchMagic, sizeof(kSearchMagic));
+    header.version = kSearchFormatVersion;
+    header.fileCount = static_cast<uint32_t>(files.size());
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.tokenCount = static_cast<uint32_t>(tokens.size());
+    header.postingCount = static_cast<uint32_t>(postingCount);
+    header.stringTableSize = static_cast<uint32_t>(strings.size());
+
+    return writeFileAtomically(file, [&](llvm::raw_ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(files.data()), files.size() * sizeof(SearchFileRecord));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+        out.write(reinterpret_cast<const char*>(tokens.data()), tokens.size() * sizeof(SearchTokenRecord));
+        // postings_ iterates in the same order as above
+        std::vector<uint32_t> ids;
+        for (const auto& [value, list] : postings_) {
+            ids.clear();
+            for (uint32_t id : list) {
+                if (entryMap[id] != std::numeric_limits<uint32_t>::max()) ids.push_back(entryMap[id]);
+            }
+            out.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint32_t));
+        }
+        out.write(strings.data(), strings.size());
+    });
+}
+
+bool SymbolSearchIndex::load(const std::string& file) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+        llvm::MemoryBuffer::getFile(file, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) return false;
+
+    const char* data = (*buffer)->getBufferStart();
+    size_t size = (*buffer)->getBufferSize();
+    if (size < sizeof(SearchHeader)) return false;
+    SearchHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kSearchMagic, sizeof(kSearchMagic)) != 0 ||
+        header.version != kSearchFormatVersion) {
+        return false;
+    }
+
+    uint64_t fileBytes = uint64_t(header.fileCount) * sizeof(SearchFileRecord);
+    uint64_t entryBytes = uint64_t(header.entryCount) * sizeof(Entry);
+    uint64_t tokenBytes = uint64_t(header.tokenCount) * sizeof(SearchTokenRecord);
+    uint64_t postingBytes = uint64_t(header.postingCount) * sizeof(uint32_t);
+    if (sizeof(SearchHeader) + fileBytes + entryBytes + tokenBytes + postingBytes + header.stringTableSize != size) {
+        return false;
+    }
+
+    const char* cursor = data + sizeof(SearchHeader);
+    const auto* files = reinterpret_cast<const SearchFileRecord*>(cursor);
+    cursor += fileBytes;
+    const char* entries = cursor;
+    cursor += entryBytes;
+    const auto* tokens = reinterpret_cast<const SearchTokenRecord*>(cursor);
+    cursor += tokenBytes;
+    const char* postings = cursor;
+    cursor += postingBytes;
+    llvm::StringRef strings(cursor, header.stringTableSize);
+
+    SymbolSearchIndex loaded;
+    for (uint32_t i = 0; i < header.fileCount; ++i) {
+        if (uint64_t(files[i].pathOffset) + files[i].pathLength > strings.size()) return false;
+        File record;
+        record.path = strings.substr(files[i].pathOffset, files[i].pathLength).str();
+        record.contentHash = files[i].contentHash;
+        record.commandHash = files[i].commandHash;
+        loaded.fileIds_[record.path] = i;
+        loaded.files_.push_back(std::move(record));
+    }
+
+    loaded.names_ = strings.str();
+    loaded.entries_.resize(header.entryCount);
+    if (entryBytes) std::memcpy(loaded.entries_.data(), entries, entryBytes);
+    loaded.masks_.reserve(header.entryCount);
+    for (uint32_t id = 0; id < header.entryCount; ++id) {
+        const Entry& entry = loaded.entries_[id];
+        if (entry.file >= header.fileCount || uint64_t(entry.nameOffset) + entry.nameLength > strings.size() ||
+            (entry.flags & EntryDead)) {
+            return false;
+        }
+        loaded.masks_.push_back(characterMask(loaded.name(entry)));
+        loaded.files_[entry.file].entries.push_back(id);
+    }
+
+    uint64_t offset = 0;
+    loaded.postings_.reserve(header.tokenCount);
+    for (uint32_t i = 0; i < header.tokenCount; ++i) {
+        if (offset + tokens[i].count > header.postingCount) return false;
+        std::vector<uint32_t>& list = loaded.postings_[tokens[i].token];
+        list.resize(tokens[i].count);
+        std::memcpy(list.data(), postings + offset * sizeof(uint32_t), tokens[i].count * sizeof(uint32_t));
+        offset += tokens[i].count;
+        for (uint32_t id : list) {
+            if (id >= header.entryCount) return false;
+        }
+    }
+
+    *this = std::move(loaded);
+    return true;
+}
+
+} // namespace lsp
+} // namespace miko
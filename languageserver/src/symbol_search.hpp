@@ -0,0 +1,100 @@
+#pragma once
+
+#include "lsp_wrapper.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace miko {
+namespace lsp {
+
+class IndexShard;
+
+// One workspace symbol search hit
+struct SymbolSearchResult {
+    std::string name;
+    std::string path;
+    int kind = 0; // LSP SymbolKind
+    Range range;
+    float score = 0.0f;
+};
+
+// LSP SymbolKind for a clang::index::SymbolKind, 0 for kinds that are not
+// worth listing (parameters, template parameters, using declarations)
+int lspSymbolKind(uint32_t indexKind);
+
+// Name index over the symbols declared in every shard, for workspace/symbol.
+// Each name is broken into trigrams, both of consecutive characters and of
+// jumps to the next word start ("gfs" in "getFileSize"), plus its first one
+// and two characters for short queries. A query intersects the posting lists
+// of its own trigrams and only the survivors are scored by FuzzyMatcher, so
+// the work depends on how selective the query is rather than on the size of
+// the workspace. Not synchronized; SymbolIndex guards it with its own lock.
+class SymbolSearchIndex {
+public:
+    // Replaces the symbols indexed for the shard's file
+    void update(const IndexShard& shard);
+    void remove(llvm::StringRef path);
+    // True when path is indexed from a shard with these hashes
+    bool contains(llvm::StringRef path, uint64_t contentHash, uint64_t commandHash) const;
+    std::vector<std::string> paths() const;
+    size_t size() const { return entries_.size() - dead_; }
+
+    // At most limit matches for query, best first. A qualifier ("ns::name")
+    // is ignored; only the name is matched. Nothing once isCancelled()
+    // reports the request was cancelled.
+    std::vector<SymbolSearchResult> search(llvm::StringRef query, size_t limit,
+                                           const std::function<bool()>& isCancelled = nullptr) const;
+
+    // Stored next to the shards so a restart does not rebuild the postings
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+private:
+    // Also the on-disk entry layout
+    struct Entry {
+        uint32_t nameOffset; // into names_
+        uint32_t nameLength;
+        uint32_t file;       // into files_
+        uint32_t kind;       // LSP SymbolKind
+        uint32_t line;
+        uint32_t column;
+        uint32_t endLine;
+        uint32_t endColumn;
+        uint64_t usrHash;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Entry) == 48, "search index format changed");
+
+    struct File {
+        std::string path;
+        uint64_t contentHash = 0;
+        uint64_t commandHash = 0;
+        std::vector<uint32_t> entries;
+    };
+
+    enum EntryFlags : uint32_t { EntryDefinition = 1u << 0, EntryDead = 1u << 1 };
+
+    llvm::StringRef name(const Entry& entry) const {
+        return llvm::StringRef(names_).substr(entry.nameOffset, entry.nameLength);
+    }
+    void addEntry(Entry entry, llvm::StringRef name);
+    void compact();
+
+    std::vector<Entry> entries_;
+    std::vector<uint64_t> masks_; // characterMask() of each entry's name
+    std::string names_;
+    std::vector<File> files_;
+    llvm::StringMap<uint32_t> fileIds_;
+    // Token -> ascending entry ids; dead entries stay until compact()
+    llvm::DenseMap<uint32_t, std::vector<uint32_t>> postings_;
+    size_t dead_ = 0;
+};
+
+} // namespace lsp
+} // namespace miko
@@ -0,0 +1,126 @@
+// Binary IPC channel (window.cefBinaryQuery, bound by the renderer process).
+// Values travel as CBOR: ArrayBuffers and typed arrays as raw bytes, so file
+// contents and search results skip JSON encoding and string conversion.
+// Byte strings in responses arrive as ArrayBuffers.
+
+export type BinaryValue =
+  | null
+  | undefined
+  | boolean
+  | number
+  | string
+  | ArrayBuffer
+  | ArrayBufferView
+  | BinaryValue[]
+  | { [key: string]: BinaryValue };
+
+declare global {
+  interface Window {
+    cefBinaryQuery?: (method: string, value?: BinaryValue, signal?: AbortSignal) => Promise<unknown>;
+  }
+}
+
+export function isBinaryIpcAvailable(): boolean {
+  return typeof window !== 'undefined' && typeof window.cefBinaryQuery === 'function';
+}
+
+// Numeric ids of the native methods ("ipc_methods"). They stay the same for
+// the life of the process, so they are resolved once; calls made by id
+// ("#<id>") skip the name lookup on the native side.
+export interface MethodIds {
+  methods: Record<string, number>;
+  binary: Record<string, number>;
+}
+
+let methodIds: Promise<MethodIds> | null = null;
+let resolvedIds: MethodIds | null = null;
+
+export function resolveMethodIds(): Promise<MethodIds> {
+  if (!methodIds) {
+    methodIds = callString('ipc_call:ipc_methods:').then((text) => (resolvedIds = JSON.parse(text) as MethodIds));
+    methodIds.catch(() => {
+      methodIds = null;
+    });
+  }
+  return methodIds;
+}
+
+// "#<id>" once ids are resolved and the method has one, else the name
+export function methodKey(method: string, binary = false): string {
+  const id = resolvedIds?.[binary ? 'binary' : 'methods'][method];
+  return id === undefined ? method : `#${id}`;
+}
+
+// Calls a handler registered with IPCHandler::RegisterBinaryHandler.
+// Aborting the signal cancels the call on the native side too.
+export function callBinary<T = unknown>(method: string, value?: BinaryValue, signal?: AbortSignal): Promise<T> {
+  if (!window.cefBinaryQuery) {
+    return Promise.reject(new Error('Binary IPC not available'));
+  }
+  return window.cefBinaryQuery(methodKey(method, true), value, signal) as Promise<T>;
+}
+
+// Calls a handler registered with IPCHandler::RegisterHandler. The string
+// channel answers failures with an "Error: ..." string; they reject here
+// with the message, as callBinary's do.
+export async function callText(method: string, message = ''): Promise<string> {
+  const response = await callString(`ipc_call:${methodKey(method)}:${message}`);
+  if (response.startsWith('Error: ')) throw new Error(response.slice('Error: '.length));
+  return response;
+}
+
+export interface IpcBenchmarkResult {
+  size: number;
+  stringMs: number; // median round trip over cefQuery
+  binaryMs: number; // median round trip over cefBinaryQuery
+}
+
+function callString(request: string): Promise<string> {
+  return new Promise((resolve, reject) => {
+    if (!window.cefQuery) {
+      reject(new Error('CEF Query not available'));
+      return;
+    }
+    window.cefQuery({
+      request,
+      onSuccess: resolve,
+      onFailure: (_code: number, message: string) => reject(new Error(message))
+    });
+  });
+}
+
+function median(samples: number[]): number {
+  const sorted = [...samples].sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+}
+
+// Fetches size-byte payloads from the native side over both channels and
+// reports the median round trip, including the point where the page can
+// use the data (a string vs an ArrayBuffer). Run from the devtools console:
+//   (await import('/src/shared/binaryipc.ts')).benchmarkIpc()
+export async function benchmarkIpc(
+  sizes: number[] = [1 << 10, 64 << 10, 1 << 20, 16 << 20],
+  iterations = 10
+): Promise<IpcBenchmarkResult[]> {
+  const results: IpcBenchmarkResult[] = [];
+  await resolveMethodIds();
+  const stringMethod = methodKey('ipcBenchPayload');
+  for (const size of sizes) {
+    const stringSamples: number[] = [];
+    const binarySamples: number[] = [];
+    for (let i = 0; i < iterations; ++i) {
+      let start = performance.now();
+      const text = await callString(`ipc_call:${stringMethod}:${size}`);
+      stringSamples.push(performance.now() - start);
+      if (text.length !== size) throw new Error(`string path returned ${text.length} bytes`);
+
+      start = performance.now();
+      const reply = await callBinary<{ data: ArrayBuffer }>('ipcBenchPayload', { size });
+      binarySamples.push(performance.now() - start);
+      if (reply.data.byteLength !== size) throw new Error(`binary path returned ${reply.data.byteLength} bytes`);
+    }
+    results.push({ size, stringMs: median(stringSamples), binaryMs: median(binarySamples) });
+  }
+  console.table(results);
+  return results;
+}
@@ -0,0 +1,131 @@
+// Native event stream (SimpleIPC::EventBus). One persistent cefQuery per page
+// carries every subscribed topic. The native side coalesces events per frame
+// into one message and sends the next only after this side has run the
+// handlers and acknowledged, so a busy page receives fewer, larger batches.
+
+export interface EventInfo {
+  topic: string;
+  dropped: number; // batched events discarded while this page lagged behind
+}
+
+// events holds the topic's events since the last delivery: all of them for
+// batched topics, the latest per key for latest-wins ones
+export type EventHandler<T = unknown> = (events: T[], info: EventInfo) => void;
+
+interface EventMessage {
+  id: number;
+  seq: number;
+  events: { topic: string; data: unknown[]; dropped?: number }[];
+}
+
+interface PersistentCefQuery {
+  cefQuery?: (request: {
+    request: string;
+    persistent?: boolean;
+    onSuccess: (response: string) => void;
+    onFailure: (error_code: number, error_message: string) => void;
+  }) => number;
+  cefQueryCancel?: (id: number) => void;
+}
+
+const handlers = new Map<string, Set<EventHandler<any>>>();
+let queryId: number | null = null;
+let subscriptionId: number | null = null;
+let subscribedTopics = '';
+let topicsUpdateQueued = false;
+
+function cef(): PersistentCefQuery {
+  return window as unknown as PersistentCefQuery;
+}
+
+function send(request: string): void {
+  cef().cefQuery?.({ request, onSuccess: () => {}, onFailure: () => {} });
+}
+
+function topicList(): string {
+  return [...handlers.keys()].join(',');
+}
+
+// Same rules as the native side: exact names, "prefix.*" and "*"
+function matches(pattern: string, topic: string): boolean {
+  if (pattern === '*' || pattern === topic) return true;
+  return pattern.endsWith('.*') && topic.length > pattern.length - 1 && topic.startsWith(pattern.slice(0, -1));
+}
+
+function deliver(message: EventMessage): void {
+  subscriptionId = message.id;
+  if (message.seq === 0) {
+    // Subscriptions changed before the native side told us its id
+    if (subscribedTopics !== topicList()) updateTopics();
+    return;
+  }
+
+  for (const entry of message.events) {
+    const info = { topic: entry.topic, dropped: entry.dropped ?? 0 };
+    for (const [pattern, set] of handlers) {
+      if (!matches(pattern, entry.topic)) continue;
+      for (const handler of set) {
+        try {
+          handler(entry.data, info);
+        } catch (e) {
+          console.error(`Event handler for ${entry.topic} failed:`, e);
+        }
+      }
+    }
+  }
+  send(`event_ack:${message.id}:${message.seq}`);
+}
+
+function updateTopics(): void {
+  const api = cef();
+  if (!api.cefQuery) return;
+  const topics = topicList();
+
+  if (handlers.size === 0) {
+    if (queryId !== null) api.cefQueryCancel?.(queryId);
+    queryId = null;
+    subscriptionId = null;
+  } else if (queryId === null) {
+    queryId = api.cefQuery({
+      request: `event_subscribe:${topics}`,
+      persistent: true,
+      onSuccess: (response) => deliver(JSON.parse(response) as EventMessage),
+      onFailure: (_code, error) => {
+        console.error('Event subscription failed:', error);
+        queryId = null;
+        subscriptionId = null;
+      }
+    });
+  } else if (subscriptionId !== null) {
+    send(`event_topics:${subscriptionId}:${topics}`);
+  }
+  subscribedTopics = topics;
+}
+
+// Subscriptions made in the same task share one round trip
+function queueTopicsUpdate(): void {
+  if (topicsUpdateQueued) return;
+  topicsUpdateQueued = true;
+  queueMicrotask(() => {
+    topicsUpdateQueued = false;
+    updateTopics();
+  });
+}
+
+// Calls handler with every delivery for topic ("fs.changed", "build.*" or
+// "*"). Returns the unsubscribe function.
+export function subscribe<T = unknown>(topic: string, handler: EventHandler<T>): () => void {
+  let set = handlers.get(topic);
+  if (!set) {
+    set = new Set();
+    handlers.set(topic, set);
+    queueTopicsUpdate();
+  }
+  set.add(handler);
+
+  return () => {
+    if (!set || !set.delete(handler) || set.size > 0) return;
+    handlers.delete(topic);
+    queueTopicsUpdate();
+  };
+}
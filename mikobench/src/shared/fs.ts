@@ -0,0 +1,158 @@
+// Native file system (app/internal/fsservice.hpp) over the binary IPC
+// channel. Files are read in ranges from an open handle, so the first
+// screen of a large file shows after one small read instead of a copy of the
+// whole file; writes replace the file atomically. The workspace watcher
+// reports changes made outside the editor.
+
+import { callBinary, callText } from './binaryipc';
+import { subscribe } from './events';
+
+export type FileType = 'file' | 'dir' | 'other';
+
+export interface FileStat {
+  type: FileType;
+  size: number;
+  mtime: number | null; // ms since the epoch
+}
+
+export interface DirEntry {
+  name: string;
+  type: FileType;
+  size: number;
+}
+
+interface DirBatch {
+  entries: DirEntry[];
+  cursor: number | null; // continues the listing
+}
+
+interface ReadResponse {
+  data: ArrayBuffer;
+  size: number; // of the whole file
+  eof: boolean;
+}
+
+export const DEFAULT_CHUNK = 1 << 20;
+// Larger contents go in chunks of this size
+const WRITE_CHUNK = 4 << 20;
+
+export function stat(path: string): Promise<FileStat> {
+  return callBinary<FileStat>('fs.stat', { path });
+}
+
+// length bytes at offset, without keeping the file open
+export function readRange(path: string, offset: number, length: number, signal?: AbortSignal): Promise<ReadResponse> {
+  return callBinary<ReadResponse>('fs.read', { path, offset, length }, signal);
+}
+
+// The file in chunks, in order. The next chunk is requested while the
+// caller handles the current one. Breaking out of the loop closes the file.
+export async function* streamFile(
+  path: string,
+  chunkSize = DEFAULT_CHUNK,
+  signal?: AbortSignal
+): AsyncGenerator<{ data: Uint8Array; offset: number; size: number }> {
+  const { handle, size } = await callBinary<{ handle: number; size: number }>('fs.open', { path }, signal);
+  const read = (offset: number) => callBinary<ReadResponse>('fs.read', { handle, offset, length: chunkSize }, signal);
+  let next: Promise<ReadResponse> | null = read(0);
+  try {
+    let offset = 0;
+    while (next) {
+      const chunk = await next;
+      const data = new Uint8Array(chunk.data);
+      next = chunk.eof || data.byteLength === 0 ? null : read(offset + data.byteLength);
+      yield { data, offset, size };
+      offset += data.byteLength;
+    }
+  } finally {
+    // A prefetch the caller no longer wants
+    next?.catch(() => {});
+    callBinary('fs.close', { handle }).catch(() => {});
+  }
+}
+
+// Decodes the file as UTF-8. onChunk gets the text of every chunk as it
+// arrives, so a view can render the beginning while the rest loads.
+export async function readTextFile(
+  path: string,
+  onChunk?: (text: string, loaded: number, size: number) => void,
+  signal?: AbortSignal
+): Promise<string> {
+  const decoder = new TextDecoder();
+  const parts: string[] = [];
+  for await (const chunk of streamFile(path, DEFAULT_CHUNK, signal)) {
+    // stream: a character split across chunks is decoded with the next one
+    const text = decoder.decode(chunk.data, { stream: true });
+    parts.push(text);
+    onChunk?.(text, chunk.offset + chunk.data.byteLength, chunk.size);
+  }
+  parts.push(decoder.decode());
+  return parts.join('');
+}
+
+// Replaces the file's content; it holds either the old or the new content,
+// never a mix, even if the app dies midway
+export async function writeFile(path: string, content: string | Uint8Array): Promise<void> {
+  const bytes = typeof content === 'string' ? new TextEncoder().encode(content) : content;
+  if (bytes.byteLength <= WRITE_CHUNK) {
+    await callBinary('fs.write', { path, data: bytes });
+    return;
+  }
+
+  const { handle } = await callBinary<{ handle: number }>('fs.writeBegin', { path });
+  try {
+    for (let offset = 0; offset < bytes.byteLength; offset += WRITE_CHUNK) {
+      await callBinary('fs.writeChunk', { handle, data: bytes.subarray(offset, offset + WRITE_CHUNK) });
+    }
+    await callBinary('fs.writeCommit', { handle });
+  } catch (e) {
+    callBinary('fs.writeAbort', { handle }).catch(() => {});
+    throw e;
+  }
+}
+
+// The directory's entries, in batches of up to limit, in no particular order
+export async function* readDir(path: string, limit = 500): AsyncGenerator<DirEntry[]> {
+  let response = await callBinary<DirBatch>('fs.readdir', { path, limit });
+  try {
+    for (;;) {
+      yield response.entries;
+      if (response.cursor === null) return;
+      response = await callBinary<DirBatch>('fs.readdir', { cursor: response.cursor, limit });
+    }
+  } finally {
+    if (response.cursor !== null) callBinary('fs.close', { handle: response.cursor }).catch(() => {});
+  }
+}
+
+// LSP FileChangeType values
+export const FileChangeType = { Created: 1, Changed: 2, Deleted: 3 } as const;
+export type FileChangeType = (typeof FileChangeType)[keyof typeof FileChangeType];
+
+export interface FileChange {
+  path: string;
+  type: FileChangeType;
+}
+
+export interface WatchStatus {
+  root: string | null;
+  watches?: number;
+  excluded?: number;
+  unwatched?: number; // directories past the OS watch limit, not watched
+  ready?: boolean;
+}
+
+// Watches root recursively, replacing the previous workspace; '' stops
+export async function watchWorkspace(root: string): Promise<WatchStatus> {
+  return JSON.parse(await callText('fs.watch', root)) as WatchStatus;
+}
+
+// Calls handler with the changes coalesced since the last call. With
+// overflow set some changes were lost and anything may have changed, so
+// views should reload what they show.
+export function onFilesChanged(handler: (changes: FileChange[], overflow: boolean) => void): () => void {
+  return subscribe<{ changes: FileChange[]; overflow: boolean }>('fs.changed', (events, info) => {
+    const changes = events.flatMap((event) => event.changes);
+    handler(changes, info.dropped > 0 || events.some((event) => event.overflow));
+  });
+}
@@ -0,0 +1,57 @@
+#include "../../app/toolchain/compiledb.hpp"
+#include <cstdio>
+
+using Hyperion::Toolchain::CompilationDatabase;
+
+static int failures = 0;
+
+static void Expect(bool condition, const char *what) {
+  if (!condition) {
+    std::printf("FAIL: %s\n", what);
+    ++failures;
+  }
+}
+
+int main() {
+  // Compiler drivers
+  const char *compilers[] = {
+      "gcc",      "g++",        "cc",       "clang",
+      "clang++",  "clang-cl",   "cl.exe",   "/usr/bin/gcc-13",
+      "clang-18", "clang++-18", "g++-12.2", "x86_64-w64-mingw32-g++",
+      "aarch64-linux-gnu-gcc-12"};
+  for (const char *command : compilers) {
+    Expect(CompilationDatabase::IsCompilerCommand(command), command);
+  }
+
+  // Tools that share a driver's prefix
+  const char *tools[] = {"clang-format",    "clang-tidy",    "clang-check",
+                         "clang-format-18", "clang-tidy-17", "gcc-ar",
+                         "gcc-nm",          "gcc-ranlib",    "gcc-ar-13",
+                         "ld",              "clangd",        "cmake"};
+  for (const char *command : tools) {
+    Expect(!CompilationDatabase::IsCompilerCommand(command), command);
+  }
+
+  // clang-format and clang-tidy runs leave the recorded flags alone
+  CompilationDatabase db;
+  Expect(db.RecordInvocation("/src", "clang++",
+                             {"-std=c++17", "-DREAL", "-c", "foo.cpp"}) == 1,
+         "compile recorded");
+  Expect(db.RecordInvocation("/src", "clang-format", {"-i", "foo.cpp"}) == 0,
+         "clang-format not recorded");
+  Expect(db.RecordInvocation("/src", "clang-tidy", {"foo.cpp", "--"}) == 0,
+         "clang-tidy not recorded");
+  const auto *entry = db.Find("foo.cpp", "/src");
+  bool kept = false;
+  if (entry) {
+    for (const std::string &arg : entry->arguments) {
+      kept = kept || arg == "-DREAL";
+    }
+  }
+  Expect(kept, "compile flags kept");
+
+  if (failures == 0) {
+    std::printf("compiledb: all checks passed\n");
+  }
+  return failures == 0 ? 0 : 1;
+}